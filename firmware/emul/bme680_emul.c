@@ -0,0 +1,567 @@
+/*
+ * I2C emulator for the BME688 behind the bosch,bme680 driver, for native_sim.
+ *
+ * Implements the registers the patched driver touches: chip/variant ID, calibration
+ * (COEFF1..3), ctrl_hum/ctrl_meas/ctrl_gas, heater set-points and the three data
+ * fields. Every forced conversion (or parallel-mode field read) takes the next row of
+ * a CSV trace built into the image (CONFIG_AIR_CTRL_BME680_EMUL_TRACE):
+ *
+ *  - physical values, as written by logging/air_ctrl_stream.py
+ *    (temp_raw_c, hum_raw_rh, press_raw_pa, gas_raw_ohm), turned back into ADC
+ *    counts with the inverse of the driver's compensation, or
+ *  - raw ADC values (adc_temp, adc_press, adc_hum, adc_gas, gas_range).
+ */
+
+#define DT_DRV_COMPAT bosch_bme680
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/emul.h>
+#include <zephyr/drivers/i2c.h>
+#include <zephyr/drivers/i2c_emul.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+LOG_MODULE_REGISTER(bme680_emul, LOG_LEVEL_INF);
+
+#define REG_RES_HEAT_VAL 0x00
+#define REG_RES_HEAT_RANGE 0x02
+#define REG_RANGE_SW_ERR 0x04
+#define REG_FIELD0_STATUS 0x1d
+#define FIELD_STRIDE 0x11
+#define NUM_FIELDS 3
+#define REG_CTRL_GAS_1 0x71
+#define REG_CTRL_MEAS 0x74
+#define REG_COEFF1 0x8a
+#define REG_CHIP_ID 0xd0
+#define REG_SOFT_RESET 0xe0
+#define REG_COEFF2 0xe1
+#define REG_VARIANT 0xf0
+
+#define CHIP_ID 0x61
+#define VARIANT_BME688 0x01
+#define SOFT_RESET_CMD 0xb6
+
+#define MODE_MASK 0x03
+#define MODE_SLEEP 0x00
+#define MODE_FORCED 0x01
+#define MODE_PARALLEL 0x02
+
+#define STATUS_NEW_DATA 0x80
+#define GAS_VALID 0x20
+#define HEATR_STAB 0x10
+
+/* Field offsets from the status register */
+#define FIELD_MEAS_INDEX 1
+#define FIELD_PRESS 2
+#define FIELD_TEMP 5
+#define FIELD_HUM 8
+#define FIELD_GAS_L 13
+#define FIELD_GAS_H 15
+
+/* Calibration of a real BME680, used both for the registers and for the inverse model */
+struct bme680_emul_calib {
+	uint16_t par_t1;
+	int16_t par_t2;
+	int8_t par_t3;
+	uint16_t par_p1;
+	int16_t par_p2;
+	int8_t par_p3;
+	int16_t par_p4;
+	int16_t par_p5;
+	int8_t par_p6;
+	int8_t par_p7;
+	int16_t par_p8;
+	int16_t par_p9;
+	uint8_t par_p10;
+	uint16_t par_h1;
+	uint16_t par_h2;
+	int8_t par_h3;
+	int8_t par_h4;
+	int8_t par_h5;
+	uint8_t par_h6;
+	int8_t par_h7;
+	int8_t par_gh1;
+	int16_t par_gh2;
+	int8_t par_gh3;
+	uint8_t res_heat_range;
+	int8_t res_heat_val;
+};
+
+static const struct bme680_emul_calib calib = {
+	.par_t1 = 26163, .par_t2 = 26446, .par_t3 = 3,
+	.par_p1 = 36228, .par_p2 = -10390, .par_p3 = 88, .par_p4 = 6853, .par_p5 = -118,
+	.par_p6 = 30, .par_p7 = 30, .par_p8 = -3560, .par_p9 = -2414, .par_p10 = 30,
+	.par_h1 = 735, .par_h2 = 1041, .par_h3 = 0, .par_h4 = 45, .par_h5 = 20,
+	.par_h6 = 120, .par_h7 = -100,
+	.par_gh1 = -39, .par_gh2 = -14103, .par_gh3 = 18,
+	.res_heat_range = 1, .res_heat_val = 48,
+};
+
+/* Forward compensation, same integer math as the driver */
+static int32_t comp_temp(uint32_t adc_temp, int32_t *t_fine)
+{
+	int64_t var1, var2, var3;
+
+	var1 = ((int32_t)adc_temp >> 3) - ((int32_t)calib.par_t1 << 1);
+	var2 = (var1 * (int32_t)calib.par_t2) >> 11;
+	var3 = ((var1 >> 1) * (var1 >> 1)) >> 12;
+	var3 = ((var3) * ((int32_t)calib.par_t3 << 4)) >> 14;
+	*t_fine = (int32_t)(var2 + var3);
+
+	return ((*t_fine * 5) + 128) >> 8;
+}
+
+static int32_t comp_press(uint32_t adc_press, int32_t t_fine)
+{
+	int32_t var1, var2, var3, calc_press;
+
+	var1 = (t_fine >> 1) - 64000;
+	var2 = ((((var1 >> 2) * (var1 >> 2)) >> 11) * (int32_t)calib.par_p6) >> 2;
+	var2 = var2 + ((var1 * (int32_t)calib.par_p5) << 1);
+	var2 = (var2 >> 2) + ((int32_t)calib.par_p4 << 16);
+	var1 = (((((var1 >> 2) * (var1 >> 2)) >> 13) * ((int32_t)calib.par_p3 << 5)) >> 3) +
+	       (((int32_t)calib.par_p2 * var1) >> 1);
+	var1 = var1 >> 18;
+	var1 = ((32768 + var1) * (int32_t)calib.par_p1) >> 15;
+	calc_press = 1048576 - (int32_t)adc_press;
+	calc_press = (int32_t)((calc_press - (var2 >> 12)) * ((uint32_t)3125));
+	if (calc_press >= (int32_t)0x40000000) {
+		calc_press = ((calc_press / var1) << 1);
+	} else {
+		calc_press = ((calc_press << 1) / var1);
+	}
+	var1 = ((int32_t)calib.par_p9 * (int32_t)(((calc_press >> 3) * (calc_press >> 3)) >> 13)) >> 12;
+	var2 = ((int32_t)(calc_press >> 2) * (int32_t)calib.par_p8) >> 13;
+	var3 = ((int32_t)(calc_press >> 8) * (int32_t)(calc_press >> 8) * (int32_t)(calc_press >> 8) *
+		(int32_t)calib.par_p10) >> 17;
+
+	return calc_press + ((var1 + var2 + var3 + ((int32_t)calib.par_p7 << 7)) >> 4);
+}
+
+static int32_t comp_hum(uint16_t adc_hum, int32_t temp_x100)
+{
+	int32_t var1, var2, var3, var4, var5, var6, calc_hum;
+
+	var1 = (int32_t)adc_hum - (int32_t)((int32_t)calib.par_h1 << 4) -
+	       (((temp_x100 * (int32_t)calib.par_h3) / ((int32_t)100)) >> 1);
+	var2 = ((int32_t)calib.par_h2 *
+		(((temp_x100 * (int32_t)calib.par_h4) / ((int32_t)100)) +
+		 (((temp_x100 * ((temp_x100 * (int32_t)calib.par_h5) / ((int32_t)100))) >> 6) /
+		  ((int32_t)100)) +
+		 ((int32_t)(1 << 14)))) >> 10;
+	var3 = var1 * var2;
+	var4 = (((int32_t)calib.par_h6 << 7) + ((temp_x100 * (int32_t)calib.par_h7) / ((int32_t)100))) >> 4;
+	var5 = ((var3 >> 14) * (var3 >> 14)) >> 10;
+	var6 = (var4 * var5) >> 1;
+	calc_hum = (((var3 + var6) >> 10) * ((int32_t)1000)) >> 12;
+
+	return CLAMP(calc_hum, 0, 100000);
+}
+
+/* Smallest ADC value in [lo, hi] whose compensated value reaches target (rising model) */
+#define INVERT_RISING(lo, hi, target, expr)                                                        \
+	({                                                                                         \
+		uint32_t _lo = (lo), _hi = (hi);                                                   \
+		while (_lo < _hi) {                                                                \
+			uint32_t adc = _lo + (_hi - _lo) / 2U;                                     \
+			if ((expr) < (target)) {                                                   \
+				_lo = adc + 1U;                                                    \
+			} else {                                                                   \
+				_hi = adc;                                                         \
+			}                                                                          \
+		}                                                                                  \
+		_lo;                                                                               \
+	})
+
+static uint32_t adc_from_temp(int32_t temp_x100)
+{
+	int32_t t_fine;
+
+	return INVERT_RISING(0U, 0xfffffU, temp_x100, comp_temp(adc, &t_fine));
+}
+
+static uint32_t adc_from_press(int32_t press_pa, int32_t t_fine)
+{
+	/* Pressure falls as the ADC value rises */
+	return INVERT_RISING(0U, 0xfffffU, -press_pa, -comp_press(adc, t_fine));
+}
+
+static uint16_t adc_from_hum(int32_t hum_x1000, int32_t temp_x100)
+{
+	return (uint16_t)INVERT_RISING(0U, 0xffffU, hum_x1000, comp_hum((uint16_t)adc, temp_x100));
+}
+
+/* BME688: R = 1e6 * (262144 >> range) / (4096 + 3 * (adc - 512)), pick the range that fits */
+static void gas_adc_from_ohm(uint32_t gas_ohm, uint16_t *adc, uint8_t *range)
+{
+	for (uint8_t r = 0; r < 16; r++) {
+		int64_t div = (1000000LL * (262144 >> r)) / MAX(gas_ohm, 1U);
+		int64_t a = (div - 4096) / 3 + 512;
+
+		if (a <= 1023 || r == 15) {
+			*adc = (uint16_t)CLAMP(a, 0, 1023);
+			*range = r;
+			return;
+		}
+	}
+}
+
+static const uint8_t trace_csv[] = {
+#include "bme680_emul_trace.csv.inc"
+};
+
+enum trace_col {
+	COL_TEMP,
+	COL_HUM,
+	COL_PRESS,
+	COL_GAS,
+	COL_ADC_TEMP,
+	COL_ADC_PRESS,
+	COL_ADC_HUM,
+	COL_ADC_GAS,
+	COL_GAS_RANGE,
+	COL_COUNT,
+};
+
+static const char *const trace_col_names[COL_COUNT] = {
+	[COL_TEMP] = "temp_raw_c",
+	[COL_HUM] = "hum_raw_rh",
+	[COL_PRESS] = "press_raw_pa",
+	[COL_GAS] = "gas_raw_ohm",
+	[COL_ADC_TEMP] = "adc_temp",
+	[COL_ADC_PRESS] = "adc_press",
+	[COL_ADC_HUM] = "adc_hum",
+	[COL_ADC_GAS] = "adc_gas",
+	[COL_GAS_RANGE] = "gas_range",
+};
+
+struct bme680_emul_data {
+	uint8_t regs[256];
+	uint8_t cur_reg;
+
+	/* CSV column index for each trace_col, -1 if absent */
+	int8_t col[COL_COUNT];
+	bool raw_trace;
+	size_t data_start;
+	size_t pos;
+
+	uint8_t meas_index;
+	uint8_t gas_index;
+	uint32_t conversions;
+};
+
+struct bme680_emul_cfg {
+	uint16_t addr;
+};
+
+struct bme680_emul_adc {
+	uint32_t temp;
+	uint32_t press;
+	uint16_t hum;
+	uint16_t gas;
+	uint8_t gas_range;
+};
+
+static size_t line_end(size_t pos)
+{
+	while (pos < sizeof(trace_csv) && trace_csv[pos] != '\n') {
+		pos++;
+	}
+
+	return pos;
+}
+
+/* Copy one CSV line into buf (NUL terminated) and return the start of the next line */
+static size_t read_line(size_t pos, char *buf, size_t len)
+{
+	size_t end = line_end(pos);
+	size_t n = MIN(end - pos, len - 1);
+
+	memcpy(buf, &trace_csv[pos], n);
+	buf[n] = '\0';
+	if (n > 0 && buf[n - 1] == '\r') {
+		buf[n - 1] = '\0';
+	}
+
+	return MIN(end + 1, sizeof(trace_csv));
+}
+
+static int parse_header(struct bme680_emul_data *data)
+{
+	char line[512];
+	char *save;
+	char *tok;
+	int idx = 0;
+
+	memset(data->col, -1, sizeof(data->col));
+	data->data_start = read_line(0, line, sizeof(line));
+
+	for (tok = strtok_r(line, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save), idx++) {
+		while (*tok == ' ') {
+			tok++;
+		}
+		for (int c = 0; c < COL_COUNT; c++) {
+			if (strcmp(tok, trace_col_names[c]) == 0) {
+				data->col[c] = (int8_t)idx;
+			}
+		}
+	}
+
+	if (data->col[COL_ADC_TEMP] >= 0 && data->col[COL_ADC_PRESS] >= 0 &&
+	    data->col[COL_ADC_HUM] >= 0 && data->col[COL_ADC_GAS] >= 0 &&
+	    data->col[COL_GAS_RANGE] >= 0) {
+		data->raw_trace = true;
+	} else if (data->col[COL_TEMP] < 0 || data->col[COL_HUM] < 0 ||
+		   data->col[COL_PRESS] < 0 || data->col[COL_GAS] < 0) {
+		return -EINVAL;
+	}
+
+	if (data->data_start >= sizeof(trace_csv)) {
+		return -ENODATA;
+	}
+
+	data->pos = data->data_start;
+
+	return 0;
+}
+
+/* Next trace row as ADC values, wrapping around at the end of the trace */
+static void next_sample(struct bme680_emul_data *data, struct bme680_emul_adc *adc)
+{
+	double v[COL_COUNT] = {0};
+	char line[512];
+	char *save;
+	char *tok;
+	int idx = 0;
+
+	do {
+		if (data->pos >= sizeof(trace_csv)) {
+			data->pos = data->data_start;
+		}
+		data->pos = read_line(data->pos, line, sizeof(line));
+	} while (line[0] == '\0' || line[0] == '#');
+
+	for (tok = strtok_r(line, ",", &save); tok != NULL; tok = strtok_r(NULL, ",", &save), idx++) {
+		for (int c = 0; c < COL_COUNT; c++) {
+			if (data->col[c] == idx) {
+				v[c] = strtod(tok, NULL);
+			}
+		}
+	}
+
+	if (data->raw_trace) {
+		adc->temp = (uint32_t)v[COL_ADC_TEMP];
+		adc->press = (uint32_t)v[COL_ADC_PRESS];
+		adc->hum = (uint16_t)v[COL_ADC_HUM];
+		adc->gas = (uint16_t)v[COL_ADC_GAS];
+		adc->gas_range = (uint8_t)v[COL_GAS_RANGE];
+	} else {
+		int32_t temp_x100 = (int32_t)(v[COL_TEMP] * 100.0);
+		int32_t t_fine;
+
+		adc->temp = adc_from_temp(temp_x100);
+		temp_x100 = comp_temp(adc->temp, &t_fine);
+		adc->press = adc_from_press((int32_t)v[COL_PRESS], t_fine);
+		adc->hum = adc_from_hum((int32_t)(v[COL_HUM] * 1000.0), temp_x100);
+		gas_adc_from_ohm((uint32_t)v[COL_GAS], &adc->gas, &adc->gas_range);
+	}
+}
+
+static void fill_field(struct bme680_emul_data *data, uint8_t field)
+{
+	uint8_t *f = &data->regs[REG_FIELD0_STATUS + field * FIELD_STRIDE];
+	uint8_t nb_conv = data->regs[REG_CTRL_GAS_1] & 0x0f;
+	bool parallel = (data->regs[REG_CTRL_MEAS] & MODE_MASK) == MODE_PARALLEL;
+	struct bme680_emul_adc adc;
+	uint8_t gas_lsb;
+
+	next_sample(data, &adc);
+
+	/* Forced mode: nb_conv selects the heater set-point. Parallel: number of steps. */
+	if (!parallel) {
+		data->gas_index = nb_conv;
+	}
+
+	f[0] = STATUS_NEW_DATA | (data->gas_index & 0x0f);
+	f[FIELD_MEAS_INDEX] = data->meas_index++;
+	f[FIELD_PRESS] = (uint8_t)(adc.press >> 12);
+	f[FIELD_PRESS + 1] = (uint8_t)(adc.press >> 4);
+	f[FIELD_PRESS + 2] = (uint8_t)((adc.press & 0x0f) << 4);
+	f[FIELD_TEMP] = (uint8_t)(adc.temp >> 12);
+	f[FIELD_TEMP + 1] = (uint8_t)(adc.temp >> 4);
+	f[FIELD_TEMP + 2] = (uint8_t)((adc.temp & 0x0f) << 4);
+	sys_put_be16(adc.hum, &f[FIELD_HUM]);
+
+	/* Written at both the BME680 and the BME688 gas register positions */
+	gas_lsb = (uint8_t)((adc.gas & 0x03) << 6) | GAS_VALID | HEATR_STAB | (adc.gas_range & 0x0f);
+	f[FIELD_GAS_L] = (uint8_t)(adc.gas >> 2);
+	f[FIELD_GAS_L + 1] = gas_lsb;
+	f[FIELD_GAS_H] = (uint8_t)(adc.gas >> 2);
+	f[FIELD_GAS_H + 1] = gas_lsb;
+
+	if (parallel) {
+		data->gas_index = (data->gas_index + 1U) % MAX(nb_conv, 1U);
+	}
+	data->conversions++;
+}
+
+static void reset_regs(struct bme680_emul_data *data)
+{
+	uint8_t *r = data->regs;
+
+	memset(r, 0, sizeof(data->regs));
+	r[REG_CHIP_ID] = CHIP_ID;
+	r[REG_VARIANT] = VARIANT_BME688;
+
+	r[REG_RES_HEAT_VAL] = (uint8_t)calib.res_heat_val;
+	r[REG_RES_HEAT_RANGE] = (uint8_t)(calib.res_heat_range << 4);
+	r[REG_RANGE_SW_ERR] = 0;
+
+	/* COEFF1 (0x8a..0xa0) */
+	sys_put_le16((uint16_t)calib.par_t2, &r[0x8a]);
+	r[0x8c] = (uint8_t)calib.par_t3;
+	sys_put_le16(calib.par_p1, &r[0x8e]);
+	sys_put_le16((uint16_t)calib.par_p2, &r[0x90]);
+	r[0x92] = (uint8_t)calib.par_p3;
+	sys_put_le16((uint16_t)calib.par_p4, &r[0x94]);
+	sys_put_le16((uint16_t)calib.par_p5, &r[0x96]);
+	r[0x98] = (uint8_t)calib.par_p7;
+	r[0x99] = (uint8_t)calib.par_p6;
+	sys_put_le16((uint16_t)calib.par_p8, &r[0x9c]);
+	sys_put_le16((uint16_t)calib.par_p9, &r[0x9e]);
+	r[0xa0] = calib.par_p10;
+
+	/* COEFF2 (0xe1..0xee) */
+	r[0xe1] = (uint8_t)(calib.par_h2 >> 4);
+	r[0xe2] = (uint8_t)((calib.par_h2 & 0x0f) << 4) | (calib.par_h1 & 0x0f);
+	r[0xe3] = (uint8_t)(calib.par_h1 >> 4);
+	r[0xe4] = (uint8_t)calib.par_h3;
+	r[0xe5] = (uint8_t)calib.par_h4;
+	r[0xe6] = (uint8_t)calib.par_h5;
+	r[0xe7] = calib.par_h6;
+	r[0xe8] = (uint8_t)calib.par_h7;
+	sys_put_le16(calib.par_t1, &r[0xe9]);
+	sys_put_le16((uint16_t)calib.par_gh2, &r[0xeb]);
+	r[0xed] = (uint8_t)calib.par_gh1;
+	r[0xee] = (uint8_t)calib.par_gh3;
+
+	data->gas_index = 0;
+}
+
+static void reg_write(struct bme680_emul_data *data, uint8_t reg, uint8_t val)
+{
+	switch (reg) {
+	case REG_SOFT_RESET:
+		if (val == SOFT_RESET_CMD) {
+			reset_regs(data);
+		}
+		return;
+	case REG_CHIP_ID:
+	case REG_VARIANT:
+		return;
+	case REG_CTRL_MEAS:
+		data->regs[reg] = val;
+		if ((val & MODE_MASK) == MODE_FORCED) {
+			/* Conversion finishes instantly, the sensor drops back to sleep */
+			fill_field(data, 0);
+			data->regs[reg] &= ~MODE_MASK;
+		} else if ((val & MODE_MASK) == MODE_PARALLEL) {
+			data->gas_index = 0;
+		}
+		return;
+	default:
+		data->regs[reg] = val;
+		return;
+	}
+}
+
+static void reg_read_start(struct bme680_emul_data *data, uint8_t reg)
+{
+	/* Parallel mode: a read from a field's status register sees a fresh conversion */
+	if ((data->regs[REG_CTRL_MEAS] & MODE_MASK) != MODE_PARALLEL) {
+		return;
+	}
+
+	for (uint8_t i = 0; i < NUM_FIELDS; i++) {
+		if (reg == REG_FIELD0_STATUS + i * FIELD_STRIDE) {
+			fill_field(data, i);
+		}
+	}
+}
+
+static int bme680_emul_transfer_i2c(const struct emul *target, struct i2c_msg *msgs, int num_msgs,
+				    int addr)
+{
+	struct bme680_emul_data *data = target->data;
+
+	ARG_UNUSED(addr);
+
+	for (int i = 0; i < num_msgs; i++) {
+		struct i2c_msg *msg = &msgs[i];
+
+		if ((msg->flags & I2C_MSG_READ) != 0U) {
+			reg_read_start(data, data->cur_reg);
+			for (uint32_t j = 0; j < msg->len; j++) {
+				msg->buf[j] = data->regs[(uint8_t)(data->cur_reg + j)];
+			}
+			data->cur_reg += msg->len;
+			continue;
+		}
+
+		if (msg->len == 0) {
+			continue;
+		}
+
+		/* First byte is the register address, then (reg, value) pairs */
+		data->cur_reg = msg->buf[0];
+		if (msg->len >= 2) {
+			reg_write(data, msg->buf[0], msg->buf[1]);
+			for (uint32_t j = 2; j + 1 < msg->len; j += 2) {
+				reg_write(data, msg->buf[j], msg->buf[j + 1]);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static const struct i2c_emul_api bme680_emul_api_i2c = {
+	.transfer = bme680_emul_transfer_i2c,
+};
+
+static int bme680_emul_init(const struct emul *target, const struct device *parent)
+{
+	struct bme680_emul_data *data = target->data;
+	int err;
+
+	ARG_UNUSED(parent);
+
+	reset_regs(data);
+
+	err = parse_header(data);
+	if (err) {
+		LOG_ERR("Trace needs temp_raw_c,hum_raw_rh,press_raw_pa,gas_raw_ohm or "
+			"adc_temp,adc_press,adc_hum,adc_gas,gas_range columns");
+		return err;
+	}
+
+	LOG_INF("Replaying %s trace (%u bytes)", data->raw_trace ? "ADC" : "physical",
+		(uint32_t)sizeof(trace_csv));
+
+	return 0;
+}
+
+#define BME680_EMUL(n)                                                                             \
+	static struct bme680_emul_data bme680_emul_data_##n;                                       \
+	static const struct bme680_emul_cfg bme680_emul_cfg_##n = {                                \
+		.addr = DT_INST_REG_ADDR(n),                                                       \
+	};                                                                                         \
+	EMUL_DT_INST_DEFINE(n, bme680_emul_init, &bme680_emul_data_##n, &bme680_emul_cfg_##n,      \
+			    &bme680_emul_api_i2c, NULL)
+
+DT_INST_FOREACH_STATUS_OKAY(BME680_EMUL)
@@ -0,0 +1,105 @@
+#include "air_ctrl_codec.h"
+
+int air_ctrl_codec_abi(void)
+{
+	return AIR_CTRL_CODEC_ABI;
+}
+
+size_t air_ctrl_codec_sizeof_sample(void)
+{
+	return sizeof(struct air_ctrl_ble_sample);
+}
+
+size_t air_ctrl_codec_sizeof_agg(void)
+{
+	return sizeof(struct air_ctrl_ble_agg);
+}
+
+size_t air_ctrl_codec_sizeof_alert(void)
+{
+	return sizeof(struct air_ctrl_ble_alert);
+}
+
+size_t air_ctrl_codec_sizeof_rtt_sample(void)
+{
+	return sizeof(struct air_ctrl_rtt_sample);
+}
+
+size_t air_ctrl_codec_sizeof_rtt_scan(void)
+{
+	return sizeof(struct air_ctrl_rtt_scan);
+}
+
+uint16_t air_ctrl_codec_versions(void)
+{
+	return AIR_CTRL_BLE_VERSIONS;
+}
+
+int air_ctrl_codec_negotiate(uint16_t offered, uint16_t ours, uint16_t *accepted)
+{
+	return air_ctrl_ble_negotiate(offered, ours, accepted);
+}
+
+int air_ctrl_codec_decode_protocol(const uint8_t *buf, size_t len, uint16_t *versions)
+{
+	return air_ctrl_ble_decode_protocol(buf, len, versions);
+}
+
+void air_ctrl_codec_encode_protocol(uint16_t versions, uint8_t *buf)
+{
+	struct air_ctrl_ble_protocol protocol;
+
+	air_ctrl_ble_encode_protocol(versions, &protocol);
+	memcpy(buf, &protocol, sizeof(protocol));
+}
+
+int air_ctrl_codec_decode_sample(const uint8_t *buf, size_t len,
+				 struct air_ctrl_ble_sample *sample)
+{
+	return air_ctrl_ble_decode_sample(buf, len, sample);
+}
+
+uint16_t air_ctrl_codec_sample_lost(uint16_t prev_seq, const struct air_ctrl_ble_sample *sample)
+{
+	return air_ctrl_ble_sample_lost(prev_seq, sample);
+}
+
+int air_ctrl_codec_decode_batch(const uint8_t *buf, size_t len,
+				struct air_ctrl_ble_sample *samples, size_t max_samples)
+{
+	return air_ctrl_ble_decode_batch(buf, len, samples, max_samples);
+}
+
+int air_ctrl_codec_decode_history(const uint8_t *buf, size_t len, uint8_t *flags,
+				  struct air_ctrl_ble_sample *samples, size_t max_samples)
+{
+	return air_ctrl_ble_decode_history(buf, len, flags, samples, max_samples);
+}
+
+int air_ctrl_codec_decode_agg(const uint8_t *buf, size_t len, struct air_ctrl_ble_agg *aggs,
+			      size_t max_aggs)
+{
+	return air_ctrl_ble_decode_agg(buf, len, aggs, max_aggs);
+}
+
+int air_ctrl_codec_decode_alert(const uint8_t *buf, size_t len, struct air_ctrl_ble_alert *alert)
+{
+	return air_ctrl_ble_decode_alert(buf, len, alert);
+}
+
+int air_ctrl_codec_decode_adv(const uint8_t *buf, size_t len, struct air_ctrl_ble_sample *sample)
+{
+	return air_ctrl_ble_decode_adv(buf, len, sample);
+}
+
+int air_ctrl_codec_rtt_decode_frame(const uint8_t *buf, size_t len,
+				    struct air_ctrl_rtt_sample *sample)
+{
+	return air_ctrl_rtt_decode_frame(buf, len, sample);
+}
+
+size_t air_ctrl_codec_rtt_scan(const uint8_t *buf, size_t len, struct air_ctrl_rtt_sample *samples,
+			       size_t max_samples, struct air_ctrl_rtt_scan *scan)
+{
+	return air_ctrl_rtt_scan(buf, len, samples, max_samples, scan);
+}
@@ -0,0 +1,63 @@
+#ifndef AIR_CTRL_CODEC_H_
+#define AIR_CTRL_CODEC_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "air_ctrl_ble_codec.h"
+#include "air_ctrl_rtt_codec.h"
+
+/* Exported entry points of libair_ctrl_codec, for gateways that link the codec instead of
+ * compiling the headers in, and for logging/air_ctrl_codec.py (ctypes). Each one calls the
+ * header function of the same name, with the same arguments and return values.
+ */
+
+#define AIR_CTRL_CODEC_API __attribute__((visibility("default")))
+
+/* Bumped when a struct below changes layout */
+#define AIR_CTRL_CODEC_ABI 1
+
+AIR_CTRL_CODEC_API int air_ctrl_codec_abi(void);
+
+/* sizeof() of the decoded structs, so bindings can check their own layouts */
+AIR_CTRL_CODEC_API size_t air_ctrl_codec_sizeof_sample(void);
+AIR_CTRL_CODEC_API size_t air_ctrl_codec_sizeof_agg(void);
+AIR_CTRL_CODEC_API size_t air_ctrl_codec_sizeof_alert(void);
+AIR_CTRL_CODEC_API size_t air_ctrl_codec_sizeof_rtt_sample(void);
+AIR_CTRL_CODEC_API size_t air_ctrl_codec_sizeof_rtt_scan(void);
+
+/* AIR_CTRL_BLE_VERSIONS */
+AIR_CTRL_CODEC_API uint16_t air_ctrl_codec_versions(void);
+
+AIR_CTRL_CODEC_API int air_ctrl_codec_negotiate(uint16_t offered, uint16_t ours,
+						uint16_t *accepted);
+AIR_CTRL_CODEC_API int air_ctrl_codec_decode_protocol(const uint8_t *buf, size_t len,
+						      uint16_t *versions);
+AIR_CTRL_CODEC_API void air_ctrl_codec_encode_protocol(uint16_t versions, uint8_t *buf);
+
+AIR_CTRL_CODEC_API int air_ctrl_codec_decode_sample(const uint8_t *buf, size_t len,
+						    struct air_ctrl_ble_sample *sample);
+AIR_CTRL_CODEC_API uint16_t air_ctrl_codec_sample_lost(uint16_t prev_seq,
+						       const struct air_ctrl_ble_sample *sample);
+AIR_CTRL_CODEC_API int air_ctrl_codec_decode_batch(const uint8_t *buf, size_t len,
+						   struct air_ctrl_ble_sample *samples,
+						   size_t max_samples);
+AIR_CTRL_CODEC_API int air_ctrl_codec_decode_history(const uint8_t *buf, size_t len,
+						     uint8_t *flags,
+						     struct air_ctrl_ble_sample *samples,
+						     size_t max_samples);
+AIR_CTRL_CODEC_API int air_ctrl_codec_decode_agg(const uint8_t *buf, size_t len,
+						 struct air_ctrl_ble_agg *aggs, size_t max_aggs);
+AIR_CTRL_CODEC_API int air_ctrl_codec_decode_alert(const uint8_t *buf, size_t len,
+						   struct air_ctrl_ble_alert *alert);
+AIR_CTRL_CODEC_API int air_ctrl_codec_decode_adv(const uint8_t *buf, size_t len,
+						 struct air_ctrl_ble_sample *sample);
+
+AIR_CTRL_CODEC_API int air_ctrl_codec_rtt_decode_frame(const uint8_t *buf, size_t len,
+						       struct air_ctrl_rtt_sample *sample);
+AIR_CTRL_CODEC_API size_t air_ctrl_codec_rtt_scan(const uint8_t *buf, size_t len,
+						  struct air_ctrl_rtt_sample *samples,
+						  size_t max_samples,
+						  struct air_ctrl_rtt_scan *scan);
+
+#endif /* AIR_CTRL_CODEC_H_ */
@@ -0,0 +1,249 @@
+/* Decode throughput of each wire format, in million frames per second on this host:
+ *
+ *   bench_decode [-n frames]
+ *
+ * Every frame is decoded from a buffer that changes between iterations, so the compiler
+ * cannot hoist the work out of the loop.
+ */
+
+#define _POSIX_C_SOURCE 199309L
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "air_ctrl_ble_codec.h"
+#include "air_ctrl_rtt_codec.h"
+
+/* Entries in a batch at the firmware's default ATT MTU of 247 */
+#define BATCH_ENTRIES ((247U - 3U - sizeof(struct air_ctrl_ble_batch_hdr_v3)) /                 \
+		       sizeof(struct air_ctrl_ble_batch_entry_v3))
+
+static volatile uint32_t sink;
+
+/* Makes the compiler assume every field of *p is read, so no part of a decode is dropped */
+#if defined(__GNUC__)
+#define ESCAPE(p) __asm__ volatile("" : : "r"(p) : "memory")
+#else
+#define ESCAPE(p) (void)(p)
+#endif
+
+/* A frame that fails to decode would time the error path instead */
+static void check(const char *name, int ret, int want)
+{
+	if (ret != want) {
+		fprintf(stderr, "%s: decode returned %d, expected %d\n", name, ret, want);
+		exit(1);
+	}
+}
+
+static double now_s(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+static void report(const char *name, size_t frame_len, unsigned long frames, double elapsed_s,
+		   unsigned long samples_per_frame)
+{
+	double mfps = (double)frames / elapsed_s / 1e6;
+
+	printf("%-16s %4zu B  %8.1f M frames/s  %8.1f M samples/s\n", name, frame_len, mfps,
+	       mfps * (double)samples_per_frame);
+}
+
+static const struct air_ctrl_ble_values values = {
+	.temp_c_x100 = 2150,
+	.hum_rh_x100 = 4520,
+	.gas_ohm = 152340,
+	.iaq_x10 = 512,
+	.iaq_acc = 3,
+	.co2_eq_ppm = 640,
+	.breath_voc_eq_ppb = 820,
+};
+
+static void bench_sample(unsigned long n)
+{
+	struct air_ctrl_ble_sample_v2 full;
+	struct air_ctrl_ble_sample sample;
+	uint8_t buf[sizeof(full)];
+	size_t len;
+	double start;
+
+	air_ctrl_ble_encode_sample_v2(1U, 1000U, &values, &full);
+	memcpy(buf, &full, sizeof(full));
+	check("sample v2", air_ctrl_ble_decode_sample(buf, sizeof(full), &sample), 0);
+	start = now_s();
+	for (unsigned long i = 0; i < n; i++) {
+		buf[2] = (uint8_t)i;
+		sink += (uint32_t)air_ctrl_ble_decode_sample(buf, sizeof(full), &sample) + sample.seq;
+		ESCAPE(&sample);
+	}
+	report("sample v2", sizeof(full), n, now_s() - start, 1);
+
+	len = air_ctrl_ble_pack_sample(&full, AIR_CTRL_BLE_FIELD_TEMP | AIR_CTRL_BLE_FIELD_HUM |
+						      AIR_CTRL_BLE_FIELD_IAQ, buf);
+	check("sample v6", air_ctrl_ble_decode_sample(buf, len, &sample), 0);
+	start = now_s();
+	for (unsigned long i = 0; i < n; i++) {
+		buf[2] = (uint8_t)i;
+		sink += (uint32_t)air_ctrl_ble_decode_sample(buf, len, &sample) + sample.seq;
+		ESCAPE(&sample);
+	}
+	report("sample v6", len, n, now_s() - start, 1);
+}
+
+static void bench_batch(unsigned long n)
+{
+	struct air_ctrl_ble_batch_hdr_v3 hdr = {
+		.version = AIR_CTRL_BLE_VERSION_BATCH,
+		.count = (uint8_t)BATCH_ENTRIES,
+	};
+	struct air_ctrl_ble_batch_entry_v3 entry;
+	struct air_ctrl_ble_sample samples[BATCH_ENTRIES];
+	uint8_t buf[sizeof(hdr) + BATCH_ENTRIES * sizeof(entry)];
+	double start;
+	int count;
+
+	memcpy(buf, &hdr, sizeof(hdr));
+	for (size_t i = 0; i < BATCH_ENTRIES; i++) {
+		air_ctrl_ble_encode_batch_entry_v3(1000U, &values, &entry);
+		memcpy(&buf[sizeof(hdr) + i * sizeof(entry)], &entry, sizeof(entry));
+	}
+	check("batch v3", air_ctrl_ble_decode_batch(buf, sizeof(buf), samples, BATCH_ENTRIES),
+	      (int)BATCH_ENTRIES);
+
+	start = now_s();
+	for (unsigned long i = 0; i < n; i++) {
+		buf[2] = (uint8_t)i;
+		count = air_ctrl_ble_decode_batch(buf, sizeof(buf), samples, BATCH_ENTRIES);
+		sink += (uint32_t)count + samples[BATCH_ENTRIES - 1U].timestamp_ms;
+		ESCAPE(&samples);
+	}
+	report("batch v3", sizeof(buf), n, now_s() - start, BATCH_ENTRIES);
+}
+
+static void bench_agg(unsigned long n)
+{
+	struct air_ctrl_ble_agg_v4 records[AIR_CTRL_BLE_AGG_LEVEL_COUNT];
+	struct air_ctrl_ble_agg aggs[AIR_CTRL_BLE_AGG_LEVEL_COUNT];
+	uint8_t buf[sizeof(records)];
+	double start;
+	int count;
+
+	memset(records, 0, sizeof(records));
+	for (uint8_t i = 0; i < AIR_CTRL_BLE_AGG_LEVEL_COUNT; i++) {
+		records[i].version = AIR_CTRL_BLE_VERSION_AGG;
+		records[i].level = i;
+	}
+	memcpy(buf, records, sizeof(records));
+	check("agg v4", air_ctrl_ble_decode_agg(buf, sizeof(buf), aggs, AIR_CTRL_BLE_AGG_LEVEL_COUNT),
+	      AIR_CTRL_BLE_AGG_LEVEL_COUNT);
+
+	start = now_s();
+	for (unsigned long i = 0; i < n; i++) {
+		buf[2] = (uint8_t)i;
+		count = air_ctrl_ble_decode_agg(buf, sizeof(buf), aggs, AIR_CTRL_BLE_AGG_LEVEL_COUNT);
+		sink += (uint32_t)count + aggs[0].start_ms;
+		ESCAPE(&aggs);
+	}
+	report("agg v4", sizeof(buf), n, now_s() - start, AIR_CTRL_BLE_AGG_LEVEL_COUNT);
+}
+
+static void bench_alert(unsigned long n)
+{
+	struct air_ctrl_ble_alert_v5 raw;
+	struct air_ctrl_ble_alert alert;
+	uint8_t buf[sizeof(raw)];
+	double start;
+
+	air_ctrl_ble_encode_alert_v5(AIR_CTRL_BLE_ALERT_CO2, true, 1U, 1000U, 1600U, 1500U, &raw);
+	memcpy(buf, &raw, sizeof(raw));
+	check("alert v5", air_ctrl_ble_decode_alert(buf, sizeof(buf), &alert), 0);
+
+	start = now_s();
+	for (unsigned long i = 0; i < n; i++) {
+		buf[3] = (uint8_t)i;
+		sink += (uint32_t)air_ctrl_ble_decode_alert(buf, sizeof(buf), &alert) + alert.seq;
+		ESCAPE(&alert);
+	}
+	report("alert v5", sizeof(buf), n, now_s() - start, 1);
+}
+
+static void bench_adv(unsigned long n)
+{
+	struct air_ctrl_ble_adv_v1 raw;
+	struct air_ctrl_ble_sample sample;
+	uint8_t buf[sizeof(raw)];
+	double start;
+
+	air_ctrl_ble_encode_adv_v1(1U, &values, &raw);
+	memcpy(buf, &raw, sizeof(raw));
+	check("adv v1", air_ctrl_ble_decode_adv(buf, sizeof(buf), &sample), 0);
+
+	start = now_s();
+	for (unsigned long i = 0; i < n; i++) {
+		buf[3] = (uint8_t)i;
+		sink += (uint32_t)air_ctrl_ble_decode_adv(buf, sizeof(buf), &sample) + sample.seq;
+		ESCAPE(&sample);
+	}
+	report("adv v1", sizeof(buf), n, now_s() - start, 1);
+}
+
+static void bench_rtt(unsigned long n)
+{
+	struct air_ctrl_rtt_record_v2 record = {.seq = 1, .co2_eq_ppm = 640};
+	struct air_ctrl_rtt_sample sample;
+	uint8_t buf[AIR_CTRL_RTT_HDR_LEN + sizeof(record) + AIR_CTRL_RTT_CRC_LEN];
+	uint16_t crc;
+	double start;
+
+	buf[0] = AIR_CTRL_RTT_SYNC0;
+	buf[1] = AIR_CTRL_RTT_SYNC1;
+	buf[2] = AIR_CTRL_RTT_VERSION;
+	buf[3] = (uint8_t)sizeof(record);
+	memcpy(&buf[AIR_CTRL_RTT_HDR_LEN], &record, sizeof(record));
+	crc = air_ctrl_rtt_crc16(&buf[2], 2U + sizeof(record));
+	buf[sizeof(buf) - 2U] = (uint8_t)crc;
+	buf[sizeof(buf) - 1U] = (uint8_t)(crc >> 8);
+	check("rtt v2", air_ctrl_rtt_decode_frame(buf, sizeof(buf), &sample), (int)sizeof(buf));
+
+	/* The CRC is checked on every frame, so this one keeps its bytes */
+	start = now_s();
+	for (unsigned long i = 0; i < n; i++) {
+		sink += (uint32_t)air_ctrl_rtt_decode_frame(buf, sizeof(buf), &sample) + sample.seq;
+		ESCAPE(&sample);
+		sink += (uint32_t)i;
+	}
+	report("rtt v2", sizeof(buf), n, now_s() - start, 1);
+}
+
+int main(int argc, char **argv)
+{
+	unsigned long n = 10000000UL;
+
+	for (int i = 1; i < argc; i++) {
+		if (strcmp(argv[i], "-n") == 0 && i + 1 < argc) {
+			n = strtoul(argv[++i], NULL, 10);
+		} else {
+			fprintf(stderr, "usage: %s [-n frames]\n", argv[0]);
+			return 2;
+		}
+	}
+
+	if (n == 0) {
+		return 2;
+	}
+
+	bench_sample(n);
+	bench_batch(n);
+	bench_agg(n);
+	bench_alert(n);
+	bench_adv(n);
+	bench_rtt(n);
+
+	return 0;
+}
@@ -0,0 +1,30 @@
+#ifndef AIR_CTRL_FUZZ_H_
+#define AIR_CTRL_FUZZ_H_
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+/* Each harness checks that a frame the decoder accepts encodes back to the same bytes, and
+ * that it rejects everything else with one of the documented errors.
+ */
+#define FUZZ_ASSERT(cond)                                                                          \
+	do {                                                                                       \
+		if (!(cond)) {                                                                     \
+			fprintf(stderr, "%s:%d: %s\n", __FILE__, __LINE__, #cond);                 \
+			abort();                                                                   \
+		}                                                                                  \
+	} while (0)
+
+/* Largest input the harnesses expect to matter (an ATT MTU of 517) */
+#define FUZZ_MAX_LEN 512U
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size);
+
+/* Valid frame number i for the standalone driver to mutate (libFuzzer finds them itself).
+ * Returns its length, 0 past the last one.
+ */
+size_t fuzz_seed(size_t i, uint8_t *buf, size_t max_len);
+
+#endif /* AIR_CTRL_FUZZ_H_ */
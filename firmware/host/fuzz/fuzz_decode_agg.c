@@ -0,0 +1,78 @@
+#include <string.h>
+
+#include "air_ctrl_ble_codec.h"
+#include "fuzz.h"
+
+size_t fuzz_seed(size_t i, uint8_t *buf, size_t max_len)
+{
+	struct air_ctrl_ble_agg_v4 records[AIR_CTRL_BLE_AGG_LEVEL_COUNT];
+	size_t count = 1U + i % AIR_CTRL_BLE_AGG_LEVEL_COUNT;
+
+	if (i >= 2U * AIR_CTRL_BLE_AGG_LEVEL_COUNT || count * sizeof(records[0]) > max_len) {
+		return 0;
+	}
+
+	memset(records, 0, sizeof(records));
+	for (size_t j = 0; j < count; j++) {
+		/* The second half of the seeds look like reads, with levels that never closed */
+		records[j].version = (i >= AIR_CTRL_BLE_AGG_LEVEL_COUNT && j == 1U) ?
+			0U : AIR_CTRL_BLE_VERSION_AGG;
+		records[j].level = (uint8_t)j;
+		records[j].start_ms = air_ctrl_ble_le32(60000U * (uint32_t)j);
+		records[j].count = air_ctrl_ble_le32(60U);
+		records[j].temp_c_x100.mean = air_ctrl_ble_le16((uint16_t)-250);
+		records[j].co2_eq_ppm.max = air_ctrl_ble_le16(1800U);
+	}
+	memcpy(buf, records, count * sizeof(records[0]));
+
+	return count * sizeof(records[0]);
+}
+
+static void check_stat(const struct air_ctrl_ble_agg_stat *stat, const uint8_t *raw)
+{
+	FUZZ_ASSERT(stat->mean == air_ctrl_ble_get_le16(&raw[0]));
+	FUZZ_ASSERT(stat->min == air_ctrl_ble_get_le16(&raw[2]));
+	FUZZ_ASSERT(stat->max == air_ctrl_ble_get_le16(&raw[4]));
+	FUZZ_ASSERT(stat->ewma == air_ctrl_ble_get_le16(&raw[6]));
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	const size_t record_len = sizeof(struct air_ctrl_ble_agg_v4);
+	struct air_ctrl_ble_agg aggs[FUZZ_MAX_LEN / sizeof(struct air_ctrl_ble_agg_v4) + 1U];
+	const size_t max_aggs = sizeof(aggs) / sizeof(aggs[0]);
+	const uint8_t *raw;
+	size_t closed = 0;
+	int count;
+
+	count = air_ctrl_ble_decode_agg(data, size, aggs, max_aggs);
+	if (count < 0) {
+		/* Longer inputs than the harness sizes for may run out of room */
+		FUZZ_ASSERT(count == -EMSGSIZE || count == -EBADMSG || count == -ENOTSUP ||
+			    (count == -ENOBUFS && size / record_len > max_aggs));
+		return 0;
+	}
+
+	/* One decoded record per closed level, in order, each carrying its bytes as they are */
+	for (size_t offset = 0; offset < size; offset += record_len) {
+		raw = &data[offset];
+		if (raw[0] == 0U) {
+			continue;
+		}
+
+		FUZZ_ASSERT(closed < (size_t)count);
+		FUZZ_ASSERT(aggs[closed].level == raw[1]);
+		FUZZ_ASSERT(aggs[closed].level < AIR_CTRL_BLE_AGG_LEVEL_COUNT);
+		FUZZ_ASSERT(aggs[closed].start_ms == air_ctrl_ble_get_le32(&raw[2]));
+		FUZZ_ASSERT(aggs[closed].count == air_ctrl_ble_get_le32(&raw[6]));
+		check_stat(&aggs[closed].temp_c_x100, &raw[10]);
+		check_stat(&aggs[closed].hum_rh_x100, &raw[18]);
+		check_stat(&aggs[closed].iaq_x10, &raw[26]);
+		check_stat(&aggs[closed].co2_eq_ppm, &raw[34]);
+		closed++;
+	}
+
+	FUZZ_ASSERT(closed == (size_t)count);
+
+	return 0;
+}
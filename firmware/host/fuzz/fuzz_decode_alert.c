@@ -0,0 +1,42 @@
+#include <string.h>
+
+#include "air_ctrl_ble_codec.h"
+#include "fuzz.h"
+
+size_t fuzz_seed(size_t i, uint8_t *buf, size_t max_len)
+{
+	struct air_ctrl_ble_alert_v5 alert;
+
+	if (i >= 2U * AIR_CTRL_BLE_ALERT_COUNT || max_len < sizeof(alert)) {
+		return 0;
+	}
+
+	air_ctrl_ble_encode_alert_v5((enum air_ctrl_ble_alert_metric)(i / 2U), (i % 2U) != 0U,
+				     (uint16_t)(0xfff0U + i), 0x80000000U + (uint32_t)i, 1500U,
+				     1000U, &alert);
+	memcpy(buf, &alert, sizeof(alert));
+
+	return sizeof(alert);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	struct air_ctrl_ble_alert alert;
+	struct air_ctrl_ble_alert_v5 raw;
+	int err;
+
+	err = air_ctrl_ble_decode_alert(data, size, &alert);
+	if (err) {
+		FUZZ_ASSERT(err == -EMSGSIZE || err == -EBADMSG || err == -ENOTSUP);
+		return 0;
+	}
+
+	FUZZ_ASSERT(alert.metric < AIR_CTRL_BLE_ALERT_COUNT);
+
+	air_ctrl_ble_encode_alert_v5(alert.metric, alert.raised, alert.seq, alert.timestamp_ms,
+				     alert.value, alert.threshold, &raw);
+	FUZZ_ASSERT(size == sizeof(raw));
+	FUZZ_ASSERT(memcmp(&raw, data, size) == 0);
+
+	return 0;
+}
@@ -0,0 +1,84 @@
+#include <string.h>
+
+#include "air_ctrl_ble_codec.h"
+#include "fuzz.h"
+
+size_t fuzz_seed(size_t i, uint8_t *buf, size_t max_len)
+{
+	static const uint8_t counts[] = {1, 2, 5, 26};
+	struct air_ctrl_ble_batch_hdr_v3 hdr;
+	struct air_ctrl_ble_batch_entry_v3 entry;
+	struct air_ctrl_ble_values values = {0};
+	size_t len = sizeof(hdr);
+
+	if (i >= sizeof(counts) || sizeof(hdr) + counts[i] * sizeof(entry) > max_len) {
+		return 0;
+	}
+
+	hdr.version = AIR_CTRL_BLE_VERSION_BATCH;
+	hdr.count = counts[i];
+	hdr.base_seq = air_ctrl_ble_le16((uint16_t)(65534U - i));
+	hdr.base_timestamp_ms = air_ctrl_ble_le32(UINT32_MAX - 2500U);
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	for (uint8_t j = 0; j < counts[i]; j++) {
+		values.temp_c_x100 = (int16_t)(-500 + 37 * j);
+		values.iaq_x10 = (uint16_t)(100U * j);
+		air_ctrl_ble_encode_batch_entry_v3((j == 0U) ? 0U : (uint16_t)(1000U + j), &values,
+						   &entry);
+		memcpy(&buf[len], &entry, sizeof(entry));
+		len += sizeof(entry);
+	}
+
+	return len;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	static struct air_ctrl_ble_sample samples[UINT8_MAX];
+	struct air_ctrl_ble_batch_hdr_v3 hdr;
+	struct air_ctrl_ble_batch_entry_v3 entry;
+	uint8_t buf[sizeof(hdr) + UINT8_MAX * sizeof(entry)];
+	uint32_t prev_ms;
+	size_t len;
+	int count;
+
+	count = air_ctrl_ble_decode_batch(data, size, samples, UINT8_MAX);
+	if (count < 0) {
+		FUZZ_ASSERT(count == -EMSGSIZE || count == -EBADMSG || count == -ENOTSUP);
+		return 0;
+	}
+
+	FUZZ_ASSERT(count > 0 && count == data[1]);
+
+	/* One slot short of the count has to be refused, not overrun */
+	FUZZ_ASSERT(air_ctrl_ble_decode_batch(data, size, samples, (size_t)count - 1U) == -ENOBUFS);
+	(void)air_ctrl_ble_decode_batch(data, size, samples, UINT8_MAX);
+
+	/* The timestamps advance by each entry's dt_ms, so re-encoding the differences gives the
+	 * same frame
+	 */
+	hdr.version = AIR_CTRL_BLE_VERSION_BATCH;
+	hdr.count = (uint8_t)count;
+	hdr.base_seq = air_ctrl_ble_le16(samples[0].seq);
+	prev_ms = air_ctrl_ble_get_le32(&data[4]);
+	hdr.base_timestamp_ms = air_ctrl_ble_le32(prev_ms);
+	memcpy(buf, &hdr, sizeof(hdr));
+	len = sizeof(hdr);
+
+	for (int i = 0; i < count; i++) {
+		FUZZ_ASSERT(samples[i].seq == (uint16_t)(samples[0].seq + i));
+		FUZZ_ASSERT(samples[i].fields == AIR_CTRL_BLE_SAMPLE_FIELDS);
+		FUZZ_ASSERT(samples[i].timestamp_ms - prev_ms <= UINT16_MAX);
+		air_ctrl_ble_encode_batch_entry_v3((uint16_t)(samples[i].timestamp_ms - prev_ms),
+						   &samples[i].values, &entry);
+		memcpy(&buf[len], &entry, sizeof(entry));
+		len += sizeof(entry);
+		prev_ms = samples[i].timestamp_ms;
+	}
+
+	FUZZ_ASSERT(len == size);
+	FUZZ_ASSERT(memcmp(buf, data, size) == 0);
+
+	return 0;
+}
@@ -0,0 +1,71 @@
+#include <string.h>
+
+#include "air_ctrl_rtt_codec.h"
+#include "fuzz.h"
+
+size_t fuzz_seed(size_t i, uint8_t *buf, size_t max_len)
+{
+	struct air_ctrl_rtt_record_v2 record;
+	const size_t frame_len = AIR_CTRL_RTT_HDR_LEN + sizeof(record) + AIR_CTRL_RTT_CRC_LEN;
+	size_t len = 0;
+	uint16_t crc;
+
+	/* One to three back-to-back frames, the last one with a leading partial sync */
+	if (i >= 3U || (i + 1U) * frame_len + 1U > max_len) {
+		return 0;
+	}
+
+	if (i == 2U) {
+		buf[len++] = AIR_CTRL_RTT_SYNC0;
+	}
+
+	for (size_t j = 0; j <= i; j++) {
+		memset(&record, 0, sizeof(record));
+		record.seq = (uint16_t)j;
+		record.flags = AIR_CTRL_RTT_FLAG_BSEC | AIR_CTRL_RTT_FLAG_STABILIZED;
+		record.raw_temp_c_x100 = -1234;
+		record.co2_eq_ppm = 600;
+
+		buf[len] = AIR_CTRL_RTT_SYNC0;
+		buf[len + 1] = AIR_CTRL_RTT_SYNC1;
+		buf[len + 2] = AIR_CTRL_RTT_VERSION;
+		buf[len + 3] = (uint8_t)sizeof(record);
+		memcpy(&buf[len + AIR_CTRL_RTT_HDR_LEN], &record, sizeof(record));
+		crc = air_ctrl_rtt_crc16(&buf[len + 2], 2U + sizeof(record));
+		buf[len + frame_len - 2U] = (uint8_t)crc;
+		buf[len + frame_len - 1U] = (uint8_t)(crc >> 8);
+		len += frame_len;
+	}
+
+	return len;
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	struct air_ctrl_rtt_sample samples[4];
+	struct air_ctrl_rtt_scan scan = {0};
+	size_t total = 0;
+	size_t pos = 0;
+	size_t count;
+
+	/* Scan the input in small steps, like a reader that gets it in chunks */
+	do {
+		count = air_ctrl_rtt_scan(&data[pos], size - pos, samples, 2U, &scan);
+		FUZZ_ASSERT(scan.consumed <= size - pos);
+		FUZZ_ASSERT(count <= 2U);
+		for (size_t i = 0; i < count; i++) {
+			FUZZ_ASSERT(samples[i].version == 1U || samples[i].version == 2U);
+		}
+		pos += scan.consumed;
+		total += count;
+	} while (count > 0);
+
+	FUZZ_ASSERT(scan.frames == total);
+	FUZZ_ASSERT(scan.skipped_bytes <= size && scan.crc_errors <= scan.skipped_bytes);
+
+	/* What is left is at most one incomplete frame */
+	FUZZ_ASSERT(size - pos < AIR_CTRL_RTT_HDR_LEN + air_ctrl_rtt_record_len(1U) +
+					 AIR_CTRL_RTT_CRC_LEN);
+
+	return 0;
+}
@@ -0,0 +1,73 @@
+#include <string.h>
+
+#include "air_ctrl_ble_codec.h"
+#include "fuzz.h"
+
+static const struct air_ctrl_ble_values seed_values = {
+	.temp_c_x100 = -1234,
+	.hum_rh_x100 = 4567,
+	.gas_ohm = 123456,
+	.iaq_x10 = 567,
+	.iaq_acc = 3,
+	.co2_eq_ppm = 612,
+	.breath_voc_eq_ppb = 890,
+};
+
+size_t fuzz_seed(size_t i, uint8_t *buf, size_t max_len)
+{
+	static const uint16_t fields[] = {
+		AIR_CTRL_BLE_SAMPLE_FIELDS,
+		0U,
+		AIR_CTRL_BLE_FIELD_TEMP | AIR_CTRL_BLE_FIELD_HUM,
+		AIR_CTRL_BLE_FIELD_IAQ | AIR_CTRL_BLE_FIELD_CO2_EQ,
+		AIR_CTRL_BLE_SAMPLE_FIELDS & ~AIR_CTRL_BLE_FIELD_GAS,
+	};
+	struct air_ctrl_ble_sample_v2 sample;
+
+	if (i >= sizeof(fields) / sizeof(fields[0]) || max_len < sizeof(sample)) {
+		return 0;
+	}
+
+	air_ctrl_ble_encode_sample_v2((uint16_t)(65530U + i), 1000U * (uint32_t)i, &seed_values,
+				      &sample);
+	sample.flags = (uint8_t)(i << AIR_CTRL_BLE_SAMPLE_HELD_SHIFT);
+
+	return air_ctrl_ble_pack_sample(&sample, fields[i], buf);
+}
+
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size)
+{
+	struct air_ctrl_ble_sample sample;
+	struct air_ctrl_ble_sample_v2 full;
+	uint8_t buf[sizeof(full)];
+	size_t len;
+	int err;
+
+	err = air_ctrl_ble_decode_sample(data, size, &sample);
+	if (err) {
+		FUZZ_ASSERT(err == -EMSGSIZE || err == -EBADMSG || err == -ENOTSUP);
+		return 0;
+	}
+
+	FUZZ_ASSERT(sample.version == data[0]);
+	FUZZ_ASSERT((sample.fields & ~AIR_CTRL_BLE_SAMPLE_FIELDS) == 0U);
+	FUZZ_ASSERT(air_ctrl_ble_sample_lost((uint16_t)(sample.seq - 1U), &sample) == 0U);
+
+	/* Fields the frame does not carry read as 0 */
+	FUZZ_ASSERT((sample.fields & AIR_CTRL_BLE_FIELD_GAS) || sample.values.gas_ohm == 0U);
+	FUZZ_ASSERT((sample.fields & AIR_CTRL_BLE_FIELD_IAQ) || sample.values.iaq_acc == 0U);
+
+	/* The firmware never sends a compact sample with every field, it sends the full one */
+	if (sample.version == AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT &&
+	    sample.fields == AIR_CTRL_BLE_SAMPLE_FIELDS) {
+		return 0;
+	}
+
+	air_ctrl_ble_encode_sample_v2(sample.seq, sample.timestamp_ms, &sample.values, &full);
+	full.flags = sample.flags;
+	len = air_ctrl_ble_pack_sample(&full, sample.fields, buf);
+	FUZZ_ASSERT(len == size);
+	FUZZ_ASSERT(memcmp(buf, data, size) == 0);
+
+	return 0;
+}
@@ -0,0 +1,114 @@
+/* Stand-in for libFuzzer when the harnesses are built without it (gcc). Replays the files
+ * given on the command line, then runs -runs=N inputs made by mutating fuzz_seed() frames.
+ * Deterministic, so a failing run can be repeated with the same arguments.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "fuzz.h"
+
+static uint64_t rng_state = 0x9e3779b97f4a7c15ULL;
+
+static uint32_t rng(void)
+{
+	rng_state ^= rng_state << 13;
+	rng_state ^= rng_state >> 7;
+	rng_state ^= rng_state << 17;
+
+	return (uint32_t)rng_state;
+}
+
+static size_t mutate(uint8_t *buf, size_t len)
+{
+	static const uint8_t interesting[] = {0x00, 0x01, 0x02, 0x03, 0x04, 0x05,
+					      0x06, 0x07, 0x7f, 0x80, 0xfe, 0xff};
+	uint32_t rounds = 1U + rng() % 4U;
+
+	for (uint32_t i = 0; i < rounds; i++) {
+		switch (rng() % 5U) {
+		case 0:
+			if (len > 0) {
+				buf[rng() % len] ^= (uint8_t)(1U << (rng() % 8U));
+			}
+			break;
+		case 1:
+			if (len > 0) {
+				buf[rng() % len] = interesting[rng() % sizeof(interesting)];
+			}
+			break;
+		case 2:
+			len -= (len > 0) ? 1U + rng() % len : 0U;
+			break;
+		case 3:
+			while (len < FUZZ_MAX_LEN && (rng() % 4U) != 0U) {
+				buf[len++] = (uint8_t)rng();
+			}
+			break;
+		default:
+			/* Keep it as it is, a valid frame has to round-trip */
+			break;
+		}
+	}
+
+	return len;
+}
+
+static int run_file(const char *path)
+{
+	static uint8_t buf[1 << 16];
+	FILE *f = fopen(path, "rb");
+	size_t len;
+
+	if (f == NULL) {
+		perror(path);
+		return -1;
+	}
+
+	len = fread(buf, 1, sizeof(buf), f);
+	fclose(f);
+
+	return LLVMFuzzerTestOneInput(buf, len);
+}
+
+int main(int argc, char **argv)
+{
+	uint8_t buf[FUZZ_MAX_LEN];
+	unsigned long runs = 0;
+	size_t seeds = 0;
+	size_t len;
+
+	for (int i = 1; i < argc; i++) {
+		if (strncmp(argv[i], "-runs=", 6) == 0) {
+			runs = strtoul(&argv[i][6], NULL, 10);
+		} else if (argv[i][0] == '-') {
+			/* Other libFuzzer options do not apply here */
+			continue;
+		} else if (run_file(argv[i]) != 0) {
+			return 1;
+		}
+	}
+
+	while (fuzz_seed(seeds, buf, sizeof(buf)) > 0) {
+		seeds++;
+	}
+
+	for (unsigned long i = 0; i < runs; i++) {
+		if (seeds == 0 || rng() % 8U == 0U) {
+			len = rng() % 64U;
+			for (size_t j = 0; j < len; j++) {
+				buf[j] = (uint8_t)rng();
+			}
+		} else {
+			len = fuzz_seed(rng() % seeds, buf, sizeof(buf));
+			len = mutate(buf, len);
+		}
+
+		(void)LLVMFuzzerTestOneInput(buf, len);
+	}
+
+	printf("%lu runs, %zu seeds\n", runs, seeds);
+
+	return 0;
+}
@@ -0,0 +1,378 @@
+#!/usr/bin/env python3
+"""ctypes binding of libair_ctrl_codec, the host build of the firmware's wire formats
+(src/air_ctrl_ble_codec.h and src/air_ctrl_rtt_codec.h). Build it once with
+
+    cmake -S host -B host/build && cmake --build host/build
+
+or point AIR_CTRL_CODEC_LIB at the library. The tools decode with the same C the firmware
+encodes with, so a format change needs a rebuild here, not a second decoder.
+
+Decoders raise CodecError with the codec's errno on a bad frame. BLE values stay in the
+integer units of the wire format (temp_c_x100, iaq_x10, ...), RTT samples are in physical
+units.
+"""
+import argparse
+import ctypes
+import errno
+import os
+import sys
+from pathlib import Path
+
+ABI = 1
+
+VERSION_ADV = 1
+VERSION_SAMPLE = 2
+VERSION_BATCH = 3
+VERSION_AGG = 4
+VERSION_ALERT = 5
+VERSION_SAMPLE_COMPACT = 6
+
+HISTORY_FLAG_END = 0x01
+SAMPLE_HELD_SHIFT = 1
+
+ALERT_METRICS = ["iaq", "co2"]
+AGG_LEVELS = ["1min", "1h", "24h"]
+
+_LIB_NAME = {"darwin": "libair_ctrl_codec.dylib", "win32": "air_ctrl_codec.dll"}.get(
+    sys.platform, "libair_ctrl_codec.so"
+)
+_DEFAULT_LIB = Path(__file__).resolve().parents[1] / "host" / "build" / _LIB_NAME
+
+
+class CodecError(ValueError):
+    def __init__(self, code: int) -> None:
+        super().__init__(f"{errno.errorcode.get(code, code)}: {os.strerror(code)}")
+        self.errno = code
+
+
+class Values(ctypes.Structure):
+    _fields_ = [
+        ("temp_c_x100", ctypes.c_int16),
+        ("hum_rh_x100", ctypes.c_uint16),
+        ("gas_ohm", ctypes.c_uint32),
+        ("iaq_x10", ctypes.c_uint16),
+        ("iaq_acc", ctypes.c_uint8),
+        ("co2_eq_ppm", ctypes.c_uint16),
+        ("breath_voc_eq_ppb", ctypes.c_uint16),
+    ]
+
+
+class Sample(ctypes.Structure):
+    _fields_ = [
+        ("version", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("seq", ctypes.c_uint16),
+        ("timestamp_ms", ctypes.c_uint32),
+        ("fields", ctypes.c_uint16),
+        ("values", Values),
+    ]
+
+    def as_dict(self) -> dict[str, int]:
+        row = {name: getattr(self, name) for name, _ in self._fields_[:-1]}
+        row.update({name: getattr(self.values, name) for name, _ in Values._fields_})
+        return row
+
+
+class AggStat(ctypes.Structure):
+    _fields_ = [(name, ctypes.c_uint16) for name in ("mean", "min", "max", "ewma")]
+
+
+class Agg(ctypes.Structure):
+    _fields_ = [
+        ("level", ctypes.c_uint8),
+        ("start_ms", ctypes.c_uint32),
+        ("count", ctypes.c_uint32),
+        ("temp_c_x100", AggStat),
+        ("hum_rh_x100", AggStat),
+        ("iaq_x10", AggStat),
+        ("co2_eq_ppm", AggStat),
+    ]
+
+    def as_dict(self) -> dict[str, int | dict[str, int]]:
+        row = {"level": AGG_LEVELS[self.level], "start_ms": self.start_ms, "count": self.count}
+        for name, _ in self._fields_[3:]:
+            stat = getattr(self, name)
+            row[name] = {s: getattr(stat, s) for s, _ in AggStat._fields_}
+        # The temperature statistics are int16_t on the wire
+        for s, v in row["temp_c_x100"].items():
+            row["temp_c_x100"][s] = v - 0x10000 if v & 0x8000 else v
+        return row
+
+
+class Alert(ctypes.Structure):
+    _fields_ = [
+        ("metric", ctypes.c_int),
+        ("raised", ctypes.c_bool),
+        ("seq", ctypes.c_uint16),
+        ("timestamp_ms", ctypes.c_uint32),
+        ("value", ctypes.c_uint16),
+        ("threshold", ctypes.c_uint16),
+    ]
+
+    def as_dict(self) -> dict[str, int | str | bool]:
+        row = {name: getattr(self, name) for name, _ in self._fields_}
+        row["metric"] = ALERT_METRICS[self.metric]
+        return row
+
+
+# Value columns of an RTT sample, in enum air_ctrl_rtt_value order
+RTT_VALUES = [
+    "temp_raw_c",
+    "temp_comp_c",
+    "hum_raw_rh",
+    "hum_comp_rh",
+    "press_raw_pa",
+    "gas_raw_ohm",
+    "iaq",
+    "static_iaq",
+    "co2_eq_ppm",
+    "breath_voc_eq_ppm",
+    "gas_pct",
+    "stabilized",
+    "run_in",
+    "gas_est_1",
+    "gas_est_2",
+    "gas_est_3",
+    "gas_est_4",
+]
+
+
+class RttSample(ctypes.Structure):
+    _fields_ = [
+        ("version", ctypes.c_uint8),
+        ("flags", ctypes.c_uint8),
+        ("iaq_acc", ctypes.c_uint8),
+        ("seq", ctypes.c_uint16),
+        ("timestamp_ns", ctypes.c_int64),
+        ("timestamp_ms", ctypes.c_uint32),
+        ("values", ctypes.c_double * len(RTT_VALUES)),
+    ]
+
+
+class RttScan(ctypes.Structure):
+    """Stream state for rtt_scan(), one per stream"""
+
+    _fields_ = [
+        ("consumed", ctypes.c_size_t),
+        ("frames", ctypes.c_uint64),
+        ("crc_errors", ctypes.c_uint64),
+        ("skipped_bytes", ctypes.c_uint64),
+    ]
+
+
+_u8p = ctypes.POINTER(ctypes.c_uint8)
+_u16p = ctypes.POINTER(ctypes.c_uint16)
+_size = ctypes.c_size_t
+
+_PROTOTYPES = {
+    "abi": (ctypes.c_int, []),
+    "sizeof_sample": (_size, []),
+    "sizeof_agg": (_size, []),
+    "sizeof_alert": (_size, []),
+    "sizeof_rtt_sample": (_size, []),
+    "sizeof_rtt_scan": (_size, []),
+    "versions": (ctypes.c_uint16, []),
+    "negotiate": (ctypes.c_int, [ctypes.c_uint16, ctypes.c_uint16, _u16p]),
+    "decode_protocol": (ctypes.c_int, [ctypes.c_char_p, _size, _u16p]),
+    "encode_protocol": (None, [ctypes.c_uint16, _u8p]),
+    "decode_sample": (ctypes.c_int, [ctypes.c_char_p, _size, ctypes.POINTER(Sample)]),
+    "sample_lost": (ctypes.c_uint16, [ctypes.c_uint16, ctypes.POINTER(Sample)]),
+    "decode_batch": (ctypes.c_int, [ctypes.c_char_p, _size, ctypes.POINTER(Sample), _size]),
+    "decode_history": (
+        ctypes.c_int,
+        [ctypes.c_char_p, _size, _u8p, ctypes.POINTER(Sample), _size],
+    ),
+    "decode_agg": (ctypes.c_int, [ctypes.c_char_p, _size, ctypes.POINTER(Agg), _size]),
+    "decode_alert": (ctypes.c_int, [ctypes.c_char_p, _size, ctypes.POINTER(Alert)]),
+    "decode_adv": (ctypes.c_int, [ctypes.c_char_p, _size, ctypes.POINTER(Sample)]),
+    "rtt_decode_frame": (ctypes.c_int, [ctypes.c_char_p, _size, ctypes.POINTER(RttSample)]),
+    "rtt_scan": (
+        _size,
+        [_u8p, _size, ctypes.POINTER(RttSample), _size, ctypes.POINTER(RttScan)],
+    ),
+}
+
+_lib = None
+
+
+def lib() -> ctypes.CDLL:
+    """The loaded library, with its prototypes and struct layouts checked"""
+    global _lib
+
+    if _lib is not None:
+        return _lib
+
+    path = os.environ.get("AIR_CTRL_CODEC_LIB", str(_DEFAULT_LIB))
+    try:
+        handle = ctypes.CDLL(path)
+    except OSError as e:
+        raise RuntimeError(
+            f"{path}: {e}. Build it with `cmake -S host -B host/build && "
+            f"cmake --build host/build` in firmware/, or set AIR_CTRL_CODEC_LIB"
+        ) from None
+
+    for name, (restype, argtypes) in _PROTOTYPES.items():
+        fn = getattr(handle, f"air_ctrl_codec_{name}")
+        fn.restype = restype
+        fn.argtypes = argtypes
+
+    if handle.air_ctrl_codec_abi() != ABI:
+        raise RuntimeError(f"{path}: ABI {handle.air_ctrl_codec_abi()}, this binding is {ABI}")
+
+    for name, struct in (
+        ("sample", Sample),
+        ("agg", Agg),
+        ("alert", Alert),
+        ("rtt_sample", RttSample),
+        ("rtt_scan", RttScan),
+    ):
+        size = getattr(handle, f"air_ctrl_codec_sizeof_{name}")()
+        if size != ctypes.sizeof(struct):
+            raise RuntimeError(
+                f"{path}: struct {name} is {size} bytes, {ctypes.sizeof(struct)} here"
+            )
+
+    _lib = handle
+    return _lib
+
+
+def _check(ret: int) -> int:
+    if ret < 0:
+        raise CodecError(-ret)
+    return ret
+
+
+def versions() -> int:
+    """The frame versions this codec decodes, as a bit mask"""
+    return lib().air_ctrl_codec_versions()
+
+
+def negotiate(offered: bytes, ours: int | None = None) -> bytes:
+    """The value to write back to the protocol characteristic, given the one read from it"""
+    offered_mask = ctypes.c_uint16()
+    accepted = ctypes.c_uint16()
+    out = (ctypes.c_uint8 * 2)()
+
+    _check(lib().air_ctrl_codec_decode_protocol(offered, len(offered), ctypes.byref(offered_mask)))
+    _check(
+        lib().air_ctrl_codec_negotiate(
+            offered_mask.value, versions() if ours is None else ours, ctypes.byref(accepted)
+        )
+    )
+    lib().air_ctrl_codec_encode_protocol(accepted.value, out)
+    return bytes(out)
+
+
+def decode_sample(data: bytes) -> Sample:
+    sample = Sample()
+    _check(lib().air_ctrl_codec_decode_sample(data, len(data), ctypes.byref(sample)))
+    return sample
+
+
+def sample_lost(prev_seq: int, sample: Sample) -> int:
+    """Samples lost between prev_seq and sample, not counting the ones held by the deadband"""
+    return lib().air_ctrl_codec_sample_lost(prev_seq, ctypes.byref(sample))
+
+
+def decode_batch(data: bytes) -> list[Sample]:
+    # A batch entry is never shorter than a byte, so len(data) entries always fit
+    samples = (Sample * max(len(data), 1))()
+    count = _check(lib().air_ctrl_codec_decode_batch(data, len(data), samples, len(samples)))
+    return list(samples[:count])
+
+
+def decode_history(data: bytes) -> tuple[int, list[Sample]]:
+    """The history flags (HISTORY_FLAG_END) and samples of one history notification"""
+    flags = ctypes.c_uint8()
+    samples = (Sample * max(len(data), 1))()
+    count = _check(
+        lib().air_ctrl_codec_decode_history(
+            data, len(data), ctypes.byref(flags), samples, len(samples)
+        )
+    )
+    return flags.value, list(samples[:count])
+
+
+def decode_agg(data: bytes) -> list[Agg]:
+    aggs = (Agg * max(len(data), 1))()
+    count = _check(lib().air_ctrl_codec_decode_agg(data, len(data), aggs, len(aggs)))
+    return list(aggs[:count])
+
+
+def decode_alert(data: bytes) -> Alert:
+    alert = Alert()
+    _check(lib().air_ctrl_codec_decode_alert(data, len(data), ctypes.byref(alert)))
+    return alert
+
+
+def decode_adv(manufacturer_data: bytes) -> Sample:
+    """The sample in the advertising manufacturer data, company ID included"""
+    sample = Sample()
+    _check(
+        lib().air_ctrl_codec_decode_adv(
+            manufacturer_data, len(manufacturer_data), ctypes.byref(sample)
+        )
+    )
+    return sample
+
+
+def rtt_scan(buf: bytearray, scan: RttScan, max_samples: int = 256) -> list[RttSample]:
+    """Decodes the RTT frames at the start of buf and drops the bytes they used, leaving a
+    partial frame for the next call. Counters accumulate in scan.
+    """
+    out: list[RttSample] = []
+
+    while buf:
+        # The returned samples point into this array, so every call gets its own
+        samples = (RttSample * max_samples)()
+        view = (ctypes.c_uint8 * len(buf)).from_buffer(buf)
+        count = lib().air_ctrl_codec_rtt_scan(
+            view, len(buf), samples, max_samples, ctypes.byref(scan)
+        )
+        # The view pins buf, it has to go before buf can be resized
+        del view
+        del buf[: scan.consumed]
+        out.extend(samples[:count])
+        if count < max_samples:
+            break
+
+    return out
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Decode an air_ctrl BLE value given in hex")
+    ap.add_argument(
+        "kind",
+        choices=["sample", "batch", "history", "agg", "alert", "adv", "protocol"],
+        help="Characteristic the value was read from (adv: manufacturer data)",
+    )
+    ap.add_argument("hex", help="Value as hex, e.g. from a BLE sniffer")
+    args = ap.parse_args()
+
+    data = bytes.fromhex(args.hex)
+    try:
+        if args.kind == "sample":
+            print(decode_sample(data).as_dict())
+        elif args.kind == "adv":
+            print(decode_adv(data).as_dict())
+        elif args.kind == "batch":
+            for sample in decode_batch(data):
+                print(sample.as_dict())
+        elif args.kind == "history":
+            flags, samples = decode_history(data)
+            print(f"flags {flags:#x}")
+            for sample in samples:
+                print(sample.as_dict())
+        elif args.kind == "agg":
+            for agg in decode_agg(data):
+                print(agg.as_dict())
+        elif args.kind == "alert":
+            print(decode_alert(data).as_dict())
+        else:
+            print(f"offered {data.hex()}, write back {negotiate(data).hex()}")
+    except CodecError as e:
+        sys.exit(f"{args.kind}: {e}")
+
+
+if __name__ == "__main__":
+    main()
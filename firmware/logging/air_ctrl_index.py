@@ -0,0 +1,484 @@
+#!/usr/bin/env python3
+"""Columnar index of JLinkRTTLogger text logs, for offline analysis of long captures.
+
+The log is parsed once (same rules as live_plot.py: "<inf> app:" payloads, a CSV header
+that may be split over several lines, fixed-point name_xN columns) and stored as one raw
+little-endian array per column, which is memory-mapped on read:
+
+    samples.log.idx/
+        meta.json            schema, row counts, boot segments, how far the log was parsed
+        part000/ts_ns.bin    int64
+        part000/<column>.bin int32/int64 (fixed point, scale in meta.json) or float64
+
+A new part starts when the header changes (another firmware build). ts_ns is uptime, so
+every reboot starts a new segment; within a segment it only grows, which is the time
+index: range queries are a binary search on the mapped ts_ns array.
+
+Running build again on a log that grew only parses the new tail.
+"""
+import argparse
+import hashlib
+import json
+import os
+import re
+import sys
+
+import numpy as np
+
+INDEX_VERSION = 1
+
+# APP_INF_RE from live_plot.py, applied to a whole chunk instead of line by line
+APP_INF_RE = re.compile(rb"<inf>[ \t]+app:[ \t]+([^\r\n]*)")
+
+# Fixed-point columns of the text log, e.g. temp_raw_c_x100 is temp_raw_c in 1/100
+SCALED_COL_RE = re.compile(r"^(.*)_x(\d+)$")
+
+# The source is recognised by a hash of its first bytes, a rotated log gets rebuilt
+SOURCE_ID_BYTES = 4096
+
+READ_CHUNK_BYTES = 8 << 20
+
+# Upper bound on points handed to matplotlib per line; longer series are strided
+MAX_DRAW_POINTS = 4000
+
+INT32_MIN, INT32_MAX = np.iinfo(np.int32).min, np.iinfo(np.int32).max
+
+
+def is_number_row(payload: bytes) -> bool:
+    # rows start with digits (timestamp_ns)
+    return bool(payload) and (payload[:1].isdigit() or payload[:1] == b"-")
+
+
+def source_id(path: str) -> str:
+    with open(path, "rb") as f:
+        return hashlib.sha1(f.read(SOURCE_ID_BYTES)).hexdigest()
+
+
+def parse_header(header: str) -> tuple[list[str], list[int]]:
+    names, scales = [], []
+    for c in (c.strip() for c in header.split(",")):
+        m = SCALED_COL_RE.match(c)
+        names.append(m.group(1) if m else c)
+        scales.append(int(m.group(2)) if m else 1)
+    return names, scales
+
+
+def to_columns(rows: list[bytes], ncols: int) -> list[np.ndarray] | None:
+    """Convert CSV rows to one int64 or float64 array per column, None if any value is junk."""
+    cells = np.array(b",".join(rows).split(b",")).reshape(len(rows), ncols)
+    out = []
+    for i in range(ncols):
+        try:
+            out.append(cells[:, i].astype(np.int64))
+        except ValueError:
+            try:
+                out.append(cells[:, i].astype(np.float64))
+            except ValueError:
+                return None
+    return out
+
+
+def column_dtype(name: str, values: np.ndarray) -> str:
+    if name == "ts_ns":
+        return "<i8"
+    if values.dtype.kind == "f":
+        return "<f8"
+    if len(values) and (values.min() < INT32_MIN or values.max() > INT32_MAX):
+        return "<i8"
+    return "<i4"
+
+
+def fits(dtype: str, values: np.ndarray) -> bool:
+    if dtype == "<f8":
+        return True
+    if values.dtype.kind == "f":
+        return False
+    return dtype == "<i8" or not len(values) or (
+        values.min() >= INT32_MIN and values.max() <= INT32_MAX
+    )
+
+
+class IndexWriter:
+    """Appends parsed rows to the column files and keeps meta.json in step."""
+
+    def __init__(self, log_path: str, out_dir: str, rebuild: bool):
+        self.log_path = log_path
+        self.out_dir = out_dir
+        self.meta_path = os.path.join(out_dir, "meta.json")
+        os.makedirs(out_dir, exist_ok=True)
+
+        sid = source_id(log_path)
+        size = os.path.getsize(log_path)
+        self.meta = None
+        if not rebuild and os.path.exists(self.meta_path):
+            with open(self.meta_path) as f:
+                meta = json.load(f)
+            if (
+                meta.get("version") == INDEX_VERSION
+                and meta.get("source_id") == sid
+                and meta.get("offset", 0) <= size
+            ):
+                self.meta = meta
+            else:
+                print("Log was replaced or rotated, rebuilding the index", file=sys.stderr)
+
+        if self.meta is None:
+            self.meta = {
+                "version": INDEX_VERSION,
+                "source": os.path.abspath(log_path),
+                "source_id": sid,
+                "offset": 0,
+                "header_buf": None,
+                "header": None,
+                "rows": 0,
+                "parts": [],
+                "segments": [],
+            }
+            self._remove_parts()
+
+        self._truncate_to_meta()
+
+        # Current schema, from the last header seen
+        header = self.meta["header"]
+        self.names, self.scales = parse_header(header) if header else (None, None)
+
+    def _part_dir(self, index: int) -> str:
+        return os.path.join(self.out_dir, f"part{index:03d}")
+
+    def _remove_parts(self) -> None:
+        for entry in os.listdir(self.out_dir):
+            path = os.path.join(self.out_dir, entry)
+            if entry.startswith("part") and os.path.isdir(path):
+                for name in os.listdir(path):
+                    os.remove(os.path.join(path, name))
+                os.rmdir(path)
+
+    def _truncate_to_meta(self) -> None:
+        # A run that was interrupted may have appended past what meta.json records
+        for i, part in enumerate(self.meta["parts"]):
+            for col in part["columns"]:
+                path = os.path.join(self._part_dir(i), col["name"] + ".bin")
+                size = part["rows"] * np.dtype(col["dtype"]).itemsize
+                with open(path, "ab") as f:
+                    f.truncate(size)
+
+    def _save_meta(self) -> None:
+        tmp = self.meta_path + ".tmp"
+        with open(tmp, "w") as f:
+            json.dump(self.meta, f, indent=1)
+        os.replace(tmp, self.meta_path)
+
+    def _writable_part(self, values: list[np.ndarray]) -> dict:
+        parts = self.meta["parts"]
+        if parts:
+            part = parts[-1]
+            if [c["name"] for c in part["columns"]] == self.names and [
+                c["scale"] for c in part["columns"]
+            ] == self.scales:
+                if all(fits(c["dtype"], v) for c, v in zip(part["columns"], values)):
+                    return part
+
+        part = {
+            "start_row": self.meta["rows"],
+            "rows": 0,
+            "columns": [
+                {"name": n, "scale": s, "dtype": column_dtype(n, v)}
+                for n, s, v in zip(self.names, self.scales, values)
+            ],
+        }
+        parts.append(part)
+        os.makedirs(self._part_dir(len(parts) - 1), exist_ok=True)
+        return part
+
+    def append(self, rows: list[bytes]) -> int:
+        if not rows:
+            return 0
+
+        values = to_columns(rows, len(self.names))
+        if values is None:
+            # A corrupted row poisons the whole batch: fall back to one row at a time
+            return sum(self.append([r]) for r in rows) if len(rows) > 1 else 0
+
+        part = self._writable_part(values)
+        part_dir = self._part_dir(len(self.meta["parts"]) - 1)
+        for col, v in zip(part["columns"], values):
+            with open(os.path.join(part_dir, col["name"] + ".bin"), "ab") as f:
+                f.write(v.astype(col["dtype"]).tobytes())
+
+        self._index_segments(values[self.names.index("ts_ns")] if "ts_ns" in self.names else None,
+                             len(rows))
+        part["rows"] += len(rows)
+        self.meta["rows"] += len(rows)
+        return len(rows)
+
+    def _index_segments(self, ts: np.ndarray | None, n: int) -> None:
+        segs = self.meta["segments"]
+        start = self.meta["rows"]
+        if ts is None:
+            if not segs:
+                segs.append({"start_row": start, "rows": 0, "first_ts": None, "last_ts": None})
+            segs[-1]["rows"] += n
+            return
+
+        # Uptime going backwards is a reboot
+        breaks = np.flatnonzero(np.diff(ts) < 0) + 1
+        bounds = [0, *breaks.tolist(), n]
+        for i in range(len(bounds) - 1):
+            lo, hi = bounds[i], bounds[i + 1]
+            first, last = int(ts[lo]), int(ts[hi - 1])
+            if i == 0 and segs and segs[-1]["last_ts"] is not None and first >= segs[-1]["last_ts"]:
+                segs[-1]["rows"] += hi - lo
+                segs[-1]["last_ts"] = last
+                continue
+            segs.append({"start_row": start + lo, "rows": hi - lo, "first_ts": first, "last_ts": last})
+
+    def build(self) -> int:
+        added = 0
+        header_buf = self.meta["header_buf"]
+        offset = self.meta["offset"]
+
+        with open(self.log_path, "rb") as f:
+            f.seek(offset)
+            tail = b""
+            while chunk := f.read(READ_CHUNK_BYTES):
+                chunk = tail + chunk
+                end = chunk.rfind(b"\n") + 1
+                # Only complete lines, the logger may be in the middle of writing one
+                chunk, tail = chunk[:end], chunk[end:]
+                rows: list[bytes] = []
+
+                for m in APP_INF_RE.finditer(chunk):
+                    payload = m.group(1).strip()
+                    number = is_number_row(payload)
+
+                    # The header can be split over several log lines
+                    if (
+                        header_buf is not None
+                        and not number
+                        and b"," in payload
+                        and not payload.startswith(b"ts_ns,")
+                    ):
+                        if header_buf.endswith(",") or payload.startswith(b","):
+                            header_buf += payload.decode(errors="ignore")
+                        else:
+                            header_buf += "," + payload.decode(errors="ignore")
+                        continue
+
+                    if payload.startswith(b"ts_ns,"):
+                        header_buf = payload.decode(errors="ignore")
+                        continue
+
+                    if not number:
+                        continue
+
+                    if header_buf is not None:
+                        # Firmware prints the header before every row, only act on changes
+                        if header_buf != self.meta["header"]:
+                            added += self.append(rows)
+                            rows = []
+                            self.meta["header"] = header_buf
+                            self.names, self.scales = parse_header(header_buf)
+                        header_buf = None
+
+                    if self.names is None:
+                        continue
+
+                    if payload.count(b",") == len(self.names) - 1:
+                        rows.append(payload)
+
+                added += self.append(rows)
+                offset += len(chunk)
+                self.meta["offset"] = offset
+                self.meta["header_buf"] = header_buf
+                self._save_meta()
+
+        self._save_meta()
+        return added
+
+
+class Index:
+    """Read side: memory-mapped columns of a built index."""
+
+    def __init__(self, path: str):
+        self.path = path
+        with open(os.path.join(path, "meta.json")) as f:
+            self.meta = json.load(f)
+        self.parts = self.meta["parts"]
+        self.segments = self.meta["segments"]
+        self._maps: dict[tuple[int, str], np.ndarray] = {}
+
+    @property
+    def rows(self) -> int:
+        return self.meta["rows"]
+
+    def columns(self) -> list[str]:
+        return list(dict.fromkeys(c["name"] for p in self.parts for c in p["columns"]))
+
+    def raw(self, part: int, name: str) -> np.ndarray:
+        """Memory-mapped column of one part, still fixed point."""
+        key = (part, name)
+        if key not in self._maps:
+            p = self.parts[part]
+            col = next(c for c in p["columns"] if c["name"] == name)
+            path = os.path.join(self.path, f"part{part:03d}", name + ".bin")
+            self._maps[key] = (
+                np.memmap(path, dtype=col["dtype"], mode="r", shape=(p["rows"],))
+                if p["rows"]
+                else np.empty(0, dtype=col["dtype"])
+            )
+        return self._maps[key]
+
+    def _scale(self, part: int, name: str) -> int:
+        return next(c["scale"] for c in self.parts[part]["columns"] if c["name"] == name)
+
+    def read(self, name: str, start: int, stop: int) -> np.ndarray:
+        """Rows [start, stop) of a column over all parts, in physical units (NaN if absent)."""
+        n = max(stop - start, 0)
+        out = np.zeros(n, dtype=np.int64) if name == "ts_ns" else np.full(n, np.nan)
+        for i, p in enumerate(self.parts):
+            lo = max(start, p["start_row"])
+            hi = min(stop, p["start_row"] + p["rows"])
+            if lo >= hi or name not in (c["name"] for c in p["columns"]):
+                continue
+            v = self.raw(i, name)[lo - p["start_row"] : hi - p["start_row"]]
+            scale = self._scale(i, name)
+            out[lo - start : hi - start] = v / scale if scale != 1 else v
+        return out
+
+    def time_range(self, segment: int, t_from: float | None, t_to: float | None) -> tuple[int, int]:
+        """Row range of one boot segment with from <= uptime (s) <= to."""
+        seg = self.segments[segment]
+        start, stop = seg["start_row"], seg["start_row"] + seg["rows"]
+        if seg["first_ts"] is None:
+            return start, stop
+
+        ts = self.read("ts_ns", start, stop)
+        lo = 0 if t_from is None else int(np.searchsorted(ts, int(t_from * 1e9), "left"))
+        hi = len(ts) if t_to is None else int(np.searchsorted(ts, int(t_to * 1e9), "right"))
+        return start + lo, start + hi
+
+
+def default_index_path(log_path: str) -> str:
+    return log_path + ".idx"
+
+
+def cmd_build(args) -> None:
+    out = args.out or default_index_path(args.log)
+    writer = IndexWriter(args.log, out, args.rebuild)
+    before = writer.meta["offset"]
+    added = writer.build()
+    print(
+        f"{added} rows added ({writer.meta['offset'] - before} bytes parsed), "
+        f"{writer.meta['rows']} rows in {len(writer.meta['segments'])} segments -> {out}",
+        file=sys.stderr,
+    )
+
+
+def cmd_info(args) -> None:
+    idx = Index(args.index)
+    print(f"source: {idx.meta['source']} (parsed up to byte {idx.meta['offset']})")
+    print(f"rows: {idx.rows}")
+    for i, p in enumerate(idx.parts):
+        cols = ", ".join(
+            f"{c['name']}{'/' + str(c['scale']) if c['scale'] != 1 else ''}:{np.dtype(c['dtype']).name}"
+            for c in p["columns"]
+        )
+        print(f"part {i}: rows {p['start_row']}..{p['start_row'] + p['rows']} [{cols}]")
+    for i, s in enumerate(idx.segments):
+        if s["first_ts"] is None:
+            print(f"segment {i}: rows {s['start_row']}+{s['rows']}")
+        else:
+            print(
+                f"segment {i}: rows {s['start_row']}+{s['rows']}, "
+                f"uptime {s['first_ts'] / 1e9:.1f}..{s['last_ts'] / 1e9:.1f} s"
+            )
+
+
+def selected_rows(idx: Index, args) -> tuple[int, int]:
+    if not idx.segments:
+        raise SystemExit("Index is empty")
+    seg = args.segment if args.segment >= 0 else len(idx.segments) + args.segment
+    if not 0 <= seg < len(idx.segments):
+        raise SystemExit(f"No segment {args.segment}, the index has {len(idx.segments)}")
+    return idx.time_range(seg, args.t_from, args.t_to)
+
+
+def selected_cols(idx: Index, spec: str | None) -> list[str]:
+    available = idx.columns()
+    if not spec:
+        return available
+    cols = [c.strip() for c in spec.split(",") if c.strip()]
+    for c in cols:
+        if c not in available:
+            raise SystemExit(f"No column '{c}', available: {', '.join(available)}")
+    return cols
+
+
+def cmd_query(args) -> None:
+    idx = Index(args.index)
+    start, stop = selected_rows(idx, args)
+    cols = selected_cols(idx, args.cols)
+    data = [idx.read(c, start, stop) for c in cols]
+
+    out = sys.stdout
+    out.write(",".join(cols) + "\n")
+    for row in zip(*data):
+        out.write(",".join(str(v) if isinstance(v, np.integer) else f"{v:g}" for v in row) + "\n")
+
+
+def cmd_plot(args) -> None:
+    import matplotlib.pyplot as plt
+
+    idx = Index(args.index)
+    start, stop = selected_rows(idx, args)
+    cols = selected_cols(idx, args.cols)
+    if stop <= start:
+        raise SystemExit("No rows in that range")
+
+    step = max(1, (stop - start) // MAX_DRAW_POINTS)
+    x = idx.read("ts_ns", start, stop)[::step] / 1e9
+
+    fig, axes = plt.subplots(nrows=len(cols), ncols=1, sharex=True, squeeze=False,
+                             figsize=(11, max(2, int(1.7 * len(cols)))))
+    for ax, c in zip((a[0] for a in axes), cols):
+        ax.plot(x, idx.read(c, start, stop)[::step], label=c)
+        ax.grid(True, which="both", alpha=0.3)
+        ax.set_ylabel(c)
+    axes[-1][0].set_xlabel("t_s")
+    fig.tight_layout()
+    plt.show()
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Index RTT text logs for offline analysis")
+    sub = ap.add_subparsers(dest="cmd", required=True)
+
+    p = sub.add_parser("build", help="Create or update the index of a log (only parses new lines)")
+    p.add_argument("log", help="JLinkRTTLogger text log")
+    p.add_argument("--out", help="Index directory (default: LOG.idx)")
+    p.add_argument("--rebuild", action="store_true", help="Parse the whole log again")
+    p.set_defaults(func=cmd_build)
+
+    p = sub.add_parser("info", help="Schema, parts and boot segments of an index")
+    p.add_argument("index")
+    p.set_defaults(func=cmd_info)
+
+    for name, func, help_text in (
+        ("query", cmd_query, "Print a time range as CSV (physical units)"),
+        ("plot", cmd_plot, "Plot a time range"),
+    ):
+        p = sub.add_parser(name, help=help_text)
+        p.add_argument("index")
+        p.add_argument("--segment", type=int, default=-1,
+                       help="Boot segment, see info (default: last)")
+        p.add_argument("--from", dest="t_from", type=float, help="Start, uptime in s")
+        p.add_argument("--to", dest="t_to", type=float, help="End, uptime in s")
+        p.add_argument("--cols", help="Comma-separated columns (default: all)")
+        p.set_defaults(func=func)
+
+    args = ap.parse_args()
+    args.func(args)
+
+
+if __name__ == "__main__":
+    main()
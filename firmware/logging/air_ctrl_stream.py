@@ -0,0 +1,93 @@
+#!/usr/bin/env python3
+"""Decoder for the binary sample stream the firmware writes to RTT channel 1.
+
+Frame layout (little endian), see src/air_ctrl_rtt_codec.h:
+
+    0xa5 0x5a | version | len | record (len bytes) | crc16 (2)
+
+The CRC is CRC-16/CCITT-FALSE (poly 0x1021, init 0xffff) over version..record.
+Version 2 records hold the fixed-point sample, version 1 (older firmware) floats.
+Both decode to the same columns in physical units, so live_plot.py works on either.
+
+Frames are found, checked and decoded by libair_ctrl_codec, see air_ctrl_codec.py.
+"""
+import argparse
+import sys
+
+import air_ctrl_codec
+
+COLUMNS = ["seq", "flags", "iaq_acc", "ts_ns"] + air_ctrl_codec.RTT_VALUES
+
+
+class StreamDecoder:
+    """Incremental frame decoder: feed() raw bytes, get back decoded rows."""
+
+    def __init__(self) -> None:
+        self._buf = bytearray()
+        self._scan = air_ctrl_codec.RttScan()
+        self.lost_frames = 0
+        self._last_seq: int | None = None
+        self._last_ms: int | None = None
+        self._ms_wraps = 0
+
+    @property
+    def frames(self) -> int:
+        return self._scan.frames
+
+    @property
+    def crc_errors(self) -> int:
+        return self._scan.crc_errors
+
+    @property
+    def skipped_bytes(self) -> int:
+        return self._scan.skipped_bytes
+
+    def feed(self, data: bytes) -> list[dict[str, float]]:
+        self._buf += data
+        return [self._row(sample) for sample in air_ctrl_codec.rtt_scan(self._buf, self._scan)]
+
+    def _row(self, sample: air_ctrl_codec.RttSample) -> dict[str, float]:
+        if sample.version == 1:
+            ts_ns = sample.timestamp_ns
+        else:
+            # The firmware timestamp is a u32 in ms and wraps after 49.7 days
+            ts_ms = sample.timestamp_ms
+            if self._last_ms is not None and ts_ms < self._last_ms - (1 << 31):
+                self._ms_wraps += 1
+            self._last_ms = ts_ms
+            ts_ns = ((self._ms_wraps << 32) + ts_ms) * 1_000_000
+
+        self._track_seq(sample.seq)
+
+        row = {"seq": sample.seq, "flags": sample.flags, "iaq_acc": sample.iaq_acc, "ts_ns": ts_ns}
+        row.update(zip(air_ctrl_codec.RTT_VALUES, sample.values))
+        return row
+
+    def _track_seq(self, seq: int) -> None:
+        if self._last_seq is not None:
+            self.lost_frames += (seq - self._last_seq - 1) & 0xFFFF
+        self._last_seq = seq
+
+
+def main():
+    ap = argparse.ArgumentParser(description="Decode an RTT sample stream dump to CSV")
+    ap.add_argument("file", help="Raw RTT channel 1 capture")
+    args = ap.parse_args()
+
+    dec = StreamDecoder()
+    out = sys.stdout
+    out.write(",".join(COLUMNS) + "\n")
+    with open(args.file, "rb") as f:
+        while chunk := f.read(65536):
+            for row in dec.feed(chunk):
+                out.write(",".join(f"{row[c]:g}" if isinstance(row[c], float) else str(row[c]) for c in COLUMNS) + "\n")
+
+    print(
+        f"{dec.frames} frames, {dec.lost_frames} lost, {dec.crc_errors} CRC errors, "
+        f"{dec.skipped_bytes} bytes skipped",
+        file=sys.stderr,
+    )
+
+
+if __name__ == "__main__":
+    main()
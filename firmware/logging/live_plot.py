@@ -3,13 +3,25 @@ import argparse
 import os
 import re
 import time
-from collections import deque
 
 import matplotlib.pyplot as plt
+import numpy as np
+
+from air_ctrl_stream import COLUMNS as STREAM_COLUMNS
+from air_ctrl_stream import StreamDecoder
 
 
 APP_INF_RE = re.compile(r"<inf>\s+app:\s+(.*)$")
 
+# Fixed-point columns of the text log, e.g. temp_raw_c_x100 is temp_raw_c in 1/100
+SCALED_COL_RE = re.compile(r"^(.*)_x(\d+)$")
+
+# Upper bound on points handed to matplotlib per line; longer series are strided
+MAX_DRAW_POINTS = 4000
+
+# Read at most this much per frame so a long replay still renders while parsing
+READ_CHUNK_BYTES = 1 << 20
+
 
 def parse_app_inf_payload(line: str) -> str | None:
     m = APP_INF_RE.search(line)
@@ -23,9 +35,227 @@ def is_number_row(payload: str) -> bool:
     return bool(payload) and (payload[0].isdigit() or payload[0] == "-")
 
 
+class SeriesBuffer:
+    """Float ring buffer backed by numpy, keeps the last maxlen values (None = unbounded).
+
+    Storage is twice the window so view() is always a contiguous slice and
+    compaction only happens once per maxlen appends.
+    """
+
+    def __init__(self, maxlen: int | None):
+        self.maxlen = maxlen
+        self._buf = np.empty(2 * maxlen if maxlen else 4096, dtype=np.float64)
+        self._start = 0
+        self._end = 0
+
+    def __len__(self) -> int:
+        return self._end - self._start
+
+    def extend(self, values: np.ndarray) -> None:
+        n = len(values)
+        if n == 0:
+            return
+
+        if self.maxlen is not None:
+            if n >= self.maxlen:
+                self._buf[: self.maxlen] = values[-self.maxlen :]
+                self._start, self._end = 0, self.maxlen
+                return
+            if self._end + n > len(self._buf):
+                keep = min(len(self), self.maxlen - n)
+                self._buf[:keep] = self._buf[self._end - keep : self._end]
+                self._start, self._end = 0, keep
+        elif self._end + n > len(self._buf):
+            grown = np.empty(max(2 * len(self._buf), self._end + n), dtype=np.float64)
+            grown[: self._end] = self._buf[: self._end]
+            self._buf = grown
+
+        self._buf[self._end : self._end + n] = values
+        self._end += n
+        if self.maxlen is not None:
+            self._start = max(self._start, self._end - self.maxlen)
+
+    def view(self) -> np.ndarray:
+        return self._buf[self._start : self._end]
+
+
+class TextLogParser:
+    """Turns RTT text log lines (CSV header + row per sample) into row dicts.
+
+    Fixed-point columns (name_xN) are divided by N and reported as name.
+    """
+
+    def __init__(self):
+        self.columns: list[str] | None = None
+        self._divisors: list[int] = []
+        self._header_buf: str | None = None
+
+    def _set_header(self, header: str) -> None:
+        self.columns = []
+        self._divisors = []
+        for c in (c.strip() for c in header.split(",")):
+            m = SCALED_COL_RE.match(c)
+            self.columns.append(m.group(1) if m else c)
+            self._divisors.append(int(m.group(2)) if m else 1)
+
+    def feed(self, lines: list[str]) -> list[dict[str, str]]:
+        rows: list[dict[str, str]] = []
+
+        for line in lines:
+            payload = parse_app_inf_payload(line)
+            if payload is None:
+                continue
+
+            # The header can be split over several log lines
+            if (
+                self._header_buf is not None
+                and (not is_number_row(payload))
+                and ("," in payload)
+                and (not payload.startswith("ts_ns,"))
+            ):
+                if self._header_buf.endswith(",") or payload.startswith(","):
+                    self._header_buf = self._header_buf + payload
+                else:
+                    self._header_buf = self._header_buf + "," + payload
+                continue
+
+            if payload.startswith("ts_ns,"):
+                self._header_buf = payload
+                continue
+
+            if not is_number_row(payload):
+                continue
+
+            if self._header_buf is not None:
+                self._set_header(self._header_buf)
+                self._header_buf = None
+
+            if self.columns is None:
+                continue
+
+            parts = payload.split(",")
+            if len(parts) != len(self.columns):
+                continue
+
+            if any(d != 1 for d in self._divisors):
+                try:
+                    parts = [
+                        p if d == 1 else int(p) / d for p, d in zip(parts, self._divisors)
+                    ]
+                except ValueError:
+                    continue
+
+            rows.append(dict(zip(self.columns, parts)))
+
+        return rows
+
+
+class Plotter:
+    """Line plots that only redraw the lines (blitting) unless an axis range changes."""
+
+    def __init__(self, y_cols: list[str], x_label: str, windowed: bool):
+        self.windowed = windowed
+        self.fig, axes = plt.subplots(
+            nrows=len(y_cols),
+            ncols=1,
+            sharex=True,
+            squeeze=False,
+            figsize=(11, max(2, int(1.7 * len(y_cols)))),
+        )
+        self.axes = {c: axes[i][0] for i, c in enumerate(y_cols)}
+        self.lines = {}
+        for c, ax in self.axes.items():
+            # Animated lines are left out of full draws, so the cached background stays clean
+            self.lines[c] = ax.plot([], [], label=c, animated=True)[0]
+            ax.grid(True, which="both", alpha=0.3)
+            ax.set_ylabel(c)
+            ax.set_xlim(0.0, 1.0)
+        axes[-1][0].set_xlabel(x_label)
+        self.fig.tight_layout()
+
+        self.background = None
+        self.full_draws = 0
+        self.blits = 0
+        self.fig.canvas.mpl_connect("draw_event", self._on_draw)
+        plt.show(block=False)
+
+    def _on_draw(self, _event):
+        canvas = self.fig.canvas
+        if getattr(canvas, "supports_blit", False):
+            self.background = canvas.copy_from_bbox(self.fig.bbox)
+        for c, ax in self.axes.items():
+            ax.draw_artist(self.lines[c])
+
+    def _update_xlim(self, x: np.ndarray) -> bool:
+        ax = next(iter(self.axes.values()))
+        lo, hi = ax.get_xlim()
+        x_min, x_max = float(x[0]), float(x[-1])
+
+        if self.windowed:
+            span = max(x_max - x_min, 1e-9)
+            # Leave room on the right so the window only scrolls every ~20% of its width
+            if x_max > hi or x_min - lo > 0.25 * span or lo > x_min:
+                ax.set_xlim(x_min, x_min + 1.2 * span)
+                return True
+            return False
+
+        if x_max > hi or lo > x_min:
+            ax.set_xlim(min(0.0, x_min), max(1.0, x_max * 1.5))
+            return True
+        return False
+
+    def _update_ylim(self, ax, y: np.ndarray) -> bool:
+        finite = y[np.isfinite(y)]
+        if finite.size == 0:
+            return False
+
+        y_min, y_max = float(finite.min()), float(finite.max())
+        lo, hi = ax.get_ylim()
+        span = max(y_max - y_min, abs(y_max) * 1e-3, 1e-9)
+
+        # Grow with headroom, shrink only when the data uses less than a quarter of the range
+        if y_min < lo or y_max > hi or (hi - lo) > 4 * span:
+            ax.set_ylim(y_min - 0.25 * span, y_max + 0.25 * span)
+            return True
+        return False
+
+    def update(self, x: np.ndarray, ys: dict[str, np.ndarray]) -> None:
+        canvas = self.fig.canvas
+        if len(x) == 0:
+            canvas.flush_events()
+            return
+
+        step = max(1, len(x) // MAX_DRAW_POINTS)
+        x_draw = x[::step]
+
+        relimit = self._update_xlim(x)
+        for c, ax in self.axes.items():
+            y = ys[c]
+            self.lines[c].set_data(x_draw, y[::step])
+            relimit |= self._update_ylim(ax, y)
+
+        if relimit or self.background is None:
+            # Ticks moved: full redraw, _on_draw grabs a new background and draws the lines
+            canvas.draw()
+            self.full_draws += 1
+        else:
+            canvas.restore_region(self.background)
+            for c, ax in self.axes.items():
+                ax.draw_artist(self.lines[c])
+            canvas.blit(self.fig.bbox)
+            self.blits += 1
+
+        canvas.flush_events()
+
+
 def main():
     ap = argparse.ArgumentParser()
     ap.add_argument("--file", required=True, help="Path to RTT log file")
+    ap.add_argument(
+        "--binary",
+        action="store_true",
+        help="File is a raw capture of the binary sample stream (RTT channel 1)",
+    )
     ap.add_argument("--x", default="ts_ns", help="X column (default: ts_ns)")
     ap.add_argument("--normalize", default="none")
     ap.add_argument(
@@ -44,169 +274,118 @@ def main():
         action="store_true",
         help="Parse from beginning (default tails from end)",
     )
+    ap.add_argument(
+        "--fps", type=float, default=15.0, help="Max plot refresh rate (default: 15)"
+    )
     ap.add_argument(
         "--list-cols", action="store_true", help="Print detected columns then exit"
     )
     args = ap.parse_args()
 
+    if args.binary and args.list_cols:
+        print("Stream columns:")
+        for c in STREAM_COLUMNS:
+            print(c)
+        return
+
     y_cols = [c.strip() for c in args.y.split(",") if c.strip()]
     if not y_cols:
         raise SystemExit("No Y columns provided")
-
-    y_cols_unique: list[str] = []
-    y_cols_seen: set[str] = set()
-    for c in y_cols:
-        if c not in y_cols_seen:
-            y_cols_unique.append(c)
-            y_cols_seen.add(c)
-    y_cols = y_cols_unique
-
-    columns: list[str] | None = None
-    col_index: dict[str, int] = {}
+    y_cols = list(dict.fromkeys(y_cols))
 
     max_points = None if args.window <= 0 else args.window
-    x_data = deque(maxlen=max_points)
-    y_data = {c: deque(maxlen=max_points) for c in y_cols}
+    x_data = SeriesBuffer(max_points)
+    y_data = {c: SeriesBuffer(max_points) for c in y_cols}
 
     t0_ns: int | None = None
+    warned_missing: set[str] = set()
 
-    groups: list[tuple[str, list[str]]] = [(c, [c]) for c in y_cols]
+    def ingest(rows: list[dict]):
+        nonlocal t0_ns
 
-    plt.ion()
-    fig, axes = plt.subplots(
-        nrows=len(groups),
-        ncols=1,
-        sharex=True,
-        squeeze=False,
-        figsize=(11, max(2, int(1.7 * len(groups)))),
-    )
-    axes_list = [axes[i][0] for i in range(len(groups))]
-
-    lines: dict[str, object] = {}
-    for ax, (name, cols) in zip(axes_list, groups):
-        for c in cols:
-            lines[c] = ax.plot([], [], label=c)[0]
-        ax.grid(True, which="both", alpha=0.3)
-        ax.set_ylabel(name)
-        ax.margins(x=0)
-    axes_list[-1].set_xlabel("t_s" if args.x == "ts_ns" else args.x)
-    fig.tight_layout()
-
-    def refresh_plot():
-        x_list = list(x_data)
-        if x_list:
-            max_x = max(x_list)
-            min_x = x_list[0]
-        else:
-            max_x = 0.0
-            min_x = 0.0
-
-        for ax, (_name, cols) in zip(axes_list, groups):
-            for c in cols:
-                y_list = list(y_data[c])
-                n = min(len(x_list), len(y_list))
-                lines[c].set_data(x_list[-n:], y_list[-n:])
-
-            ax.relim()
-            ax.autoscale_view()
-            if max_points is None:
-                ax.set_xlim(0.0, max_x if max_x > 0.0 else 1.0)
-            else:
-                ax.set_xlim(min_x, max_x if max_x > min_x else (min_x + 1.0))
+        if not rows:
+            return
 
-        fig.canvas.draw_idle()
-        plt.pause(0.001)
+        first = rows[0]
+        for c in [args.x, *y_cols]:
+            if c not in first and c not in warned_missing:
+                print(f"Warning: requested column '{c}' not in data")
+                warned_missing.add(c)
 
-    warned_missing: set[str] = set()
-    header_buf: str | None = None
+        try:
+            if args.x == "ts_ns":
+                ts = np.array([int(r["ts_ns"]) for r in rows], dtype=np.int64)
+                if t0_ns is None:
+                    t0_ns = int(ts[0])
+                x = (ts - t0_ns) / 1e9  # seconds since first sample
+            else:
+                x = np.array([r[args.x] for r in rows], dtype=np.float64)
+            cols = {
+                c: np.array([r.get(c, np.nan) for r in rows], dtype=np.float64)
+                for c in y_cols
+            }
+        except (KeyError, ValueError):
+            # A corrupted row poisons the whole batch: fall back to one row at a time
+            if len(rows) > 1:
+                for r in rows:
+                    ingest([r])
+            return
+
+        x_data.extend(x)
+        for c in y_cols:
+            y_data[c].extend(cols[c])
+
+    text_parser = TextLogParser()
+    decoder = StreamDecoder()
+
+    def read_rows(f) -> tuple[list[dict], bool]:
+        """Everything that is available now (up to READ_CHUNK_BYTES). Second value: hit EOF."""
+        if args.binary:
+            chunk = f.read(READ_CHUNK_BYTES)
+            return decoder.feed(chunk), len(chunk) < READ_CHUNK_BYTES
+
+        lines = f.readlines(READ_CHUNK_BYTES)
+        rows = text_parser.feed(lines)
+        if args.list_cols and text_parser.columns is not None:
+            print("Detected columns:")
+            for c in text_parser.columns:
+                print(c)
+            raise SystemExit(0)
+        return rows, not lines
+
+    plotter = None if args.list_cols else Plotter(
+        y_cols, "t_s" if args.x == "ts_ns" else args.x, max_points is not None
+    )
+    frame_s = 1.0 / args.fps if args.fps > 0 else 0.0
+    next_frame = 0.0
+    dirty = False
 
-    with open(args.file, "r", errors="ignore") as f:
+    mode = "rb" if args.binary else "r"
+    with open(args.file, mode, **({} if args.binary else {"errors": "ignore"})) as f:
         if not args.from_start:
             f.seek(0, os.SEEK_END)
 
         while True:
-            line = f.readline()
-            if not line:
-                refresh_plot()
-                time.sleep(0.05)
-                continue
-
-            payload = parse_app_inf_payload(line)
-            if payload is None:
-                continue
-
-            if (
-                header_buf is not None
-                and (not is_number_row(payload))
-                and ("," in payload)
-                and (not payload.startswith("ts_ns,"))
-            ):
-                if header_buf.endswith(",") or payload.startswith(","):
-                    header_buf = header_buf + payload
-                else:
-                    header_buf = header_buf + "," + payload
-                continue
-
-            # Detect header
-            if payload.startswith("ts_ns,"):
-                header_buf = payload
-                continue
-
-            # Parse data row (needs header first)
-            if ((columns is None) and (header_buf is None)) or (
-                not is_number_row(payload)
-            ):
-                continue
-
-            parts = [p.strip() for p in payload.split(",")]
-
-            try:
-                if header_buf is not None:
-                    columns = [c.strip() for c in header_buf.split(",")]
-                    col_index = {c: i for i, c in enumerate(columns)}
-                    header_buf = None
-
-                    if args.list_cols:
-                        print("Detected columns:")
-                        for c in columns:
-                            print(c)
-                        return
-
-                    for c in [args.x, *y_cols]:
-                        if c not in col_index and c not in warned_missing:
-                            print(f"Warning: requested column '{c}' not in header")
-                            warned_missing.add(c)
-
-                if columns is None:
-                    continue
-
-                if len(parts) != len(columns):
-                    continue
-
-                # Parse x
-                if args.x == "ts_ns":
-                    ts_ns = int(parts[col_index["ts_ns"]])
-                    if t0_ns is None:
-                        t0_ns = ts_ns
-                    x_val = (ts_ns - t0_ns) / 1e9  # seconds since first sample
-                else:
-                    x_val = float(parts[col_index[args.x]])
-
-                row_y: dict[str, float] = {}
-                for c in y_cols:
-                    if c in col_index:
-                        row_y[c] = float(parts[col_index[c]])
+            # Parse everything available until the next frame is due, then render once
+            while True:
+                rows, at_eof = read_rows(f)
+                ingest(rows)
+                dirty |= bool(rows)
+                if at_eof or time.monotonic() >= next_frame:
+                    break
+
+            now = time.monotonic()
+            if now >= next_frame:
+                if plotter is not None:
+                    if dirty:
+                        plotter.update(x_data.view(), {c: y_data[c].view() for c in y_cols})
+                        dirty = False
                     else:
-                        row_y[c] = float("nan")
+                        plotter.fig.canvas.flush_events()
+                next_frame = now + frame_s
 
-                x_data.append(x_val)
-                for c in y_cols:
-                    y_data[c].append(row_y[c])
-
-                refresh_plot()
-            except Exception:
-                # ignore parse errors
-                continue
+            if at_eof:
+                time.sleep(max(0.0, min(0.05, next_frame - time.monotonic())) or 0.01)
 
 
 if __name__ == "__main__":
@@ -0,0 +1,84 @@
+#!/usr/bin/env python3
+"""Fail the build when the static RAM of the firmware image grows past a budget.
+
+Counts every allocated, writable section of the ELF: .data and friends (initialized,
+copied from flash) and .bss/.noinit (thread stacks, buffers). Run from CMakeLists.txt
+after every link, a budget of 0 (CONFIG_AIR_CTRL_RAM_BUDGET unset) only reports the
+usage. It also works standalone:
+
+    python3 scripts/ram_budget.py --budget 61440 build/zephyr/zephyr.elf
+"""
+import argparse
+import struct
+import sys
+
+SHT_NOBITS = 8
+SHF_WRITE = 0x1
+SHF_ALLOC = 0x2
+
+
+def ram_sections(path: str) -> list[tuple[str, int, bool]]:
+    """(name, size, is_bss) of every writable, allocated section."""
+    with open(path, "rb") as f:
+        data = f.read()
+
+    if data[:4] != b"\x7fELF":
+        raise SystemExit(f"{path}: not an ELF file")
+
+    is64 = data[4] == 2
+    endian = "<" if data[5] == 1 else ">"
+    if is64:
+        shoff, = struct.unpack_from(endian + "Q", data, 0x28)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", data, 0x3A)
+        shdr = struct.Struct(endian + "IIQQQQIIQQ")
+    else:
+        shoff, = struct.unpack_from(endian + "I", data, 0x20)
+        shentsize, shnum, shstrndx = struct.unpack_from(endian + "HHH", data, 0x2E)
+        shdr = struct.Struct(endian + "IIIIIIIIII")
+
+    headers = [shdr.unpack_from(data, shoff + i * shentsize) for i in range(shnum)]
+    strtab_off = headers[shstrndx][4]
+
+    def name(off: int) -> str:
+        end = data.index(b"\0", strtab_off + off)
+        return data[strtab_off + off : end].decode()
+
+    sections = []
+    for sh_name, sh_type, sh_flags, _addr, _off, sh_size, *_ in headers:
+        if (sh_flags & (SHF_ALLOC | SHF_WRITE)) == (SHF_ALLOC | SHF_WRITE) and sh_size:
+            sections.append((name(sh_name), sh_size, sh_type == SHT_NOBITS))
+    return sections
+
+
+def main() -> int:
+    ap = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    ap.add_argument("elf", help="Linked firmware image")
+    ap.add_argument("--budget", type=int, default=0,
+                    help="Max static RAM in bytes, 0 only reports")
+    ap.add_argument("--top", type=int, default=8, help="Largest sections listed on failure")
+    args = ap.parse_args()
+
+    sections = ram_sections(args.elf)
+    data = sum(size for _, size, bss in sections if not bss)
+    bss = sum(size for _, size, bss in sections if bss)
+    total = data + bss
+
+    if args.budget <= 0:
+        print(f"RAM: {data} B data + {bss} B bss = {total} B (no budget set)")
+        return 0
+
+    print(f"RAM: {data} B data + {bss} B bss = {total} B of {args.budget} B budget "
+          f"({args.budget - total:+d} B)")
+
+    if total <= args.budget:
+        return 0
+
+    print(f"error: static RAM exceeds CONFIG_AIR_CTRL_RAM_BUDGET by {total - args.budget} B",
+          file=sys.stderr)
+    for name, size, bss in sorted(sections, key=lambda s: s[1], reverse=True)[: args.top]:
+        print(f"  {size:8d}  {'bss ' if bss else 'data'}  {name}", file=sys.stderr)
+    return 1
+
+
+if __name__ == "__main__":
+    sys.exit(main())
@@ -0,0 +1,137 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <stdbool.h>
+#include <string.h>
+
+#include "air_ctrl_agg.h"
+
+LOG_MODULE_REGISTER(air_ctrl_agg, LOG_LEVEL_INF);
+
+/* EWMA state is in 1/256 of the metric's unit so slow trends are not rounded away */
+#define EWMA_FRAC_BITS 8
+
+static const uint32_t period_ms[AIR_CTRL_AGG_LEVEL_COUNT] = {
+	[AIR_CTRL_AGG_1MIN] = 60U * 1000U,
+	[AIR_CTRL_AGG_1H] = 60U * 60U * 1000U,
+	[AIR_CTRL_AGG_24H] = 24U * 60U * 60U * 1000U,
+};
+
+struct bucket {
+	bool open;
+	uint32_t index; /* Uptime in ms / period */
+	uint32_t count;
+	int64_t sum[AIR_CTRL_AGG_METRIC_COUNT];
+	int32_t min[AIR_CTRL_AGG_METRIC_COUNT];
+	int32_t max[AIR_CTRL_AGG_METRIC_COUNT];
+};
+
+static struct bucket buckets[AIR_CTRL_AGG_LEVEL_COUNT];
+
+static int32_t ewma[AIR_CTRL_AGG_LEVEL_COUNT][AIR_CTRL_AGG_METRIC_COUNT];
+static bool ewma_valid[AIR_CTRL_AGG_LEVEL_COUNT];
+
+uint32_t air_ctrl_agg_period_ms(enum air_ctrl_agg_level level)
+{
+	return (level < AIR_CTRL_AGG_LEVEL_COUNT) ? period_ms[level] : 0U;
+}
+
+static int32_t div_round(int64_t num, uint32_t den)
+{
+	return (int32_t)((num >= 0) ? (num + den / 2U) / den : (num - den / 2U) / den);
+}
+
+/* Merge count samples with the given sum/min/max into bucket b (opening it at index) */
+static void bucket_merge(struct bucket *b, uint32_t index, uint32_t count, const int64_t *sum,
+			 const int32_t *min, const int32_t *max)
+{
+	if (!b->open) {
+		b->open = true;
+		b->index = index;
+		b->count = 0;
+		for (int m = 0; m < AIR_CTRL_AGG_METRIC_COUNT; m++) {
+			b->sum[m] = 0;
+			b->min[m] = min[m];
+			b->max[m] = max[m];
+		}
+	}
+
+	b->count += count;
+	for (int m = 0; m < AIR_CTRL_AGG_METRIC_COUNT; m++) {
+		b->sum[m] += sum[m];
+		b->min[m] = MIN(b->min[m], min[m]);
+		b->max[m] = MAX(b->max[m], max[m]);
+	}
+}
+
+static void bucket_close(int level, air_ctrl_agg_summary_t *out)
+{
+	struct bucket *b = &buckets[level];
+
+	out->level = (uint8_t)level;
+	/* Wraps like the other wire timestamps */
+	out->start_ms = (uint32_t)((uint64_t)b->index * period_ms[level]);
+	out->count = b->count;
+
+	for (int m = 0; m < AIR_CTRL_AGG_METRIC_COUNT; m++) {
+		air_ctrl_agg_stat_t *stat = &out->stat[m];
+		int32_t mean_q;
+
+		stat->mean = div_round(b->sum[m], b->count);
+		stat->min = b->min[m];
+		stat->max = b->max[m];
+
+		mean_q = stat->mean * (1 << EWMA_FRAC_BITS);
+		if (ewma_valid[level]) {
+			ewma[level][m] += (mean_q - ewma[level][m]) /
+					  (1 << CONFIG_AIR_CTRL_AGG_EWMA_SHIFT);
+		} else {
+			ewma[level][m] = mean_q;
+		}
+		stat->ewma = div_round(ewma[level][m], 1U << EWMA_FRAC_BITS);
+	}
+	ewma_valid[level] = true;
+
+	LOG_DBG("Level %d bucket at %u ms closed, %u samples", level, out->start_ms, out->count);
+
+	/* The next level up gets the whole bucket at once */
+	if (level + 1 < AIR_CTRL_AGG_LEVEL_COUNT) {
+		bucket_merge(&buckets[level + 1],
+			     (uint32_t)((uint64_t)b->index * period_ms[level] / period_ms[level + 1]),
+			     b->count, b->sum, b->min, b->max);
+	}
+
+	b->open = false;
+}
+
+size_t air_ctrl_agg_add(const air_ctrl_sensor_data_t *data,
+			air_ctrl_agg_summary_t closed[AIR_CTRL_AGG_LEVEL_COUNT])
+{
+	int64_t sum[AIR_CTRL_AGG_METRIC_COUNT];
+	int32_t value[AIR_CTRL_AGG_METRIC_COUNT];
+	size_t n = 0;
+
+	value[AIR_CTRL_AGG_TEMP] = data->raw_temp_c_x100;
+	value[AIR_CTRL_AGG_HUM] = data->raw_hum_rh_x100;
+	value[AIR_CTRL_AGG_IAQ] = data->iaq_x10;
+	value[AIR_CTRL_AGG_CO2] = data->co2_eq_ppm;
+
+	/* Finest level first, a closing minute lands in its hour before the hour is checked */
+	for (int level = 0; level < AIR_CTRL_AGG_LEVEL_COUNT; level++) {
+		struct bucket *b = &buckets[level];
+
+		if (b->open && b->index != (uint32_t)(data->timestamp_ms / period_ms[level])) {
+			bucket_close(level, &closed[n++]);
+		}
+	}
+
+	for (int m = 0; m < AIR_CTRL_AGG_METRIC_COUNT; m++) {
+		sum[m] = value[m];
+	}
+	bucket_merge(&buckets[AIR_CTRL_AGG_1MIN],
+		     (uint32_t)(data->timestamp_ms / period_ms[AIR_CTRL_AGG_1MIN]), 1U, sum, value,
+		     value);
+
+	return n;
+}
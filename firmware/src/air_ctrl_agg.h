@@ -0,0 +1,70 @@
+#ifndef AIR_CTRL_AGG_H_
+#define AIR_CTRL_AGG_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "air_ctrl_sensor.h"
+
+/* Rolling 1 min / 1 h / 24 h aggregates of temperature, humidity, IAQ and CO2-eq.
+ * Buckets are aligned to multiples of their length in uptime. Each level keeps a
+ * running sum, min and max; when a minute closes it is folded into the open hour and the
+ * hour into the day, so memory does not depend on the sample rate. The EWMA of a level
+ * is updated from the mean of every bucket it closes.
+ */
+
+enum air_ctrl_agg_level {
+	AIR_CTRL_AGG_1MIN,
+	AIR_CTRL_AGG_1H,
+	AIR_CTRL_AGG_24H,
+	AIR_CTRL_AGG_LEVEL_COUNT,
+};
+
+enum air_ctrl_agg_metric {
+	AIR_CTRL_AGG_TEMP, /* raw_temp_c_x100 */
+	AIR_CTRL_AGG_HUM,  /* raw_hum_rh_x100 */
+	AIR_CTRL_AGG_IAQ,  /* iaq_x10 */
+	AIR_CTRL_AGG_CO2,  /* co2_eq_ppm */
+	AIR_CTRL_AGG_METRIC_COUNT,
+};
+
+typedef struct {
+	int32_t mean;
+	int32_t min;
+	int32_t max;
+	int32_t ewma;
+} air_ctrl_agg_stat_t;
+
+/* One closed bucket, values in the fixed-point units of air_ctrl_sensor_data_t */
+typedef struct {
+	uint8_t level;
+	uint32_t start_ms;
+	uint32_t count;
+	air_ctrl_agg_stat_t stat[AIR_CTRL_AGG_METRIC_COUNT];
+} air_ctrl_agg_summary_t;
+
+#if defined(CONFIG_AIR_CTRL_AGG)
+
+/* Add one sample, from the main thread. Buckets the sample's timestamp no longer falls
+ * into are closed first and written to closed[] (finest level first).
+ * Returns how many were closed, 0 to AIR_CTRL_AGG_LEVEL_COUNT.
+ */
+size_t air_ctrl_agg_add(const air_ctrl_sensor_data_t *data,
+			air_ctrl_agg_summary_t closed[AIR_CTRL_AGG_LEVEL_COUNT]);
+
+uint32_t air_ctrl_agg_period_ms(enum air_ctrl_agg_level level);
+
+#else
+
+static inline size_t air_ctrl_agg_add(const air_ctrl_sensor_data_t *data,
+				      air_ctrl_agg_summary_t closed[AIR_CTRL_AGG_LEVEL_COUNT])
+{
+	(void)data;
+	(void)closed;
+
+	return 0;
+}
+
+#endif /* CONFIG_AIR_CTRL_AGG */
+
+#endif /* AIR_CTRL_AGG_H_ */
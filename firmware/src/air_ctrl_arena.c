@@ -0,0 +1,58 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/__assert.h>
+#include <zephyr/sys/util.h>
+
+#include "air_ctrl_arena.h"
+
+#if defined(CONFIG_AIR_CTRL_USE_BSEC)
+#include "bsec_datatypes.h"
+#endif
+
+LOG_MODULE_REGISTER(air_ctrl_arena, LOG_LEVEL_INF);
+
+/* Work buffer followed by the state blob, for bsec_set_configuration/set_state/get_state */
+#if defined(CONFIG_AIR_CTRL_USE_BSEC)
+#define ARENA_BSEC_SIZE (BSEC_MAX_WORKBUFFER_SIZE + BSEC_MAX_STATE_BLOB_SIZE)
+#else
+#define ARENA_BSEC_SIZE 0
+#endif
+
+/* One history notification */
+#if defined(CONFIG_BT)
+#define ARENA_BT_SIZE (CONFIG_BT_L2CAP_TX_MTU - 3)
+#else
+#define ARENA_BT_SIZE 0
+#endif
+
+#define ARENA_SIZE MAX(MAX(ARENA_BSEC_SIZE, ARENA_BT_SIZE), 8)
+
+static uint8_t arena[ARENA_SIZE] __aligned(8);
+
+/* A semaphore and not a mutex: the BSEC state is released by the work queue that saves it */
+static K_SEM_DEFINE(arena_sem, 1, 1);
+static enum air_ctrl_arena_user arena_owner;
+
+void *air_ctrl_arena_acquire(enum air_ctrl_arena_user user, size_t size, k_timeout_t timeout)
+{
+	if (size > sizeof(arena)) {
+		LOG_ERR("Arena too small for user %d (%u > %u bytes)", user, (uint32_t)size,
+			(uint32_t)sizeof(arena));
+		return NULL;
+	}
+
+	if (k_sem_take(&arena_sem, timeout) != 0) {
+		return NULL;
+	}
+
+	arena_owner = user;
+	return arena;
+}
+
+void air_ctrl_arena_release(enum air_ctrl_arena_user user)
+{
+	__ASSERT(arena_owner == user, "Arena released by %d but owned by %d", user, arena_owner);
+
+	arena_owner = AIR_CTRL_ARENA_NONE;
+	k_sem_give(&arena_sem);
+}
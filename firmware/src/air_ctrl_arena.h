@@ -0,0 +1,27 @@
+#ifndef AIR_CTRL_ARENA_H_
+#define AIR_CTRL_ARENA_H_
+
+#include <stddef.h>
+
+#include <zephyr/kernel.h>
+
+/* One statically allocated scratch region shared by buffers that are only needed during a
+ * phase (BSEC init, BSEC state save, BLE history download). One user owns it at a time; the
+ * region is sized for the largest user.
+ */
+enum air_ctrl_arena_user {
+	AIR_CTRL_ARENA_NONE,
+	AIR_CTRL_ARENA_BSEC_INIT,
+	AIR_CTRL_ARENA_BSEC_STATE,
+	AIR_CTRL_ARENA_BT_HISTORY,
+};
+
+/* Take the region for at least size bytes. Returns NULL if it is still owned after timeout
+ * or if size is larger than the region. The contents are undefined.
+ */
+void *air_ctrl_arena_acquire(enum air_ctrl_arena_user user, size_t size, k_timeout_t timeout);
+
+/* Hand the region back. May be called from another thread than the one that acquired it. */
+void air_ctrl_arena_release(enum air_ctrl_arena_user user);
+
+#endif /* AIR_CTRL_ARENA_H_ */
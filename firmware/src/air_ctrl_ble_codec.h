@@ -0,0 +1,780 @@
+#ifndef AIR_CTRL_BLE_CODEC_H_
+#define AIR_CTRL_BLE_CODEC_H_
+
+#include <errno.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* BLE wire formats with their encoders and decoders. Plain C99 with no Zephyr or firmware
+ * dependencies, so gateways and host tools can include it as is (cc -I firmware/src).
+ * air_ctrl_ble_proto.h adds the firmware side on top.
+ *
+ * Every frame starts with a version byte, numbered across all formats, so a value can be
+ * told apart by its first byte (except history notifications, which start with flags):
+ *
+ *   1  advertising data (after the company ID)
+ *   2  single sample                 6  compact single sample
+ *   3  sample batch
+ *   4  aggregates
+ *   5  threshold alert
+ *   7  diagnostics (air_ctrl_prof.c, no decoder here and not negotiated)
+ *
+ * The protocol characteristic lets both sides agree on the formats: a read returns the
+ * versions the firmware sends (a mask of AIR_CTRL_BLE_VERSION_BIT()), and a central writes
+ * back the ones it decodes, see air_ctrl_ble_negotiate(). Formats the central leaves out are
+ * replaced by an older one where there is one (a full sample instead of a compact one), or
+ * not sent. A central that never writes gets every format.
+ *
+ * Decoders are strict: the length must match the frame exactly and every enumerated field
+ * must be in range. They return 0 (or a record count) on success, -EMSGSIZE for a length
+ * mismatch, -ENOTSUP for a version this codec does not know (newer firmware), -EBADMSG for
+ * a value out of range and -ENOBUFS when the output array is too small.
+ */
+
+#define AIR_CTRL_BLE_PACKED __attribute__((__packed__))
+
+#define AIR_CTRL_BLE_VERSION_ADV 1U
+#define AIR_CTRL_BLE_VERSION_SAMPLE 2U
+#define AIR_CTRL_BLE_VERSION_BATCH 3U
+#define AIR_CTRL_BLE_VERSION_AGG 4U
+#define AIR_CTRL_BLE_VERSION_ALERT 5U
+#define AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT 6U
+#define AIR_CTRL_BLE_VERSION_DIAG 7U
+
+#define AIR_CTRL_BLE_VERSION_BIT(version) (1U << (version))
+/* Every version this codec decodes */
+#define AIR_CTRL_BLE_VERSIONS                                                                      \
+	(AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_ADV) |                                      \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_SAMPLE) |                                   \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_BATCH) |                                    \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_AGG) |                                      \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_ALERT) |                                    \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT))
+/* The fallback every central has to accept */
+#define AIR_CTRL_BLE_VERSIONS_REQUIRED AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_SAMPLE)
+
+/* Bluetooth SIG company ID reserved for testing */
+#define AIR_CTRL_BLE_COMPANY_ID 0xFFFFU
+
+/* Bits in the sample flags */
+#define AIR_CTRL_BLE_SAMPLE_FLAG_KEEPALIVE 0x01U /* Sent by the keep-alive, still in the deadband */
+/* Bits 1-7: samples the deadband held back right before this one. Their seqs were not
+ * lost, their values stayed within the band of the previously notified sample.
+ */
+#define AIR_CTRL_BLE_SAMPLE_HELD_SHIFT 1U
+#define AIR_CTRL_BLE_SAMPLE_HELD_MAX 127U
+
+/* Sample fields, as in the compact sample's field mask (same bits as the firmware's
+ * AIR_CTRL_SENSOR_OUT_* output groups)
+ */
+#define AIR_CTRL_BLE_FIELD_TEMP 0x0001U
+#define AIR_CTRL_BLE_FIELD_HUM 0x0002U
+#define AIR_CTRL_BLE_FIELD_GAS 0x0008U
+#define AIR_CTRL_BLE_FIELD_IAQ 0x0010U /* iaq_x10 and iaq_acc */
+#define AIR_CTRL_BLE_FIELD_CO2_EQ 0x0040U
+#define AIR_CTRL_BLE_FIELD_BREATH_VOC 0x0080U
+#define AIR_CTRL_BLE_SAMPLE_FIELDS                                                                 \
+	(AIR_CTRL_BLE_FIELD_TEMP | AIR_CTRL_BLE_FIELD_HUM | AIR_CTRL_BLE_FIELD_GAS |               \
+	 AIR_CTRL_BLE_FIELD_IAQ | AIR_CTRL_BLE_FIELD_CO2_EQ | AIR_CTRL_BLE_FIELD_BREATH_VOC)
+
+/* History notifications: a flags byte followed by stored single samples */
+#define AIR_CTRL_BLE_HISTORY_FLAG_END 0x01U /* Last notification of the download */
+
+#define AIR_CTRL_BLE_AGG_LEVEL_COUNT 3 /* 1 min, 1 h, 24 h */
+
+enum air_ctrl_ble_alert_metric {
+	AIR_CTRL_BLE_ALERT_IAQ,
+	AIR_CTRL_BLE_ALERT_CO2,
+	AIR_CTRL_BLE_ALERT_COUNT,
+};
+
+static inline uint16_t air_ctrl_ble_le16(uint16_t value)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	return (uint16_t)((value >> 8) | (value << 8));
+#else
+	return value;
+#endif
+}
+
+static inline uint32_t air_ctrl_ble_le32(uint32_t value)
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+	return ((value >> 24) & 0xFFU) | ((value >> 8) & 0xFF00U) | ((value << 8) & 0xFF0000U) |
+	       (value << 24);
+#else
+	return value;
+#endif
+}
+
+/* Sample values in BLE units, shared by the single and batched formats */
+struct air_ctrl_ble_values {
+	int16_t temp_c_x100;
+	uint16_t hum_rh_x100;
+	uint32_t gas_ohm;
+	uint16_t iaq_x10;
+	uint8_t iaq_acc;
+	uint16_t co2_eq_ppm;
+	uint16_t breath_voc_eq_ppb;
+};
+
+/* Wire structs, little endian */
+
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_sample_v2 {
+	uint8_t version;
+	uint8_t flags;
+	uint16_t seq;
+	uint32_t timestamp_ms;
+	int16_t temp_c_x100;
+	uint16_t hum_rh_x100;
+	uint32_t gas_ohm;
+	uint16_t iaq_x10;
+	uint8_t iaq_acc;
+	uint16_t co2_eq_ppm;
+	uint16_t breath_voc_eq_ppb;
+};
+
+/* Compact single sample, sent instead of the full one while some of its fields are not
+ * subscribed: this header, then only the fields whose bit is set in `fields`, in the order
+ * and encoding of air_ctrl_ble_sample_v2 (IAQ is iaq_x10 followed by iaq_acc)
+ */
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_sample_hdr_v6 {
+	uint8_t version;
+	uint8_t flags;
+	uint16_t seq;
+	uint32_t timestamp_ms;
+	uint16_t fields;
+};
+
+/* Batched samples: one header followed by up to N entries, sized to the ATT MTU */
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_batch_hdr_v3 {
+	uint8_t version;
+	uint8_t count;
+	uint16_t base_seq;
+	uint32_t base_timestamp_ms;
+};
+
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_batch_entry_v3 {
+	uint16_t dt_ms; /* Time since the previous entry (0 for the first) */
+	int16_t temp_c_x100;
+	uint16_t hum_rh_x100;
+	uint32_t gas_ohm;
+	uint16_t iaq_x10;
+	uint8_t iaq_acc;
+	uint16_t co2_eq_ppm;
+	uint16_t breath_voc_eq_ppb;
+};
+
+/* One closed aggregate bucket. A notification carries one record per level that closed on
+ * the same sample, finest first.
+ */
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_agg_stat_v4 {
+	uint16_t mean; /* int16 for temperature */
+	uint16_t min;
+	uint16_t max;
+	uint16_t ewma;
+};
+
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_agg_v4 {
+	uint8_t version;
+	uint8_t level; /* 0: 1 min, 1: 1 h, 2: 24 h */
+	uint32_t start_ms;
+	uint32_t count;
+	struct air_ctrl_ble_agg_stat_v4 temp_c_x100;
+	struct air_ctrl_ble_agg_stat_v4 hum_rh_x100;
+	struct air_ctrl_ble_agg_stat_v4 iaq_x10;
+	struct air_ctrl_ble_agg_stat_v4 co2_eq_ppm;
+};
+
+/* Threshold alert, sent when a value crosses its threshold (raised) or drops below
+ * threshold - hysteresis (cleared)
+ */
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_alert_v5 {
+	uint8_t version;
+	uint8_t metric; /* enum air_ctrl_ble_alert_metric */
+	uint8_t raised; /* 1: above the threshold, 0: cleared */
+	uint16_t seq;
+	uint32_t timestamp_ms;
+	uint16_t value; /* iaq_x10 or co2_eq_ppm */
+	uint16_t threshold;
+};
+
+/* Protocol characteristic, read and write: a mask of AIR_CTRL_BLE_VERSION_BIT() */
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_protocol {
+	uint16_t versions;
+};
+
+/* Manufacturer specific advertising data: the latest sample for passive scanners */
+struct AIR_CTRL_BLE_PACKED air_ctrl_ble_adv_v1 {
+	uint16_t company_id;
+	uint8_t version;
+	uint16_t seq;
+	int16_t temp_c_x100;
+	uint16_t hum_rh_x100;
+	uint16_t iaq_x10;
+	uint8_t iaq_acc;
+	uint16_t co2_eq_ppm;
+	uint16_t breath_voc_eq_ppb;
+};
+
+/* Decoded records, host byte order */
+
+/* A single, batched, stored or advertised sample. Fields not in `fields` are 0. */
+struct air_ctrl_ble_sample {
+	uint8_t version;
+	uint8_t flags;
+	uint16_t seq;
+	uint32_t timestamp_ms; /* 0 for advertising data, which carries none */
+	uint16_t fields;
+	struct air_ctrl_ble_values values;
+};
+
+struct air_ctrl_ble_agg_stat {
+	uint16_t mean;
+	uint16_t min;
+	uint16_t max;
+	uint16_t ewma;
+};
+
+struct air_ctrl_ble_agg {
+	uint8_t level;
+	uint32_t start_ms;
+	uint32_t count;
+	struct air_ctrl_ble_agg_stat temp_c_x100; /* Cast to int16_t */
+	struct air_ctrl_ble_agg_stat hum_rh_x100;
+	struct air_ctrl_ble_agg_stat iaq_x10;
+	struct air_ctrl_ble_agg_stat co2_eq_ppm;
+};
+
+struct air_ctrl_ble_alert {
+	enum air_ctrl_ble_alert_metric metric;
+	bool raised;
+	uint16_t seq;
+	uint32_t timestamp_ms;
+	uint16_t value;
+	uint16_t threshold;
+};
+
+/* True for the frame versions this codec decodes */
+static inline bool air_ctrl_ble_version_supported(uint8_t version)
+{
+	return version < 16U && (AIR_CTRL_BLE_VERSIONS & AIR_CTRL_BLE_VERSION_BIT(version)) != 0U;
+}
+
+/* What a central writes to the protocol characteristic, given what the firmware offers
+ * there (the read value) and the versions the central decodes (`ours`, usually
+ * AIR_CTRL_BLE_VERSIONS). -ENOTSUP when the two have no usable format in common: the
+ * firmware is too new for this central, or the central too new for the firmware.
+ */
+static inline int air_ctrl_ble_negotiate(uint16_t offered, uint16_t ours, uint16_t *accepted)
+{
+	uint16_t common = (uint16_t)(offered & ours);
+
+	if ((common & AIR_CTRL_BLE_VERSIONS_REQUIRED) != AIR_CTRL_BLE_VERSIONS_REQUIRED) {
+		return -ENOTSUP;
+	}
+
+	*accepted = common;
+	return 0;
+}
+
+static inline void air_ctrl_ble_encode_protocol(uint16_t versions,
+						struct air_ctrl_ble_protocol *protocol)
+{
+	protocol->versions = air_ctrl_ble_le16(versions);
+}
+
+/* A read of the protocol characteristic, or a central's write of it */
+static inline int air_ctrl_ble_decode_protocol(const uint8_t *buf, size_t len, uint16_t *versions)
+{
+	struct air_ctrl_ble_protocol raw;
+
+	if (len != sizeof(raw)) {
+		return -EMSGSIZE;
+	}
+
+	memcpy(&raw, buf, sizeof(raw));
+	*versions = air_ctrl_ble_le16(raw.versions);
+	if ((*versions & AIR_CTRL_BLE_VERSION_BIT(0)) != 0U) {
+		return -EBADMSG;
+	}
+
+	return 0;
+}
+
+/* Encoders */
+
+static inline void air_ctrl_ble_encode_sample_v2(uint16_t seq, uint32_t timestamp_ms,
+						 const struct air_ctrl_ble_values *values,
+						 struct air_ctrl_ble_sample_v2 *sample)
+{
+	sample->version = AIR_CTRL_BLE_VERSION_SAMPLE;
+	sample->flags = 0U;
+	sample->seq = air_ctrl_ble_le16(seq);
+	sample->timestamp_ms = air_ctrl_ble_le32(timestamp_ms);
+	sample->temp_c_x100 = (int16_t)air_ctrl_ble_le16((uint16_t)values->temp_c_x100);
+	sample->hum_rh_x100 = air_ctrl_ble_le16(values->hum_rh_x100);
+	sample->gas_ohm = air_ctrl_ble_le32(values->gas_ohm);
+	sample->iaq_x10 = air_ctrl_ble_le16(values->iaq_x10);
+	sample->iaq_acc = values->iaq_acc;
+	sample->co2_eq_ppm = air_ctrl_ble_le16(values->co2_eq_ppm);
+	sample->breath_voc_eq_ppb = air_ctrl_ble_le16(values->breath_voc_eq_ppb);
+}
+
+static inline size_t air_ctrl_ble_pack_field(uint8_t *buf, size_t len, const void *field,
+					      size_t size)
+{
+	memcpy(&buf[len], field, size);
+	return len + size;
+}
+
+/* Wire form of an encoded sample for the given fields: the sample itself when all of them
+ * are set, the compact v6 form otherwise. Never longer than the full sample.
+ */
+static inline size_t air_ctrl_ble_pack_sample(const struct air_ctrl_ble_sample_v2 *sample,
+					      uint32_t fields, uint8_t *buf)
+{
+	struct air_ctrl_ble_sample_hdr_v6 hdr;
+	size_t len = sizeof(hdr);
+
+	fields &= AIR_CTRL_BLE_SAMPLE_FIELDS;
+	if (fields == AIR_CTRL_BLE_SAMPLE_FIELDS) {
+		memcpy(buf, sample, sizeof(*sample));
+		return sizeof(*sample);
+	}
+
+	hdr.version = AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT;
+	hdr.flags = sample->flags;
+	hdr.seq = sample->seq;
+	hdr.timestamp_ms = sample->timestamp_ms;
+	hdr.fields = air_ctrl_ble_le16((uint16_t)fields);
+	memcpy(buf, &hdr, sizeof(hdr));
+
+	if (fields & AIR_CTRL_BLE_FIELD_TEMP) {
+		len = air_ctrl_ble_pack_field(buf, len, &sample->temp_c_x100,
+					      sizeof(sample->temp_c_x100));
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_HUM) {
+		len = air_ctrl_ble_pack_field(buf, len, &sample->hum_rh_x100,
+					      sizeof(sample->hum_rh_x100));
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_GAS) {
+		len = air_ctrl_ble_pack_field(buf, len, &sample->gas_ohm, sizeof(sample->gas_ohm));
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_IAQ) {
+		len = air_ctrl_ble_pack_field(buf, len, &sample->iaq_x10, sizeof(sample->iaq_x10));
+		len = air_ctrl_ble_pack_field(buf, len, &sample->iaq_acc, sizeof(sample->iaq_acc));
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_CO2_EQ) {
+		len = air_ctrl_ble_pack_field(buf, len, &sample->co2_eq_ppm,
+					      sizeof(sample->co2_eq_ppm));
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_BREATH_VOC) {
+		len = air_ctrl_ble_pack_field(buf, len, &sample->breath_voc_eq_ppb,
+					      sizeof(sample->breath_voc_eq_ppb));
+	}
+
+	return len;
+}
+
+static inline void air_ctrl_ble_encode_batch_entry_v3(uint16_t dt_ms,
+						      const struct air_ctrl_ble_values *values,
+						      struct air_ctrl_ble_batch_entry_v3 *entry)
+{
+	entry->dt_ms = air_ctrl_ble_le16(dt_ms);
+	entry->temp_c_x100 = (int16_t)air_ctrl_ble_le16((uint16_t)values->temp_c_x100);
+	entry->hum_rh_x100 = air_ctrl_ble_le16(values->hum_rh_x100);
+	entry->gas_ohm = air_ctrl_ble_le32(values->gas_ohm);
+	entry->iaq_x10 = air_ctrl_ble_le16(values->iaq_x10);
+	entry->iaq_acc = values->iaq_acc;
+	entry->co2_eq_ppm = air_ctrl_ble_le16(values->co2_eq_ppm);
+	entry->breath_voc_eq_ppb = air_ctrl_ble_le16(values->breath_voc_eq_ppb);
+}
+
+static inline void air_ctrl_ble_encode_adv_v1(uint16_t seq, const struct air_ctrl_ble_values *values,
+					      struct air_ctrl_ble_adv_v1 *adv)
+{
+	adv->company_id = air_ctrl_ble_le16(AIR_CTRL_BLE_COMPANY_ID);
+	adv->version = AIR_CTRL_BLE_VERSION_ADV;
+	adv->seq = air_ctrl_ble_le16(seq);
+	adv->temp_c_x100 = (int16_t)air_ctrl_ble_le16((uint16_t)values->temp_c_x100);
+	adv->hum_rh_x100 = air_ctrl_ble_le16(values->hum_rh_x100);
+	adv->iaq_x10 = air_ctrl_ble_le16(values->iaq_x10);
+	adv->iaq_acc = values->iaq_acc;
+	adv->co2_eq_ppm = air_ctrl_ble_le16(values->co2_eq_ppm);
+	adv->breath_voc_eq_ppb = air_ctrl_ble_le16(values->breath_voc_eq_ppb);
+}
+
+static inline void air_ctrl_ble_encode_alert_v5(enum air_ctrl_ble_alert_metric metric, bool raised,
+						uint16_t seq, uint32_t timestamp_ms, uint16_t value,
+						uint16_t threshold, struct air_ctrl_ble_alert_v5 *alert)
+{
+	alert->version = AIR_CTRL_BLE_VERSION_ALERT;
+	alert->metric = (uint8_t)metric;
+	alert->raised = raised ? 1U : 0U;
+	alert->seq = air_ctrl_ble_le16(seq);
+	alert->timestamp_ms = air_ctrl_ble_le32(timestamp_ms);
+	alert->value = air_ctrl_ble_le16(value);
+	alert->threshold = air_ctrl_ble_le16(threshold);
+}
+
+/* Decoders */
+
+/* Returns the entry's dt_ms */
+static inline uint16_t air_ctrl_ble_decode_batch_entry_v3(const struct air_ctrl_ble_batch_entry_v3 *entry,
+							  struct air_ctrl_ble_values *values)
+{
+	values->temp_c_x100 = (int16_t)air_ctrl_ble_le16((uint16_t)entry->temp_c_x100);
+	values->hum_rh_x100 = air_ctrl_ble_le16(entry->hum_rh_x100);
+	values->gas_ohm = air_ctrl_ble_le32(entry->gas_ohm);
+	values->iaq_x10 = air_ctrl_ble_le16(entry->iaq_x10);
+	values->iaq_acc = entry->iaq_acc;
+	values->co2_eq_ppm = air_ctrl_ble_le16(entry->co2_eq_ppm);
+	values->breath_voc_eq_ppb = air_ctrl_ble_le16(entry->breath_voc_eq_ppb);
+
+	return air_ctrl_ble_le16(entry->dt_ms);
+}
+
+static inline size_t air_ctrl_ble_sample_fields_len(uint16_t fields)
+{
+	size_t len = 0;
+
+	len += (fields & AIR_CTRL_BLE_FIELD_TEMP) ? 2U : 0U;
+	len += (fields & AIR_CTRL_BLE_FIELD_HUM) ? 2U : 0U;
+	len += (fields & AIR_CTRL_BLE_FIELD_GAS) ? 4U : 0U;
+	len += (fields & AIR_CTRL_BLE_FIELD_IAQ) ? 3U : 0U;
+	len += (fields & AIR_CTRL_BLE_FIELD_CO2_EQ) ? 2U : 0U;
+	len += (fields & AIR_CTRL_BLE_FIELD_BREATH_VOC) ? 2U : 0U;
+
+	return len;
+}
+
+static inline uint16_t air_ctrl_ble_get_le16(const uint8_t *buf)
+{
+	return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static inline uint32_t air_ctrl_ble_get_le32(const uint8_t *buf)
+{
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+	       ((uint32_t)buf[3] << 24);
+}
+
+static inline int air_ctrl_ble_decode_sample_v2(const uint8_t *buf, size_t len,
+						struct air_ctrl_ble_sample *sample)
+{
+	struct air_ctrl_ble_sample_v2 raw;
+
+	if (len != sizeof(raw)) {
+		return -EMSGSIZE;
+	}
+
+	memcpy(&raw, buf, sizeof(raw));
+	if (raw.version != AIR_CTRL_BLE_VERSION_SAMPLE) {
+		return -EBADMSG;
+	}
+
+	sample->version = raw.version;
+	sample->flags = raw.flags;
+	sample->seq = air_ctrl_ble_le16(raw.seq);
+	sample->timestamp_ms = air_ctrl_ble_le32(raw.timestamp_ms);
+	sample->fields = AIR_CTRL_BLE_SAMPLE_FIELDS;
+	sample->values.temp_c_x100 = (int16_t)air_ctrl_ble_le16((uint16_t)raw.temp_c_x100);
+	sample->values.hum_rh_x100 = air_ctrl_ble_le16(raw.hum_rh_x100);
+	sample->values.gas_ohm = air_ctrl_ble_le32(raw.gas_ohm);
+	sample->values.iaq_x10 = air_ctrl_ble_le16(raw.iaq_x10);
+	sample->values.iaq_acc = raw.iaq_acc;
+	sample->values.co2_eq_ppm = air_ctrl_ble_le16(raw.co2_eq_ppm);
+	sample->values.breath_voc_eq_ppb = air_ctrl_ble_le16(raw.breath_voc_eq_ppb);
+
+	return 0;
+}
+
+/* A notification or read of the sample characteristic (full or compact) */
+static inline int air_ctrl_ble_decode_sample(const uint8_t *buf, size_t len,
+					     struct air_ctrl_ble_sample *sample)
+{
+	struct air_ctrl_ble_sample_hdr_v6 hdr;
+	const uint8_t *p;
+	uint16_t fields;
+
+	if (len < 1U) {
+		return -EMSGSIZE;
+	}
+
+	if (buf[0] == AIR_CTRL_BLE_VERSION_SAMPLE) {
+		return air_ctrl_ble_decode_sample_v2(buf, len, sample);
+	}
+
+	if (buf[0] != AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT) {
+		return air_ctrl_ble_version_supported(buf[0]) ? -EBADMSG : -ENOTSUP;
+	}
+
+	if (len < sizeof(hdr)) {
+		return -EMSGSIZE;
+	}
+
+	memcpy(&hdr, buf, sizeof(hdr));
+	fields = air_ctrl_ble_le16(hdr.fields);
+	if ((fields & ~AIR_CTRL_BLE_SAMPLE_FIELDS) != 0U) {
+		return -EBADMSG;
+	}
+
+	if (len != sizeof(hdr) + air_ctrl_ble_sample_fields_len(fields)) {
+		return -EMSGSIZE;
+	}
+
+	memset(sample, 0, sizeof(*sample));
+	sample->version = hdr.version;
+	sample->flags = hdr.flags;
+	sample->seq = air_ctrl_ble_le16(hdr.seq);
+	sample->timestamp_ms = air_ctrl_ble_le32(hdr.timestamp_ms);
+	sample->fields = fields;
+
+	p = &buf[sizeof(hdr)];
+	if (fields & AIR_CTRL_BLE_FIELD_TEMP) {
+		sample->values.temp_c_x100 = (int16_t)air_ctrl_ble_get_le16(p);
+		p += 2;
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_HUM) {
+		sample->values.hum_rh_x100 = air_ctrl_ble_get_le16(p);
+		p += 2;
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_GAS) {
+		sample->values.gas_ohm = air_ctrl_ble_get_le32(p);
+		p += 4;
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_IAQ) {
+		sample->values.iaq_x10 = air_ctrl_ble_get_le16(p);
+		sample->values.iaq_acc = p[2];
+		p += 3;
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_CO2_EQ) {
+		sample->values.co2_eq_ppm = air_ctrl_ble_get_le16(p);
+		p += 2;
+	}
+	if (fields & AIR_CTRL_BLE_FIELD_BREATH_VOC) {
+		sample->values.breath_voc_eq_ppb = air_ctrl_ble_get_le16(p);
+	}
+
+	return 0;
+}
+
+/* Samples lost between two decoded notifications of the sample characteristic: the seq gap
+ * minus what the deadband held back on purpose (0 when nothing is missing)
+ */
+static inline uint16_t air_ctrl_ble_sample_lost(uint16_t prev_seq,
+						const struct air_ctrl_ble_sample *sample)
+{
+	uint16_t gap = (uint16_t)(sample->seq - prev_seq - 1U);
+	uint16_t held = sample->flags >> AIR_CTRL_BLE_SAMPLE_HELD_SHIFT;
+
+	return (gap > held) ? (uint16_t)(gap - held) : 0U;
+}
+
+/* A batch notification. Returns the number of samples, with seq and timestamp_ms
+ * rebuilt from the header and the entries' dt_ms.
+ */
+static inline int air_ctrl_ble_decode_batch(const uint8_t *buf, size_t len,
+					    struct air_ctrl_ble_sample *samples, size_t max_samples)
+{
+	struct air_ctrl_ble_batch_hdr_v3 hdr;
+	struct air_ctrl_ble_batch_entry_v3 entry;
+	uint32_t timestamp_ms;
+	uint16_t seq;
+
+	if (len < sizeof(hdr)) {
+		return -EMSGSIZE;
+	}
+
+	memcpy(&hdr, buf, sizeof(hdr));
+	if (hdr.version != AIR_CTRL_BLE_VERSION_BATCH) {
+		return air_ctrl_ble_version_supported(hdr.version) ? -EBADMSG : -ENOTSUP;
+	}
+
+	if (hdr.count == 0U) {
+		return -EBADMSG;
+	}
+
+	if (len != sizeof(hdr) + (size_t)hdr.count * sizeof(entry)) {
+		return -EMSGSIZE;
+	}
+
+	if (hdr.count > max_samples) {
+		return -ENOBUFS;
+	}
+
+	seq = air_ctrl_ble_le16(hdr.base_seq);
+	timestamp_ms = air_ctrl_ble_le32(hdr.base_timestamp_ms);
+	for (uint8_t i = 0; i < hdr.count; i++) {
+		memcpy(&entry, &buf[sizeof(hdr) + (size_t)i * sizeof(entry)], sizeof(entry));
+		timestamp_ms += air_ctrl_ble_decode_batch_entry_v3(&entry, &samples[i].values);
+		samples[i].version = hdr.version;
+		samples[i].flags = 0U;
+		samples[i].seq = (uint16_t)(seq + i);
+		samples[i].timestamp_ms = timestamp_ms;
+		samples[i].fields = AIR_CTRL_BLE_SAMPLE_FIELDS;
+	}
+
+	return hdr.count;
+}
+
+/* A history notification. Returns the number of samples; *flags gets the flags byte. */
+static inline int air_ctrl_ble_decode_history(const uint8_t *buf, size_t len, uint8_t *flags,
+					      struct air_ctrl_ble_sample *samples,
+					      size_t max_samples)
+{
+	const size_t record_len = sizeof(struct air_ctrl_ble_sample_v2);
+	size_t count;
+	int err;
+
+	if (len < 1U || (len - 1U) % record_len != 0U) {
+		return -EMSGSIZE;
+	}
+
+	count = (len - 1U) / record_len;
+	if (count > max_samples) {
+		return -ENOBUFS;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		err = air_ctrl_ble_decode_sample_v2(&buf[1U + i * record_len], record_len,
+						    &samples[i]);
+		if (err) {
+			return err;
+		}
+	}
+
+	*flags = buf[0];
+	return (int)count;
+}
+
+/* An aggregate notification or read. Returns the number of records. Records of levels
+ * that never closed (version 0, only in reads) are skipped.
+ */
+static inline int air_ctrl_ble_decode_agg(const uint8_t *buf, size_t len,
+					  struct air_ctrl_ble_agg *aggs, size_t max_aggs)
+{
+	struct air_ctrl_ble_agg_v4 raw;
+	const struct air_ctrl_ble_agg_stat_v4 *in[4];
+	struct air_ctrl_ble_agg_stat *out[4];
+	size_t count = 0;
+
+	if (len == 0U || len % sizeof(raw) != 0U) {
+		return -EMSGSIZE;
+	}
+
+	for (size_t offset = 0; offset < len; offset += sizeof(raw)) {
+		memcpy(&raw, &buf[offset], sizeof(raw));
+		if (raw.version == 0U) {
+			continue;
+		}
+		if (raw.version != AIR_CTRL_BLE_VERSION_AGG) {
+			return air_ctrl_ble_version_supported(raw.version) ? -EBADMSG : -ENOTSUP;
+		}
+		if (raw.level >= AIR_CTRL_BLE_AGG_LEVEL_COUNT) {
+			return -EBADMSG;
+		}
+		if (count == max_aggs) {
+			return -ENOBUFS;
+		}
+
+		aggs[count].level = raw.level;
+		aggs[count].start_ms = air_ctrl_ble_le32(raw.start_ms);
+		aggs[count].count = air_ctrl_ble_le32(raw.count);
+
+		in[0] = &raw.temp_c_x100;
+		in[1] = &raw.hum_rh_x100;
+		in[2] = &raw.iaq_x10;
+		in[3] = &raw.co2_eq_ppm;
+		out[0] = &aggs[count].temp_c_x100;
+		out[1] = &aggs[count].hum_rh_x100;
+		out[2] = &aggs[count].iaq_x10;
+		out[3] = &aggs[count].co2_eq_ppm;
+		for (size_t i = 0; i < 4; i++) {
+			out[i]->mean = air_ctrl_ble_le16(in[i]->mean);
+			out[i]->min = air_ctrl_ble_le16(in[i]->min);
+			out[i]->max = air_ctrl_ble_le16(in[i]->max);
+			out[i]->ewma = air_ctrl_ble_le16(in[i]->ewma);
+		}
+		count++;
+	}
+
+	return (int)count;
+}
+
+/* An alert notification */
+static inline int air_ctrl_ble_decode_alert(const uint8_t *buf, size_t len,
+					    struct air_ctrl_ble_alert *alert)
+{
+	struct air_ctrl_ble_alert_v5 raw;
+
+	if (len < 1U) {
+		return -EMSGSIZE;
+	}
+
+	if (buf[0] != AIR_CTRL_BLE_VERSION_ALERT) {
+		return air_ctrl_ble_version_supported(buf[0]) ? -EBADMSG : -ENOTSUP;
+	}
+
+	if (len != sizeof(raw)) {
+		return -EMSGSIZE;
+	}
+
+	memcpy(&raw, buf, sizeof(raw));
+	if (raw.metric >= AIR_CTRL_BLE_ALERT_COUNT || raw.raised > 1U) {
+		return -EBADMSG;
+	}
+
+	alert->metric = (enum air_ctrl_ble_alert_metric)raw.metric;
+	alert->raised = (raw.raised != 0U);
+	alert->seq = air_ctrl_ble_le16(raw.seq);
+	alert->timestamp_ms = air_ctrl_ble_le32(raw.timestamp_ms);
+	alert->value = air_ctrl_ble_le16(raw.value);
+	alert->threshold = air_ctrl_ble_le16(raw.threshold);
+
+	return 0;
+}
+
+/* Manufacturer specific advertising data, without the AD length and type bytes. -ENOENT
+ * when it is not ours (another company ID).
+ */
+static inline int air_ctrl_ble_decode_adv(const uint8_t *buf, size_t len,
+					  struct air_ctrl_ble_sample *sample)
+{
+	struct air_ctrl_ble_adv_v1 raw;
+
+	if (len < 3U) {
+		return -EMSGSIZE;
+	}
+
+	if (air_ctrl_ble_get_le16(buf) != AIR_CTRL_BLE_COMPANY_ID) {
+		return -ENOENT;
+	}
+
+	if (buf[2] != AIR_CTRL_BLE_VERSION_ADV) {
+		return air_ctrl_ble_version_supported(buf[2]) ? -EBADMSG : -ENOTSUP;
+	}
+
+	if (len != sizeof(raw)) {
+		return -EMSGSIZE;
+	}
+
+	memcpy(&raw, buf, sizeof(raw));
+	memset(sample, 0, sizeof(*sample));
+	sample->version = raw.version;
+	sample->seq = air_ctrl_ble_le16(raw.seq);
+	sample->fields = AIR_CTRL_BLE_SAMPLE_FIELDS & ~AIR_CTRL_BLE_FIELD_GAS;
+	sample->values.temp_c_x100 = (int16_t)air_ctrl_ble_le16((uint16_t)raw.temp_c_x100);
+	sample->values.hum_rh_x100 = air_ctrl_ble_le16(raw.hum_rh_x100);
+	sample->values.iaq_x10 = air_ctrl_ble_le16(raw.iaq_x10);
+	sample->values.iaq_acc = raw.iaq_acc;
+	sample->values.co2_eq_ppm = air_ctrl_ble_le16(raw.co2_eq_ppm);
+	sample->values.breath_voc_eq_ppb = air_ctrl_ble_le16(raw.breath_voc_eq_ppb);
+
+	return 0;
+}
+
+#endif /* AIR_CTRL_BLE_CODEC_H_ */
@@ -0,0 +1,62 @@
+#ifndef AIR_CTRL_BLE_PROTO_H_
+#define AIR_CTRL_BLE_PROTO_H_
+
+#include <zephyr/sys/util.h>
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "air_ctrl_agg.h"
+#include "air_ctrl_ble_codec.h"
+#include "air_ctrl_sensor.h"
+
+/* Firmware side of the BLE wire format (air_ctrl_ble_codec.h), shared by the GATT service
+ * and the native_sim loopback
+ */
+
+BUILD_ASSERT(AIR_CTRL_BLE_FIELD_TEMP == AIR_CTRL_SENSOR_OUT_TEMP &&
+		     AIR_CTRL_BLE_FIELD_HUM == AIR_CTRL_SENSOR_OUT_HUM &&
+		     AIR_CTRL_BLE_FIELD_GAS == AIR_CTRL_SENSOR_OUT_GAS &&
+		     AIR_CTRL_BLE_FIELD_IAQ == AIR_CTRL_SENSOR_OUT_IAQ &&
+		     AIR_CTRL_BLE_FIELD_CO2_EQ == AIR_CTRL_SENSOR_OUT_CO2_EQ &&
+		     AIR_CTRL_BLE_FIELD_BREATH_VOC == AIR_CTRL_SENSOR_OUT_BREATH_VOC,
+	     "The compact sample's field mask is the output set");
+BUILD_ASSERT(AIR_CTRL_BLE_AGG_LEVEL_COUNT == AIR_CTRL_AGG_LEVEL_COUNT,
+	     "One aggregate record per level");
+
+/* Samples are already in BLE units, this only picks the transmitted fields */
+static inline void air_ctrl_ble_scale(const air_ctrl_sensor_data_t *data,
+				      struct air_ctrl_ble_values *values)
+{
+	values->temp_c_x100 = data->raw_temp_c_x100;
+	values->hum_rh_x100 = data->raw_hum_rh_x100;
+	values->gas_ohm = data->gas_ohm;
+	values->iaq_x10 = data->iaq_x10;
+	values->iaq_acc = data->iaq_acc;
+	values->co2_eq_ppm = data->co2_eq_ppm;
+	values->breath_voc_eq_ppb = data->breath_voc_eq_ppb;
+}
+
+static inline void air_ctrl_ble_encode_agg_stat_v4(const air_ctrl_agg_stat_t *stat,
+						   struct air_ctrl_ble_agg_stat_v4 *out)
+{
+	out->mean = air_ctrl_ble_le16((uint16_t)stat->mean);
+	out->min = air_ctrl_ble_le16((uint16_t)stat->min);
+	out->max = air_ctrl_ble_le16((uint16_t)stat->max);
+	out->ewma = air_ctrl_ble_le16((uint16_t)stat->ewma);
+}
+
+static inline void air_ctrl_ble_encode_agg_v4(const air_ctrl_agg_summary_t *summary,
+					      struct air_ctrl_ble_agg_v4 *agg)
+{
+	agg->version = AIR_CTRL_BLE_VERSION_AGG;
+	agg->level = summary->level;
+	agg->start_ms = air_ctrl_ble_le32(summary->start_ms);
+	agg->count = air_ctrl_ble_le32(summary->count);
+	air_ctrl_ble_encode_agg_stat_v4(&summary->stat[AIR_CTRL_AGG_TEMP], &agg->temp_c_x100);
+	air_ctrl_ble_encode_agg_stat_v4(&summary->stat[AIR_CTRL_AGG_HUM], &agg->hum_rh_x100);
+	air_ctrl_ble_encode_agg_stat_v4(&summary->stat[AIR_CTRL_AGG_IAQ], &agg->iaq_x10);
+	air_ctrl_ble_encode_agg_stat_v4(&summary->stat[AIR_CTRL_AGG_CO2], &agg->co2_eq_ppm);
+}
+
+#endif /* AIR_CTRL_BLE_PROTO_H_ */
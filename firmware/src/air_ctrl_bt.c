@@ -10,183 +10,1605 @@
 
 #include <errno.h>
 #include <limits.h>
+#include <stddef.h>
 #include <string.h>
 
+#include "air_ctrl_arena.h"
+#include "air_ctrl_ble_proto.h"
 #include "air_ctrl_bt.h"
+#include "air_ctrl_bt_filter.h"
+#include "air_ctrl_history.h"
+#include "air_ctrl_prof.h"
+#include "air_ctrl_rate.h"
 
 LOG_MODULE_REGISTER(air_ctrl_bt, LOG_LEVEL_INF);
 
-struct __packed air_ctrl_ble_sample_v1 {
-	uint8_t version;
-	uint8_t flags;
-	uint16_t seq;
-	uint32_t timestamp_ms;
-	int16_t temp_c_x100;
-	uint16_t hum_rh_x100;
-	uint32_t gas_ohm;
-	uint16_t iaq_x10;
-	uint8_t iaq_acc;
-	uint16_t co2_eq_ppm;
-	uint16_t breath_voc_eq_ppb;
+/* Largest notification payload: ATT MTU minus opcode and handle */
+#define BATCH_MAX_LEN (CONFIG_BT_L2CAP_TX_MTU - 3)
+
+/* History download: a flags byte (AIR_CTRL_BLE_HISTORY_FLAG_END) followed by as many stored
+ * samples as fit, written to the control point as an op code and its argument
+ */
+#define HISTORY_OP_ABORT 0x00
+#define HISTORY_OP_FROM_SEQ 0x01
+#define HISTORY_OP_FROM_TIMESTAMP 0x02
+
+#define HISTORY_MAX_IN_FLIGHT 4
+#define HISTORY_RETRY_MS 20
+
+/* Live notifications a peer may have queued in the stack before it misses samples */
+#define PEER_MAX_IN_FLIGHT 2
+
+/* Transfers that want the fast link profile, bits in link.bulk_users */
+enum link_bulk_user {
+	LINK_BULK_HISTORY,
+	LINK_BULK_DIAG,
+};
+
+enum link_profile {
+	LINK_PROFILE_NONE,
+	LINK_PROFILE_STREAM,
+	LINK_PROFILE_BULK,
 };
 
-static struct bt_conn *default_conn;
-static bool notify_enabled;
-static uint16_t sample_seq;
+/* One per connected central */
+struct bt_peer {
+	struct bt_conn *conn;
+	uint16_t mtu;
+	bool notify_enabled;
+	bool batch_notify_enabled;
+	bool agg_notify_enabled;
+	bool alert_notify_enabled;
+	/* Versions the central decodes (protocol characteristic), guarded by batch_lock */
+	uint16_t versions;
+	atomic_t in_flight;
+	uint32_t missed;
+	struct bt_gatt_exchange_params mtu_exchange_params;
+	/* Last sample notified to this central, guarded by batch_lock */
+	struct air_ctrl_bt_deadband deadband;
+
+	/* Pending batch, guarded by batch_lock */
+	uint8_t batch_buf[BATCH_MAX_LEN];
+	size_t batch_len;
+	uint8_t batch_count;
+	uint16_t batch_base_seq;
+	uint32_t batch_base_ts_ms;
+	uint32_t batch_last_ts_ms;
+	struct k_work_delayable batch_flush_work;
+
+	uint8_t last_batch[BATCH_MAX_LEN];
+	size_t last_batch_len;
+
+#if defined(CONFIG_AIR_CTRL_PROF)
+	/* Diagnostics snapshot taken at offset 0, so each central's long read stays consistent */
+	uint8_t diag[AIR_CTRL_PROF_ENCODED_LEN];
+	size_t diag_len;
+#endif
+
+#if defined(CONFIG_AIR_CTRL_BT_LINK_MANAGER)
+	struct {
+		enum link_profile applied;
+		atomic_t bulk_users;
+		int64_t idle_since_ms;
+		int64_t bulk_start_ms;
+		atomic_t bulk_bytes;
+		struct k_work_delayable work;
+	} link;
+#endif
+};
+
+static struct bt_peer peers[CONFIG_BT_MAX_CONN];
+
+static uint16_t sample_seq;
+
+#if defined(CONFIG_AIR_CTRL_HISTORY)
+/* Uptime of the newest sample sent to the history log, guarded by batch_lock */
+static uint32_t history_last_ts_ms;
+static bool history_have_last;
+#endif
+
+static uint8_t last_sample[sizeof(struct air_ctrl_ble_sample_v2)];
+static size_t last_sample_len;
+/* The same sample in full, for centrals that do not take compact samples */
+static struct air_ctrl_ble_sample_v2 last_full_sample;
+
+static K_MUTEX_DEFINE(batch_lock);
+
+/* One download at a time, to the peer that asked for it */
+static struct {
+	bool active;
+	struct bt_peer *peer;
+	uint8_t op;
+	uint16_t start_seq;
+	uint32_t start_ts_ms;
+	air_ctrl_history_cursor_t cursor;
+	size_t unsent_len;
+	atomic_t in_flight;
+	uint32_t sent;
+} history_dl;
+
+/* Staging buffer from the shared arena, only held while a download is active */
+static uint8_t *history_buf;
+
+static void history_work_handler(struct k_work *work);
+static K_WORK_DELAYABLE_DEFINE(history_work, history_work_handler);
+
+static void adv_work_handler(struct k_work *work);
+static K_WORK_DEFINE(adv_work, adv_work_handler);
+
+#if defined(CONFIG_AIR_CTRL_BT_LINK_MANAGER)
+static void link_bulk_begin(struct bt_peer *peer, enum link_bulk_user user);
+static void link_bulk_end(struct bt_peer *peer, enum link_bulk_user user);
+static void link_count_bytes(struct bt_peer *peer, size_t len);
+#else
+static inline void link_bulk_begin(struct bt_peer *peer, enum link_bulk_user user)
+{
+	ARG_UNUSED(peer);
+	ARG_UNUSED(user);
+}
+
+static inline void link_bulk_end(struct bt_peer *peer, enum link_bulk_user user)
+{
+	ARG_UNUSED(peer);
+	ARG_UNUSED(user);
+}
+
+static inline void link_count_bytes(struct bt_peer *peer, size_t len)
+{
+	ARG_UNUSED(peer);
+	ARG_UNUSED(len);
+}
+#endif
+
+static struct bt_peer *peer_get(const struct bt_conn *conn)
+{
+	if (conn == NULL) {
+		return NULL;
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		if (peers[i].conn == conn) {
+			return &peers[i];
+		}
+	}
+
+	return NULL;
+}
+
+static unsigned int peer_id(const struct bt_peer *peer)
+{
+	return (unsigned int)(peer - peers);
+}
+
+/* Formats this build sends, offered on the protocol characteristic */
+#define SENT_VERSIONS                                                                              \
+	(AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_ADV) |                                      \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_SAMPLE) |                                   \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_BATCH) |                                    \
+	 (IS_ENABLED(CONFIG_AIR_CTRL_AGG) ?                                                        \
+		  AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_AGG) : 0U) |                       \
+	 (IS_ENABLED(CONFIG_AIR_CTRL_BT_ALERTS) ?                                                  \
+		  AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_ALERT) : 0U) |                     \
+	 AIR_CTRL_BLE_VERSION_BIT(AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT))
+
+static bool peer_accepts(const struct bt_peer *peer, uint8_t version)
+{
+	return (peer->versions & AIR_CTRL_BLE_VERSION_BIT(version)) != 0U;
+}
+
+/* The sample characteristic's value for this central: compact if it takes those */
+static const void *peer_sample(const struct bt_peer *peer, size_t *len)
+{
+	if (peer != NULL && !peer_accepts(peer, AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT)) {
+		*len = sizeof(last_full_sample);
+		return &last_full_sample;
+	}
+
+	*len = last_sample_len;
+	return last_sample;
+}
+
+#define BT_UUID_AIR_CTRL_SERVICE BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc2, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_SAMPLE BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc3, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_BATCH BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc4, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_HISTORY BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc5, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_HISTORY_CTRL BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc6, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_DIAG BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc7, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_AGG BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc8, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_ALERT BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc9, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_RATE BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cca, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_OUTPUTS BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2ccb, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+#define BT_UUID_AIR_CTRL_PROTOCOL BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2ccc, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+
+/* Value attribute indices in air_ctrl_svc */
+#define ATTR_SAMPLE_VALUE 2
+#define ATTR_BATCH_VALUE 5
+#define ATTR_HISTORY_VALUE 8
+#define ATTR_AGG_VALUE 13
+#define ATTR_ALERT_VALUE (IS_ENABLED(CONFIG_AIR_CTRL_AGG) ? 16 : 13)
+
+static ssize_t ccc_cfg_write(struct bt_conn *conn, const struct bt_gatt_attr *attr, uint16_t value)
+{
+	struct bt_peer *peer = peer_get(conn);
+
+	if (peer != NULL) {
+		k_mutex_lock(&batch_lock, K_FOREVER);
+		peer->notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+		/* A new subscriber gets the next sample even if it is inside the deadband */
+		air_ctrl_bt_deadband_reset(&peer->deadband);
+		k_mutex_unlock(&batch_lock);
+	}
+
+	return sizeof(value);
+}
+
+static ssize_t batch_ccc_cfg_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				   uint16_t value)
+{
+	struct bt_peer *peer = peer_get(conn);
+
+	if (peer != NULL) {
+		peer->batch_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	}
+
+	return sizeof(value);
+}
+
+static ssize_t read_sample(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			   uint16_t len, uint16_t offset)
+{
+	const void *value;
+	size_t value_len;
+
+	value = peer_sample(peer_get(conn), &value_len);
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, value, value_len);
+}
+
+static ssize_t read_batch(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			  uint16_t len, uint16_t offset)
+{
+	struct bt_peer *peer = peer_get(conn);
+
+	if (peer == NULL) {
+		return bt_gatt_attr_read(conn, attr, buf, len, offset, NULL, 0);
+	}
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, peer->last_batch,
+				 peer->last_batch_len);
+}
+
+static ssize_t write_history_ctrl(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				  const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	struct bt_peer *peer = peer_get(conn);
+	const uint8_t *req = buf;
+
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len < 1) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	if (peer == NULL) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	switch (req[0]) {
+	case HISTORY_OP_ABORT:
+		break;
+	case HISTORY_OP_FROM_SEQ:
+		if (len != 3) {
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+		}
+		break;
+	case HISTORY_OP_FROM_TIMESTAMP:
+		if (len != 5) {
+			return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+		}
+		break;
+	default:
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	if (req[0] != HISTORY_OP_ABORT &&
+	    (!IS_ENABLED(CONFIG_AIR_CTRL_HISTORY) || !air_ctrl_history_is_ready())) {
+		return BT_GATT_ERR(BT_ATT_ERR_NOT_SUPPORTED);
+	}
+
+	/* history_dl.peer is also read by the work item and cleared on disconnect */
+	k_mutex_lock(&batch_lock, K_FOREVER);
+
+	/* The staging buffer and the flash cursor are shared, another peer has to wait */
+	if (history_dl.active && history_dl.peer != peer) {
+		k_mutex_unlock(&batch_lock);
+		return BT_GATT_ERR(BT_ATT_ERR_PROCEDURE_IN_PROGRESS);
+	}
+
+	if (req[0] == HISTORY_OP_ABORT) {
+		history_dl.active = false;
+	} else {
+		if (req[0] == HISTORY_OP_FROM_SEQ) {
+			history_dl.start_seq = sys_get_le16(&req[1]);
+		} else {
+			history_dl.start_ts_ms = sys_get_le32(&req[1]);
+		}
+		history_dl.op = req[0];
+		history_dl.peer = peer;
+		history_dl.unsent_len = 0;
+		history_dl.sent = 0;
+		air_ctrl_history_cursor_init(&history_dl.cursor);
+		history_dl.active = true;
+		link_bulk_begin(peer, LINK_BULK_HISTORY);
+	}
+	k_mutex_unlock(&batch_lock);
+
+	/* Also lets the work item hand back the staging buffer after an abort */
+	k_work_reschedule(&history_work, K_NO_WAIT);
+
+	return len;
+}
+
+#if defined(CONFIG_AIR_CTRL_AGG)
+/* Last closed bucket of each level, version 0 until that level first closes */
+static struct air_ctrl_ble_agg_v4 last_agg[AIR_CTRL_AGG_LEVEL_COUNT];
+
+static ssize_t agg_ccc_cfg_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				 uint16_t value)
+{
+	struct bt_peer *peer = peer_get(conn);
+
+	if (peer != NULL) {
+		peer->agg_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	}
+
+	return sizeof(value);
+}
+
+static ssize_t read_agg(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			uint16_t len, uint16_t offset)
+{
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, last_agg, sizeof(last_agg));
+}
+
+#define AIR_CTRL_AGG_ATTRS                                                                         \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_AGG, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,    \
+				 BT_GATT_PERM_READ, read_agg, NULL, NULL),                         \
+	BT_GATT_CCC_WITH_WRITE_CB(NULL, agg_ccc_cfg_write, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
+#else
+#define AIR_CTRL_AGG_ATTRS
+#endif
+
+#if defined(CONFIG_AIR_CTRL_BT_ALERTS)
+/* Last crossing per metric, version 0 until the first one */
+static struct air_ctrl_ble_alert_v5 last_alert[AIR_CTRL_BLE_ALERT_COUNT];
+
+static ssize_t alert_ccc_cfg_write(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+				   uint16_t value)
+{
+	struct bt_peer *peer = peer_get(conn);
+
+	if (peer != NULL) {
+		peer->alert_notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	}
+
+	return sizeof(value);
+}
+
+static ssize_t read_alert(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			  uint16_t len, uint16_t offset)
+{
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, last_alert, sizeof(last_alert));
+}
+
+#define AIR_CTRL_ALERT_ATTRS                                                                       \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_ALERT, BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,  \
+				 BT_GATT_PERM_READ, read_alert, NULL, NULL),                       \
+	BT_GATT_CCC_WITH_WRITE_CB(NULL, alert_ccc_cfg_write, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
+#else
+#define AIR_CTRL_ALERT_ATTRS
+#endif
+
+#if defined(CONFIG_AIR_CTRL_RATE)
+/* Sample rate: reads back the policy and the rate in use, a 1 byte write sets the policy */
+static ssize_t read_rate(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			 uint16_t len, uint16_t offset)
+{
+	uint8_t value[2] = {
+		(uint8_t)air_ctrl_rate_get_policy(),
+		(uint8_t)air_ctrl_sensor_get_rate(),
+	};
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, value, sizeof(value));
+}
+
+static ssize_t write_rate(struct bt_conn *conn, const struct bt_gatt_attr *attr, const void *buf,
+			  uint16_t len, uint16_t offset, uint8_t flags)
+{
+	uint8_t policy;
+
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(policy)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	policy = *(const uint8_t *)buf;
+	if (policy >= AIR_CTRL_RATE_POLICY_COUNT) {
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	if (air_ctrl_rate_set_policy(policy) != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	return len;
+}
+
+#define AIR_CTRL_RATE_ATTRS                                                                        \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_RATE, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,    \
+				 BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_rate, write_rate,    \
+				 NULL)
+#else
+#define AIR_CTRL_RATE_ATTRS
+#endif
+
+#if defined(CONFIG_AIR_CTRL_USE_BSEC)
+/* BSEC output set: u16 of AIR_CTRL_SENSOR_OUT_* bits, read returns the set in use */
+static ssize_t read_outputs(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			    uint16_t len, uint16_t offset)
+{
+	uint16_t value = sys_cpu_to_le16((uint16_t)air_ctrl_sensor_get_outputs());
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+static ssize_t write_outputs(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			     const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	int err;
+
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	if (len != sizeof(uint16_t)) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	}
+
+	err = air_ctrl_sensor_set_outputs(sys_get_le16(buf));
+	if (err == -EINVAL) {
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	} else if (err) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	return len;
+}
+
+#define AIR_CTRL_OUTPUTS_ATTRS                                                                     \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_OUTPUTS, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE, \
+				 BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_outputs,             \
+				 write_outputs, NULL)
+#else
+#define AIR_CTRL_OUTPUTS_ATTRS
+#endif
+
+#if defined(CONFIG_AIR_CTRL_PROF)
+static ssize_t read_diag(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			 uint16_t len, uint16_t offset)
+{
+	struct bt_peer *peer = peer_get(conn);
+	ssize_t ret;
+
+	if (peer == NULL) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	/* Snapshot on the first chunk so a long read sees consistent counters */
+	if (offset == 0) {
+		peer->diag_len = air_ctrl_prof_encode(peer->diag, sizeof(peer->diag));
+		link_bulk_begin(peer, LINK_BULK_DIAG);
+	}
+
+	ret = bt_gatt_attr_read(conn, attr, buf, len, offset, peer->diag, peer->diag_len);
+
+	if (ret > 0) {
+		link_count_bytes(peer, ret);
+	}
+
+	/* A read that returns less than asked for is the last chunk */
+	if (ret < 0 || ret < len) {
+		link_bulk_end(peer, LINK_BULK_DIAG);
+	}
+
+	return ret;
+}
+
+#define AIR_CTRL_DIAG_ATTRS                                                                        \
+	, BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_DIAG, BT_GATT_CHRC_READ, BT_GATT_PERM_READ,      \
+				 read_diag, NULL, NULL)
+#else
+#define AIR_CTRL_DIAG_ATTRS
+#endif
+
+/* Protocol: reads the versions this build sends, a central writes the ones it decodes */
+static ssize_t read_protocol(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
+			     uint16_t len, uint16_t offset)
+{
+	struct air_ctrl_ble_protocol value;
+
+	air_ctrl_ble_encode_protocol(SENT_VERSIONS, &value);
+
+	return bt_gatt_attr_read(conn, attr, buf, len, offset, &value, sizeof(value));
+}
+
+static ssize_t write_protocol(struct bt_conn *conn, const struct bt_gatt_attr *attr,
+			      const void *buf, uint16_t len, uint16_t offset, uint8_t flags)
+{
+	struct bt_peer *peer = peer_get(conn);
+	uint16_t versions;
+	int err;
+
+	if (offset != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_OFFSET);
+	}
+
+	err = air_ctrl_ble_decode_protocol(buf, len, &versions);
+	if (err == -EMSGSIZE) {
+		return BT_GATT_ERR(BT_ATT_ERR_INVALID_ATTRIBUTE_LEN);
+	} else if (err || air_ctrl_ble_negotiate(SENT_VERSIONS, versions, &versions) != 0) {
+		return BT_GATT_ERR(BT_ATT_ERR_VALUE_NOT_ALLOWED);
+	}
+
+	if (peer == NULL) {
+		return BT_GATT_ERR(BT_ATT_ERR_UNLIKELY);
+	}
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	peer->versions = versions;
+	k_mutex_unlock(&batch_lock);
+
+	LOG_INF("Peer %u takes versions 0x%04x", peer_id(peer), versions);
+
+	return len;
+}
+
+BT_GATT_SERVICE_DEFINE(air_ctrl_svc,
+	BT_GATT_PRIMARY_SERVICE(BT_UUID_AIR_CTRL_SERVICE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_SAMPLE,
+			       BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_READ, read_sample, NULL, NULL),
+	BT_GATT_CCC_WITH_WRITE_CB(NULL, ccc_cfg_write, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_BATCH,
+			       BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_READ, read_batch, NULL, NULL),
+	BT_GATT_CCC_WITH_WRITE_CB(NULL, batch_ccc_cfg_write,
+				  BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_HISTORY, BT_GATT_CHRC_NOTIFY,
+			       BT_GATT_PERM_NONE, NULL, NULL, NULL),
+	BT_GATT_CCC(NULL, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE),
+	BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_HISTORY_CTRL, BT_GATT_CHRC_WRITE,
+			       BT_GATT_PERM_WRITE, NULL, write_history_ctrl, NULL)
+	AIR_CTRL_AGG_ATTRS
+	AIR_CTRL_ALERT_ATTRS
+	AIR_CTRL_RATE_ATTRS
+	AIR_CTRL_OUTPUTS_ATTRS
+	AIR_CTRL_DIAG_ATTRS,
+	BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_PROTOCOL, BT_GATT_CHRC_READ | BT_GATT_CHRC_WRITE,
+			       BT_GATT_PERM_READ | BT_GATT_PERM_WRITE, read_protocol,
+			       write_protocol, NULL)
+);
+
+/* Latest sample for scanners, guarded by adv_lock until adv_work copies it into adv_sample */
+static struct air_ctrl_ble_adv_v1 adv_sample;
+static struct air_ctrl_ble_adv_v1 adv_next;
+static bool adv_next_valid;
+static struct k_spinlock adv_lock;
+
+/* Advertising state, only touched from adv_work */
+static bool adv_running;
+static bool adv_connectable;
+static size_t ad_len = 1;
+
+static const struct bt_data ad[] = {
+	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
+	BT_DATA(BT_DATA_MANU_DATA, &adv_sample, sizeof(adv_sample)),
+};
+
+/* The name moved to the scan response to make room for the sample */
+static const struct bt_data sd[] = {
+	BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
+};
+
+static void mtu_exchange_cb(struct bt_conn *conn, uint8_t err,
+			    struct bt_gatt_exchange_params *params)
+{
+	if (err) {
+		LOG_WRN("MTU exchange failed (err %u)", err);
+	}
+}
+
+/* Either side may start the exchange, the result lands here in both cases */
+static void att_mtu_updated(struct bt_conn *conn, uint16_t tx, uint16_t rx)
+{
+	struct bt_peer *peer = peer_get(conn);
+
+	if (peer != NULL) {
+		peer->mtu = bt_gatt_get_mtu(conn);
+		LOG_INF("Peer %u: ATT MTU %u", peer_id(peer), peer->mtu);
+	}
+}
+
+static struct bt_gatt_cb gatt_callbacks = {
+	.att_mtu_updated = att_mtu_updated,
+};
+
+/* Ask for the largest ATT MTU and LL data length so a batch fits in one link-layer packet */
+static void request_link_upgrade(struct bt_peer *peer)
+{
+	int err;
+
+	peer->mtu_exchange_params.func = mtu_exchange_cb;
+	err = bt_gatt_exchange_mtu(peer->conn, &peer->mtu_exchange_params);
+	if (err) {
+		LOG_WRN("MTU exchange request failed (err %d)", err);
+	}
+
+	err = bt_conn_le_data_len_update(peer->conn, BT_LE_DATA_LEN_PARAM_MAX);
+	if (err) {
+		LOG_WRN("Data length update request failed (err %d)", err);
+	}
+}
+
+#if defined(CONFIG_AIR_CTRL_BT_LINK_MANAGER)
+/* Let the central finish service discovery before asking for the streaming profile */
+#define LINK_SETTLE_MS 5000
+
+/* Stay on the fast profile this long after a transfer, so back-to-back reads don't flap */
+#define LINK_BULK_HOLD_MS 2000
+
+/* Connection interval in 1.25 ms units, supervision timeout in 10 ms units */
+#define LINK_INTERVAL(ms) ((ms) * 4U / 5U)
+#define LINK_TIMEOUT(ms) (MIN(MAX((ms), 4000U), 32000U) / 10U)
+
+#define LINK_STREAM_TIMEOUT_MS                                                                     \
+	(3U * (1U + CONFIG_AIR_CTRL_BT_STREAM_LATENCY) * CONFIG_AIR_CTRL_BT_STREAM_INTERVAL_MS)
+
+static void link_bulk_begin(struct bt_peer *peer, enum link_bulk_user user)
+{
+	if (!atomic_test_and_set_bit(&peer->link.bulk_users, user)) {
+		k_work_reschedule(&peer->link.work, K_NO_WAIT);
+	}
+}
+
+static void link_bulk_end(struct bt_peer *peer, enum link_bulk_user user)
+{
+	if (atomic_test_and_clear_bit(&peer->link.bulk_users, user)) {
+		peer->link.idle_since_ms = k_uptime_get();
+		k_work_reschedule(&peer->link.work, K_MSEC(LINK_BULK_HOLD_MS));
+	}
+}
+
+static void link_count_bytes(struct bt_peer *peer, size_t len)
+{
+	atomic_add(&peer->link.bulk_bytes, (atomic_val_t)len);
+}
+
+static void link_apply(struct bt_conn *conn, enum link_profile profile)
+{
+	struct bt_le_conn_param param;
+	bool bulk = (profile == LINK_PROFILE_BULK);
+	int err;
+
+	if (bulk) {
+		param = (struct bt_le_conn_param)BT_LE_CONN_PARAM_INIT(
+			LINK_INTERVAL(CONFIG_AIR_CTRL_BT_BULK_INTERVAL_MS),
+			LINK_INTERVAL(2U * CONFIG_AIR_CTRL_BT_BULK_INTERVAL_MS), 0, LINK_TIMEOUT(0U));
+	} else {
+		param = (struct bt_le_conn_param)BT_LE_CONN_PARAM_INIT(
+			LINK_INTERVAL(CONFIG_AIR_CTRL_BT_STREAM_INTERVAL_MS),
+			LINK_INTERVAL(CONFIG_AIR_CTRL_BT_STREAM_INTERVAL_MS),
+			CONFIG_AIR_CTRL_BT_STREAM_LATENCY, LINK_TIMEOUT(LINK_STREAM_TIMEOUT_MS));
+	}
+
+	/* Live samples are tiny, 1M keeps the better receiver sensitivity */
+	err = bt_conn_le_phy_update(conn, bulk ? BT_CONN_LE_PHY_PARAM_2M : BT_CONN_LE_PHY_PARAM_1M);
+	if (err && err != -EALREADY) {
+		LOG_WRN("PHY update request failed (err %d)", err);
+	}
+
+	/* The central may have shrunk the data length since the upgrade after connecting */
+	if (bulk) {
+		err = bt_conn_le_data_len_update(conn, BT_LE_DATA_LEN_PARAM_MAX);
+		if (err && err != -EALREADY) {
+			LOG_WRN("Data length update request failed (err %d)", err);
+		}
+	}
+
+	err = bt_conn_le_param_update(conn, &param);
+	if (err && err != -EALREADY) {
+		LOG_WRN("Connection parameter update request failed (err %d)", err);
+	}
+}
+
+static void link_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct bt_peer *peer = CONTAINER_OF(dwork, struct bt_peer, link.work);
+	struct bt_conn *conn = peer->conn;
+	enum link_profile want;
+	int64_t now = k_uptime_get();
+	uint32_t elapsed_ms;
+	uint32_t bytes;
+
+	if (conn == NULL) {
+		return;
+	}
+
+	want = (atomic_get(&peer->link.bulk_users) != 0) ? LINK_PROFILE_BULK : LINK_PROFILE_STREAM;
+	if (want == peer->link.applied) {
+		return;
+	}
+
+	if (want == LINK_PROFILE_STREAM && peer->link.applied == LINK_PROFILE_BULK &&
+	    now - peer->link.idle_since_ms < LINK_BULK_HOLD_MS) {
+		k_work_reschedule(&peer->link.work,
+				  K_MSEC(LINK_BULK_HOLD_MS - (now - peer->link.idle_since_ms)));
+		return;
+	}
+
+	if (peer->link.applied == LINK_PROFILE_BULK) {
+		elapsed_ms = (uint32_t)(peer->link.idle_since_ms - peer->link.bulk_start_ms);
+		bytes = (uint32_t)atomic_get(&peer->link.bulk_bytes);
+		LOG_INF("Peer %u: bulk transfer %u B in %u ms (%u kbit/s)",
+			peer_id(peer), bytes, elapsed_ms,
+			(uint32_t)((uint64_t)bytes * 8U / MAX(elapsed_ms, 1U)));
+	}
+
+	if (want == LINK_PROFILE_BULK) {
+		peer->link.bulk_start_ms = now;
+		atomic_set(&peer->link.bulk_bytes, 0);
+	}
+
+	LOG_INF("Peer %u: link profile %s", peer_id(peer),
+		want == LINK_PROFILE_BULK ? "bulk" : "stream");
+	link_apply(conn, want);
+	peer->link.applied = want;
+}
+
+static void link_connected(struct bt_peer *peer)
+{
+	atomic_clear(&peer->link.bulk_users);
+	peer->link.applied = LINK_PROFILE_NONE;
+	k_work_reschedule(&peer->link.work, K_MSEC(LINK_SETTLE_MS));
+}
+
+static void le_param_updated(struct bt_conn *conn, uint16_t interval, uint16_t latency,
+			     uint16_t timeout)
+{
+	LOG_INF("Connection parameters: interval %u us, latency %u, timeout %u ms",
+		interval * 1250U, latency, timeout * 10U);
+}
+
+static void le_phy_updated(struct bt_conn *conn, struct bt_conn_le_phy_info *info)
+{
+	LOG_INF("PHY: tx %uM rx %uM", info->tx_phy == BT_GAP_LE_PHY_2M ? 2U : 1U,
+		info->rx_phy == BT_GAP_LE_PHY_2M ? 2U : 1U);
+}
+#else
+static inline void link_connected(struct bt_peer *peer)
+{
+	ARG_UNUSED(peer);
+}
+#endif
+
+static void batch_flush_work_handler(struct k_work *work);
 
-static uint8_t last_sample[sizeof(struct air_ctrl_ble_sample_v1)];
-static size_t last_sample_len;
+static struct bt_peer *peer_alloc(struct bt_conn *conn)
+{
+	struct bt_peer *peer = NULL;
 
-#define BT_UUID_AIR_CTRL_SERVICE BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc2, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		if (peers[i].conn == NULL) {
+			peer = &peers[i];
+			break;
+		}
+	}
 
-#define BT_UUID_AIR_CTRL_SAMPLE BT_UUID_DECLARE_128(BT_UUID_128_ENCODE(0x7f5f2cc3, 0x5d7a, 0x4a34, 0xa8c8, 0x1c7e3c01a7e1))
+	if (peer == NULL) {
+		return NULL;
+	}
 
-static void ccc_cfg_changed(const struct bt_gatt_attr *attr, uint16_t value)
+	peer->conn = bt_conn_ref(conn);
+	peer->mtu = bt_gatt_get_mtu(conn);
+	peer->notify_enabled = false;
+	peer->batch_notify_enabled = false;
+	peer->agg_notify_enabled = false;
+	peer->alert_notify_enabled = false;
+	peer->versions = AIR_CTRL_BLE_VERSIONS;
+	atomic_clear(&peer->in_flight);
+	peer->missed = 0;
+	peer->batch_len = 0;
+	peer->batch_count = 0;
+	peer->last_batch_len = 0;
+
+	return peer;
+}
+
+static unsigned int peer_count(void)
 {
-	notify_enabled = (value == BT_GATT_CCC_NOTIFY);
+	unsigned int count = 0;
+
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		count += (peers[i].conn != NULL);
+	}
+
+	return count;
 }
 
-static ssize_t read_sample(struct bt_conn *conn, const struct bt_gatt_attr *attr, void *buf,
-			   uint16_t len, uint16_t offset)
+static void adv_work_handler(struct k_work *work)
 {
-	return bt_gatt_attr_read(conn, attr, buf, len, offset, last_sample, last_sample_len);
+	bool connectable = peer_count() < ARRAY_SIZE(peers);
+	k_spinlock_key_t key;
+	int err;
+
+	ARG_UNUSED(work);
+
+	key = k_spin_lock(&adv_lock);
+	if (adv_next_valid) {
+		adv_sample = adv_next;
+		adv_next_valid = false;
+		ad_len = ARRAY_SIZE(ad);
+	}
+	k_spin_unlock(&adv_lock, key);
+
+	/* -EAGAIN: the controller stopped the advertiser when a central connected */
+	if (adv_running && connectable == adv_connectable) {
+		err = bt_le_adv_update_data(ad, ad_len, connectable ? sd : NULL,
+					    connectable ? ARRAY_SIZE(sd) : 0);
+		if (err != -EAGAIN) {
+			if (err) {
+				LOG_WRN("Advertising data update failed (err %d)", err);
+			}
+			return;
+		}
+		adv_running = false;
+	}
+
+	/* Switching between connectable and broadcast-only needs a restart */
+	if (adv_running) {
+		(void)bt_le_adv_stop();
+		adv_running = false;
+	}
+
+	if (!connectable && !IS_ENABLED(CONFIG_AIR_CTRL_BT_BROADCAST)) {
+		return;
+	}
+
+	if (connectable) {
+		err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_1, ad, ad_len, sd, ARRAY_SIZE(sd));
+	} else {
+		err = bt_le_adv_start(BT_LE_ADV_NCONN, ad, ad_len, NULL, 0);
+	}
+
+	if (err) {
+		LOG_ERR("Advertising failed to start (err %d)", err);
+		return;
+	}
+
+	adv_running = true;
+	adv_connectable = connectable;
+	LOG_INF("Advertising successfully started (%s)",
+		connectable ? "connectable" : "broadcast only");
 }
 
-BT_GATT_SERVICE_DEFINE(air_ctrl_svc,
-	BT_GATT_PRIMARY_SERVICE(BT_UUID_AIR_CTRL_SERVICE),
-	BT_GATT_CHARACTERISTIC(BT_UUID_AIR_CTRL_SAMPLE,
-			       BT_GATT_CHRC_READ | BT_GATT_CHRC_NOTIFY,
-			       BT_GATT_PERM_READ, read_sample, NULL, NULL),
-	BT_GATT_CCC(ccc_cfg_changed, BT_GATT_PERM_READ | BT_GATT_PERM_WRITE)
-);
+/* Refresh the broadcast sample, advertising picks it up from the work queue */
+static void adv_update(uint16_t seq, const struct air_ctrl_ble_values *values)
+{
+	k_spinlock_key_t key;
 
-static const struct bt_data ad[] = {
-	BT_DATA_BYTES(BT_DATA_FLAGS, (BT_LE_AD_GENERAL | BT_LE_AD_NO_BREDR)),
-	BT_DATA(BT_DATA_NAME_COMPLETE, CONFIG_BT_DEVICE_NAME, sizeof(CONFIG_BT_DEVICE_NAME) - 1),
-};
+	if (!IS_ENABLED(CONFIG_AIR_CTRL_BT_BROADCAST)) {
+		return;
+	}
+
+	key = k_spin_lock(&adv_lock);
+	air_ctrl_ble_encode_adv_v1(seq, values, &adv_next);
+	adv_next_valid = true;
+	k_spin_unlock(&adv_lock, key);
+
+	k_work_submit(&adv_work);
+}
 
 static void connected(struct bt_conn *conn, uint8_t err)
 {
+	struct bt_peer *peer;
+
 	if (err) {
 		LOG_ERR("Connection failed err 0x%02x %s", err, bt_hci_err_to_str(err));
-	} else {
-		if (default_conn == NULL) {
-			default_conn = bt_conn_ref(conn);
+		k_work_submit(&adv_work);
+		return;
+	}
+
+	peer = peer_alloc(conn);
+	if (peer == NULL) {
+		LOG_WRN("No free peer slot, disconnecting");
+		(void)bt_conn_disconnect(conn, BT_HCI_ERR_CONN_LIMIT_EXCEEDED);
+		return;
+	}
+
+	/* Connectable advertising stops on every connection, restart it (or broadcast only when
+	 * all slots are taken)
+	 */
+	k_work_submit(&adv_work);
+
+	request_link_upgrade(peer);
+	link_connected(peer);
+	LOG_INF("Peer %u connected (%u of %u)", peer_id(peer), peer_count(), CONFIG_BT_MAX_CONN);
+	air_ctrl_rate_link_changed(true);
+}
+
+static bool other_peer_subscribed(const struct bt_peer *peer)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		if (&peers[i] != peer && peers[i].conn != NULL &&
+		    (peers[i].notify_enabled || peers[i].batch_notify_enabled)) {
+			return true;
 		}
-		LOG_INF("Connected");
 	}
+
+	return false;
 }
 
+static void batch_spill_locked(struct bt_peer *peer);
+
 static void disconnected(struct bt_conn *conn, uint8_t reason)
 {
-	if (default_conn != NULL) {
-		bt_conn_unref(default_conn);
-		default_conn = NULL;
-	}
+	struct bt_peer *peer = peer_get(conn);
+	struct bt_conn *peer_conn;
 
-	notify_enabled = false;
 	LOG_INF("Disconnected, reason 0x%02x %s", reason, bt_hci_err_to_str(reason));
+
+	if (peer == NULL) {
+		return;
+	}
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	if (history_dl.active && history_dl.peer == peer) {
+		history_dl.active = false;
+		k_work_reschedule(&history_work, K_NO_WAIT);
+	}
+
+	/* Samples still waiting in the batch go to the history log, unless another
+	 * central received them live
+	 */
+	if (!other_peer_subscribed(peer)) {
+		batch_spill_locked(peer);
+	}
+	peer->batch_count = 0;
+	peer->batch_len = 0;
+	peer->notify_enabled = false;
+	peer->batch_notify_enabled = false;
+	peer->agg_notify_enabled = false;
+	peer->alert_notify_enabled = false;
+	air_ctrl_bt_deadband_reset(&peer->deadband);
+	/* Cleared under the lock, the history work item takes its own reference under it */
+	peer_conn = peer->conn;
+	peer->conn = NULL;
+	k_mutex_unlock(&batch_lock);
+	(void)k_work_cancel_delayable(&peer->batch_flush_work);
+
+	if (peer->missed > 0) {
+		LOG_INF("Peer %u missed %u live samples", peer_id(peer), peer->missed);
+	}
+
+	bt_conn_unref(peer_conn);
+	air_ctrl_rate_link_changed(peer_count() > 0);
+}
+
+/* The connection object is free again, so a new central can take its place */
+static void recycled(void)
+{
+	k_work_submit(&adv_work);
+}
+
+static void le_data_len_updated(struct bt_conn *conn, struct bt_conn_le_data_len_info *info)
+{
+	LOG_INF("Data length: tx %u B / %u us, rx %u B / %u us", info->tx_max_len,
+		info->tx_max_time, info->rx_max_len, info->rx_max_time);
 }
 
 BT_CONN_CB_DEFINE(conn_callbacks) = {
 	.connected = connected,
 	.disconnected = disconnected,
+	.recycled = recycled,
+	.le_data_len_updated = le_data_len_updated,
+#if defined(CONFIG_AIR_CTRL_BT_LINK_MANAGER)
+	.le_param_updated = le_param_updated,
+	.le_phy_updated = le_phy_updated,
+#endif
 };
 
 static void bt_ready(void)
 {
-	int err;
-
 	LOG_INF("Bluetooth initialized");
 
 	if (IS_ENABLED(CONFIG_SETTINGS)) {
 		settings_load();
 	}
 
-	err = bt_le_adv_start(BT_LE_ADV_CONN_FAST_1, ad, ARRAY_SIZE(ad), NULL, 0);
-
-	if (err) {
-		LOG_ERR("Advertising failed to start (err %d)", err);
-	} else {
-		LOG_INF("Advertising successfully started");
-	}
+	k_work_submit(&adv_work);
 }
 
 int air_ctrl_bt_init(void)
 {
 	int err;
 
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		k_work_init_delayable(&peers[i].batch_flush_work, batch_flush_work_handler);
+#if defined(CONFIG_AIR_CTRL_BT_LINK_MANAGER)
+		k_work_init_delayable(&peers[i].link.work, link_work_handler);
+#endif
+	}
+
+	bt_gatt_cb_register(&gatt_callbacks);
+
 	err = bt_enable(NULL);
 	if (err) {
 		LOG_ERR("Bluetooth init failed (err %d)", err);
 		return err;
 	}
 
+	if (IS_ENABLED(CONFIG_AIR_CTRL_HISTORY)) {
+		struct air_ctrl_ble_sample_v2 last;
+
+		/* Continue numbering after the newest stored sample so backfill stays unambiguous */
+		if (air_ctrl_history_read_last(&last, sizeof(last)) == sizeof(last)) {
+			sample_seq = sys_le16_to_cpu(last.seq) + 1U;
+			LOG_INF("Resuming sample seq at %u", sample_seq);
+		}
+	}
+
 	bt_ready();
 	return 0;
 }
 
 bool air_ctrl_bt_is_connected(void)
 {
-	return default_conn != NULL;
+	return peer_count() > 0;
+}
+
+/* Entries that fit in one notification at the peer's ATT MTU */
+static size_t batch_capacity(const struct bt_peer *peer)
+{
+	size_t payload;
+	size_t capacity;
+
+	payload = MIN((size_t)peer->mtu - 3U, sizeof(peer->batch_buf));
+	if (payload < sizeof(struct air_ctrl_ble_batch_hdr_v3)) {
+		return 0;
+	}
+
+	capacity = (payload - sizeof(struct air_ctrl_ble_batch_hdr_v3)) /
+		   sizeof(struct air_ctrl_ble_batch_entry_v3);
+
+	if (CONFIG_AIR_CTRL_BT_BATCH_MAX_SAMPLES > 0) {
+		capacity = MIN(capacity, (size_t)CONFIG_AIR_CTRL_BT_BATCH_MAX_SAMPLES);
+	}
+
+	return MIN(capacity, (size_t)UINT8_MAX);
+}
+
+/* Thins the log out so it spans the time a gateway is away, not just an hour at LP */
+static bool history_due(uint32_t timestamp_ms)
+{
+#if defined(CONFIG_AIR_CTRL_HISTORY)
+	bool due;
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	due = !history_have_last ||
+	      (timestamp_ms - history_last_ts_ms) >= CONFIG_AIR_CTRL_HISTORY_INTERVAL_S * 1000U;
+	if (due) {
+		history_last_ts_ms = timestamp_ms;
+		history_have_last = true;
+	}
+	k_mutex_unlock(&batch_lock);
+
+	return due;
+#else
+	ARG_UNUSED(timestamp_ms);
+	return false;
+#endif
+}
+
+static void history_store(const struct air_ctrl_ble_sample_v2 *sample)
+{
+	int err;
+
+	if (!IS_ENABLED(CONFIG_AIR_CTRL_HISTORY) ||
+	    !history_due(sys_le32_to_cpu(sample->timestamp_ms))) {
+		return;
+	}
+
+	err = air_ctrl_history_append(sample, sizeof(*sample));
+	if (err) {
+		LOG_WRN("History append failed (err %d)", err);
+	}
+}
+
+/* Move a batch that can no longer be sent into the history log, as single samples */
+static void batch_spill_locked(struct bt_peer *peer)
+{
+	struct air_ctrl_ble_batch_entry_v3 entry;
+	struct air_ctrl_ble_values values;
+	struct air_ctrl_ble_sample_v2 sample;
+	uint32_t timestamp_ms = peer->batch_base_ts_ms;
+	size_t offset = sizeof(struct air_ctrl_ble_batch_hdr_v3);
+
+	for (uint8_t i = 0; i < peer->batch_count; i++) {
+		memcpy(&entry, &peer->batch_buf[offset], sizeof(entry));
+		offset += sizeof(entry);
+
+		timestamp_ms += air_ctrl_ble_decode_batch_entry_v3(&entry, &values);
+
+		air_ctrl_ble_encode_sample_v2(peer->batch_base_seq + i, timestamp_ms, &values,
+					      &sample);
+		history_store(&sample);
+	}
+
+	peer->batch_count = 0;
+	peer->batch_len = 0;
+}
+
+static void peer_sent_cb(struct bt_conn *conn, void *user_data)
+{
+	struct bt_peer *peer = user_data;
+
+	if (peer->conn == conn) {
+		atomic_dec(&peer->in_flight);
+	}
+}
+
+/* Queue a live notification unless the peer is still behind on the previous ones */
+static int peer_notify(struct bt_peer *peer, const struct bt_gatt_attr *attr, const void *data,
+		       size_t len)
+{
+	struct bt_gatt_notify_params params;
+	int err;
+
+	if (atomic_get(&peer->in_flight) >= PEER_MAX_IN_FLIGHT) {
+		peer->missed++;
+		return -EBUSY;
+	}
+
+	memset(&params, 0, sizeof(params));
+	params.attr = attr;
+	params.data = data;
+	params.len = len;
+	params.func = peer_sent_cb;
+	params.user_data = peer;
+
+	atomic_inc(&peer->in_flight);
+	AIR_CTRL_PROF_BEGIN(AIR_CTRL_PROF_BT_NOTIFY);
+	err = bt_gatt_notify_cb(peer->conn, &params);
+	AIR_CTRL_PROF_END(AIR_CTRL_PROF_BT_NOTIFY);
+	if (err) {
+		atomic_dec(&peer->in_flight);
+		peer->missed++;
+	}
+
+	return err;
+}
+
+BUILD_ASSERT(offsetof(struct air_ctrl_ble_sample_v2, flags) ==
+	     offsetof(struct air_ctrl_ble_sample_hdr_v6, flags));
+
+/* The last sample with this central's deadband flags. Must be called with batch_lock held. */
+static int peer_notify_sample(struct bt_peer *peer, uint8_t flags)
+{
+	uint8_t buf[sizeof(struct air_ctrl_ble_sample_v2)];
+	const void *value;
+	size_t len;
+
+	value = peer_sample(peer, &len);
+	memcpy(buf, value, len);
+	buf[offsetof(struct air_ctrl_ble_sample_v2, flags)] = flags;
+
+	return peer_notify(peer, &air_ctrl_svc.attrs[ATTR_SAMPLE_VALUE], buf, len);
+}
+
+/* Must be called with batch_lock held */
+static int batch_flush_locked(struct bt_peer *peer)
+{
+	struct air_ctrl_ble_batch_hdr_v3 hdr;
+
+	if (peer->batch_count == 0) {
+		return 0;
+	}
+
+	hdr.version = AIR_CTRL_BLE_VERSION_BATCH;
+	hdr.count = peer->batch_count;
+	hdr.base_seq = sys_cpu_to_le16(peer->batch_base_seq);
+	hdr.base_timestamp_ms = sys_cpu_to_le32(peer->batch_base_ts_ms);
+	memcpy(peer->batch_buf, &hdr, sizeof(hdr));
+
+	memcpy(peer->last_batch, peer->batch_buf, peer->batch_len);
+	peer->last_batch_len = peer->batch_len;
+
+	peer->batch_count = 0;
+	peer->batch_len = 0;
+	(void)k_work_cancel_delayable(&peer->batch_flush_work);
+
+	if (peer->conn == NULL || !peer->batch_notify_enabled) {
+		return -ENOTCONN;
+	}
+
+	return peer_notify(peer, &air_ctrl_svc.attrs[ATTR_BATCH_VALUE], peer->last_batch,
+			   peer->last_batch_len);
+}
+
+static void batch_flush_work_handler(struct k_work *work)
+{
+	struct k_work_delayable *dwork = k_work_delayable_from_work(work);
+	struct bt_peer *peer = CONTAINER_OF(dwork, struct bt_peer, batch_flush_work);
+	int err;
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	err = batch_flush_locked(peer);
+	k_mutex_unlock(&batch_lock);
+
+	if (err) {
+		LOG_WRN("Peer %u: batch flush failed (err %d)", peer_id(peer), err);
+	}
 }
 
-static uint32_t ns_to_ms_u32(int64_t timestamp_ns)
+/* entry is encoded once for all peers, only dt_ms depends on the peer's batch */
+static int batch_add(struct bt_peer *peer, uint16_t seq, uint32_t timestamp_ms,
+		     const struct air_ctrl_ble_batch_entry_v3 *entry)
 {
-	if (timestamp_ns <= 0) {
-		return 0U;
+	size_t capacity;
+	uint16_t dt_ms;
+	int err = 0;
+
+	capacity = batch_capacity(peer);
+	if (capacity == 0) {
+		return -EMSGSIZE;
+	}
+
+	/* Start a new batch if the seq/time deltas can no longer be encoded */
+	if (peer->batch_count > 0 &&
+	    (seq != (uint16_t)(peer->batch_base_seq + peer->batch_count) ||
+	     (timestamp_ms - peer->batch_last_ts_ms) > UINT16_MAX)) {
+		err = batch_flush_locked(peer);
+	}
+
+	if (peer->batch_count == 0) {
+		peer->batch_len = sizeof(struct air_ctrl_ble_batch_hdr_v3);
+		peer->batch_base_seq = seq;
+		peer->batch_base_ts_ms = timestamp_ms;
+		peer->batch_last_ts_ms = timestamp_ms;
+		k_work_schedule(&peer->batch_flush_work,
+				K_MSEC(CONFIG_AIR_CTRL_BT_BATCH_MAX_LATENCY_MS));
+	}
+
+	memcpy(&peer->batch_buf[peer->batch_len], entry, sizeof(*entry));
+	dt_ms = (uint16_t)(timestamp_ms - peer->batch_last_ts_ms);
+	sys_put_le16(dt_ms, &peer->batch_buf[peer->batch_len +
+					     offsetof(struct air_ctrl_ble_batch_entry_v3, dt_ms)]);
+	peer->batch_len += sizeof(*entry);
+	peer->batch_count++;
+	peer->batch_last_ts_ms = timestamp_ms;
+
+	if (peer->batch_count >= capacity) {
+		err = batch_flush_locked(peer);
 	}
 
-	return (uint32_t)(timestamp_ns / 1000000LL);
+	return err;
 }
 
 int air_ctrl_bt_notify_sensor_data(const air_ctrl_sensor_data_t *data)
 {
-	struct air_ctrl_ble_sample_v1 sample;
-	uint16_t iaq_x10;
-	uint32_t gas_ohm;
-	uint16_t hum_x100;
-	int16_t temp_x100;
-	uint16_t co2_eq_ppm;
-	uint16_t breath_voc_eq_ppb;
+	struct air_ctrl_ble_sample_v2 sample;
+	struct air_ctrl_ble_batch_entry_v3 entry;
+	struct air_ctrl_ble_values values;
+	struct air_ctrl_ble_alert_v5 alerts[AIR_CTRL_BLE_ALERT_COUNT];
+	size_t alert_count;
+	uint32_t timestamp_ms;
+	uint16_t seq;
+	bool delivered = false;
+	int ret = -EACCES;
+	int err;
 
 	if (data == NULL) {
 		return -EINVAL;
 	}
 
+	/* Every sample gets a sequence number, so batches and gaps stay consistent */
+	seq = sample_seq++;
+	/* What the wire carries, every comparison below is modulo 2^32 */
+	timestamp_ms = (uint32_t)data->timestamp_ms;
+	air_ctrl_ble_scale(data, &values);
+
+	/* Encode once, subscribers only differ in their deadband flags */
+	air_ctrl_ble_encode_sample_v2(seq, timestamp_ms, &values, &sample);
+	air_ctrl_ble_encode_batch_entry_v3(0U, &values, &entry);
+	last_sample_len = air_ctrl_ble_pack_sample(&sample, air_ctrl_sensor_get_outputs(),
+						   last_sample);
+	last_full_sample = sample;
+	adv_update(seq, &values);
+
+	alert_count = air_ctrl_bt_alerts_update(seq, timestamp_ms, &values, alerts);
+#if defined(CONFIG_AIR_CTRL_BT_ALERTS)
+	for (size_t i = 0; i < alert_count; i++) {
+		last_alert[alerts[i].metric] = alerts[i];
+	}
+#endif
+
 	if (!air_ctrl_bt_is_connected()) {
+		history_store(&sample);
 		return -ENOTCONN;
 	}
 
-	if (!notify_enabled) {
-		return -EACCES;
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		struct bt_peer *peer = &peers[i];
+
+		if (peer->conn == NULL) {
+			continue;
+		}
+
+		/* Alerts first, so a peer behind on live samples is less likely to miss them */
+		if (peer->alert_notify_enabled && peer_accepts(peer, AIR_CTRL_BLE_VERSION_ALERT)) {
+			for (size_t j = 0; j < alert_count; j++) {
+				(void)peer_notify(peer, &air_ctrl_svc.attrs[ATTR_ALERT_VALUE],
+						  &alerts[j], sizeof(alerts[j]));
+			}
+		}
+
+		if (peer->batch_notify_enabled && peer_accepts(peer, AIR_CTRL_BLE_VERSION_BATCH)) {
+			err = batch_add(peer, seq, timestamp_ms, &entry);
+			/* Anything but -EMSGSIZE means the sample sits in a batch */
+			delivered |= (err != -EMSGSIZE);
+			ret = err;
+		}
+
+		if (peer->notify_enabled) {
+			uint8_t flags = 0U;
+
+			if (!air_ctrl_bt_deadband_pass(&peer->deadband, &values, timestamp_ms,
+						       &flags)) {
+				/* Within the deadband of the last sample it received, the peer is
+				 * up to date
+				 */
+				delivered = true;
+				continue;
+			}
+
+			err = peer_notify_sample(peer, flags);
+			if (err == 0) {
+				air_ctrl_bt_deadband_sent(&peer->deadband, &values, timestamp_ms,
+							  flags);
+			}
+			delivered |= (err == 0);
+			ret = err;
+		}
+	}
+	k_mutex_unlock(&batch_lock);
+
+	/* Nobody received the sample live, keep it for backfill */
+	if (!delivered) {
+		history_store(&sample);
+	}
+
+	return delivered ? 0 : ret;
+}
+
+#if defined(CONFIG_AIR_CTRL_AGG)
+int air_ctrl_bt_notify_aggregates(const air_ctrl_agg_summary_t *summaries, size_t count)
+{
+	struct air_ctrl_ble_agg_v4 records[AIR_CTRL_AGG_LEVEL_COUNT];
+	size_t len;
+	int ret = -ENOTCONN;
+	int err;
+
+	if (summaries == NULL || count == 0 || count > ARRAY_SIZE(records)) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		air_ctrl_ble_encode_agg_v4(&summaries[i], &records[i]);
+		if (summaries[i].level < ARRAY_SIZE(last_agg)) {
+			last_agg[summaries[i].level] = records[i];
+		}
+	}
+	len = count * sizeof(records[0]);
+
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	for (size_t i = 0; i < ARRAY_SIZE(peers); i++) {
+		struct bt_peer *peer = &peers[i];
+
+		if (peer->conn == NULL || !peer->agg_notify_enabled ||
+		    !peer_accepts(peer, AIR_CTRL_BLE_VERSION_AGG)) {
+			continue;
+		}
+
+		/* Records are never split, a peer on the default MTU can still read them */
+		if ((size_t)peer->mtu - 3U < len) {
+			peer->missed++;
+			ret = -EMSGSIZE;
+			continue;
+		}
+
+		err = peer_notify(peer, &air_ctrl_svc.attrs[ATTR_AGG_VALUE], records, len);
+		ret = (ret == 0) ? 0 : err;
+	}
+	k_mutex_unlock(&batch_lock);
+
+	return ret;
+}
+#endif /* CONFIG_AIR_CTRL_AGG */
+
+static bool history_record_wanted(const struct air_ctrl_ble_sample_v2 *sample)
+{
+	if (history_dl.op == HISTORY_OP_FROM_SEQ) {
+		return (int16_t)(sys_le16_to_cpu(sample->seq) - history_dl.start_seq) >= 0;
+	}
+
+	/* Serial, the stored uptime wraps after 49.7 days */
+	return (int32_t)(sys_le32_to_cpu(sample->timestamp_ms) - history_dl.start_ts_ms) >= 0;
+}
+
+static void history_sent_cb(struct bt_conn *conn, void *user_data)
+{
+	ARG_UNUSED(conn);
+	ARG_UNUSED(user_data);
+
+	atomic_dec(&history_dl.in_flight);
+	if (history_dl.active) {
+		k_work_reschedule(&history_work, K_NO_WAIT);
+	}
+}
+
+/* Fill one notification from the log. Returns its length including the flags byte. */
+static size_t history_fill(size_t max_len)
+{
+	struct air_ctrl_ble_sample_v2 sample;
+	size_t len = 1;
+	int rc;
+
+	history_buf[0] = 0U;
+
+	while (len + sizeof(sample) <= max_len) {
+		rc = air_ctrl_history_read_next(&history_dl.cursor, &sample, sizeof(sample));
+		if (rc < 0) {
+			/* Anything but the end of the log would fail again on the next call */
+			if (rc != -ENOENT) {
+				LOG_WRN("History read failed (err %d), ending the download", rc);
+			}
+			history_buf[0] = AIR_CTRL_BLE_HISTORY_FLAG_END;
+			break;
+		}
+		if (rc != sizeof(sample) || !history_record_wanted(&sample)) {
+			continue;
+		}
+
+		memcpy(&history_buf[len], &sample, sizeof(sample));
+		len += sizeof(sample);
+	}
+
+	return len;
+}
+
+static void history_work_handler(struct k_work *work)
+{
+	struct bt_gatt_notify_params params;
+	struct bt_peer *peer;
+	struct bt_conn *conn = NULL;
+	size_t max_len;
+	size_t len;
+	int err;
+
+	ARG_UNUSED(work);
+
+	if (history_dl.active && history_buf == NULL) {
+		/* Busy with a BSEC state save, retry shortly */
+		history_buf = air_ctrl_arena_acquire(AIR_CTRL_ARENA_BT_HISTORY, BATCH_MAX_LEN,
+						     K_NO_WAIT);
+		if (history_buf == NULL) {
+			k_work_reschedule(&history_work, K_MSEC(HISTORY_RETRY_MS));
+			return;
+		}
+	}
+
+	/* disconnected() clears peer->conn under batch_lock on the BT RX thread. A reference
+	 * taken here keeps this run on that one connection: a NULL conn would notify every
+	 * central.
+	 */
+	k_mutex_lock(&batch_lock, K_FOREVER);
+	peer = history_dl.peer;
+	if (peer != NULL && peer->conn != NULL) {
+		conn = bt_conn_ref(peer->conn);
 	}
+	k_mutex_unlock(&batch_lock);
+
+	while (history_dl.active && atomic_get(&history_dl.in_flight) < HISTORY_MAX_IN_FLIGHT) {
+		if (conn == NULL) {
+			history_dl.active = false;
+			break;
+		}
+
+		/* A notification refused for lack of buffers is sent again unchanged */
+		if (history_dl.unsent_len > 0) {
+			len = history_dl.unsent_len;
+		} else {
+			max_len = MIN((size_t)peer->mtu - 3U, BATCH_MAX_LEN);
+			len = history_fill(max_len);
+		}
+
+		memset(&params, 0, sizeof(params));
+		params.attr = &air_ctrl_svc.attrs[ATTR_HISTORY_VALUE];
+		params.data = history_buf;
+		params.len = len;
+		params.func = history_sent_cb;
+
+		atomic_inc(&history_dl.in_flight);
+		err = bt_gatt_notify_cb(conn, &params);
+		if (err == -ENOMEM) {
+			atomic_dec(&history_dl.in_flight);
+			history_dl.unsent_len = len;
+			k_work_reschedule(&history_work, K_MSEC(HISTORY_RETRY_MS));
+			bt_conn_unref(conn);
+			return;
+		}
 
-	gas_ohm = (data->raw_gas_resistance <= 0.0f) ? 0U : (uint32_t)data->raw_gas_resistance;
+		history_dl.unsent_len = 0;
 
-	temp_x100 = (int16_t)CLAMP((int32_t)(data->raw_temperature * 100.0f), INT16_MIN, INT16_MAX);
-	hum_x100 = (uint16_t)CLAMP((int32_t)(data->raw_humidity * 100.0f), 0, UINT16_MAX);
+		if (err) {
+			atomic_dec(&history_dl.in_flight);
+			LOG_WRN("History notify failed (err %d)", err);
+			history_dl.active = false;
+			break;
+		}
 
-	iaq_x10 = (data->iaq <= 0.0f) ? 0U : (uint16_t)CLAMP((int32_t)(data->iaq * 10.0f), 0, UINT16_MAX);
-	co2_eq_ppm = (data->co2_equivalent <= 0.0f) ? 0U :
-		(uint16_t)CLAMP((int32_t)(data->co2_equivalent + 0.5f), 0, UINT16_MAX);
-	breath_voc_eq_ppb = (data->breath_voc_equivalent <= 0.0f) ? 0U :
-		(uint16_t)CLAMP((int32_t)(data->breath_voc_equivalent * 1000.0f + 0.5f), 0, UINT16_MAX);
+		link_count_bytes(peer, len);
+		history_dl.sent += (len - 1) / sizeof(struct air_ctrl_ble_sample_v2);
+		if (history_buf[0] & AIR_CTRL_BLE_HISTORY_FLAG_END) {
+			history_dl.active = false;
+			LOG_INF("History download done (%u samples)", history_dl.sent);
+		}
+	}
 
-	sample.version = 2U;
-	sample.flags = 0U;
-	sample.seq = sys_cpu_to_le16(sample_seq++);
-	sample.timestamp_ms = sys_cpu_to_le32(ns_to_ms_u32(data->timestamp_ns));
-	sample.temp_c_x100 = (int16_t)sys_cpu_to_le16((uint16_t)temp_x100);
-	sample.hum_rh_x100 = sys_cpu_to_le16(hum_x100);
-	sample.gas_ohm = sys_cpu_to_le32(gas_ohm);
-	sample.iaq_x10 = sys_cpu_to_le16(iaq_x10);
-	sample.iaq_acc = data->iaq_accuracy;
-	sample.co2_eq_ppm = sys_cpu_to_le16(co2_eq_ppm);
-	sample.breath_voc_eq_ppb = sys_cpu_to_le16(breath_voc_eq_ppb);
+	/* Notifications in flight were copied by the stack, the buffer is no longer needed */
+	if (!history_dl.active && history_buf != NULL) {
+		history_buf = NULL;
+		history_dl.unsent_len = 0;
+		air_ctrl_arena_release(AIR_CTRL_ARENA_BT_HISTORY);
+	}
 
-	memcpy(last_sample, &sample, sizeof(sample));
-	last_sample_len = sizeof(sample);
+	if (!history_dl.active && peer != NULL) {
+		link_bulk_end(peer, LINK_BULK_HISTORY);
+		k_mutex_lock(&batch_lock, K_FOREVER);
+		if (!history_dl.active && history_dl.peer == peer) {
+			history_dl.peer = NULL;
+		}
+		k_mutex_unlock(&batch_lock);
+	}
 
-	return bt_gatt_notify(default_conn, &air_ctrl_svc.attrs[2], last_sample, last_sample_len);
+	if (conn != NULL) {
+		bt_conn_unref(conn);
+	}
 }
@@ -3,6 +3,7 @@
 
 #include <stdbool.h>
 
+#include "air_ctrl_agg.h"
 #include "air_ctrl_sensor.h"
 
 int air_ctrl_bt_init(void);
@@ -11,4 +12,18 @@ bool air_ctrl_bt_is_connected(void);
 
 int air_ctrl_bt_notify_sensor_data(const air_ctrl_sensor_data_t *data);
 
+#if defined(CONFIG_AIR_CTRL_AGG)
+/* Notify the buckets air_ctrl_agg_add() closed for one sample, in one notification */
+int air_ctrl_bt_notify_aggregates(const air_ctrl_agg_summary_t *summaries, size_t count);
+#else
+static inline int air_ctrl_bt_notify_aggregates(const air_ctrl_agg_summary_t *summaries,
+						size_t count)
+{
+	(void)summaries;
+	(void)count;
+
+	return 0;
+}
+#endif
+
 #endif /* AIR_CTRL_BT_H */
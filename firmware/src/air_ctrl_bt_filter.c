@@ -0,0 +1,156 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/util.h>
+
+#include <stdlib.h>
+
+#include "air_ctrl_bt_filter.h"
+
+LOG_MODULE_REGISTER(air_ctrl_bt_filter, LOG_LEVEL_INF);
+
+#if defined(CONFIG_AIR_CTRL_BT_DEADBAND)
+static bool outside(int32_t value, int32_t ref, int32_t width)
+{
+	return abs(value - ref) > width;
+}
+
+bool air_ctrl_bt_deadband_pass(struct air_ctrl_bt_deadband *deadband,
+			       const struct air_ctrl_ble_values *values, uint32_t timestamp_ms,
+			       uint8_t *flags)
+{
+	const struct air_ctrl_ble_values *ref = &deadband->values;
+	bool changed;
+
+	changed = !deadband->valid ||
+		  outside(values->temp_c_x100, ref->temp_c_x100,
+			  CONFIG_AIR_CTRL_BT_DEADBAND_TEMP_X100) ||
+		  outside(values->hum_rh_x100, ref->hum_rh_x100,
+			  CONFIG_AIR_CTRL_BT_DEADBAND_HUM_X100) ||
+		  outside(values->iaq_x10, ref->iaq_x10, CONFIG_AIR_CTRL_BT_DEADBAND_IAQ_X10) ||
+		  outside(values->co2_eq_ppm, ref->co2_eq_ppm,
+			  CONFIG_AIR_CTRL_BT_DEADBAND_CO2_PPM) ||
+		  values->iaq_acc != ref->iaq_acc;
+
+	if (!changed) {
+		/* The held count has to fit the flags, so it also forces a keep-alive */
+		if ((timestamp_ms - deadband->timestamp_ms) <
+			    CONFIG_AIR_CTRL_BT_DEADBAND_KEEPALIVE_S * 1000U &&
+		    deadband->held < AIR_CTRL_BLE_SAMPLE_HELD_MAX) {
+			deadband->held++;
+			return false;
+		}
+		*flags |= AIR_CTRL_BLE_SAMPLE_FLAG_KEEPALIVE;
+	}
+
+	/* Lets a gateway tell these seq gaps from lost notifications */
+	*flags |= (uint8_t)(deadband->held << AIR_CTRL_BLE_SAMPLE_HELD_SHIFT);
+
+	return true;
+}
+
+void air_ctrl_bt_deadband_sent(struct air_ctrl_bt_deadband *deadband,
+			       const struct air_ctrl_ble_values *values, uint32_t timestamp_ms,
+			       uint8_t flags)
+{
+	deadband->held = 0U;
+
+	/* The band stays put during keep-alives so a slow drift still counts as a change */
+	if (!deadband->valid || !(flags & AIR_CTRL_BLE_SAMPLE_FLAG_KEEPALIVE)) {
+		deadband->values = *values;
+	}
+	deadband->valid = true;
+	deadband->timestamp_ms = timestamp_ms;
+}
+
+void air_ctrl_bt_deadband_reset(struct air_ctrl_bt_deadband *deadband)
+{
+	deadband->valid = false;
+}
+#else
+bool air_ctrl_bt_deadband_pass(struct air_ctrl_bt_deadband *deadband,
+			       const struct air_ctrl_ble_values *values, uint32_t timestamp_ms,
+			       uint8_t *flags)
+{
+	ARG_UNUSED(deadband);
+	ARG_UNUSED(values);
+	ARG_UNUSED(timestamp_ms);
+	ARG_UNUSED(flags);
+
+	return true;
+}
+
+void air_ctrl_bt_deadband_sent(struct air_ctrl_bt_deadband *deadband,
+			       const struct air_ctrl_ble_values *values, uint32_t timestamp_ms,
+			       uint8_t flags)
+{
+	ARG_UNUSED(deadband);
+	ARG_UNUSED(values);
+	ARG_UNUSED(timestamp_ms);
+	ARG_UNUSED(flags);
+}
+
+void air_ctrl_bt_deadband_reset(struct air_ctrl_bt_deadband *deadband)
+{
+	ARG_UNUSED(deadband);
+}
+#endif /* CONFIG_AIR_CTRL_BT_DEADBAND */
+
+#if defined(CONFIG_AIR_CTRL_BT_ALERTS)
+static const struct {
+	uint16_t threshold;
+	uint16_t hysteresis;
+	const char *name;
+} alert_cfg[AIR_CTRL_BLE_ALERT_COUNT] = {
+	[AIR_CTRL_BLE_ALERT_IAQ] = {CONFIG_AIR_CTRL_BT_ALERT_IAQ_X10,
+				    CONFIG_AIR_CTRL_BT_ALERT_IAQ_HYST_X10, "IAQ x10"},
+	[AIR_CTRL_BLE_ALERT_CO2] = {CONFIG_AIR_CTRL_BT_ALERT_CO2_PPM,
+				    CONFIG_AIR_CTRL_BT_ALERT_CO2_HYST_PPM, "CO2-eq ppm"},
+};
+
+static bool alert_raised[AIR_CTRL_BLE_ALERT_COUNT];
+
+size_t air_ctrl_bt_alerts_update(uint16_t seq, uint32_t timestamp_ms,
+				 const struct air_ctrl_ble_values *values,
+				 struct air_ctrl_ble_alert_v5 events[AIR_CTRL_BLE_ALERT_COUNT])
+{
+	uint16_t value[AIR_CTRL_BLE_ALERT_COUNT];
+	size_t n = 0;
+
+	value[AIR_CTRL_BLE_ALERT_IAQ] = values->iaq_x10;
+	value[AIR_CTRL_BLE_ALERT_CO2] = values->co2_eq_ppm;
+
+	for (int i = 0; i < AIR_CTRL_BLE_ALERT_COUNT; i++) {
+		bool raised = alert_raised[i];
+
+		if (!raised && value[i] >= alert_cfg[i].threshold) {
+			raised = true;
+		} else if (raised && value[i] + alert_cfg[i].hysteresis < alert_cfg[i].threshold) {
+			raised = false;
+		}
+
+		if (raised == alert_raised[i]) {
+			continue;
+		}
+
+		alert_raised[i] = raised;
+		LOG_INF("%s %u %s threshold %u", alert_cfg[i].name, value[i],
+			raised ? "above" : "back below", alert_cfg[i].threshold);
+		air_ctrl_ble_encode_alert_v5(i, raised, seq, timestamp_ms, value[i],
+					     alert_cfg[i].threshold, &events[n++]);
+	}
+
+	return n;
+}
+#else
+size_t air_ctrl_bt_alerts_update(uint16_t seq, uint32_t timestamp_ms,
+				 const struct air_ctrl_ble_values *values,
+				 struct air_ctrl_ble_alert_v5 events[AIR_CTRL_BLE_ALERT_COUNT])
+{
+	ARG_UNUSED(seq);
+	ARG_UNUSED(timestamp_ms);
+	ARG_UNUSED(values);
+	ARG_UNUSED(events);
+
+	return 0;
+}
+#endif /* CONFIG_AIR_CTRL_BT_ALERTS */
@@ -0,0 +1,55 @@
+#ifndef AIR_CTRL_BT_FILTER_H_
+#define AIR_CTRL_BT_FILTER_H_
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#include "air_ctrl_ble_proto.h"
+
+/* Decisions on what is worth a notification, shared by air_ctrl_bt.c and the loopback.
+ * The alerts are only updated from the main thread (air_ctrl_bt_notify_sensor_data()).
+ *
+ * Deadband: a sample is notified to a subscriber when temperature, humidity, IAQ or CO2-eq
+ * left the band around the last sample that subscriber received, the IAQ accuracy changed,
+ * or nothing reached it for CONFIG_AIR_CTRL_BT_DEADBAND_KEEPALIVE_S.
+ *
+ * Alerts: IAQ and CO2-eq are compared against their thresholds, with hysteresis on the
+ * way down.
+ */
+
+/* Deadband state of one subscriber. All zero lets the next sample through. */
+struct air_ctrl_bt_deadband {
+	bool valid;
+	uint32_t timestamp_ms;
+	struct air_ctrl_ble_values values;
+	/* Samples held back since the last notified one */
+	uint8_t held;
+};
+
+/* True if the sample should be notified. *flags gets AIR_CTRL_BLE_SAMPLE_FLAG_KEEPALIVE
+ * when it only goes out because of the keep-alive, and the number of samples held back
+ * since the last notified one in bits 1-7. Always true with the deadband off.
+ * A sample that passes only becomes the reference with air_ctrl_bt_deadband_sent(), so a
+ * change whose notification failed is still a change for the next sample.
+ */
+bool air_ctrl_bt_deadband_pass(struct air_ctrl_bt_deadband *deadband,
+			       const struct air_ctrl_ble_values *values, uint32_t timestamp_ms,
+			       uint8_t *flags);
+
+/* The sample that passed with these flags was notified */
+void air_ctrl_bt_deadband_sent(struct air_ctrl_bt_deadband *deadband,
+			       const struct air_ctrl_ble_values *values, uint32_t timestamp_ms,
+			       uint8_t flags);
+
+/* Let the next sample through, e.g. for a new subscriber */
+void air_ctrl_bt_deadband_reset(struct air_ctrl_bt_deadband *deadband);
+
+/* Update the alert states. Returns the number of crossings written to events, at most
+ * one per metric (none with alerts off).
+ */
+size_t air_ctrl_bt_alerts_update(uint16_t seq, uint32_t timestamp_ms,
+				 const struct air_ctrl_ble_values *values,
+				 struct air_ctrl_ble_alert_v5 events[AIR_CTRL_BLE_ALERT_COUNT]);
+
+#endif /* AIR_CTRL_BT_FILTER_H_ */
@@ -0,0 +1,284 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "air_ctrl_ble_proto.h"
+#include "air_ctrl_bt.h"
+#include "air_ctrl_bt_filter.h"
+#include "air_ctrl_power.h"
+
+LOG_MODULE_REGISTER(air_ctrl_bt, LOG_LEVEL_INF);
+
+/* Stand-in for air_ctrl_bt.c on targets without a radio (native_sim). Samples are
+ * encoded into the same single and batched notifications, then decoded again by a
+ * loopback "central" that checks seq continuity and counts throughput.
+ */
+
+#define LOOPBACK_PAYLOAD_LEN (CONFIG_AIR_CTRL_BT_LOOPBACK_MTU - 3)
+
+BUILD_ASSERT(LOOPBACK_PAYLOAD_LEN >= sizeof(struct air_ctrl_ble_batch_hdr_v3) +
+				      sizeof(struct air_ctrl_ble_batch_entry_v3),
+	     "Loopback MTU too small for one batch entry");
+
+static uint16_t sample_seq;
+/* The loopback central's, it receives every notification */
+static struct air_ctrl_bt_deadband deadband;
+
+static uint8_t batch_buf[LOOPBACK_PAYLOAD_LEN];
+static size_t batch_len;
+static uint8_t batch_count;
+static uint16_t batch_base_seq;
+static uint32_t batch_base_ts_ms;
+static uint32_t batch_last_ts_ms;
+
+static struct {
+	uint32_t samples;
+	uint32_t notifications;
+	uint64_t bytes;
+	uint32_t seq_errors;
+	uint32_t decode_errors;
+	uint32_t suppressed;
+	uint32_t alerts;
+	uint32_t agg_notifications;
+	uint64_t agg_bytes;
+	uint16_t next_seq;
+	bool synced;
+	uint64_t encode_cycles;
+	int64_t start_ms;
+} stats;
+
+static void central_check_seq(uint16_t seq)
+{
+	if (stats.synced && seq != stats.next_seq) {
+		stats.seq_errors++;
+		LOG_WRN("Loopback seq gap: expected %u, got %u", stats.next_seq, seq);
+	}
+
+	stats.synced = true;
+	stats.next_seq = seq + 1U;
+}
+
+/* What a central would do with each notification, using the host codec; seq is checked
+ * on the batches
+ */
+static void central_receive(const uint8_t *buf, size_t len)
+{
+	static struct air_ctrl_ble_sample samples[LOOPBACK_PAYLOAD_LEN /
+						  sizeof(struct air_ctrl_ble_batch_entry_v3)];
+	struct air_ctrl_ble_agg aggs[AIR_CTRL_BLE_AGG_LEVEL_COUNT];
+	struct air_ctrl_ble_alert alert;
+	int rc;
+
+	stats.notifications++;
+	stats.bytes += len;
+
+	switch (buf[0]) {
+	case AIR_CTRL_BLE_VERSION_BATCH:
+		rc = air_ctrl_ble_decode_batch(buf, len, samples, ARRAY_SIZE(samples));
+		for (int i = 0; i < rc; i++) {
+			central_check_seq(samples[i].seq);
+		}
+		break;
+	case AIR_CTRL_BLE_VERSION_SAMPLE:
+	case AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT:
+		rc = air_ctrl_ble_decode_sample(buf, len, &samples[0]);
+		break;
+	case AIR_CTRL_BLE_VERSION_ALERT:
+		rc = air_ctrl_ble_decode_alert(buf, len, &alert);
+		if (rc == 0) {
+			stats.alerts++;
+		}
+		break;
+	case AIR_CTRL_BLE_VERSION_AGG:
+		rc = air_ctrl_ble_decode_agg(buf, len, aggs, ARRAY_SIZE(aggs));
+		if (rc >= 0) {
+			stats.agg_notifications++;
+			stats.agg_bytes += len;
+		}
+		break;
+	default:
+		rc = -ENOTSUP;
+		break;
+	}
+
+	if (rc < 0) {
+		stats.decode_errors++;
+		LOG_WRN("Loopback could not decode a v%u notification (err %d)", buf[0], rc);
+	}
+}
+
+static size_t batch_capacity(void)
+{
+	size_t capacity = (LOOPBACK_PAYLOAD_LEN - sizeof(struct air_ctrl_ble_batch_hdr_v3)) /
+			  sizeof(struct air_ctrl_ble_batch_entry_v3);
+
+	if (CONFIG_AIR_CTRL_BT_BATCH_MAX_SAMPLES > 0) {
+		capacity = MIN(capacity, (size_t)CONFIG_AIR_CTRL_BT_BATCH_MAX_SAMPLES);
+	}
+
+	return MIN(capacity, (size_t)UINT8_MAX);
+}
+
+static void batch_flush(void)
+{
+	struct air_ctrl_ble_batch_hdr_v3 hdr;
+
+	if (batch_count == 0) {
+		return;
+	}
+
+	hdr.version = AIR_CTRL_BLE_VERSION_BATCH;
+	hdr.count = batch_count;
+	hdr.base_seq = sys_cpu_to_le16(batch_base_seq);
+	hdr.base_timestamp_ms = sys_cpu_to_le32(batch_base_ts_ms);
+	memcpy(batch_buf, &hdr, sizeof(hdr));
+
+	central_receive(batch_buf, batch_len);
+
+	batch_count = 0;
+	batch_len = 0;
+}
+
+static void batch_add(uint16_t seq, uint32_t timestamp_ms, const struct air_ctrl_ble_values *values)
+{
+	struct air_ctrl_ble_batch_entry_v3 entry;
+
+	if (batch_count > 0 &&
+	    (seq != (uint16_t)(batch_base_seq + batch_count) ||
+	     (timestamp_ms - batch_last_ts_ms) > UINT16_MAX)) {
+		batch_flush();
+	}
+
+	if (batch_count == 0) {
+		batch_len = sizeof(struct air_ctrl_ble_batch_hdr_v3);
+		batch_base_seq = seq;
+		batch_base_ts_ms = timestamp_ms;
+		batch_last_ts_ms = timestamp_ms;
+	}
+
+	air_ctrl_ble_encode_batch_entry_v3((uint16_t)(timestamp_ms - batch_last_ts_ms), values, &entry);
+	memcpy(&batch_buf[batch_len], &entry, sizeof(entry));
+	batch_len += sizeof(entry);
+	batch_count++;
+	batch_last_ts_ms = timestamp_ms;
+
+	if (batch_count >= batch_capacity()) {
+		batch_flush();
+	}
+}
+
+#if defined(CONFIG_AIR_CTRL_AGG)
+int air_ctrl_bt_notify_aggregates(const air_ctrl_agg_summary_t *summaries, size_t count)
+{
+	struct air_ctrl_ble_agg_v4 records[AIR_CTRL_AGG_LEVEL_COUNT];
+
+	if (summaries == NULL || count == 0 || count > ARRAY_SIZE(records)) {
+		return -EINVAL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+		air_ctrl_ble_encode_agg_v4(&summaries[i], &records[i]);
+	}
+
+	central_receive((const uint8_t *)records, count * sizeof(records[0]));
+
+	return 0;
+}
+#endif
+
+static void report(void)
+{
+	int64_t elapsed_ms = k_uptime_get() - stats.start_ms;
+
+	LOG_INF("Loopback: %u samples, %u notifications, %llu B (%llu B/s), %u cyc/sample, "
+		"%u seq errors, %u decode errors",
+		stats.samples, stats.notifications, (unsigned long long)stats.bytes,
+		(unsigned long long)(elapsed_ms > 0 ? (stats.bytes * 1000U) / elapsed_ms : 0U),
+		(uint32_t)(stats.encode_cycles / MAX(stats.samples, 1U)), stats.seq_errors,
+		stats.decode_errors);
+	LOG_INF("Loopback: %u samples inside the deadband, %u alerts", stats.suppressed,
+		stats.alerts);
+
+#if defined(CONFIG_AIR_CTRL_AGG)
+	LOG_INF("Loopback: %u aggregate notifications, %llu B", stats.agg_notifications,
+		(unsigned long long)stats.agg_bytes);
+#endif
+
+#if defined(CONFIG_AIR_CTRL_POWER)
+	air_ctrl_power_stats_t power;
+
+	air_ctrl_power_get_stats(&power);
+	LOG_INF("Residency: cpu active %llu ms, idle %llu ms, sensor active %llu ms, "
+		"suspended %llu ms (%u resumes)",
+		power.residency_us[AIR_CTRL_POWER_CPU_ACTIVE] / 1000U,
+		power.residency_us[AIR_CTRL_POWER_CPU_IDLE] / 1000U,
+		power.residency_us[AIR_CTRL_POWER_SENSOR_ACTIVE] / 1000U,
+		power.residency_us[AIR_CTRL_POWER_SENSOR_SUSPENDED] / 1000U, power.sensor_resumes);
+#endif
+}
+
+int air_ctrl_bt_init(void)
+{
+	stats.start_ms = k_uptime_get();
+	LOG_INF("BLE loopback, %u-byte ATT MTU, %u samples per batch",
+		CONFIG_AIR_CTRL_BT_LOOPBACK_MTU, (uint32_t)batch_capacity());
+
+	return 0;
+}
+
+bool air_ctrl_bt_is_connected(void)
+{
+	return true;
+}
+
+int air_ctrl_bt_notify_sensor_data(const air_ctrl_sensor_data_t *data)
+{
+	struct air_ctrl_ble_sample_v2 sample;
+	uint8_t packed[sizeof(sample)];
+	struct air_ctrl_ble_values values;
+	struct air_ctrl_ble_alert_v5 alerts[AIR_CTRL_BLE_ALERT_COUNT];
+	size_t alert_count;
+	size_t len;
+	uint32_t timestamp_ms;
+	uint32_t start;
+	uint16_t seq;
+
+	if (data == NULL) {
+		return -EINVAL;
+	}
+
+	start = k_cycle_get_32();
+
+	seq = sample_seq++;
+	timestamp_ms = (uint32_t)data->timestamp_ms;
+	air_ctrl_ble_scale(data, &values);
+	air_ctrl_ble_encode_sample_v2(seq, timestamp_ms, &values, &sample);
+
+	/* The loopback central is subscribed to every characteristic */
+	alert_count = air_ctrl_bt_alerts_update(seq, timestamp_ms, &values, alerts);
+	for (size_t i = 0; i < alert_count; i++) {
+		central_receive((const uint8_t *)&alerts[i], sizeof(alerts[i]));
+	}
+
+	if (air_ctrl_bt_deadband_pass(&deadband, &values, timestamp_ms, &sample.flags)) {
+		len = air_ctrl_ble_pack_sample(&sample, air_ctrl_sensor_get_outputs(), packed);
+		central_receive(packed, len);
+		air_ctrl_bt_deadband_sent(&deadband, &values, timestamp_ms, sample.flags);
+	} else {
+		stats.suppressed++;
+	}
+	batch_add(seq, timestamp_ms, &values);
+
+	stats.encode_cycles += k_cycle_get_32() - start;
+	stats.samples++;
+
+	if ((stats.samples % CONFIG_AIR_CTRL_BT_LOOPBACK_REPORT_EVERY) == 0U) {
+		report();
+	}
+
+	return 0;
+}
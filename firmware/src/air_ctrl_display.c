@@ -0,0 +1,293 @@
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/display.h>
+#include <zephyr/drivers/pwm.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/printk.h>
+#include <zephyr/sys/util.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "air_ctrl_display.h"
+#include "air_ctrl_prof.h"
+
+LOG_MODULE_REGISTER(air_ctrl_display, LOG_LEVEL_INF);
+
+#define PANEL_WIDTH DT_PROP(DT_CHOSEN(zephyr_display), width)
+#define PANEL_HEIGHT DT_PROP(DT_CHOSEN(zephyr_display), height)
+
+#define STRIPE_LINES CONFIG_AIR_CTRL_DISPLAY_STRIPE_LINES
+
+/* 5x7 glyphs in a 6 pixel cell, scaled up by whole pixels */
+#define GLYPH_W 5
+#define GLYPH_H 7
+#define CELL_W (GLYPH_W + 1)
+
+/* Five rows: label on the left, value box on the right */
+#define ROW_COUNT 5
+#define ROW_HEIGHT (PANEL_HEIGHT / ROW_COUNT)
+#define LABEL_SCALE 2
+#define LABEL_X 4
+#define VALUE_SCALE 4
+#define VALUE_X 96
+#define VALUE_CHARS 6
+#define VALUE_W (VALUE_CHARS * CELL_W * VALUE_SCALE)
+#define VALUE_H (GLYPH_H * VALUE_SCALE)
+
+BUILD_ASSERT(VALUE_X + VALUE_W <= PANEL_WIDTH, "Value boxes do not fit the panel");
+BUILD_ASSERT(VALUE_H <= ROW_HEIGHT, "Value boxes do not fit a row");
+
+/* RGB565 */
+#define COLOR_BG 0x0000U
+#define COLOR_LABEL 0x9CF3U
+#define COLOR_VALUE 0xFFFFU
+#define COLOR_GREY 0x7BEFU
+#define COLOR_GREEN 0x07E0U
+#define COLOR_YELLOW 0xFFE0U
+#define COLOR_RED 0xF800U
+
+struct glyph {
+	char c;
+	uint8_t cols[GLYPH_W]; /* Bit 0 is the top row */
+};
+
+static const struct glyph font[] = {
+	{'0', {0x3E, 0x51, 0x49, 0x45, 0x3E}}, {'1', {0x00, 0x42, 0x7F, 0x40, 0x00}},
+	{'2', {0x42, 0x61, 0x51, 0x49, 0x46}}, {'3', {0x21, 0x41, 0x45, 0x4B, 0x31}},
+	{'4', {0x18, 0x14, 0x12, 0x7F, 0x10}}, {'5', {0x27, 0x45, 0x45, 0x45, 0x39}},
+	{'6', {0x3C, 0x4A, 0x49, 0x49, 0x30}}, {'7', {0x01, 0x71, 0x09, 0x05, 0x03}},
+	{'8', {0x36, 0x49, 0x49, 0x49, 0x36}}, {'9', {0x06, 0x49, 0x49, 0x29, 0x1E}},
+	{'.', {0x00, 0x60, 0x60, 0x00, 0x00}}, {'-', {0x08, 0x08, 0x08, 0x08, 0x08}},
+	{'%', {0x23, 0x13, 0x08, 0x64, 0x62}}, {'A', {0x7E, 0x11, 0x11, 0x11, 0x7E}},
+	{'B', {0x7F, 0x49, 0x49, 0x49, 0x36}}, {'C', {0x3E, 0x41, 0x41, 0x41, 0x22}},
+	{'E', {0x7F, 0x49, 0x49, 0x49, 0x41}}, {'H', {0x7F, 0x08, 0x08, 0x08, 0x7F}},
+	{'I', {0x00, 0x41, 0x7F, 0x41, 0x00}}, {'M', {0x7F, 0x02, 0x0C, 0x02, 0x7F}},
+	{'O', {0x3E, 0x41, 0x41, 0x41, 0x3E}}, {'P', {0x7F, 0x09, 0x09, 0x09, 0x06}},
+	{'Q', {0x3E, 0x41, 0x51, 0x21, 0x5E}}, {'T', {0x01, 0x01, 0x7F, 0x01, 0x01}},
+	{'U', {0x3F, 0x40, 0x40, 0x40, 0x3F}}, {'V', {0x1F, 0x20, 0x40, 0x20, 0x1F}},
+};
+
+struct row {
+	const char *label;
+	char text[VALUE_CHARS + 1];
+	uint16_t color;
+	bool valid;
+};
+
+static struct row rows[ROW_COUNT] = {
+	{.label = "TEMP C"},
+	{.label = "HUM %"},
+	{.label = "IAQ"},
+	{.label = "CO2 PPM"},
+	{.label = "VOC PPB"},
+};
+
+static const struct device *const panel = DEVICE_DT_GET(DT_CHOSEN(zephyr_display));
+
+#if DT_NODE_EXISTS(DT_ALIAS(backlight))
+static const struct pwm_dt_spec backlight = PWM_DT_SPEC_GET(DT_ALIAS(backlight));
+#endif
+
+/* Big endian RGB565, the byte order the panel expects */
+static uint16_t stripe[PANEL_WIDTH * STRIPE_LINES];
+
+static const uint8_t *glyph_cols(char c)
+{
+	for (size_t i = 0; i < ARRAY_SIZE(font); i++) {
+		if (font[i].c == c) {
+			return font[i].cols;
+		}
+	}
+
+	return NULL;
+}
+
+/* Text box of w x h pixels at (x, y), unused cells are cleared to the background */
+static int draw_text(uint16_t x, uint16_t y, uint16_t w, uint16_t h, const char *text,
+		     uint8_t scale, uint16_t fg)
+{
+	struct display_buffer_descriptor desc;
+	const uint16_t fg_be = sys_cpu_to_be16(fg);
+	const uint16_t bg_be = sys_cpu_to_be16(COLOR_BG);
+	size_t text_len = strlen(text);
+	int err;
+
+	for (uint16_t y0 = 0; y0 < h; y0 += STRIPE_LINES) {
+		uint16_t lines = MIN(STRIPE_LINES, h - y0);
+		uint16_t *px = stripe;
+
+		for (uint16_t dy = y0; dy < y0 + lines; dy++) {
+			uint8_t glyph_row = dy / scale;
+
+			for (uint16_t dx = 0; dx < w; dx++) {
+				size_t cell = dx / (CELL_W * scale);
+				uint8_t col = (dx % (CELL_W * scale)) / scale;
+				const uint8_t *cols = NULL;
+
+				if (cell < text_len && col < GLYPH_W && glyph_row < GLYPH_H) {
+					cols = glyph_cols(text[cell]);
+				}
+
+				*px++ = (cols != NULL && (cols[col] & BIT(glyph_row))) ? fg_be : bg_be;
+			}
+		}
+
+		desc.buf_size = (size_t)w * lines * sizeof(stripe[0]);
+		desc.width = w;
+		desc.height = lines;
+		desc.pitch = w;
+
+		/* Blocks on the SPIM transfer, the CPU idles until EasyDMA is done */
+		err = display_write(panel, x, y + y0, &desc, stripe);
+		if (err) {
+			return err;
+		}
+	}
+
+	return 0;
+}
+
+static void format_fixed1(char *buf, size_t len, int32_t value_x100)
+{
+	int32_t tenths = (value_x100 + (value_x100 < 0 ? -5 : 5)) / 10;
+
+	snprintk(buf, len, "%s%d.%d", tenths < 0 ? "-" : "", abs(tenths) / 10, abs(tenths) % 10);
+}
+
+static void format_uint(char *buf, size_t len, uint32_t value, bool available)
+{
+	if (available) {
+		snprintk(buf, len, "%u", value);
+	} else {
+		snprintk(buf, len, "--");
+	}
+}
+
+static uint16_t iaq_color(const air_ctrl_sensor_data_t *data)
+{
+	if (data->iaq_acc == 0U) {
+		return COLOR_GREY;
+	}
+
+	if (data->iaq_x10 <= 1000U) {
+		return COLOR_GREEN;
+	}
+
+	return (data->iaq_x10 <= 2000U) ? COLOR_YELLOW : COLOR_RED;
+}
+
+static void row_set(struct row *row, const char *text, uint16_t color)
+{
+	if (row->valid && row->color == color && strcmp(row->text, text) == 0) {
+		return;
+	}
+
+	strncpy(row->text, text, VALUE_CHARS);
+	row->text[VALUE_CHARS] = '\0';
+	row->color = color;
+	row->valid = false;
+}
+
+void air_ctrl_display_update(const air_ctrl_sensor_data_t *data)
+{
+	char text[16];
+	bool bsec = IS_ENABLED(CONFIG_AIR_CTRL_USE_BSEC);
+	int err;
+
+	if (data == NULL) {
+		return;
+	}
+
+	format_fixed1(text, sizeof(text), data->temp_c_x100);
+	row_set(&rows[0], text, COLOR_VALUE);
+
+	format_fixed1(text, sizeof(text), data->hum_rh_x100);
+	row_set(&rows[1], text, COLOR_VALUE);
+
+	/* The raw backend has no IAQ or equivalents */
+	format_uint(text, sizeof(text), data->iaq_x10 / 10U, bsec);
+	row_set(&rows[2], text, bsec ? iaq_color(data) : COLOR_GREY);
+
+	format_uint(text, sizeof(text), data->co2_eq_ppm, bsec);
+	row_set(&rows[3], text, bsec && data->iaq_acc > 0U ? COLOR_VALUE : COLOR_GREY);
+
+	format_uint(text, sizeof(text), data->breath_voc_eq_ppb, bsec);
+	row_set(&rows[4], text, bsec && data->iaq_acc > 0U ? COLOR_VALUE : COLOR_GREY);
+
+	AIR_CTRL_PROF_BEGIN(AIR_CTRL_PROF_DISPLAY);
+	for (size_t i = 0; i < ARRAY_SIZE(rows); i++) {
+		if (rows[i].valid) {
+			continue;
+		}
+
+		err = draw_text(VALUE_X, i * ROW_HEIGHT + (ROW_HEIGHT - VALUE_H) / 2, VALUE_W,
+				VALUE_H, rows[i].text, VALUE_SCALE, rows[i].color);
+		if (err) {
+			LOG_WRN("Display write failed (err %d)", err);
+			break;
+		}
+
+		rows[i].valid = true;
+	}
+	AIR_CTRL_PROF_END(AIR_CTRL_PROF_DISPLAY);
+}
+
+static int backlight_init(void)
+{
+#if DT_NODE_EXISTS(DT_ALIAS(backlight))
+	if (!pwm_is_ready_dt(&backlight)) {
+		return -ENODEV;
+	}
+
+	return pwm_set_pulse_dt(&backlight,
+				backlight.period * CONFIG_AIR_CTRL_DISPLAY_BRIGHTNESS / 100U);
+#else
+	return 0;
+#endif
+}
+
+int air_ctrl_display_init(void)
+{
+	int err;
+
+	if (!device_is_ready(panel)) {
+		LOG_ERR("Display not ready");
+		return -ENODEV;
+	}
+
+	/* Full redraw once: blank every row, then the static labels */
+	for (uint16_t y = 0; y < PANEL_HEIGHT; y += ROW_HEIGHT) {
+		err = draw_text(0, y, PANEL_WIDTH, MIN(ROW_HEIGHT, PANEL_HEIGHT - y), "", 1,
+				COLOR_BG);
+		if (err) {
+			LOG_ERR("Display clear failed (err %d)", err);
+			return err;
+		}
+	}
+
+	for (size_t i = 0; i < ARRAY_SIZE(rows); i++) {
+		err = draw_text(LABEL_X, i * ROW_HEIGHT + (ROW_HEIGHT - GLYPH_H * LABEL_SCALE) / 2,
+				VALUE_X - LABEL_X, GLYPH_H * LABEL_SCALE, rows[i].label,
+				LABEL_SCALE, COLOR_LABEL);
+		if (err) {
+			return err;
+		}
+	}
+
+	err = display_blanking_off(panel);
+	if (err && err != -ENOSYS) {
+		LOG_WRN("Display blanking off failed (err %d)", err);
+	}
+
+	err = backlight_init();
+	if (err) {
+		LOG_WRN("Backlight init failed (err %d)", err);
+	}
+
+	LOG_INF("Display %ux%u, %u line stripes", PANEL_WIDTH, PANEL_HEIGHT, STRIPE_LINES);
+	return 0;
+}
@@ -0,0 +1,32 @@
+#ifndef AIR_CTRL_DISPLAY_H_
+#define AIR_CTRL_DISPLAY_H_
+
+#include "air_ctrl_sensor.h"
+
+/* ST7789V status screen. Pixels are rendered into a stripe buffer of
+ * CONFIG_AIR_CTRL_DISPLAY_STRIPE_LINES lines and sent with SPIM EasyDMA, there is no
+ * framebuffer. Only the value boxes whose text or colour changed are redrawn.
+ */
+
+#if defined(CONFIG_AIR_CTRL_DISPLAY)
+
+int air_ctrl_display_init(void);
+
+/* Called from the main thread for every processed sample */
+void air_ctrl_display_update(const air_ctrl_sensor_data_t *data);
+
+#else
+
+static inline int air_ctrl_display_init(void)
+{
+	return 0;
+}
+
+static inline void air_ctrl_display_update(const air_ctrl_sensor_data_t *data)
+{
+	(void)data;
+}
+
+#endif /* CONFIG_AIR_CTRL_DISPLAY */
+
+#endif /* AIR_CTRL_DISPLAY_H_ */
@@ -0,0 +1,190 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/fs/fcb.h>
+#include <zephyr/storage/flash_map.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "air_ctrl_history.h"
+
+LOG_MODULE_REGISTER(air_ctrl_history, LOG_LEVEL_INF);
+
+#define HISTORY_PARTITION_ID FIXED_PARTITION_ID(history_partition)
+
+#define HISTORY_FCB_MAGIC 0x41514831 /* "AQH1" */
+#define HISTORY_FCB_VERSION 1
+
+#define HISTORY_MAX_SECTORS 16
+
+static struct flash_sector history_sectors[HISTORY_MAX_SECTORS];
+/* Bumped whenever fcb_rotate() erases a sector, so cursors can tell their sector is gone */
+static uint32_t sector_erases[HISTORY_MAX_SECTORS];
+static struct fcb history_fcb;
+static bool history_ready;
+/* Appends (and the rotations they cause) vs. cursor reads */
+static K_MUTEX_DEFINE(history_lock);
+
+static uint32_t *sector_erase_count(const struct flash_sector *sector)
+{
+	return &sector_erases[sector - history_sectors];
+}
+
+static int erase_history_partition(void)
+{
+	const struct flash_area *fa;
+	int err;
+
+	err = flash_area_open(HISTORY_PARTITION_ID, &fa);
+	if (err) {
+		return err;
+	}
+
+	err = flash_area_erase(fa, 0, flash_area_get_size(fa));
+	flash_area_close(fa);
+
+	return err;
+}
+
+int air_ctrl_history_init(void)
+{
+	uint32_t sector_cnt = ARRAY_SIZE(history_sectors);
+	int err;
+
+	err = flash_area_get_sectors(HISTORY_PARTITION_ID, &sector_cnt, history_sectors);
+	if (err) {
+		LOG_ERR("Failed to get history sectors (err %d)", err);
+		return err;
+	}
+
+	history_fcb.f_magic = HISTORY_FCB_MAGIC;
+	history_fcb.f_version = HISTORY_FCB_VERSION;
+	history_fcb.f_sectors = history_sectors;
+	history_fcb.f_sector_cnt = (uint8_t)sector_cnt;
+	history_fcb.f_scratch_cnt = 0;
+
+	err = fcb_init(HISTORY_PARTITION_ID, &history_fcb);
+	if (err) {
+		/* Unknown or corrupted layout: start over with an empty log */
+		LOG_WRN("History FCB init failed (err %d), erasing", err);
+		err = erase_history_partition();
+		if (!err) {
+			err = fcb_init(HISTORY_PARTITION_ID, &history_fcb);
+		}
+		if (err) {
+			LOG_ERR("History FCB init failed (err %d)", err);
+			return err;
+		}
+	}
+
+	history_ready = true;
+	LOG_INF("History log ready (%u sectors, %u free)", sector_cnt, fcb_free_sector_cnt(&history_fcb));
+
+	return 0;
+}
+
+bool air_ctrl_history_is_ready(void)
+{
+	return history_ready;
+}
+
+int air_ctrl_history_append(const void *record, uint16_t len)
+{
+	struct fcb_entry loc;
+	int err;
+
+	if (!history_ready) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&history_lock, K_FOREVER);
+	err = fcb_append(&history_fcb, len, &loc);
+	if (err == -ENOSPC) {
+		/* Ring buffer: drop the oldest sector */
+		(*sector_erase_count(history_fcb.f_oldest))++;
+		err = fcb_rotate(&history_fcb);
+		if (!err) {
+			err = fcb_append(&history_fcb, len, &loc);
+		}
+	}
+	if (!err) {
+		err = flash_area_write(history_fcb.fap, FCB_ENTRY_FA_DATA_OFF(loc), record, len);
+	}
+	if (!err) {
+		err = fcb_append_finish(&history_fcb, &loc);
+	}
+	k_mutex_unlock(&history_lock);
+
+	return err;
+}
+
+void air_ctrl_history_cursor_init(air_ctrl_history_cursor_t *cursor)
+{
+	memset(cursor, 0, sizeof(*cursor));
+}
+
+static int read_entry(struct fcb_entry *loc, void *record, uint16_t max_len)
+{
+	int err;
+
+	if (loc->fe_data_len > max_len) {
+		return -EMSGSIZE;
+	}
+
+	err = flash_area_read(history_fcb.fap, FCB_ENTRY_FA_DATA_OFF((*loc)), record,
+			      loc->fe_data_len);
+	if (err) {
+		return err;
+	}
+
+	return loc->fe_data_len;
+}
+
+int air_ctrl_history_read_next(air_ctrl_history_cursor_t *cursor, void *record, uint16_t max_len)
+{
+	int err;
+
+	if (!history_ready) {
+		return -ENODEV;
+	}
+
+	k_mutex_lock(&history_lock, K_FOREVER);
+	if (cursor->loc.fe_sector != NULL &&
+	    *sector_erase_count(cursor->loc.fe_sector) != cursor->sector_erases) {
+		/* Everything after the erased sector is newer, so nothing unread is skipped */
+		LOG_WRN("History rotated under a reader, continuing at the oldest record");
+		memset(&cursor->loc, 0, sizeof(cursor->loc));
+	}
+
+	err = fcb_getnext(&history_fcb, &cursor->loc);
+	if (err) {
+		err = -ENOENT;
+	} else {
+		cursor->sector_erases = *sector_erase_count(cursor->loc.fe_sector);
+		err = read_entry(&cursor->loc, record, max_len);
+	}
+	k_mutex_unlock(&history_lock);
+
+	return err;
+}
+
+int air_ctrl_history_read_last(void *record, uint16_t max_len)
+{
+	struct fcb_entry loc;
+	int err;
+
+	if (!history_ready) {
+		return -ENODEV;
+	}
+
+	memset(&loc, 0, sizeof(loc));
+	k_mutex_lock(&history_lock, K_FOREVER);
+	if (fcb_offset_last_n(&history_fcb, 1, &loc) != 0) {
+		err = -ENOENT;
+	} else {
+		err = read_entry(&loc, record, max_len);
+	}
+	k_mutex_unlock(&history_lock);
+
+	return err;
+}
@@ -0,0 +1,35 @@
+#ifndef AIR_CTRL_HISTORY_H_
+#define AIR_CTRL_HISTORY_H_
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <zephyr/fs/fcb.h>
+
+/* Position in the history log, start with air_ctrl_history_cursor_init() */
+typedef struct {
+    struct fcb_entry loc;
+    /* Erase count of loc's sector when the cursor moved there */
+    uint32_t sector_erases;
+} air_ctrl_history_cursor_t;
+
+int air_ctrl_history_init(void);
+
+/* False until air_ctrl_history_init() succeeded, reads and appends then fail with -ENODEV */
+bool air_ctrl_history_is_ready(void);
+
+/* Append one record. The oldest sector is erased when the log is full. */
+int air_ctrl_history_append(const void *record, uint16_t len);
+
+void air_ctrl_history_cursor_init(air_ctrl_history_cursor_t *cursor);
+
+/* Read the record after the cursor and advance it. If the log rotated the cursor's sector
+ * away in the meantime, reading continues at the oldest record still stored.
+ * Returns the record length, -ENOENT at the end of the log or another negative errno.
+ */
+int air_ctrl_history_read_next(air_ctrl_history_cursor_t *cursor, void *record, uint16_t max_len);
+
+/* Read the newest record. Returns its length or -ENOENT if the log is empty. */
+int air_ctrl_history_read_last(void *record, uint16_t max_len);
+
+#endif /* AIR_CTRL_HISTORY_H_ */
@@ -0,0 +1,82 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+
+#include <errno.h>
+
+#include "air_ctrl_pipeline.h"
+#include "air_ctrl_sched.h"
+#include "air_ctrl_sensor.h"
+
+LOG_MODULE_REGISTER(air_ctrl_pipeline, LOG_LEVEL_INF);
+
+/* Used when the sensor backend has no future deadline (e.g. after a failed BSEC call) */
+#define SENSOR_RETRY_NS (100LL * 1000000LL)
+
+K_MSGQ_DEFINE(sample_msgq, sizeof(air_ctrl_sensor_data_t), CONFIG_AIR_CTRL_SAMPLE_QUEUE_LEN, 4);
+
+K_THREAD_STACK_DEFINE(sensor_stack, CONFIG_AIR_CTRL_SENSOR_THREAD_STACK_SIZE);
+static struct k_thread sensor_thread;
+
+static uint32_t dropped_samples;
+
+static void queue_sample(const air_ctrl_sensor_data_t *sample)
+{
+	air_ctrl_sensor_data_t stale;
+
+	/* Keep the freshest data if the consumer falls behind */
+	while (k_msgq_put(&sample_msgq, sample, K_NO_WAIT) != 0) {
+		(void)k_msgq_get(&sample_msgq, &stale, K_NO_WAIT);
+		dropped_samples++;
+		LOG_WRN("Sample queue full, dropped oldest (total %u)", dropped_samples);
+	}
+}
+
+static void sensor_thread_fn(void *p1, void *p2, void *p3)
+{
+	air_ctrl_sensor_raw_t raw[AIR_CTRL_SENSOR_MAX_RAW];
+	air_ctrl_sensor_data_t sample;
+	int64_t deadline_ns;
+	int64_t now_ns;
+	int n_raw;
+
+	ARG_UNUSED(p1);
+	ARG_UNUSED(p2);
+	ARG_UNUSED(p3);
+
+	while (true) {
+		n_raw = air_ctrl_sensor_acquire(raw, ARRAY_SIZE(raw));
+		if (n_raw > 0 && air_ctrl_sensor_process(raw, n_raw, &sample)) {
+			queue_sample(&sample);
+		}
+
+		deadline_ns = air_ctrl_sensor_get_next_call_ns();
+		now_ns = air_ctrl_sensor_get_timestamp_ns();
+		if (deadline_ns <= now_ns) {
+			deadline_ns = now_ns + SENSOR_RETRY_NS;
+		}
+
+		(void)air_ctrl_sched_wait_until(deadline_ns);
+	}
+}
+
+int air_ctrl_pipeline_start(void)
+{
+	k_tid_t tid;
+
+	tid = k_thread_create(&sensor_thread, sensor_stack, K_THREAD_STACK_SIZEOF(sensor_stack),
+			      sensor_thread_fn, NULL, NULL, NULL,
+			      CONFIG_AIR_CTRL_SENSOR_THREAD_PRIORITY,
+			      IS_ENABLED(CONFIG_AIR_CTRL_USE_BSEC) ? K_FP_REGS : 0, K_NO_WAIT);
+	k_thread_name_set(tid, "air_ctrl_sensor");
+
+	return 0;
+}
+
+int air_ctrl_pipeline_get(air_ctrl_sensor_data_t *sample, k_timeout_t timeout)
+{
+	if (sample == NULL) {
+		return -EINVAL;
+	}
+
+	return k_msgq_get(&sample_msgq, sample, timeout);
+}
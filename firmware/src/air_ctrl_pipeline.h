@@ -0,0 +1,16 @@
+#ifndef AIR_CTRL_PIPELINE_H_
+#define AIR_CTRL_PIPELINE_H_
+
+#include <zephyr/kernel.h>
+
+#include "air_ctrl_sensor.h"
+
+/* Start the sensor thread. It sleeps until each sensor deadline, runs the
+ * acquisition and processing stages and queues the finished samples.
+ */
+int air_ctrl_pipeline_start(void);
+
+/* Take the next processed sample. Returns 0 on success, -EAGAIN on timeout. */
+int air_ctrl_pipeline_get(air_ctrl_sensor_data_t *sample, k_timeout_t timeout);
+
+#endif /* AIR_CTRL_PIPELINE_H_ */
@@ -0,0 +1,241 @@
+#include <zephyr/kernel.h>
+#include <zephyr/device.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/drivers/sensor/bme680.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/pm/device.h>
+#include <zephyr/pm/device_runtime.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/util.h>
+
+#include <errno.h>
+#include <stdbool.h>
+#include <string.h>
+
+#include "air_ctrl_power.h"
+
+LOG_MODULE_REGISTER(air_ctrl_power, LOG_LEVEL_INF);
+
+#define SENSOR_NODE DT_INST(0, bosch_bme680)
+
+static const struct device *const sensor = DEVICE_DT_GET(SENSOR_NODE);
+static const struct device *const bus = DEVICE_DT_GET(DT_BUS(SENSOR_NODE));
+
+static const char *const state_names[AIR_CTRL_POWER_STATE_COUNT] = {
+	[AIR_CTRL_POWER_CPU_ACTIVE] = "cpu_active",
+	[AIR_CTRL_POWER_CPU_IDLE] = "cpu_idle",
+	[AIR_CTRL_POWER_SENSOR_ACTIVE] = "sensor_active",
+	[AIR_CTRL_POWER_SENSOR_SUSPENDED] = "sensor_suspended",
+};
+
+static struct k_spinlock power_lock;
+
+/* Sensor residency, in ticks so short measurements are not rounded away */
+static bool sensor_on;
+static int64_t sensor_active_ticks;
+static int64_t sensor_resumed_at;
+static int64_t stats_reset_at;
+static uint32_t sensor_resumes;
+static uint32_t sensor_errors;
+
+/* CPU counters at the last reset, the kernel ones only count up */
+static uint64_t cpu_active_base;
+static uint64_t cpu_idle_base;
+
+int air_ctrl_power_sensor_get(void)
+{
+	k_spinlock_key_t key;
+	int err;
+
+	/* Parent first: the sensor's PM action talks over the bus */
+	err = pm_device_runtime_get(bus);
+	if (err == 0) {
+		err = pm_device_runtime_get(sensor);
+		if (err) {
+			(void)pm_device_runtime_put(bus);
+		}
+	}
+
+	key = k_spin_lock(&power_lock);
+	if (err) {
+		sensor_errors++;
+	} else {
+		sensor_resumes++;
+		sensor_on = true;
+		sensor_resumed_at = k_uptime_ticks();
+	}
+	k_spin_unlock(&power_lock, key);
+
+	if (err) {
+		LOG_ERR("Failed to resume sensor (err %d)", err);
+	}
+
+	return err;
+}
+
+void air_ctrl_power_sensor_put(void)
+{
+	k_spinlock_key_t key;
+
+	if (!sensor_on) {
+		/* The matching get failed */
+		return;
+	}
+
+	(void)pm_device_runtime_put(sensor);
+	(void)pm_device_runtime_put(bus);
+
+	key = k_spin_lock(&power_lock);
+	sensor_active_ticks += k_uptime_ticks() - sensor_resumed_at;
+	sensor_on = false;
+	k_spin_unlock(&power_lock, key);
+}
+
+static void cpu_cycles(uint64_t *active, uint64_t *idle)
+{
+	k_thread_runtime_stats_t rt;
+
+	if (k_thread_runtime_stats_all_get(&rt) != 0) {
+		*active = 0;
+		*idle = 0;
+		return;
+	}
+
+	/* total_cycles only counts non-idle threads */
+	*active = rt.total_cycles;
+	*idle = rt.idle_cycles;
+}
+
+void air_ctrl_power_get_stats(air_ctrl_power_stats_t *stats)
+{
+	struct bme680_poll_stats polls = {0};
+	uint64_t active;
+	uint64_t idle;
+	int64_t now;
+	int64_t sensor_ticks;
+	k_spinlock_key_t key;
+
+	cpu_cycles(&active, &idle);
+	(void)bme680_get_poll_stats(sensor, &polls);
+
+	key = k_spin_lock(&power_lock);
+	now = k_uptime_ticks();
+	sensor_ticks = sensor_active_ticks;
+	if (sensor_on) {
+		sensor_ticks += now - sensor_resumed_at;
+	}
+
+	memset(stats, 0, sizeof(*stats));
+	stats->residency_us[AIR_CTRL_POWER_CPU_ACTIVE] = k_cyc_to_us_floor64(active - cpu_active_base);
+	stats->residency_us[AIR_CTRL_POWER_CPU_IDLE] = k_cyc_to_us_floor64(idle - cpu_idle_base);
+	stats->residency_us[AIR_CTRL_POWER_SENSOR_ACTIVE] = k_ticks_to_us_floor64(sensor_ticks);
+	stats->residency_us[AIR_CTRL_POWER_SENSOR_SUSPENDED] =
+		k_ticks_to_us_floor64(now - stats_reset_at - sensor_ticks);
+	stats->sensor_resumes = sensor_resumes;
+	stats->sensor_errors = sensor_errors;
+	k_spin_unlock(&power_lock, key);
+
+	stats->sensor_status_polls = polls.status_polls;
+	stats->sensor_polls_saved = polls.polls_saved;
+}
+
+void air_ctrl_power_reset_stats(void)
+{
+	uint64_t active;
+	uint64_t idle;
+	k_spinlock_key_t key;
+
+	cpu_cycles(&active, &idle);
+
+	key = k_spin_lock(&power_lock);
+	cpu_active_base = active;
+	cpu_idle_base = idle;
+	stats_reset_at = k_uptime_ticks();
+	sensor_active_ticks = 0;
+	if (sensor_on) {
+		sensor_resumed_at = stats_reset_at;
+	}
+	sensor_resumes = 0;
+	sensor_errors = 0;
+	k_spin_unlock(&power_lock, key);
+}
+
+const char *air_ctrl_power_state_name(enum air_ctrl_power_state state)
+{
+	return (state < AIR_CTRL_POWER_STATE_COUNT) ? state_names[state] : "?";
+}
+
+/* Drivers are up (the BME688 read its calibration), from here on the bus only runs on demand */
+static int power_init(void)
+{
+	int err;
+
+	err = pm_device_runtime_enable(bus);
+	if (err && err != -ENOTSUP) {
+		LOG_ERR("Runtime PM for %s failed (err %d)", bus->name, err);
+	}
+
+	/* The BME688 sleeps by itself after each forced conversion, this is a no-op unless the
+	 * driver implements PM
+	 */
+	err = pm_device_runtime_enable(sensor);
+	if (err && err != -ENOTSUP) {
+		LOG_ERR("Runtime PM for %s failed (err %d)", sensor->name, err);
+	}
+
+	return 0;
+}
+
+SYS_INIT(power_init, APPLICATION, 0);
+
+#if defined(CONFIG_SHELL)
+static int cmd_power_show(const struct shell *sh, size_t argc, char **argv)
+{
+	air_ctrl_power_stats_t stats;
+	uint64_t cpu_total;
+	uint64_t sensor_total;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	air_ctrl_power_get_stats(&stats);
+	cpu_total = MAX(stats.residency_us[AIR_CTRL_POWER_CPU_ACTIVE] +
+			stats.residency_us[AIR_CTRL_POWER_CPU_IDLE], 1U);
+	sensor_total = MAX(stats.residency_us[AIR_CTRL_POWER_SENSOR_ACTIVE] +
+			   stats.residency_us[AIR_CTRL_POWER_SENSOR_SUSPENDED], 1U);
+
+	for (int i = 0; i < AIR_CTRL_POWER_STATE_COUNT; i++) {
+		uint64_t total = (i <= AIR_CTRL_POWER_CPU_IDLE) ? cpu_total : sensor_total;
+
+		shell_print(sh, "%-18s %12llu us %5u.%u %%", state_names[i], stats.residency_us[i],
+			    (uint32_t)(stats.residency_us[i] * 100U / total),
+			    (uint32_t)(stats.residency_us[i] * 1000U / total % 10U));
+	}
+	shell_print(sh, "sensor resumes: %u, errors: %u", stats.sensor_resumes,
+		    stats.sensor_errors);
+	shell_print(sh, "sensor status polls: %u, saved by sleeping: %u", stats.sensor_status_polls,
+		    stats.sensor_polls_saved);
+
+	return 0;
+}
+
+static int cmd_power_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	air_ctrl_power_reset_stats();
+	shell_print(sh, "Power residency counters cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_power,
+	SHELL_CMD(show, NULL, "Residency per power state", cmd_power_show),
+	SHELL_CMD(reset, NULL, "Clear the residency counters", cmd_power_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(power, &sub_power, "Power state residency", cmd_power_show);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,60 @@
+#ifndef AIR_CTRL_POWER_H_
+#define AIR_CTRL_POWER_H_
+
+#include <stdint.h>
+
+/* Runtime PM of the BME688 and its I2C bus, plus residency accounting. The bus is only
+ * resumed between air_ctrl_power_sensor_get() and _put(); in between samples it is
+ * suspended (TWIM off, pins in the sleep pinctrl state) and the tickless kernel idles
+ * until the next deadline.
+ */
+
+enum air_ctrl_power_state {
+	AIR_CTRL_POWER_CPU_ACTIVE,
+	AIR_CTRL_POWER_CPU_IDLE,
+	AIR_CTRL_POWER_SENSOR_ACTIVE,
+	AIR_CTRL_POWER_SENSOR_SUSPENDED,
+	AIR_CTRL_POWER_STATE_COUNT,
+};
+
+typedef struct {
+	/* Time spent in each state since boot (or the last reset) */
+	uint64_t residency_us[AIR_CTRL_POWER_STATE_COUNT];
+	uint32_t sensor_resumes;
+	uint32_t sensor_errors;
+	/* From the patched driver, since boot: status reads done while waiting for a
+	 * conversion, and the ones avoided by sleeping for its computed duration
+	 */
+	uint32_t sensor_status_polls;
+	uint32_t sensor_polls_saved;
+} air_ctrl_power_stats_t;
+
+#if defined(CONFIG_AIR_CTRL_POWER)
+
+/* Resume the sensor and its bus for one measurement. Always pair with
+ * air_ctrl_power_sensor_put(), also when this fails.
+ */
+int air_ctrl_power_sensor_get(void);
+
+void air_ctrl_power_sensor_put(void);
+
+void air_ctrl_power_get_stats(air_ctrl_power_stats_t *stats);
+
+void air_ctrl_power_reset_stats(void);
+
+const char *air_ctrl_power_state_name(enum air_ctrl_power_state state);
+
+#else
+
+static inline int air_ctrl_power_sensor_get(void)
+{
+	return 0;
+}
+
+static inline void air_ctrl_power_sensor_put(void)
+{
+}
+
+#endif /* CONFIG_AIR_CTRL_POWER */
+
+#endif /* AIR_CTRL_POWER_H_ */
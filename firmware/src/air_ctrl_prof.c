@@ -0,0 +1,260 @@
+#include <zephyr/kernel.h>
+#include <zephyr/devicetree.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/spinlock.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/util.h>
+
+#if defined(CONFIG_CORTEX_M_DWT)
+#include <cmsis_core.h>
+#endif
+
+#include <string.h>
+
+#include "air_ctrl_ble_codec.h"
+#include "air_ctrl_prof.h"
+#include "air_ctrl_sched.h"
+
+LOG_MODULE_REGISTER(air_ctrl_prof, LOG_LEVEL_INF);
+
+struct prof_stage {
+	uint32_t count;
+	uint32_t min_us;
+	uint32_t max_us;
+	uint64_t total_us;
+	uint32_t cpu_max_cycles;
+	uint64_t cpu_total_cycles;
+	uint32_t hist[AIR_CTRL_PROF_HIST_BUCKETS];
+};
+
+static struct prof_stage stages[AIR_CTRL_PROF_STAGE_COUNT];
+static struct k_spinlock prof_lock;
+
+static const char *const stage_names[AIR_CTRL_PROF_STAGE_COUNT] = {
+	[AIR_CTRL_PROF_SENSOR_FETCH] = "sensor_fetch",
+	[AIR_CTRL_PROF_BSEC_CONTROL] = "bsec_control",
+	[AIR_CTRL_PROF_BSEC_DO_STEPS] = "bsec_do_steps",
+	[AIR_CTRL_PROF_BSEC_STATE_SAVE] = "bsec_state_save",
+	[AIR_CTRL_PROF_BT_NOTIFY] = "bt_notify",
+	[AIR_CTRL_PROF_DISPLAY] = "display",
+};
+
+static uint32_t cpu_cycles(void)
+{
+#if defined(CONFIG_CORTEX_M_DWT)
+	return DWT->CYCCNT;
+#else
+	return k_cycle_get_32();
+#endif
+}
+
+struct air_ctrl_prof_mark air_ctrl_prof_mark(void)
+{
+	return (struct air_ctrl_prof_mark){
+		.cycles = cpu_cycles(),
+		.wall = k_cycle_get_32(),
+	};
+}
+
+static uint32_t cpu_cycles_to_us(uint64_t cycles)
+{
+#if defined(CONFIG_CORTEX_M_DWT)
+	/* CYCCNT runs at the CPU clock */
+	return (uint32_t)(cycles / (DT_PROP(DT_PATH(cpus, cpu_0), clock_frequency) / 1000000U));
+#else
+	return (uint32_t)k_cyc_to_us_floor64(cycles);
+#endif
+}
+
+void air_ctrl_prof_record(enum air_ctrl_prof_stage stage, const struct air_ctrl_prof_mark *start)
+{
+	uint32_t cycles = cpu_cycles() - start->cycles;
+	uint32_t us = (uint32_t)k_cyc_to_us_floor64(k_cycle_get_32() - start->wall);
+	uint32_t bucket = (us < 2U) ? 0U : MIN(31U - __builtin_clz(us), AIR_CTRL_PROF_HIST_BUCKETS - 1U);
+	struct prof_stage *s = &stages[stage];
+	k_spinlock_key_t key = k_spin_lock(&prof_lock);
+
+	if (s->count == 0U || us < s->min_us) {
+		s->min_us = us;
+	}
+	s->max_us = MAX(s->max_us, us);
+	s->total_us += us;
+	s->cpu_max_cycles = MAX(s->cpu_max_cycles, cycles);
+	s->cpu_total_cycles += cycles;
+	s->count++;
+	s->hist[bucket]++;
+
+	k_spin_unlock(&prof_lock, key);
+}
+
+void air_ctrl_prof_get(enum air_ctrl_prof_stage stage, air_ctrl_prof_stats_t *stats)
+{
+	k_spinlock_key_t key = k_spin_lock(&prof_lock);
+	const struct prof_stage *s = &stages[stage];
+
+	stats->count = s->count;
+	stats->min_us = s->min_us;
+	stats->max_us = s->max_us;
+	stats->mean_us = (s->count > 0U) ? (uint32_t)(s->total_us / s->count) : 0U;
+	stats->cpu_max_us = cpu_cycles_to_us(s->cpu_max_cycles);
+	stats->cpu_mean_us = (s->count > 0U) ? cpu_cycles_to_us(s->cpu_total_cycles / s->count) : 0U;
+	memcpy(stats->hist, s->hist, sizeof(stats->hist));
+
+	k_spin_unlock(&prof_lock, key);
+}
+
+void air_ctrl_prof_reset(void)
+{
+	k_spinlock_key_t key = k_spin_lock(&prof_lock);
+
+	memset(stages, 0, sizeof(stages));
+
+	k_spin_unlock(&prof_lock, key);
+}
+
+const char *air_ctrl_prof_stage_name(enum air_ctrl_prof_stage stage)
+{
+	return (stage < AIR_CTRL_PROF_STAGE_COUNT) ? stage_names[stage] : "?";
+}
+
+/*
+ * version (AIR_CTRL_BLE_VERSION_DIAG), stage count (1), then per stage: count, min_us, max_us, mean_us (wall time),
+ * cpu_max_us, cpu_mean_us (u32 each) and the wall time histogram as u16 counters that
+ * saturate at 0xffff.
+ */
+size_t air_ctrl_prof_encode(uint8_t *buf, size_t len)
+{
+	air_ctrl_prof_stats_t stats;
+	size_t pos = 2;
+
+	if (len < 2) {
+		return 0;
+	}
+
+	buf[0] = AIR_CTRL_BLE_VERSION_DIAG;
+	buf[1] = AIR_CTRL_PROF_STAGE_COUNT;
+
+	for (int i = 0; i < AIR_CTRL_PROF_STAGE_COUNT; i++) {
+		if (pos + AIR_CTRL_PROF_STAGE_LEN > len) {
+			break;
+		}
+
+		air_ctrl_prof_get(i, &stats);
+		sys_put_le32(stats.count, &buf[pos]);
+		sys_put_le32(stats.min_us, &buf[pos + 4]);
+		sys_put_le32(stats.max_us, &buf[pos + 8]);
+		sys_put_le32(stats.mean_us, &buf[pos + 12]);
+		sys_put_le32(stats.cpu_max_us, &buf[pos + 16]);
+		sys_put_le32(stats.cpu_mean_us, &buf[pos + 20]);
+		pos += 24U;
+
+		for (int b = 0; b < AIR_CTRL_PROF_HIST_BUCKETS; b++) {
+			sys_put_le16((uint16_t)MIN(stats.hist[b], UINT16_MAX), &buf[pos]);
+			pos += 2U;
+		}
+	}
+
+	return pos;
+}
+
+static int prof_init(void)
+{
+#if defined(CONFIG_CORTEX_M_DWT)
+	CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+	DWT->CYCCNT = 0;
+	DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+#endif
+	return 0;
+}
+
+SYS_INIT(prof_init, APPLICATION, 0);
+
+#if defined(CONFIG_SHELL)
+static int cmd_prof_show(const struct shell *sh, size_t argc, char **argv)
+{
+	air_ctrl_prof_stats_t stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	/* Wall time, then CPU time (without sleep) */
+	shell_print(sh, "%-16s %8s %10s %10s %10s %11s %11s", "stage", "count", "min_us", "mean_us",
+		    "max_us", "cpu_mean_us", "cpu_max_us");
+
+	for (int i = 0; i < AIR_CTRL_PROF_STAGE_COUNT; i++) {
+		air_ctrl_prof_get(i, &stats);
+		shell_print(sh, "%-16s %8u %10u %10u %10u %11u %11u", stage_names[i], stats.count,
+			    stats.min_us, stats.mean_us, stats.max_us, stats.cpu_mean_us,
+			    stats.cpu_max_us);
+	}
+
+	return 0;
+}
+
+static int cmd_prof_hist(const struct shell *sh, size_t argc, char **argv)
+{
+	air_ctrl_prof_stats_t stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	for (int i = 0; i < AIR_CTRL_PROF_STAGE_COUNT; i++) {
+		air_ctrl_prof_get(i, &stats);
+		if (stats.count == 0U) {
+			continue;
+		}
+
+		shell_print(sh, "%s:", stage_names[i]);
+		for (int b = 0; b < AIR_CTRL_PROF_HIST_BUCKETS; b++) {
+			if (stats.hist[b] > 0U) {
+				shell_print(sh, "  >= %7u us: %u", (b == 0) ? 0U : BIT(b),
+					    stats.hist[b]);
+			}
+		}
+	}
+
+	return 0;
+}
+
+/* How late the sensor thread woke up for its deadlines */
+static int cmd_prof_sched(const struct shell *sh, size_t argc, char **argv)
+{
+	air_ctrl_sched_stats_t stats;
+
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	air_ctrl_sched_get_stats(&stats);
+	shell_print(sh, "wakeups %u, early (kicked) %u", stats.wakeups, stats.early_wakeups);
+	if (stats.wakeups > 0U) {
+		shell_print(sh, "late_us: last %lld, mean %lld, max %lld",
+			    (long long)(stats.last_late_ns / 1000LL),
+			    (long long)(stats.total_late_ns / stats.wakeups / 1000LL),
+			    (long long)(stats.max_late_ns / 1000LL));
+	}
+
+	return 0;
+}
+
+static int cmd_prof_reset(const struct shell *sh, size_t argc, char **argv)
+{
+	ARG_UNUSED(argc);
+	ARG_UNUSED(argv);
+
+	air_ctrl_prof_reset();
+	shell_print(sh, "Profiling counters cleared");
+
+	return 0;
+}
+
+SHELL_STATIC_SUBCMD_SET_CREATE(sub_prof,
+	SHELL_CMD(show, NULL, "Per-stage wall and CPU time", cmd_prof_show),
+	SHELL_CMD(hist, NULL, "Per-stage wall time histograms", cmd_prof_hist),
+	SHELL_CMD(sched, NULL, "Sensor thread wake-up lateness", cmd_prof_sched),
+	SHELL_CMD(reset, NULL, "Clear all counters", cmd_prof_reset),
+	SHELL_SUBCMD_SET_END
+);
+
+SHELL_CMD_REGISTER(prof, &sub_prof, "Sample pipeline profiling", cmd_prof_show);
+#endif /* CONFIG_SHELL */
@@ -0,0 +1,76 @@
+#ifndef AIR_CTRL_PROF_H_
+#define AIR_CTRL_PROF_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Per-stage timing. Each stage records its wall time (k_cycle_get_32()) and its CPU time
+ * (DWT CYCCNT on Cortex-M). CYCCNT stops while the core sleeps in WFI, so the two only differ
+ * for stages that block, such as the sensor fetch waiting for a conversion. Without DWT both
+ * are wall time. With CONFIG_AIR_CTRL_PROF=n the AIR_CTRL_PROF_* macros expand to nothing and
+ * this module is not built.
+ */
+
+enum air_ctrl_prof_stage {
+	AIR_CTRL_PROF_SENSOR_FETCH,
+	AIR_CTRL_PROF_BSEC_CONTROL,
+	AIR_CTRL_PROF_BSEC_DO_STEPS,
+	AIR_CTRL_PROF_BSEC_STATE_SAVE,
+	AIR_CTRL_PROF_BT_NOTIFY,
+	AIR_CTRL_PROF_DISPLAY,
+	AIR_CTRL_PROF_STAGE_COUNT,
+};
+
+/* Histogram bucket i counts wall times in [2^i, 2^(i+1)) us (bucket 0 from 0 us), the last
+ * bucket everything above
+ */
+#define AIR_CTRL_PROF_HIST_BUCKETS 20
+
+/* Encoded size of one stage and of the whole diagnostics record */
+#define AIR_CTRL_PROF_STAGE_LEN (24 + 2 * AIR_CTRL_PROF_HIST_BUCKETS)
+#define AIR_CTRL_PROF_ENCODED_LEN (2 + AIR_CTRL_PROF_STAGE_COUNT * AIR_CTRL_PROF_STAGE_LEN)
+
+typedef struct {
+	uint32_t count;
+	/* Wall time */
+	uint32_t min_us;
+	uint32_t max_us;
+	uint32_t mean_us;
+	/* CPU time, without the time spent sleeping */
+	uint32_t cpu_max_us;
+	uint32_t cpu_mean_us;
+	uint32_t hist[AIR_CTRL_PROF_HIST_BUCKETS];
+} air_ctrl_prof_stats_t;
+
+/* Start of a timed stage */
+struct air_ctrl_prof_mark {
+	uint32_t cycles;
+	uint32_t wall;
+};
+
+#if defined(CONFIG_AIR_CTRL_PROF)
+
+struct air_ctrl_prof_mark air_ctrl_prof_mark(void);
+
+void air_ctrl_prof_record(enum air_ctrl_prof_stage stage, const struct air_ctrl_prof_mark *start);
+
+void air_ctrl_prof_get(enum air_ctrl_prof_stage stage, air_ctrl_prof_stats_t *stats);
+
+void air_ctrl_prof_reset(void);
+
+const char *air_ctrl_prof_stage_name(enum air_ctrl_prof_stage stage);
+
+/* Wire format of the diagnostics characteristic, returns the length written */
+size_t air_ctrl_prof_encode(uint8_t *buf, size_t len);
+
+#define AIR_CTRL_PROF_BEGIN(stage) const struct air_ctrl_prof_mark _prof_##stage = air_ctrl_prof_mark()
+#define AIR_CTRL_PROF_END(stage) air_ctrl_prof_record(stage, &_prof_##stage)
+
+#else
+
+#define AIR_CTRL_PROF_BEGIN(stage) do { } while (0)
+#define AIR_CTRL_PROF_END(stage) do { } while (0)
+
+#endif /* CONFIG_AIR_CTRL_PROF */
+
+#endif /* AIR_CTRL_PROF_H_ */
@@ -0,0 +1,216 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/settings/settings.h>
+#include <zephyr/shell/shell.h>
+#include <zephyr/sys/util.h>
+
+#include <errno.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "air_ctrl_rate.h"
+
+LOG_MODULE_REGISTER(air_ctrl_rate, LOG_LEVEL_INF);
+
+#define QUIET_MS ((uint32_t)CONFIG_AIR_CTRL_RATE_QUIET_MIN * 60U * 1000U)
+
+static const char *const policy_names[AIR_CTRL_RATE_POLICY_COUNT] = {
+	[AIR_CTRL_RATE_POLICY_AUTO] = "auto",
+	[AIR_CTRL_RATE_POLICY_LP] = "lp",
+	[AIR_CTRL_RATE_POLICY_ULP] = "ulp",
+};
+
+static struct k_spinlock rate_lock;
+static enum air_ctrl_rate_policy policy;
+static bool link_up;
+static bool quiet;
+
+/* Main thread only: the sample the bands are centred on and when it was taken */
+static struct {
+	bool valid;
+	uint64_t since_ms;
+	int32_t temp_c_x100;
+	int32_t hum_rh_x100;
+	int32_t iaq_x10;
+	int32_t co2_eq_ppm;
+} ref;
+
+static void rate_apply(void)
+{
+	enum air_ctrl_sensor_rate rate;
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&rate_lock);
+	switch (policy) {
+	case AIR_CTRL_RATE_POLICY_LP:
+		rate = AIR_CTRL_SENSOR_RATE_LP;
+		break;
+	case AIR_CTRL_RATE_POLICY_ULP:
+		rate = AIR_CTRL_SENSOR_RATE_ULP;
+		break;
+	default:
+		rate = (link_up || !quiet) ? AIR_CTRL_SENSOR_RATE_LP : AIR_CTRL_SENSOR_RATE_ULP;
+		break;
+	}
+	k_spin_unlock(&rate_lock, key);
+
+	/* Only wakes the sensor thread when the rate actually changes */
+	(void)air_ctrl_sensor_set_rate(rate);
+}
+
+static bool outside(int32_t value, int32_t center, int32_t width)
+{
+	return abs(value - center) > width;
+}
+
+void air_ctrl_rate_update(const air_ctrl_sensor_data_t *data)
+{
+	bool changed;
+	bool now_quiet;
+	k_spinlock_key_t key;
+
+	changed = !ref.valid ||
+		  outside(data->raw_temp_c_x100, ref.temp_c_x100,
+			  CONFIG_AIR_CTRL_RATE_BAND_TEMP_X100) ||
+		  outside(data->raw_hum_rh_x100, ref.hum_rh_x100,
+			  CONFIG_AIR_CTRL_RATE_BAND_HUM_X100) ||
+		  outside(data->iaq_x10, ref.iaq_x10, CONFIG_AIR_CTRL_RATE_BAND_IAQ_X10) ||
+		  outside(data->co2_eq_ppm, ref.co2_eq_ppm, CONFIG_AIR_CTRL_RATE_BAND_CO2_PPM);
+
+	if (changed) {
+		ref.valid = true;
+		ref.since_ms = data->timestamp_ms;
+		ref.temp_c_x100 = data->raw_temp_c_x100;
+		ref.hum_rh_x100 = data->raw_hum_rh_x100;
+		ref.iaq_x10 = data->iaq_x10;
+		ref.co2_eq_ppm = data->co2_eq_ppm;
+	}
+
+	now_quiet = !changed && (data->timestamp_ms - ref.since_ms) >= QUIET_MS;
+
+	key = k_spin_lock(&rate_lock);
+	if (now_quiet != quiet) {
+		LOG_INF("Air %s", now_quiet ? "quiet" : "changing");
+	}
+	quiet = now_quiet;
+	k_spin_unlock(&rate_lock, key);
+
+	rate_apply();
+}
+
+void air_ctrl_rate_link_changed(bool connected)
+{
+	k_spinlock_key_t key;
+
+	key = k_spin_lock(&rate_lock);
+	link_up = connected;
+	k_spin_unlock(&rate_lock, key);
+
+	rate_apply();
+}
+
+#if defined(CONFIG_SETTINGS)
+static void policy_save_work_handler(struct k_work *work)
+{
+	uint8_t value = (uint8_t)policy;
+	int err;
+
+	ARG_UNUSED(work);
+
+	err = settings_save_one("air_ctrl/rate/policy", &value, sizeof(value));
+	if (err) {
+		/* Still applies until the next reboot */
+		LOG_WRN("Failed to save the rate policy (err %d)", err);
+	}
+}
+
+/* The policy is set from a GATT write, so the flash write runs on the system workqueue
+ * instead of the BT RX thread. Back-to-back writes end up in one save of the latest policy.
+ */
+static K_WORK_DEFINE(policy_save_work, policy_save_work_handler);
+#endif /* CONFIG_SETTINGS */
+
+int air_ctrl_rate_set_policy(enum air_ctrl_rate_policy new_policy)
+{
+	k_spinlock_key_t key;
+
+	if (new_policy >= AIR_CTRL_RATE_POLICY_COUNT) {
+		return -EINVAL;
+	}
+
+	key = k_spin_lock(&rate_lock);
+	policy = new_policy;
+	k_spin_unlock(&rate_lock, key);
+
+	LOG_INF("Sample rate policy %s", policy_names[new_policy]);
+	rate_apply();
+
+#if defined(CONFIG_SETTINGS)
+	(void)k_work_submit(&policy_save_work);
+#endif
+
+	return 0;
+}
+
+enum air_ctrl_rate_policy air_ctrl_rate_get_policy(void)
+{
+	return policy;
+}
+
+#if defined(CONFIG_SETTINGS)
+static int rate_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
+{
+	uint8_t value;
+	ssize_t rc;
+
+	if (strcmp(name, "policy") != 0) {
+		return -ENOENT;
+	}
+
+	if (len != sizeof(value)) {
+		return -EINVAL;
+	}
+
+	rc = read_cb(cb_arg, &value, sizeof(value));
+	if (rc < 0) {
+		return (int)rc;
+	}
+
+	if (value >= AIR_CTRL_RATE_POLICY_COUNT) {
+		return -EINVAL;
+	}
+
+	policy = (enum air_ctrl_rate_policy)value;
+	LOG_INF("Restored sample rate policy %s", policy_names[policy]);
+	rate_apply();
+
+	return 0;
+}
+
+SETTINGS_STATIC_HANDLER_DEFINE(air_ctrl_rate, "air_ctrl/rate", NULL, rate_settings_set, NULL,
+			       NULL);
+#endif /* CONFIG_SETTINGS */
+
+#if defined(CONFIG_SHELL)
+static int cmd_rate(const struct shell *sh, size_t argc, char **argv)
+{
+	if (argc > 1) {
+		for (int i = 0; i < AIR_CTRL_RATE_POLICY_COUNT; i++) {
+			if (strcmp(argv[1], policy_names[i]) == 0) {
+				return air_ctrl_rate_set_policy(i);
+			}
+		}
+
+		shell_error(sh, "Unknown policy %s (auto, lp, ulp)", argv[1]);
+		return -EINVAL;
+	}
+
+	shell_print(sh, "policy %s, sampling at %s, %s, %s", policy_names[policy],
+		    (air_ctrl_sensor_get_rate() == AIR_CTRL_SENSOR_RATE_ULP) ? "ULP" : "LP",
+		    link_up ? "connected" : "not connected", quiet ? "quiet" : "changing");
+
+	return 0;
+}
+
+SHELL_CMD_ARG_REGISTER(rate, NULL, "Sample rate policy: rate [auto|lp|ulp]", cmd_rate, 1, 1);
+#endif /* CONFIG_SHELL */
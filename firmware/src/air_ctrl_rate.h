@@ -0,0 +1,49 @@
+#ifndef AIR_CTRL_RATE_H_
+#define AIR_CTRL_RATE_H_
+
+#include <stdbool.h>
+
+#include "air_ctrl_sensor.h"
+
+/* Picks the sensor sample rate. In the automatic policy the sensor runs at LP (3 s) while a
+ * central is connected or the air is changing, and drops to ULP (300 s) once nobody is
+ * connected and temperature, humidity, IAQ and CO2-eq stayed within their bands for
+ * CONFIG_AIR_CTRL_RATE_QUIET_MIN. The first ULP sample outside the bands, or a connection,
+ * brings it back to LP. The policy can also pin either rate; it is written over BLE and
+ * kept in settings.
+ */
+
+enum air_ctrl_rate_policy {
+	AIR_CTRL_RATE_POLICY_AUTO,
+	AIR_CTRL_RATE_POLICY_LP,
+	AIR_CTRL_RATE_POLICY_ULP,
+	AIR_CTRL_RATE_POLICY_COUNT,
+};
+
+#if defined(CONFIG_AIR_CTRL_RATE)
+
+/* Called from the main thread for every processed sample */
+void air_ctrl_rate_update(const air_ctrl_sensor_data_t *data);
+
+/* A central connected or the last one disconnected */
+void air_ctrl_rate_link_changed(bool connected);
+
+int air_ctrl_rate_set_policy(enum air_ctrl_rate_policy policy);
+
+enum air_ctrl_rate_policy air_ctrl_rate_get_policy(void);
+
+#else
+
+static inline void air_ctrl_rate_update(const air_ctrl_sensor_data_t *data)
+{
+	(void)data;
+}
+
+static inline void air_ctrl_rate_link_changed(bool connected)
+{
+	(void)connected;
+}
+
+#endif /* CONFIG_AIR_CTRL_RATE */
+
+#endif /* AIR_CTRL_RATE_H_ */
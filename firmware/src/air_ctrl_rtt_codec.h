@@ -0,0 +1,277 @@
+#ifndef AIR_CTRL_RTT_CODEC_H_
+#define AIR_CTRL_RTT_CODEC_H_
+
+#include <errno.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+/* Frames of the binary sample stream on RTT (air_ctrl_rtt_stream.c). Plain C99 like
+ * air_ctrl_ble_codec.h: the host library in host/ builds it, and logging/air_ctrl_stream.py
+ * decodes through that.
+ *
+ * Frame: sync (0xa5 0x5a), version, record length, record, CRC-16/CCITT-FALSE (poly 0x1021,
+ * init 0xffff) over version..record. All fields little endian. Version 2 records hold the
+ * fixed-point sample, version 1 (older firmware) held floats.
+ */
+
+#define AIR_CTRL_RTT_SYNC0 0xa5U
+#define AIR_CTRL_RTT_SYNC1 0x5aU
+#define AIR_CTRL_RTT_VERSION 2U
+
+#define AIR_CTRL_RTT_HDR_LEN 4U
+#define AIR_CTRL_RTT_CRC_LEN 2U
+
+/* Bits in the record flags. Version 1 only had AIR_CTRL_RTT_FLAG_BSEC. */
+#define AIR_CTRL_RTT_FLAG_BSEC 0x01U
+#define AIR_CTRL_RTT_FLAG_STABILIZED 0x02U
+#define AIR_CTRL_RTT_FLAG_RUN_IN 0x04U
+
+#define AIR_CTRL_RTT_PACKED __attribute__((__packed__))
+
+/* Fields follow the old float sample, in the order of the old CSV columns */
+struct AIR_CTRL_RTT_PACKED air_ctrl_rtt_record_v1 {
+	uint16_t seq;
+	uint8_t flags;
+	uint8_t iaq_accuracy;
+	int64_t timestamp_ns;
+	float values[17];
+};
+
+/* air_ctrl_sensor_data_t as it is, gas estimates are 0 unless BSEC provides them */
+struct AIR_CTRL_RTT_PACKED air_ctrl_rtt_record_v2 {
+	uint16_t seq;
+	uint8_t flags;
+	uint8_t iaq_acc;
+	uint32_t timestamp_ms;
+	int16_t raw_temp_c_x100;
+	int16_t temp_c_x100;
+	uint16_t raw_hum_rh_x100;
+	uint16_t hum_rh_x100;
+	uint32_t press_pa;
+	uint32_t gas_ohm;
+	uint16_t iaq_x10;
+	uint16_t static_iaq_x10;
+	uint16_t co2_eq_ppm;
+	uint16_t breath_voc_eq_ppb;
+	uint16_t gas_pct_x100;
+	uint16_t gas_estimate_x10000[4];
+};
+
+/* Decoded values in physical units, the value columns of logging/air_ctrl_stream.py */
+enum air_ctrl_rtt_value {
+	AIR_CTRL_RTT_TEMP_RAW_C,
+	AIR_CTRL_RTT_TEMP_COMP_C,
+	AIR_CTRL_RTT_HUM_RAW_RH,
+	AIR_CTRL_RTT_HUM_COMP_RH,
+	AIR_CTRL_RTT_PRESS_RAW_PA,
+	AIR_CTRL_RTT_GAS_RAW_OHM,
+	AIR_CTRL_RTT_IAQ,
+	AIR_CTRL_RTT_STATIC_IAQ,
+	AIR_CTRL_RTT_CO2_EQ_PPM,
+	AIR_CTRL_RTT_BREATH_VOC_EQ_PPM,
+	AIR_CTRL_RTT_GAS_PCT,
+	AIR_CTRL_RTT_STABILIZED,
+	AIR_CTRL_RTT_RUN_IN,
+	AIR_CTRL_RTT_GAS_EST_1,
+	AIR_CTRL_RTT_VALUE_COUNT = AIR_CTRL_RTT_GAS_EST_1 + 4,
+};
+
+struct air_ctrl_rtt_sample {
+	uint8_t version;
+	uint8_t flags; /* As sent for version 1, AIR_CTRL_RTT_FLAG_BSEC only for version 2 */
+	uint8_t iaq_acc;
+	uint16_t seq;
+	int64_t timestamp_ns;  /* Version 1 */
+	uint32_t timestamp_ms; /* Version 2, wraps after 49.7 days */
+	double values[AIR_CTRL_RTT_VALUE_COUNT];
+};
+
+/* CRC-16/CCITT-FALSE a byte at a time, without a table */
+static inline uint16_t air_ctrl_rtt_crc16(const uint8_t *buf, size_t len)
+{
+	unsigned int crc = 0xffffU;
+	unsigned int x;
+
+	for (size_t i = 0; i < len; i++) {
+		x = ((crc >> 8) ^ buf[i]) & 0xffU;
+		x ^= x >> 4;
+		crc = ((crc << 8) ^ (x << 12) ^ (x << 5) ^ x) & 0xffffU;
+	}
+
+	return (uint16_t)crc;
+}
+
+static inline uint16_t air_ctrl_rtt_get_le16(const uint8_t *buf)
+{
+	return (uint16_t)(buf[0] | (buf[1] << 8));
+}
+
+static inline uint32_t air_ctrl_rtt_get_le32(const uint8_t *buf)
+{
+	return (uint32_t)buf[0] | ((uint32_t)buf[1] << 8) | ((uint32_t)buf[2] << 16) |
+	       ((uint32_t)buf[3] << 24);
+}
+
+static inline size_t air_ctrl_rtt_record_len(uint8_t version)
+{
+	switch (version) {
+	case 1U:
+		return sizeof(struct air_ctrl_rtt_record_v1);
+	case 2U:
+		return sizeof(struct air_ctrl_rtt_record_v2);
+	default:
+		return 0U;
+	}
+}
+
+static inline void air_ctrl_rtt_decode_v1(const uint8_t *rec, struct air_ctrl_rtt_sample *sample)
+{
+	const size_t values = offsetof(struct air_ctrl_rtt_record_v1, values);
+	uint32_t bits;
+	float value;
+
+	sample->flags = rec[2];
+	sample->iaq_acc = rec[3];
+	sample->timestamp_ns = (int64_t)((uint64_t)air_ctrl_rtt_get_le32(&rec[4]) |
+					 ((uint64_t)air_ctrl_rtt_get_le32(&rec[8]) << 32));
+	for (size_t i = 0; i < AIR_CTRL_RTT_VALUE_COUNT; i++) {
+		bits = air_ctrl_rtt_get_le32(&rec[values + i * sizeof(float)]);
+		memcpy(&value, &bits, sizeof(value));
+		sample->values[i] = value;
+	}
+}
+
+static inline void air_ctrl_rtt_decode_v2(const uint8_t *rec, struct air_ctrl_rtt_sample *sample)
+{
+	double *v = sample->values;
+	uint8_t flags = rec[2];
+
+	sample->flags = flags & AIR_CTRL_RTT_FLAG_BSEC;
+	sample->iaq_acc = rec[3];
+	sample->timestamp_ms = air_ctrl_rtt_get_le32(&rec[4]);
+	v[AIR_CTRL_RTT_TEMP_RAW_C] = (int16_t)air_ctrl_rtt_get_le16(&rec[8]) / 100.0;
+	v[AIR_CTRL_RTT_TEMP_COMP_C] = (int16_t)air_ctrl_rtt_get_le16(&rec[10]) / 100.0;
+	v[AIR_CTRL_RTT_HUM_RAW_RH] = air_ctrl_rtt_get_le16(&rec[12]) / 100.0;
+	v[AIR_CTRL_RTT_HUM_COMP_RH] = air_ctrl_rtt_get_le16(&rec[14]) / 100.0;
+	v[AIR_CTRL_RTT_PRESS_RAW_PA] = air_ctrl_rtt_get_le32(&rec[16]);
+	v[AIR_CTRL_RTT_GAS_RAW_OHM] = air_ctrl_rtt_get_le32(&rec[20]);
+	v[AIR_CTRL_RTT_IAQ] = air_ctrl_rtt_get_le16(&rec[24]) / 10.0;
+	v[AIR_CTRL_RTT_STATIC_IAQ] = air_ctrl_rtt_get_le16(&rec[26]) / 10.0;
+	v[AIR_CTRL_RTT_CO2_EQ_PPM] = air_ctrl_rtt_get_le16(&rec[28]);
+	v[AIR_CTRL_RTT_BREATH_VOC_EQ_PPM] = air_ctrl_rtt_get_le16(&rec[30]) / 1000.0;
+	v[AIR_CTRL_RTT_GAS_PCT] = air_ctrl_rtt_get_le16(&rec[32]) / 100.0;
+	v[AIR_CTRL_RTT_STABILIZED] = (flags & AIR_CTRL_RTT_FLAG_STABILIZED) ? 1.0 : 0.0;
+	v[AIR_CTRL_RTT_RUN_IN] = (flags & AIR_CTRL_RTT_FLAG_RUN_IN) ? 1.0 : 0.0;
+	for (size_t i = 0; i < 4; i++) {
+		v[AIR_CTRL_RTT_GAS_EST_1 + i] = air_ctrl_rtt_get_le16(&rec[34 + 2 * i]) / 10000.0;
+	}
+}
+
+/* The frame at the start of buf. Returns the frame length, -EAGAIN when buf ends before the
+ * frame does, -EBADMSG when buf does not start with a frame of a known version and length,
+ * and -EILSEQ for a CRC mismatch. On the last two the stream resyncs one byte later.
+ */
+static inline int air_ctrl_rtt_decode_frame(const uint8_t *buf, size_t len,
+					    struct air_ctrl_rtt_sample *sample)
+{
+	size_t record_len;
+	size_t frame_len;
+
+	if (len < AIR_CTRL_RTT_HDR_LEN) {
+		return -EAGAIN;
+	}
+
+	if (buf[0] != AIR_CTRL_RTT_SYNC0 || buf[1] != AIR_CTRL_RTT_SYNC1) {
+		return -EBADMSG;
+	}
+
+	record_len = air_ctrl_rtt_record_len(buf[2]);
+	if (record_len == 0U || buf[3] != record_len) {
+		/* Sync bytes inside another frame's record */
+		return -EBADMSG;
+	}
+
+	frame_len = AIR_CTRL_RTT_HDR_LEN + record_len + AIR_CTRL_RTT_CRC_LEN;
+	if (len < frame_len) {
+		return -EAGAIN;
+	}
+
+	if (air_ctrl_rtt_crc16(&buf[2], frame_len - 2U - AIR_CTRL_RTT_CRC_LEN) !=
+	    air_ctrl_rtt_get_le16(&buf[frame_len - AIR_CTRL_RTT_CRC_LEN])) {
+		return -EILSEQ;
+	}
+
+	memset(sample, 0, sizeof(*sample));
+	sample->version = buf[2];
+	sample->seq = air_ctrl_rtt_get_le16(&buf[AIR_CTRL_RTT_HDR_LEN]);
+	if (sample->version == 1U) {
+		air_ctrl_rtt_decode_v1(&buf[AIR_CTRL_RTT_HDR_LEN], sample);
+	} else {
+		air_ctrl_rtt_decode_v2(&buf[AIR_CTRL_RTT_HDR_LEN], sample);
+	}
+
+	return (int)frame_len;
+}
+
+/* Counters kept across air_ctrl_rtt_scan() calls, zero them once per stream */
+struct air_ctrl_rtt_scan {
+	size_t consumed; /* Bytes of the last call's buf the caller can drop */
+	uint64_t frames;
+	uint64_t crc_errors;
+	uint64_t skipped_bytes;
+};
+
+/* Decodes the frames in a chunk of the stream, up to max_samples. Bytes that are not part
+ * of a frame are skipped. The caller drops scan->consumed bytes and passes the rest again,
+ * followed by the next data: it holds a frame that is not complete yet (or samples beyond
+ * max_samples).
+ */
+static inline size_t air_ctrl_rtt_scan(const uint8_t *buf, size_t len,
+				       struct air_ctrl_rtt_sample *samples, size_t max_samples,
+				       struct air_ctrl_rtt_scan *scan)
+{
+	const uint8_t *sync;
+	size_t count = 0;
+	size_t pos = 0;
+	size_t start;
+	int ret;
+
+	while (count < max_samples) {
+		sync = (pos < len) ? memchr(&buf[pos], AIR_CTRL_RTT_SYNC0, len - pos) : NULL;
+		if (sync == NULL) {
+			scan->skipped_bytes += len - pos;
+			pos = len;
+			break;
+		}
+
+		start = (size_t)(sync - buf);
+		scan->skipped_bytes += start - pos;
+		pos = start;
+
+		ret = air_ctrl_rtt_decode_frame(&buf[start], len - start, &samples[count]);
+		if (ret == -EAGAIN) {
+			/* A sync byte at the very end may be the first half of the next sync */
+			if (len - start == 1U || buf[start + 1] == AIR_CTRL_RTT_SYNC1) {
+				break;
+			}
+			ret = -EBADMSG;
+		}
+
+		if (ret < 0) {
+			scan->crc_errors += (ret == -EILSEQ) ? 1U : 0U;
+			scan->skipped_bytes++;
+			pos = start + 1U;
+			continue;
+		}
+
+		pos = start + (size_t)ret;
+		scan->frames++;
+		count++;
+	}
+
+	scan->consumed = pos;
+	return count;
+}
+
+#endif /* AIR_CTRL_RTT_CODEC_H_ */
@@ -0,0 +1,104 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/sys/byteorder.h>
+#include <zephyr/sys/crc.h>
+#include <SEGGER_RTT.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "air_ctrl_rtt_codec.h"
+#include "air_ctrl_rtt_stream.h"
+
+LOG_MODULE_REGISTER(air_ctrl_rtt_stream, LOG_LEVEL_INF);
+
+struct __packed air_ctrl_rtt_frame_v2 {
+	uint8_t sync[2];
+	uint8_t version;
+	uint8_t len;
+	struct air_ctrl_rtt_record_v2 record;
+	uint16_t crc;
+};
+
+BUILD_ASSERT(sizeof(struct air_ctrl_rtt_record_v2) <= UINT8_MAX);
+BUILD_ASSERT(CONFIG_AIR_CTRL_RTT_STREAM_CHANNEL < CONFIG_SEGGER_RTT_MAX_NUM_UP_BUFFERS,
+	     "RTT stream channel exceeds the number of RTT up-buffers");
+
+static uint8_t stream_buf[CONFIG_AIR_CTRL_RTT_STREAM_BUFFER_SIZE];
+static uint16_t stream_seq;
+static uint32_t dropped_frames;
+
+int air_ctrl_rtt_stream_init(void)
+{
+	int err;
+
+	/* Skip whole frames when full, so the host never sees a torn record */
+	err = SEGGER_RTT_ConfigUpBuffer(CONFIG_AIR_CTRL_RTT_STREAM_CHANNEL, "air_ctrl", stream_buf,
+					sizeof(stream_buf), SEGGER_RTT_MODE_NO_BLOCK_SKIP);
+	if (err < 0) {
+		LOG_ERR("Failed to configure RTT channel %d (err %d)",
+			CONFIG_AIR_CTRL_RTT_STREAM_CHANNEL, err);
+		return -EIO;
+	}
+
+	LOG_INF("Binary sample stream on RTT channel %d", CONFIG_AIR_CTRL_RTT_STREAM_CHANNEL);
+
+	return 0;
+}
+
+int air_ctrl_rtt_stream_write(const air_ctrl_sensor_data_t *data)
+{
+	struct air_ctrl_rtt_frame_v2 frame;
+	struct air_ctrl_rtt_record_v2 *rec = &frame.record;
+	uint16_t crc;
+
+	if (data == NULL) {
+		return -EINVAL;
+	}
+
+	frame.sync[0] = AIR_CTRL_RTT_SYNC0;
+	frame.sync[1] = AIR_CTRL_RTT_SYNC1;
+	frame.version = AIR_CTRL_RTT_VERSION;
+	frame.len = sizeof(*rec);
+
+	memset(rec, 0, sizeof(*rec));
+	rec->seq = sys_cpu_to_le16(stream_seq++);
+	rec->flags = IS_ENABLED(CONFIG_AIR_CTRL_USE_BSEC) ? AIR_CTRL_RTT_FLAG_BSEC : 0U;
+	if (data->status & AIR_CTRL_SENSOR_STABILIZED) {
+		rec->flags |= AIR_CTRL_RTT_FLAG_STABILIZED;
+	}
+	if (data->status & AIR_CTRL_SENSOR_RUN_IN) {
+		rec->flags |= AIR_CTRL_RTT_FLAG_RUN_IN;
+	}
+	rec->iaq_acc = data->iaq_acc;
+	rec->timestamp_ms = sys_cpu_to_le32((uint32_t)data->timestamp_ms);
+	rec->raw_temp_c_x100 = (int16_t)sys_cpu_to_le16((uint16_t)data->raw_temp_c_x100);
+	rec->temp_c_x100 = (int16_t)sys_cpu_to_le16((uint16_t)data->temp_c_x100);
+	rec->raw_hum_rh_x100 = sys_cpu_to_le16(data->raw_hum_rh_x100);
+	rec->hum_rh_x100 = sys_cpu_to_le16(data->hum_rh_x100);
+	rec->press_pa = sys_cpu_to_le32(data->press_pa);
+	rec->gas_ohm = sys_cpu_to_le32(data->gas_ohm);
+	rec->iaq_x10 = sys_cpu_to_le16(data->iaq_x10);
+	rec->static_iaq_x10 = sys_cpu_to_le16(data->static_iaq_x10);
+	rec->co2_eq_ppm = sys_cpu_to_le16(data->co2_eq_ppm);
+	rec->breath_voc_eq_ppb = sys_cpu_to_le16(data->breath_voc_eq_ppb);
+	rec->gas_pct_x100 = sys_cpu_to_le16(data->gas_pct_x100);
+#if defined(CONFIG_AIR_CTRL_BSEC_GAS_ESTIMATES)
+	for (size_t i = 0; i < ARRAY_SIZE(rec->gas_estimate_x10000); i++) {
+		rec->gas_estimate_x10000[i] = sys_cpu_to_le16(data->gas_estimate_x10000[i]);
+	}
+#endif
+
+	crc = crc16_itu_t(0xffff, &frame.version,
+			  offsetof(struct air_ctrl_rtt_frame_v2, crc) -
+			  offsetof(struct air_ctrl_rtt_frame_v2, version));
+	frame.crc = sys_cpu_to_le16(crc);
+
+	if (SEGGER_RTT_Write(CONFIG_AIR_CTRL_RTT_STREAM_CHANNEL, &frame, sizeof(frame)) == 0) {
+		dropped_frames++;
+		LOG_DBG("RTT stream full, dropped frame (total %u)", dropped_frames);
+		return -ENOSPC;
+	}
+
+	return 0;
+}
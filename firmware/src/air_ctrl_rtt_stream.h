@@ -0,0 +1,18 @@
+#ifndef AIR_CTRL_RTT_STREAM_H_
+#define AIR_CTRL_RTT_STREAM_H_
+
+#include "air_ctrl_sensor.h"
+
+/* Binary sample stream on its own RTT up-channel (decoded by logging/air_ctrl_stream.py).
+ * The frame format is in air_ctrl_rtt_codec.h, values are the fixed-point units of
+ * air_ctrl_sensor_data_t.
+ */
+
+int air_ctrl_rtt_stream_init(void);
+
+/* Write one sample frame. Never blocks: returns -ENOSPC and drops the frame when the
+ * host is not draining the channel.
+ */
+int air_ctrl_rtt_stream_write(const air_ctrl_sensor_data_t *data);
+
+#endif /* AIR_CTRL_RTT_STREAM_H_ */
@@ -0,0 +1,68 @@
+#include <zephyr/kernel.h>
+#include <zephyr/logging/log.h>
+#include <zephyr/spinlock.h>
+
+#include <string.h>
+
+#include "air_ctrl_sched.h"
+#include "air_ctrl_sensor.h"
+
+LOG_MODULE_REGISTER(air_ctrl_sched, LOG_LEVEL_INF);
+
+/* Given by air_ctrl_sched_kick(). A kick before the wait starts is kept, not lost. */
+static K_SEM_DEFINE(sched_sem, 0, 1);
+
+/* Updated by the waiter, read from the shell */
+static air_ctrl_sched_stats_t sched_stats;
+static struct k_spinlock sched_lock;
+
+int64_t air_ctrl_sched_wait_until(int64_t deadline_ns)
+{
+	int64_t now_ns = air_ctrl_sensor_get_timestamp_ns();
+	int64_t late_ns;
+	k_spinlock_key_t key;
+
+	if (deadline_ns > now_ns) {
+		if (k_sem_take(&sched_sem, K_TIMEOUT_ABS_NS(deadline_ns)) == 0) {
+			/* Kicked by air_ctrl_sched_kick() before the deadline */
+			key = k_spin_lock(&sched_lock);
+			sched_stats.early_wakeups++;
+			k_spin_unlock(&sched_lock, key);
+			return -1;
+		}
+		now_ns = air_ctrl_sensor_get_timestamp_ns();
+	}
+
+	late_ns = now_ns - deadline_ns;
+
+	key = k_spin_lock(&sched_lock);
+	sched_stats.wakeups++;
+	sched_stats.last_late_ns = late_ns;
+	sched_stats.total_late_ns += late_ns;
+	if (late_ns > sched_stats.max_late_ns) {
+		sched_stats.max_late_ns = late_ns;
+	}
+	k_spin_unlock(&sched_lock, key);
+
+	LOG_DBG("Woke %lld us after deadline", (long long)(late_ns / 1000LL));
+
+	return late_ns;
+}
+
+void air_ctrl_sched_kick(void)
+{
+	k_sem_give(&sched_sem);
+}
+
+void air_ctrl_sched_get_stats(air_ctrl_sched_stats_t *stats)
+{
+	k_spinlock_key_t key;
+
+	if (stats == NULL) {
+		return;
+	}
+
+	key = k_spin_lock(&sched_lock);
+	memcpy(stats, &sched_stats, sizeof(*stats));
+	k_spin_unlock(&sched_lock, key);
+}
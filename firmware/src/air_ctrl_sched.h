@@ -0,0 +1,28 @@
+#ifndef AIR_CTRL_SCHED_H_
+#define AIR_CTRL_SCHED_H_
+
+#include <stdint.h>
+
+typedef struct {
+	uint32_t wakeups;
+	uint32_t early_wakeups;
+	int64_t last_late_ns;
+	int64_t max_late_ns;
+	int64_t total_late_ns;
+} air_ctrl_sched_stats_t;
+
+/* Sleep until the absolute deadline (same time base as air_ctrl_sensor_get_timestamp_ns()).
+ * Returns how late the wake-up was in ns, or a negative value if the wait was cut short
+ * by air_ctrl_sched_kick().
+ */
+int64_t air_ctrl_sched_wait_until(int64_t deadline_ns);
+
+/* Wake the waiter early so it can re-evaluate its deadline. A kick while nobody waits
+ * ends the next wait right away.
+ */
+void air_ctrl_sched_kick(void);
+
+/* Wake-up counts and lateness since boot, shown by the "prof sched" shell command */
+void air_ctrl_sched_get_stats(air_ctrl_sched_stats_t *stats);
+
+#endif /* AIR_CTRL_SCHED_H_ */
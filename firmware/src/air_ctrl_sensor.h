@@ -1,37 +1,168 @@
 #ifndef AIR_CTRL_SENSOR_H_
 #define AIR_CTRL_SENSOR_H_
 
+#include <math.h>
+#include <stddef.h>
 #include <stdint.h>
 #include <stdbool.h>
 
+#include <zephyr/sys/util.h>
+
+/* Most readings one acquisition can return (BME688 parallel mode has three data fields) */
+#define AIR_CTRL_SENSOR_MAX_RAW 3
+
+/* Bits in air_ctrl_sensor_data_t.status */
+#define AIR_CTRL_SENSOR_STABILIZED BIT(0)
+#define AIR_CTRL_SENSOR_RUN_IN BIT(1)
+
+/* One processed sample in fixed point, in the units of the BLE format (air_ctrl_ble_proto.h).
+ * Outputs the backend does not produce (everything BSEC computes in raw mode) are 0.
+ */
+typedef struct {
+    /* Uptime, 64 bits so it does not wrap. The wire formats carry it modulo 2^32 (49.7 days),
+     * compare those with serial arithmetic: (int32_t)(a - b).
+     */
+    uint64_t timestamp_ms;
+
+    int16_t raw_temp_c_x100;
+    int16_t temp_c_x100; /* Heat compensated */
+    uint16_t raw_hum_rh_x100;
+    uint16_t hum_rh_x100; /* Heat compensated */
+    uint32_t press_pa;
+    uint32_t gas_ohm;
+
+    uint16_t iaq_x10;
+    uint16_t static_iaq_x10;
+    uint16_t co2_eq_ppm;
+    uint16_t breath_voc_eq_ppb;
+    uint16_t gas_pct_x100;
+    uint8_t iaq_acc;
+    uint8_t status;
+
+#if defined(CONFIG_AIR_CTRL_BSEC_GAS_ESTIMATES)
+    uint16_t gas_estimate_x10000[4];
+#endif
+} air_ctrl_sensor_data_t;
+
+/* One reading as the driver returns it */
 typedef struct {
     int64_t timestamp_ns;
 
-    float raw_temperature;
-    float raw_humidity;
-    float raw_pressure;
-    float raw_gas_resistance;
+    int16_t temp_c_x100;
+    uint32_t hum_rh_x1000;
+    uint32_t press_pa;
+    uint32_t gas_ohm;
+    uint8_t gas_index;
+} air_ctrl_sensor_raw_t;
 
-    float temperature;
-    float humidity;
+/* Copy the measured values of a reading into a sample */
+static inline void air_ctrl_sensor_fill_raw(const air_ctrl_sensor_raw_t *raw,
+                                            air_ctrl_sensor_data_t *data)
+{
+    data->timestamp_ms = (raw->timestamp_ns <= 0) ? 0U :
+        (uint64_t)(raw->timestamp_ns / 1000000LL);
+    data->raw_temp_c_x100 = raw->temp_c_x100;
+    data->raw_hum_rh_x100 = (uint16_t)MIN(raw->hum_rh_x1000 / 10U, UINT16_MAX);
+    data->press_pa = raw->press_pa;
+    data->gas_ohm = raw->gas_ohm;
+}
 
-    float iaq;
-    uint8_t iaq_accuracy;
-    float static_iaq;
-    float co2_equivalent;
-    float breath_voc_equivalent;
-    float gas_percentage;
+/* BSEC outputs to sample units, with the rounding the BLE encoding has always used. Clamped
+ * in float first: converting a float outside the integer range (or NaN) is undefined.
+ */
+static inline int16_t air_ctrl_sensor_fixed_i16(float value, float scale)
+{
+    float scaled = value * scale;
 
-    float stabilization_status;
-    float run_in_status;
-} air_ctrl_sensor_data_t;
+    if (isnan(scaled)) {
+        return 0;
+    }
+    if (scaled <= (float)INT16_MIN) {
+        return INT16_MIN;
+    }
+    if (scaled >= (float)INT16_MAX) {
+        return INT16_MAX;
+    }
+
+    return (int16_t)scaled;
+}
+
+/* Negative values and NaN read as 0 */
+static inline uint16_t air_ctrl_sensor_fixed_u16(float value, float scale, float round)
+{
+    float scaled;
+
+    if (!(value > 0.0f)) {
+        return 0U;
+    }
+
+    scaled = value * scale + round;
+    if (scaled >= (float)UINT16_MAX) {
+        return UINT16_MAX;
+    }
+
+    return (uint16_t)scaled;
+}
 
 int air_ctrl_sensor_init(void);
 
-bool air_ctrl_sensor_run(air_ctrl_sensor_data_t *output);
+/* Acquisition stage: triggers a conversion when one is due and reads it back over I2C.
+ * Blocks for the conversion time, so it must only be called from the sensor thread.
+ * Returns the number of readings written (one per heater step read in parallel mode).
+ */
+int air_ctrl_sensor_acquire(air_ctrl_sensor_raw_t *raw, size_t max_raw);
+
+/* Processing stage: turns the readings of one acquisition into one sample (BSEC or
+ * passthrough). The measured values are the last reading's; BSEC outputs not recomputed for
+ * these readings keep their latest value. Returns false when there is no new sample.
+ */
+bool air_ctrl_sensor_process(const air_ctrl_sensor_raw_t *raw, size_t n_raw,
+                             air_ctrl_sensor_data_t *output);
 
+/* Deadline of the next acquisition. 0 while a rate change is pending, so the sensor thread
+ * picks it up right away.
+ */
 int64_t air_ctrl_sensor_get_next_call_ns(void);
 
+/* Sample rates, BSEC_SAMPLE_RATE_LP / _ULP in BSEC builds */
+enum air_ctrl_sensor_rate {
+    AIR_CTRL_SENSOR_RATE_LP,  /* 3 s */
+    AIR_CTRL_SENSOR_RATE_ULP, /* 300 s */
+};
+
+/* Request a sample rate, from any thread. The sensor thread switches before its next
+ * acquisition (it is woken up for it); the BSEC state and calibration carry over.
+ */
+int air_ctrl_sensor_set_rate(enum air_ctrl_sensor_rate rate);
+
+/* Rate the sensor thread is currently sampling at */
+enum air_ctrl_sensor_rate air_ctrl_sensor_get_rate(void);
+
+/* BSEC output groups for air_ctrl_sensor_set_outputs(). Outputs outside the set are not
+ * computed and read as 0; BSEC only asks for the physical inputs the set needs (no heater
+ * run without a gas based output).
+ */
+#define AIR_CTRL_SENSOR_OUT_TEMP BIT(0)       /* Raw temperature */
+#define AIR_CTRL_SENSOR_OUT_HUM BIT(1)        /* Raw humidity */
+#define AIR_CTRL_SENSOR_OUT_PRESS BIT(2)
+#define AIR_CTRL_SENSOR_OUT_GAS BIT(3)        /* Gas resistance */
+#define AIR_CTRL_SENSOR_OUT_IAQ BIT(4)        /* IAQ and its accuracy */
+#define AIR_CTRL_SENSOR_OUT_STATIC_IAQ BIT(5)
+#define AIR_CTRL_SENSOR_OUT_CO2_EQ BIT(6)
+#define AIR_CTRL_SENSOR_OUT_BREATH_VOC BIT(7)
+#define AIR_CTRL_SENSOR_OUT_COMP BIT(8)       /* Heat compensated temperature and humidity */
+#define AIR_CTRL_SENSOR_OUT_GAS_PCT BIT(9)
+#define AIR_CTRL_SENSOR_OUT_STATUS BIT(10)    /* Stabilization and run-in status */
+#define AIR_CTRL_SENSOR_OUT_ALL BIT_MASK(11)
+
+/* Request an output set, from any thread. Applied by the sensor thread like a rate change
+ * and kept in settings once BSEC accepted it. -EINVAL for an empty set or unknown bits, -ENOTSUP in raw mode.
+ */
+int air_ctrl_sensor_set_outputs(uint32_t outputs);
+
+/* Output set in use (AIR_CTRL_SENSOR_OUT_ALL in raw mode, which has nothing to select) */
+uint32_t air_ctrl_sensor_get_outputs(void);
+
 int64_t air_ctrl_sensor_get_timestamp_ns(void);
 
 #endif /* AIR_CTRL_SENSOR_H_ */
@@ -3,11 +3,17 @@
 #include <zephyr/device.h>
 #include <zephyr/devicetree.h>
 #include <zephyr/drivers/sensor.h>
+#include <zephyr/drivers/sensor/bme680.h>
 #include <zephyr/settings/settings.h>
+#include <zephyr/sys/crc.h>
 
 #include <errno.h>
 #include <string.h>
 
+#include "air_ctrl_arena.h"
+#include "air_ctrl_power.h"
+#include "air_ctrl_prof.h"
+#include "air_ctrl_sched.h"
 #include "air_ctrl_sensor.h"
 #include "bsec_interface.h"
 #include "bsec_datatypes.h"
@@ -19,8 +25,16 @@ LOG_MODULE_REGISTER(air_ctrl_sensor_bsec, LOG_LEVEL_INF);
 
 #define BSEC_CHECK_INPUT(x, shift) (x & (1 << ((shift) - 1)))
 
+/* bme_settings.op_mode values (BME68x API encoding) */
+#define BME68X_SLEEP_MODE 0
+#define BME68X_FORCED_MODE 1
+#define BME68X_PARALLEL_MODE 2
+
 static bsec_bme_settings_t bme_settings;
 
+/* Heater profile currently programmed into the sensor */
+static struct bme680_heatr_profile active_heatr_profile;
+
 static float temp_offset = 0.0f;
 
 static const struct device *const bme = DEVICE_DT_GET_ONE(bosch_bme680);
@@ -28,23 +42,77 @@ static const struct device *const bme = DEVICE_DT_GET_ONE(bosch_bme680);
 static uint8_t bsec_mem[BSEC_INSTANCE_SIZE] __aligned(4);
 static void *bsec_instance = NULL;
 
-static uint8_t bsec_work_buffer[BSEC_MAX_WORKBUFFER_SIZE] __aligned(4);
+/* Written by air_ctrl_sensor_set_rate() / _set_outputs() (and settings), applied on the
+ * sensor thread (BSEC is not reentrant)
+ */
+static atomic_t requested_rate = ATOMIC_INIT(AIR_CTRL_SENSOR_RATE_LP);
+static atomic_t requested_outputs = ATOMIC_INIT(AIR_CTRL_SENSOR_OUT_ALL);
+static enum air_ctrl_sensor_rate active_rate = AIR_CTRL_SENSOR_RATE_LP;
+static uint32_t active_outputs = AIR_CTRL_SENSOR_OUT_ALL;
+
+/* Latest value of every BSEC output, sensor thread only. In parallel mode a bsec_do_steps()
+ * call returns only the outputs due at that heater step, the others keep their value.
+ */
+static air_ctrl_sensor_data_t bsec_latest;
+
+/* Only needed while loading the config and while getting or setting the state, so it lives in
+ * the shared arena (air_ctrl_arena.c sizes the region for it).
+ */
+struct bsec_scratch {
+	uint8_t work_buffer[BSEC_MAX_WORKBUFFER_SIZE];
+	uint8_t state_blob[BSEC_MAX_STATE_BLOB_SIZE];
+};
+
+/* Save on IAQ accuracy changes, but not more often than the minimum interval */
+#define BSEC_STATE_SAVE_MIN_INTERVAL_NS                                                            \
+	((int64_t)CONFIG_AIR_CTRL_BSEC_STATE_SAVE_MIN_INTERVAL_S * 1000000000LL)
+/* Catch slow calibration progress that never changes the accuracy */
+#define BSEC_STATE_SAVE_MAX_INTERVAL_NS                                                            \
+	((int64_t)CONFIG_AIR_CTRL_BSEC_STATE_SAVE_MAX_INTERVAL_MIN * 60LL * 1000000000LL)
 
-#define BSEC_STATE_SAVE_INTERVAL_NS (5LL * 60LL * 1000000000LL)
+#define FLASH_STATS_DAY_MS (24LL * 60LL * 60LL * 1000LL)
 
-static uint8_t bsec_state_blob[BSEC_MAX_STATE_BLOB_SIZE] __aligned(4);
+/*
+ * Set while the arena is held for init or for a save. A save is acquired by the sensor thread
+ * and released by the work item once the blob is written.
+ */
+static struct bsec_scratch *bsec_scratch;
 static size_t bsec_state_blob_len;
 static bool bsec_state_blob_valid;
-static int64_t bsec_last_state_save_ns;
+static bool bsec_state_loading;
+
+/* Sensor thread only */
+static int64_t bsec_last_state_snapshot_ns;
+static uint8_t bsec_last_iaq_accuracy;
+static bool bsec_state_save_requested;
+
+/* Save work item only */
+static uint32_t bsec_state_saved_crc;
+static size_t bsec_state_saved_len;
+static int64_t flash_stats_day;
+static uint32_t flash_bytes_today;
+
+K_THREAD_STACK_DEFINE(bsec_state_wq_stack, CONFIG_AIR_CTRL_BSEC_STATE_WQ_STACK_SIZE);
+static struct k_work_q bsec_state_wq;
+static struct k_work bsec_state_work;
+static struct k_work bsec_outputs_work;
+
+/* Output set BSEC accepted last, written by the sensor thread for bsec_outputs_work */
+static atomic_t bsec_outputs_to_save;
 
 static int bsec_settings_set(const char *name, size_t len, settings_read_cb read_cb, void *cb_arg)
 {
 	if (strcmp(name, "state") == 0) {
-		if (len > sizeof(bsec_state_blob)) {
+		/* Later settings_load() calls (e.g. from the BT stack) must not touch the arena */
+		if (!bsec_state_loading) {
+			return 0;
+		}
+
+		if (len > sizeof(bsec_scratch->state_blob)) {
 			return -EINVAL;
 		}
 
-		ssize_t rc = read_cb(cb_arg, bsec_state_blob, len);
+		ssize_t rc = read_cb(cb_arg, bsec_scratch->state_blob, len);
 		if (rc < 0) {
 			return (int)rc;
 		}
@@ -54,6 +122,26 @@ static int bsec_settings_set(const char *name, size_t len, settings_read_cb read
 		return 0;
 	}
 
+	if (strcmp(name, "outputs") == 0) {
+		uint16_t outputs;
+
+		if (len != sizeof(outputs)) {
+			return -EINVAL;
+		}
+
+		ssize_t rc = read_cb(cb_arg, &outputs, sizeof(outputs));
+		if (rc < 0) {
+			return (int)rc;
+		}
+
+		if (outputs == 0 || (outputs & ~AIR_CTRL_SENSOR_OUT_ALL) != 0) {
+			return -EINVAL;
+		}
+
+		atomic_set(&requested_outputs, outputs);
+		return 0;
+	}
+
 	return -ENOENT;
 }
 
@@ -62,34 +150,118 @@ static struct settings_handler bsec_settings_handler = {
 	.h_set = bsec_settings_set,
 };
 
+static void bsec_state_work_handler(struct k_work *work)
+{
+	uint32_t crc;
+	int64_t day;
+	int err;
+
+	ARG_UNUSED(work);
+
+	/* Skip the flash write (and erase) when the blob is what we already have stored */
+	crc = crc32_ieee(bsec_scratch->state_blob, bsec_state_blob_len);
+	if (bsec_state_blob_len == bsec_state_saved_len && crc == bsec_state_saved_crc) {
+		LOG_DBG("BSEC state unchanged, not saved");
+		goto out;
+	}
+
+	AIR_CTRL_PROF_BEGIN(AIR_CTRL_PROF_BSEC_STATE_SAVE);
+	err = settings_save_one("air_ctrl/bsec/state", bsec_scratch->state_blob,
+				bsec_state_blob_len);
+	AIR_CTRL_PROF_END(AIR_CTRL_PROF_BSEC_STATE_SAVE);
+	if (err) {
+		LOG_ERR("Failed to save BSEC state (err %d)", err);
+		goto out;
+	}
+
+	bsec_state_saved_crc = crc;
+	bsec_state_saved_len = bsec_state_blob_len;
+
+	day = k_uptime_get() / FLASH_STATS_DAY_MS;
+	if (day != flash_stats_day) {
+		LOG_INF("BSEC state: %u bytes written to flash on day %u", flash_bytes_today,
+			(uint32_t)flash_stats_day);
+		flash_stats_day = day;
+		flash_bytes_today = 0;
+	}
+	flash_bytes_today += bsec_state_blob_len;
+
+	LOG_INF("Saved BSEC state (%u bytes, %u bytes today)", (uint32_t)bsec_state_blob_len,
+		flash_bytes_today);
+
+out:
+	bsec_scratch = NULL;
+	air_ctrl_arena_release(AIR_CTRL_ARENA_BSEC_STATE);
+}
+
+static void bsec_outputs_work_handler(struct k_work *work)
+{
+	uint16_t value = (uint16_t)atomic_get(&bsec_outputs_to_save);
+	int err;
+
+	ARG_UNUSED(work);
+
+	err = settings_save_one("air_ctrl/bsec/outputs", &value, sizeof(value));
+	if (err) {
+		LOG_WRN("Failed to save the output set (err %d)", err);
+	}
+}
+
+/* Called for every IAQ output, other bsec_do_steps() results carry no IAQ accuracy */
+static void bsec_state_track_accuracy(uint8_t iaq_accuracy)
+{
+	if (iaq_accuracy != bsec_last_iaq_accuracy) {
+		LOG_DBG("IAQ accuracy %u -> %u", bsec_last_iaq_accuracy, iaq_accuracy);
+		bsec_last_iaq_accuracy = iaq_accuracy;
+		bsec_state_save_requested = true;
+	}
+}
+
 static void bsec_state_save_if_needed(int64_t timestamp_ns)
 {
+	int64_t elapsed_ns;
+
 	if (!IS_ENABLED(CONFIG_SETTINGS)) {
 		return;
 	}
 
-	if (timestamp_ns < (bsec_last_state_save_ns + BSEC_STATE_SAVE_INTERVAL_NS)) {
+	/* A state that is still stabilizing must not replace a calibrated one */
+	if (bsec_last_iaq_accuracy == 0) {
 		return;
 	}
 
-	uint32_t state_len = 0;
-	memset(bsec_work_buffer, 0, sizeof(bsec_work_buffer));
-	bsec_library_return_t bsec_status = bsec_get_state(bsec_instance, 0, bsec_state_blob,
-						   sizeof(bsec_state_blob), bsec_work_buffer,
-						   sizeof(bsec_work_buffer), &state_len);
-	if (bsec_status != BSEC_OK) {
-		LOG_ERR("bsec_get_state failed: %d", bsec_status);
+	elapsed_ns = timestamp_ns - bsec_last_state_snapshot_ns;
+	if (!(bsec_state_save_requested && elapsed_ns >= BSEC_STATE_SAVE_MIN_INTERVAL_NS) &&
+	    elapsed_ns < BSEC_STATE_SAVE_MAX_INTERVAL_NS) {
 		return;
 	}
 
-	int err = settings_save_one("air_ctrl/bsec/state", bsec_state_blob, state_len);
-	if (err) {
-		LOG_ERR("Failed to save BSEC state (err %d)", err);
+	/* Previous write still running or the arena is in use (history download), try again
+	 * with the next sample
+	 */
+	struct bsec_scratch *scratch =
+		air_ctrl_arena_acquire(AIR_CTRL_ARENA_BSEC_STATE, sizeof(*scratch), K_NO_WAIT);
+	if (scratch == NULL) {
+		return;
+	}
+
+	/* bsec_get_state() is only a copy and must run on the thread that owns the instance */
+	uint32_t state_len = 0;
+	memset(scratch->work_buffer, 0, sizeof(scratch->work_buffer));
+	bsec_library_return_t bsec_status = bsec_get_state(bsec_instance, 0, scratch->state_blob,
+						   sizeof(scratch->state_blob), scratch->work_buffer,
+						   sizeof(scratch->work_buffer), &state_len);
+	if (bsec_status != BSEC_OK) {
+		LOG_ERR("bsec_get_state failed: %d", bsec_status);
+		air_ctrl_arena_release(AIR_CTRL_ARENA_BSEC_STATE);
 		return;
 	}
 
-	bsec_last_state_save_ns = timestamp_ns;
-	LOG_INF("Saved BSEC state (%u bytes)", state_len);
+	bsec_scratch = scratch;
+	bsec_state_blob_len = state_len;
+	bsec_last_state_snapshot_ns = timestamp_ns;
+	bsec_state_save_requested = false;
+	(void)k_work_submit_to_queue(&bsec_state_wq, &bsec_state_work);
 }
 
 static bsec_sensor_configuration_t virtual_sensors[] = {
@@ -106,18 +278,184 @@ static bsec_sensor_configuration_t virtual_sensors[] = {
 	{BSEC_SAMPLE_RATE_LP, BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE},
 	{BSEC_SAMPLE_RATE_LP, BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY},
 	{BSEC_SAMPLE_RATE_LP, BSEC_OUTPUT_GAS_PERCENTAGE},
+#if IS_ENABLED(CONFIG_AIR_CTRL_BSEC_GAS_ESTIMATES)
+	{BSEC_SAMPLE_RATE_SCAN, BSEC_OUTPUT_GAS_ESTIMATE_1},
+	{BSEC_SAMPLE_RATE_SCAN, BSEC_OUTPUT_GAS_ESTIMATE_2},
+	{BSEC_SAMPLE_RATE_SCAN, BSEC_OUTPUT_GAS_ESTIMATE_3},
+	{BSEC_SAMPLE_RATE_SCAN, BSEC_OUTPUT_GAS_ESTIMATE_4},
+#endif
 };
 
 #define NUM_VIRTUAL_SENSORS (sizeof(virtual_sensors) / sizeof(virtual_sensors[0]))
 
+static float bsec_rate(enum air_ctrl_sensor_rate rate)
+{
+	return (rate == AIR_CTRL_SENSOR_RATE_ULP) ? BSEC_SAMPLE_RATE_ULP : BSEC_SAMPLE_RATE_LP;
+}
+
+static const char *rate_name(enum air_ctrl_sensor_rate rate)
+{
+	return (rate == AIR_CTRL_SENSOR_RATE_ULP) ? "ULP" : "LP";
+}
+
+static uint32_t output_group(uint8_t sensor_id)
+{
+	switch (sensor_id) {
+	case BSEC_OUTPUT_RAW_TEMPERATURE:
+		return AIR_CTRL_SENSOR_OUT_TEMP;
+	case BSEC_OUTPUT_RAW_HUMIDITY:
+		return AIR_CTRL_SENSOR_OUT_HUM;
+	case BSEC_OUTPUT_RAW_PRESSURE:
+		return AIR_CTRL_SENSOR_OUT_PRESS;
+	case BSEC_OUTPUT_RAW_GAS:
+		return AIR_CTRL_SENSOR_OUT_GAS;
+	case BSEC_OUTPUT_IAQ:
+		return AIR_CTRL_SENSOR_OUT_IAQ;
+	case BSEC_OUTPUT_STATIC_IAQ:
+		return AIR_CTRL_SENSOR_OUT_STATIC_IAQ;
+	case BSEC_OUTPUT_CO2_EQUIVALENT:
+		return AIR_CTRL_SENSOR_OUT_CO2_EQ;
+	case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
+		return AIR_CTRL_SENSOR_OUT_BREATH_VOC;
+	case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
+	case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY:
+		return AIR_CTRL_SENSOR_OUT_COMP;
+	case BSEC_OUTPUT_GAS_PERCENTAGE:
+		return AIR_CTRL_SENSOR_OUT_GAS_PCT;
+	case BSEC_OUTPUT_STABILIZATION_STATUS:
+	case BSEC_OUTPUT_RUN_IN_STATUS:
+		return AIR_CTRL_SENSOR_OUT_STATUS;
+	default:
+		/* Scan-rate gas estimates are not selectable */
+		return 0;
+	}
+}
+
+static bsec_library_return_t subscribe(enum air_ctrl_sensor_rate rate, uint32_t outputs,
+				       uint8_t *n_required)
+{
+	bsec_sensor_configuration_t required_sensors[BSEC_MAX_PHYSICAL_SENSOR];
+
+	/* Scan-rate outputs (gas estimates) keep their rate, the others are disabled when
+	 * they are not selected
+	 */
+	for (size_t i = 0; i < NUM_VIRTUAL_SENSORS; i++) {
+		uint32_t group = output_group(virtual_sensors[i].sensor_id);
+
+		if (group != 0) {
+			virtual_sensors[i].sample_rate = (outputs & group) ?
+				bsec_rate(rate) : BSEC_SAMPLE_RATE_DISABLED;
+		}
+	}
+
+	*n_required = BSEC_MAX_PHYSICAL_SENSOR;
+	return bsec_update_subscription(bsec_instance, virtual_sensors, NUM_VIRTUAL_SENSORS,
+					required_sensors, n_required);
+}
+
+static bool subscription_pending(void)
+{
+	return atomic_get(&requested_rate) != active_rate ||
+	       (uint32_t)atomic_get(&requested_outputs) != active_outputs;
+}
+
+/* Sensor thread only. The instance keeps its state (baseline, IAQ accuracy), only the
+ * schedule and the computed outputs change: the next bsec_sensor_control() call starts
+ * the new subscription.
+ */
+static void resubscribe(enum air_ctrl_sensor_rate rate, uint32_t outputs)
+{
+	bsec_library_return_t status;
+	uint8_t n_required;
+
+	status = subscribe(rate, outputs, &n_required);
+	if (status != BSEC_OK) {
+		LOG_ERR("Subscribing to outputs 0x%03x at %s failed: %d, keeping 0x%03x at %s",
+			outputs, rate_name(rate), status, active_outputs, rate_name(active_rate));
+		(void)subscribe(active_rate, active_outputs, &n_required);
+		atomic_set(&requested_rate, active_rate);
+		atomic_set(&requested_outputs, active_outputs);
+		return;
+	}
+
+	if (rate != active_rate) {
+		LOG_INF("BSEC sample rate %s -> %s", rate_name(active_rate), rate_name(rate));
+	}
+	if (outputs != active_outputs) {
+		LOG_INF("BSEC outputs 0x%03x -> 0x%03x, requires %d physical sensors",
+			active_outputs, outputs, n_required);
+
+		/* Deselected outputs read as 0 from now on */
+		memset(&bsec_latest, 0, sizeof(bsec_latest));
+
+		/* Only a set BSEC accepted is kept, and the flash write stays off this thread */
+		if (IS_ENABLED(CONFIG_SETTINGS)) {
+			atomic_set(&bsec_outputs_to_save, outputs);
+			(void)k_work_submit_to_queue(&bsec_state_wq, &bsec_outputs_work);
+		}
+	}
+
+	active_rate = rate;
+	active_outputs = outputs;
+	bme_settings.next_call = 0;
+}
+
+int air_ctrl_sensor_set_rate(enum air_ctrl_sensor_rate rate)
+{
+	if (rate != AIR_CTRL_SENSOR_RATE_LP && rate != AIR_CTRL_SENSOR_RATE_ULP) {
+		return -EINVAL;
+	}
+
+	if (atomic_set(&requested_rate, rate) != rate) {
+		/* Out of a 300 s ULP sleep now rather than at the next ULP sample */
+		air_ctrl_sched_kick();
+	}
+
+	return 0;
+}
+
+enum air_ctrl_sensor_rate air_ctrl_sensor_get_rate(void)
+{
+	return active_rate;
+}
+
+int air_ctrl_sensor_set_outputs(uint32_t outputs)
+{
+	if (outputs == 0 || (outputs & ~AIR_CTRL_SENSOR_OUT_ALL) != 0) {
+		return -EINVAL;
+	}
+
+	if ((uint32_t)atomic_set(&requested_outputs, outputs) == outputs) {
+		return 0;
+	}
+
+	/* Saved by resubscribe() once BSEC accepted the set */
+	air_ctrl_sched_kick();
+
+	return 0;
+}
+
+uint32_t air_ctrl_sensor_get_outputs(void)
+{
+	return active_outputs;
+}
+
 int64_t air_ctrl_sensor_get_timestamp_ns(void)
 {
 	return k_ticks_to_ns_near64(k_uptime_ticks());
 }
 
-static bool process_data(float temperature_c, float humidity_percent, float pressure_pa,
-			 float gas_ohm, int64_t timestamp_ns, air_ctrl_sensor_data_t *output)
+/* The only place where samples are floats: BSEC takes and returns them. Updates the outputs
+ * BSEC returned for this reading in output and leaves the others.
+ */
+static bool process_data(const air_ctrl_sensor_raw_t *raw, air_ctrl_sensor_data_t *output)
 {
+	const float temperature_c = (float)raw->temp_c_x100 / 100.0f;
+	const float humidity_percent = (float)raw->hum_rh_x1000 / 1000.0f;
+	const float pressure_pa = (float)raw->press_pa;
+	const float gas_ohm = (float)raw->gas_ohm;
+	const uint8_t gas_index = raw->gas_index;
+	const int64_t timestamp_ns = raw->timestamp_ns;
 	bsec_input_t inputs[BSEC_MAX_PHYSICAL_SENSOR];
 	bsec_output_t outputs[BSEC_NUMBER_OUTPUTS];
 	uint8_t n_inputs = 0;
@@ -163,7 +501,7 @@ static bool process_data(float temperature_c, float humidity_percent, float pres
 
 	if (BSEC_CHECK_INPUT(bme_settings.process_data, BSEC_INPUT_PROFILE_PART)) {
 		inputs[n_inputs].sensor_id = BSEC_INPUT_PROFILE_PART;
-		inputs[n_inputs].signal = 0.0f;
+		inputs[n_inputs].signal = (float)gas_index;
 		inputs[n_inputs].time_stamp = timestamp_ns;
 		n_inputs++;
 	}
@@ -179,11 +517,13 @@ static bool process_data(float temperature_c, float humidity_percent, float pres
 		return false;
 	}
 
-	LOG_DBG("BSEC inputs: n=%d T=%.2f H=%.2f P=%.0f Gas=%.0f", n_inputs, (double)temperature_c,
-		(double)humidity_percent, (double)pressure_pa, (double)gas_ohm);
+	LOG_DBG("BSEC inputs: n=%d T=%d/100 H=%u/1000 P=%u Gas=%u step=%u", n_inputs,
+		raw->temp_c_x100, raw->hum_rh_x1000, raw->press_pa, raw->gas_ohm, gas_index);
 
 	memset(outputs, 0, sizeof(outputs));
+	AIR_CTRL_PROF_BEGIN(AIR_CTRL_PROF_BSEC_DO_STEPS);
 	status = bsec_do_steps(bsec_instance, inputs, n_inputs, outputs, &n_outputs);
+	AIR_CTRL_PROF_END(AIR_CTRL_PROF_BSEC_DO_STEPS);
 
 	if (status != BSEC_OK) {
 		LOG_ERR("bsec_do_steps failed: %d", status);
@@ -192,105 +532,145 @@ static bool process_data(float temperature_c, float humidity_percent, float pres
 
 	LOG_DBG("bsec_do_steps: n_outputs=%d", n_outputs);
 
-	memset(output, 0, sizeof(air_ctrl_sensor_data_t));
-
 	for (uint8_t i = 0; i < n_outputs; i++) {
 		switch (outputs[i].sensor_id) {
-		case BSEC_OUTPUT_RAW_TEMPERATURE:
-			output->raw_temperature = outputs[i].signal;
-			break;
-		case BSEC_OUTPUT_RAW_HUMIDITY:
-			output->raw_humidity = outputs[i].signal;
-			break;
-		case BSEC_OUTPUT_RAW_PRESSURE:
-			output->raw_pressure = outputs[i].signal;
-			break;
-		case BSEC_OUTPUT_RAW_GAS:
-			output->raw_gas_resistance = outputs[i].signal;
-			break;
 		case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE:
-			output->temperature = outputs[i].signal;
+			output->temp_c_x100 = air_ctrl_sensor_fixed_i16(outputs[i].signal, 100.0f);
 			break;
 		case BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY:
-			output->humidity = outputs[i].signal;
+			output->hum_rh_x100 = air_ctrl_sensor_fixed_u16(outputs[i].signal, 100.0f, 0.0f);
 			break;
 		case BSEC_OUTPUT_IAQ:
-			output->iaq = outputs[i].signal;
-			output->iaq_accuracy = outputs[i].accuracy;
+			output->iaq_x10 = air_ctrl_sensor_fixed_u16(outputs[i].signal, 10.0f, 0.0f);
+			output->iaq_acc = outputs[i].accuracy;
+			bsec_state_track_accuracy(outputs[i].accuracy);
 			break;
 		case BSEC_OUTPUT_STATIC_IAQ:
-			output->static_iaq = outputs[i].signal;
+			output->static_iaq_x10 =
+				air_ctrl_sensor_fixed_u16(outputs[i].signal, 10.0f, 0.0f);
 			break;
 		case BSEC_OUTPUT_CO2_EQUIVALENT:
-			output->co2_equivalent = outputs[i].signal;
+			output->co2_eq_ppm = air_ctrl_sensor_fixed_u16(outputs[i].signal, 1.0f, 0.5f);
 			break;
 		case BSEC_OUTPUT_BREATH_VOC_EQUIVALENT:
-			output->breath_voc_equivalent = outputs[i].signal;
+			output->breath_voc_eq_ppb =
+				air_ctrl_sensor_fixed_u16(outputs[i].signal, 1000.0f, 0.5f);
 			break;
 		case BSEC_OUTPUT_GAS_PERCENTAGE:
-			output->gas_percentage = outputs[i].signal;
+			output->gas_pct_x100 = air_ctrl_sensor_fixed_u16(outputs[i].signal, 100.0f, 0.5f);
 			break;
 		case BSEC_OUTPUT_STABILIZATION_STATUS:
-			output->stabilization_status = outputs[i].signal;
+			if (outputs[i].signal > 0.5f) {
+				output->status |= AIR_CTRL_SENSOR_STABILIZED;
+			} else {
+				output->status &= ~AIR_CTRL_SENSOR_STABILIZED;
+			}
 			break;
 		case BSEC_OUTPUT_RUN_IN_STATUS:
-			output->run_in_status = outputs[i].signal;
+			if (outputs[i].signal > 0.5f) {
+				output->status |= AIR_CTRL_SENSOR_RUN_IN;
+			} else {
+				output->status &= ~AIR_CTRL_SENSOR_RUN_IN;
+			}
+			break;
+#if defined(CONFIG_AIR_CTRL_BSEC_GAS_ESTIMATES)
+		case BSEC_OUTPUT_GAS_ESTIMATE_1:
+		case BSEC_OUTPUT_GAS_ESTIMATE_2:
+		case BSEC_OUTPUT_GAS_ESTIMATE_3:
+		case BSEC_OUTPUT_GAS_ESTIMATE_4:
+			output->gas_estimate_x10000[outputs[i].sensor_id - BSEC_OUTPUT_GAS_ESTIMATE_1] =
+				air_ctrl_sensor_fixed_u16(outputs[i].signal, 10000.0f, 0.5f);
 			break;
+#endif
 		default:
+			/* Raw outputs echo the inputs, the sample has them exactly */
 			break;
 		}
-		output->timestamp_ns = outputs[i].time_stamp;
 	}
 
 	return (n_outputs > 0);
 }
 
-static bool measure_and_process(air_ctrl_sensor_data_t *output)
+static int apply_heatr_profile(void)
 {
-	struct sensor_value temp;
-	struct sensor_value pressure;
-	struct sensor_value humidity;
-	struct sensor_value gas;
-	bool need_gas = BSEC_CHECK_INPUT(bme_settings.process_data, BSEC_INPUT_GASRESISTOR);
+	struct bme680_heatr_profile profile;
+	int err;
 
-	if (sensor_sample_fetch(bme) < 0) {
-		LOG_ERR("BME680 sample fetch failed");
-		return false;
+	memset(&profile, 0, sizeof(profile));
+
+	if (bme_settings.op_mode == BME68X_PARALLEL_MODE) {
+		profile.parallel = true;
+		profile.len = MIN(bme_settings.heater_profile_len, BME680_HEATR_PROFILE_MAX_LEN);
+		memcpy(profile.temp_c, bme_settings.heater_temperature_profile,
+		       profile.len * sizeof(profile.temp_c[0]));
+		memcpy(profile.dur, bme_settings.heater_duration_profile,
+		       profile.len * sizeof(profile.dur[0]));
+	} else {
+		profile.len = 1;
+		profile.temp_c[0] = bme_settings.heater_temperature;
+		profile.dur[0] = bme_settings.heater_duration;
 	}
 
-	if (sensor_channel_get(bme, SENSOR_CHAN_AMBIENT_TEMP, &temp) ||
-	    sensor_channel_get(bme, SENSOR_CHAN_PRESS, &pressure) ||
-	    sensor_channel_get(bme, SENSOR_CHAN_HUMIDITY, &humidity)) {
-		LOG_ERR("BME680 channel read failed");
-		return false;
+	if (memcmp(&profile, &active_heatr_profile, sizeof(profile)) == 0) {
+		return 0;
 	}
 
-	if (need_gas) {
-		if (sensor_channel_get(bme, SENSOR_CHAN_GAS_RES, &gas)) {
-			LOG_ERR("BME680 gas channel read failed");
-			return false;
-		}
-	} else {
-		gas.val1 = 0;
-		gas.val2 = 0;
+	err = bme680_set_heatr_profile(bme, &profile);
+	if (err) {
+		LOG_ERR("Failed to set heater profile (err %d)", err);
+		return err;
+	}
+
+	memcpy(&active_heatr_profile, &profile, sizeof(profile));
+	LOG_INF("Heater profile: %s mode, %u step(s)", profile.parallel ? "parallel" : "forced",
+		profile.len);
+
+	return 0;
+}
+
+static int measure(air_ctrl_sensor_raw_t *raw, size_t max_raw)
+{
+	struct bme680_field fields[AIR_CTRL_SENSOR_MAX_RAW];
+	bool need_gas = BSEC_CHECK_INPUT(bme_settings.process_data, BSEC_INPUT_GASRESISTOR);
+	int64_t timestamp_ns;
+	int n_fields;
+	int count = 0;
+
+	AIR_CTRL_PROF_BEGIN(AIR_CTRL_PROF_SENSOR_FETCH);
+	n_fields = bme680_read_fields(bme, fields, MIN(max_raw, ARRAY_SIZE(fields)));
+	AIR_CTRL_PROF_END(AIR_CTRL_PROF_SENSOR_FETCH);
+	if (n_fields < 0) {
+		LOG_ERR("BME680 sample fetch failed (err %d)", n_fields);
+		return 0;
 	}
 
-	const int64_t timestamp_ns = air_ctrl_sensor_get_timestamp_ns();
+	/* All fields read in one go share a timestamp, as in the Bosch reference code */
+	timestamp_ns = air_ctrl_sensor_get_timestamp_ns();
+
+	for (int i = 0; i < n_fields; i++) {
+		if (need_gas && active_heatr_profile.parallel && !fields[i].gas_valid) {
+			LOG_DBG("Skipping field %u without valid gas reading", fields[i].meas_index);
+			continue;
+		}
 
-	const float temperature_c = (float)sensor_value_to_double(&temp);
-	const float humidity_percent = (float)sensor_value_to_double(&humidity);
-	const float pressure_pa = (float)(sensor_value_to_double(&pressure) * 1000.0);
-	const float gas_ohm = (float)gas.val1;
+		raw[count].timestamp_ns = timestamp_ns;
+		raw[count].temp_c_x100 = (int16_t)CLAMP(fields[i].temp_x100, INT16_MIN, INT16_MAX);
+		raw[count].hum_rh_x1000 = fields[i].hum_x1000;
+		raw[count].press_pa = fields[i].press_pa;
+		raw[count].gas_ohm = need_gas ? fields[i].gas_ohm : 0U;
+		raw[count].gas_index = active_heatr_profile.parallel ? fields[i].gas_index : 0U;
+		count++;
+	}
 
-	return process_data(temperature_c, humidity_percent, pressure_pa, gas_ohm, timestamp_ns, output);
+	return count;
 }
 
 int air_ctrl_sensor_init(void)
 {
 	bsec_library_return_t bsec_status;
 	bsec_version_t version;
-	bsec_sensor_configuration_t required_sensors[BSEC_MAX_PHYSICAL_SENSOR];
-	uint8_t n_required = BSEC_MAX_PHYSICAL_SENSOR;
+	uint8_t n_required;
+	struct bsec_scratch *scratch;
 	int err;
 
 	LOG_INF("Initializing BSEC integration...");
@@ -313,50 +693,82 @@ int air_ctrl_sensor_init(void)
 	}
 	LOG_INF("BSEC initialized");
 
-	memset(bsec_work_buffer, 0, sizeof(bsec_work_buffer));
+	scratch = air_ctrl_arena_acquire(AIR_CTRL_ARENA_BSEC_INIT, sizeof(*scratch), K_FOREVER);
+	if (scratch == NULL) {
+		return -ENOMEM;
+	}
+
+	memset(scratch->work_buffer, 0, sizeof(scratch->work_buffer));
 	bsec_status = bsec_set_configuration(bsec_instance, bsec_config_selectivity, BSEC_MAX_PROPERTY_BLOB_SIZE,
-					 bsec_work_buffer, BSEC_MAX_WORKBUFFER_SIZE);
+					 scratch->work_buffer, sizeof(scratch->work_buffer));
 	if (bsec_status != BSEC_OK) {
 		LOG_ERR("bsec_set_configuration failed: %d", bsec_status);
+		air_ctrl_arena_release(AIR_CTRL_ARENA_BSEC_INIT);
 		return -EIO;
 	}
 
 	if (IS_ENABLED(CONFIG_SETTINGS)) {
+		k_work_init(&bsec_state_work, bsec_state_work_handler);
+		k_work_init(&bsec_outputs_work, bsec_outputs_work_handler);
+		k_work_queue_start(&bsec_state_wq, bsec_state_wq_stack,
+				   K_THREAD_STACK_SIZEOF(bsec_state_wq_stack),
+				   K_LOWEST_APPLICATION_THREAD_PRIO, NULL);
+		k_thread_name_set(k_work_queue_thread_get(&bsec_state_wq), "bsec_state");
+
 		err = settings_register(&bsec_settings_handler);
 		if (err) {
 			LOG_ERR("settings_register failed (err %d)", err);
 		} else {
 			bsec_state_blob_valid = false;
 			bsec_state_blob_len = 0;
+			bsec_scratch = scratch;
+			bsec_state_loading = true;
 			err = settings_load_subtree("air_ctrl/bsec");
+			bsec_state_loading = false;
+			bsec_scratch = NULL;
 			if (err) {
 				LOG_ERR("settings_load_subtree failed (err %d)", err);
 			}
 
 			if (bsec_state_blob_valid && bsec_state_blob_len > 0) {
-				memset(bsec_work_buffer, 0, sizeof(bsec_work_buffer));
-				bsec_status = bsec_set_state(bsec_instance, bsec_state_blob, bsec_state_blob_len,
-							     bsec_work_buffer, sizeof(bsec_work_buffer));
+				memset(scratch->work_buffer, 0, sizeof(scratch->work_buffer));
+				bsec_status = bsec_set_state(bsec_instance, scratch->state_blob,
+							     bsec_state_blob_len, scratch->work_buffer,
+							     sizeof(scratch->work_buffer));
 				if (bsec_status != BSEC_OK) {
 					LOG_ERR("bsec_set_state failed: %d", bsec_status);
 				} else {
 					LOG_INF("Restored BSEC state (%u bytes)", (uint32_t)bsec_state_blob_len);
+					bsec_state_saved_crc =
+						crc32_ieee(scratch->state_blob, bsec_state_blob_len);
+					bsec_state_saved_len = bsec_state_blob_len;
 				}
 			}
 		}
 	}
 
-	bsec_status = bsec_update_subscription(bsec_instance, virtual_sensors, NUM_VIRTUAL_SENSORS,
-					 required_sensors, &n_required);
+	air_ctrl_arena_release(AIR_CTRL_ARENA_BSEC_INIT);
+
+	active_rate = (enum air_ctrl_sensor_rate)atomic_get(&requested_rate);
+	active_outputs = (uint32_t)atomic_get(&requested_outputs);
+	bsec_status = subscribe(active_rate, active_outputs, &n_required);
+	if (bsec_status != BSEC_OK && active_outputs != AIR_CTRL_SENSOR_OUT_ALL) {
+		LOG_WRN("Stored outputs 0x%03x rejected: %d, subscribing to all", active_outputs,
+			bsec_status);
+		active_outputs = AIR_CTRL_SENSOR_OUT_ALL;
+		atomic_set(&requested_outputs, active_outputs);
+		bsec_status = subscribe(active_rate, active_outputs, &n_required);
+	}
 	if (bsec_status != BSEC_OK) {
 		LOG_ERR("bsec_update_subscription failed: %d", bsec_status);
 		return -EIO;
 	}
-	LOG_INF("BSEC subscribed to %d virtual sensors, requires %d physical sensors", NUM_VIRTUAL_SENSORS,
-		n_required);
+	LOG_INF("BSEC subscribed to outputs 0x%03x at %s, requires %d physical sensors",
+		active_outputs, rate_name(active_rate), n_required);
 
 	memset(&bme_settings, 0, sizeof(bme_settings));
-	bsec_last_state_save_ns = air_ctrl_sensor_get_timestamp_ns();
+	memset(&bsec_latest, 0, sizeof(bsec_latest));
+	bsec_last_state_snapshot_ns = air_ctrl_sensor_get_timestamp_ns();
 
 	LOG_INF("BSEC integration initialized successfully");
 
@@ -365,41 +777,85 @@ int air_ctrl_sensor_init(void)
 
 int64_t air_ctrl_sensor_get_next_call_ns(void)
 {
+	if (subscription_pending()) {
+		return 0;
+	}
+
 	return bme_settings.next_call;
 }
 
-bool air_ctrl_sensor_run(air_ctrl_sensor_data_t *output)
+int air_ctrl_sensor_acquire(air_ctrl_sensor_raw_t *raw, size_t max_raw)
 {
 	int64_t timestamp_ns;
 	bsec_library_return_t bsec_status;
+	int count = 0;
 
-	if (output == NULL) {
-		return false;
+	if (raw == NULL || max_raw == 0) {
+		return 0;
+	}
+
+	if (subscription_pending()) {
+		resubscribe((enum air_ctrl_sensor_rate)atomic_get(&requested_rate),
+			    (uint32_t)atomic_get(&requested_outputs));
 	}
 
 	timestamp_ns = air_ctrl_sensor_get_timestamp_ns();
 
 	if (timestamp_ns < bme_settings.next_call) {
-		return false;
+		return 0;
 	}
 
+	AIR_CTRL_PROF_BEGIN(AIR_CTRL_PROF_BSEC_CONTROL);
 	bsec_status = bsec_sensor_control(bsec_instance, timestamp_ns, &bme_settings);
-	if (bsec_status != BSEC_OK) {
+	AIR_CTRL_PROF_END(AIR_CTRL_PROF_BSEC_CONTROL);
+	if (bsec_status < BSEC_OK) {
 		LOG_ERR("bsec_sensor_control failed: %d", bsec_status);
-		return false;
+		return 0;
+	}
+
+	/* Warnings still fill in bme_settings, e.g. the timing one right after a rate switch */
+	if (bsec_status > BSEC_OK) {
+		LOG_WRN("bsec_sensor_control: %d", bsec_status);
 	}
 
-	if (bme_settings.op_mode == 0) {
+	if (bme_settings.op_mode == BME68X_SLEEP_MODE || !bme_settings.trigger_measurement) {
+		return 0;
+	}
+
+	/* The bus is only up for the heater setup and the conversion */
+	if (air_ctrl_power_sensor_get() == 0 && apply_heatr_profile() == 0) {
+		count = measure(raw, max_raw);
+	}
+	air_ctrl_power_sensor_put();
+
+	return count;
+}
+
+bool air_ctrl_sensor_process(const air_ctrl_sensor_raw_t *raw, size_t n_raw,
+			     air_ctrl_sensor_data_t *output)
+{
+	const air_ctrl_sensor_raw_t *last;
+	bool updated = false;
+
+	if (raw == NULL || n_raw == 0 || output == NULL) {
 		return false;
 	}
 
-	if (bme_settings.trigger_measurement) {
-		bool ok = measure_and_process(output);
-		if (ok) {
-			bsec_state_save_if_needed(timestamp_ns);
+	/* Every heater step goes through BSEC, in order, but the cycle makes one sample */
+	for (size_t i = 0; i < n_raw; i++) {
+		if (process_data(&raw[i], &bsec_latest)) {
+			updated = true;
 		}
-		return ok;
 	}
 
-	return false;
+	if (!updated) {
+		return false;
+	}
+
+	last = &raw[n_raw - 1];
+	*output = bsec_latest;
+	air_ctrl_sensor_fill_raw(last, output);
+
+	bsec_state_save_if_needed(last->timestamp_ns);
+	return true;
 }
@@ -7,16 +7,24 @@
 #include <errno.h>
 #include <string.h>
 
+#include "air_ctrl_power.h"
+#include "air_ctrl_prof.h"
+#include "air_ctrl_sched.h"
 #include "air_ctrl_sensor.h"
 
 LOG_MODULE_REGISTER(air_ctrl_sensor, LOG_LEVEL_DBG);
 
-#define RAW_SAMPLE_PERIOD_NS (3LL * 1000000000LL)
+/* Same periods as BSEC LP and ULP */
+#define RAW_SAMPLE_PERIOD_LP_NS (3LL * 1000000000LL)
+#define RAW_SAMPLE_PERIOD_ULP_NS (300LL * 1000000000LL)
 
 static const struct device *const bme = DEVICE_DT_GET_ONE(bosch_bme680);
 
 static int64_t next_call_ns;
 
+static atomic_t requested_rate = ATOMIC_INIT(AIR_CTRL_SENSOR_RATE_LP);
+static enum air_ctrl_sensor_rate active_rate = AIR_CTRL_SENSOR_RATE_LP;
+
 int64_t air_ctrl_sensor_get_timestamp_ns(void)
 {
 	return k_ticks_to_ns_near64(k_uptime_ticks());
@@ -36,30 +44,80 @@ int air_ctrl_sensor_init(void)
 
 int64_t air_ctrl_sensor_get_next_call_ns(void)
 {
+	if (atomic_get(&requested_rate) != active_rate) {
+		return 0;
+	}
+
 	return next_call_ns;
 }
 
-bool air_ctrl_sensor_run(air_ctrl_sensor_data_t *output)
+int air_ctrl_sensor_set_rate(enum air_ctrl_sensor_rate rate)
+{
+	if (rate != AIR_CTRL_SENSOR_RATE_LP && rate != AIR_CTRL_SENSOR_RATE_ULP) {
+		return -EINVAL;
+	}
+
+	if (atomic_set(&requested_rate, rate) != rate) {
+		air_ctrl_sched_kick();
+	}
+
+	return 0;
+}
+
+enum air_ctrl_sensor_rate air_ctrl_sensor_get_rate(void)
+{
+	return active_rate;
+}
+
+int air_ctrl_sensor_set_outputs(uint32_t outputs)
+{
+	ARG_UNUSED(outputs);
+
+	return -ENOTSUP;
+}
+
+uint32_t air_ctrl_sensor_get_outputs(void)
+{
+	return AIR_CTRL_SENSOR_OUT_ALL;
+}
+
+int air_ctrl_sensor_acquire(air_ctrl_sensor_raw_t *raw, size_t max_raw)
 {
 	struct sensor_value temp;
 	struct sensor_value pressure;
 	struct sensor_value humidity;
 	struct sensor_value gas;
 	int64_t timestamp_ns;
+	int err;
 
-	if (output == NULL) {
-		return false;
+	if (raw == NULL || max_raw == 0) {
+		return 0;
+	}
+
+	if ((enum air_ctrl_sensor_rate)atomic_get(&requested_rate) != active_rate) {
+		active_rate = (enum air_ctrl_sensor_rate)atomic_get(&requested_rate);
+		LOG_INF("Sample rate %s", (active_rate == AIR_CTRL_SENSOR_RATE_ULP) ? "ULP" : "LP");
+		next_call_ns = 0;
 	}
 
 	timestamp_ns = air_ctrl_sensor_get_timestamp_ns();
 	if (timestamp_ns < next_call_ns) {
-		return false;
+		return 0;
 	}
 
-	if (sensor_sample_fetch(bme) < 0) {
+	next_call_ns = timestamp_ns + ((active_rate == AIR_CTRL_SENSOR_RATE_ULP) ?
+				       RAW_SAMPLE_PERIOD_ULP_NS : RAW_SAMPLE_PERIOD_LP_NS);
+
+	err = air_ctrl_power_sensor_get();
+	if (err == 0) {
+		AIR_CTRL_PROF_BEGIN(AIR_CTRL_PROF_SENSOR_FETCH);
+		err = sensor_sample_fetch(bme);
+		AIR_CTRL_PROF_END(AIR_CTRL_PROF_SENSOR_FETCH);
+	}
+	air_ctrl_power_sensor_put();
+	if (err < 0) {
 		LOG_ERR("BME680 sample fetch failed");
-		next_call_ns = timestamp_ns + RAW_SAMPLE_PERIOD_NS;
-		return false;
+		return 0;
 	}
 
 	if (sensor_channel_get(bme, SENSOR_CHAN_AMBIENT_TEMP, &temp) ||
@@ -67,21 +125,33 @@ bool air_ctrl_sensor_run(air_ctrl_sensor_data_t *output)
 		sensor_channel_get(bme, SENSOR_CHAN_HUMIDITY, &humidity) ||
 		sensor_channel_get(bme, SENSOR_CHAN_GAS_RES, &gas)) {
 		LOG_ERR("BME680 channel read failed");
-		next_call_ns = timestamp_ns + RAW_SAMPLE_PERIOD_NS;
+		return 0;
+	}
+
+	/* Integer only: degC, %RH and kPa in milli units */
+	raw->timestamp_ns = timestamp_ns;
+	raw->temp_c_x100 = (int16_t)CLAMP(sensor_value_to_milli(&temp) / 10, INT16_MIN, INT16_MAX);
+	raw->hum_rh_x1000 = (uint32_t)MAX(sensor_value_to_milli(&humidity), 0);
+	raw->press_pa = (uint32_t)MAX(sensor_value_to_milli(&pressure), 0);
+	raw->gas_ohm = (uint32_t)MAX(gas.val1, 0);
+	raw->gas_index = 0;
+
+	return 1;
+}
+
+bool air_ctrl_sensor_process(const air_ctrl_sensor_raw_t *raw, size_t n_raw,
+			     air_ctrl_sensor_data_t *output)
+{
+	if (raw == NULL || n_raw == 0 || output == NULL) {
 		return false;
 	}
 
 	memset(output, 0, sizeof(*output));
 
-	output->timestamp_ns = timestamp_ns;
-	output->raw_temperature = (float)sensor_value_to_double(&temp);
-	output->raw_humidity = (float)sensor_value_to_double(&humidity);
-	output->raw_pressure = (float)(sensor_value_to_double(&pressure) * 1000.0);
-	output->raw_gas_resistance = (float)gas.val1;
-
-	output->temperature = output->raw_temperature;
-	output->humidity = output->raw_humidity;
+	/* One reading per acquisition here, the newest one if there were more */
+	air_ctrl_sensor_fill_raw(&raw[n_raw - 1], output);
+	output->temp_c_x100 = output->raw_temp_c_x100;
+	output->hum_rh_x100 = output->raw_hum_rh_x100;
 
-	next_call_ns = timestamp_ns + RAW_SAMPLE_PERIOD_NS;
 	return true;
 }
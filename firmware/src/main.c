@@ -2,8 +2,16 @@
 #include <zephyr/logging/log.h>
 #include <zephyr/sys/util.h>
 
+#include <stdlib.h>
+
 #include "air_ctrl_sensor.h"
+#include "air_ctrl_agg.h"
 #include "air_ctrl_bt.h"
+#include "air_ctrl_display.h"
+#include "air_ctrl_pipeline.h"
+#include "air_ctrl_rate.h"
+#include "air_ctrl_history.h"
+#include "air_ctrl_rtt_stream.h"
 
 LOG_MODULE_REGISTER(app, LOG_LEVEL_INF);
 
@@ -11,6 +19,16 @@ int main(void)
 {
 	int err;
 	air_ctrl_sensor_data_t sensor_data;
+	air_ctrl_agg_summary_t closed[AIR_CTRL_AGG_LEVEL_COUNT];
+	size_t closed_count;
+
+	/* Before BT, so sample numbering resumes after the stored history */
+	if (IS_ENABLED(CONFIG_AIR_CTRL_HISTORY)) {
+		err = air_ctrl_history_init();
+		if (err) {
+			LOG_ERR("History init failed: %d", err);
+		}
+	}
 
 	err = air_ctrl_bt_init();
 	if (err) {
@@ -19,6 +37,11 @@ int main(void)
 
 	LOG_INF("Air-ctrl device starting...");
 
+	err = air_ctrl_display_init();
+	if (err) {
+		LOG_ERR("Display init failed: %d", err);
+	}
+
 	err = air_ctrl_sensor_init();
 	if (err != 0) {
 		LOG_ERR("Sensor integration init failed: %d", err);
@@ -32,41 +55,78 @@ int main(void)
 	LOG_INF("Raw sensor mode initialized, starting sensor loop...");
 	#endif
 
+	if (IS_ENABLED(CONFIG_AIR_CTRL_RTT_STREAM)) {
+		err = air_ctrl_rtt_stream_init();
+		if (err) {
+			LOG_ERR("RTT sample stream init failed: %d", err);
+		}
+	}
+
+	err = air_ctrl_pipeline_start();
+	if (err != 0) {
+		LOG_ERR("Sensor pipeline start failed: %d", err);
+		return 0;
+	}
+
 	while (true) {
-		if (air_ctrl_sensor_run(&sensor_data)) {
+		if (air_ctrl_pipeline_get(&sensor_data, K_FOREVER) == 0) {
+			if (IS_ENABLED(CONFIG_AIR_CTRL_RTT_STREAM)) {
+				(void)air_ctrl_rtt_stream_write(&sensor_data);
+			}
+
+			#if IS_ENABLED(CONFIG_AIR_CTRL_LOG_SAMPLES)
 			#if IS_ENABLED(CONFIG_AIR_CTRL_USE_BSEC)
+			/* Fixed-point columns, live_plot.py divides the _xN ones back */
 			LOG_INF(
-				"ts_ns,temp_raw_c,temp_comp_c,hum_raw_rh,hum_comp_rh,press_raw_pa,gas_raw_ohm,iaq,iaq_acc,static_iaq,co2_eq_ppm,breath_voc_eq_ppm,gas_pct,stabilized,run_in"
+				"ts_ns,temp_raw_c_x100,temp_comp_c_x100,hum_raw_rh_x100,hum_comp_rh_x100,press_raw_pa,gas_raw_ohm,iaq_x10,iaq_acc,static_iaq_x10,co2_eq_ppm,breath_voc_eq_ppm_x1000,gas_pct_x100,stabilized,run_in"
 			);
 			LOG_INF(
-				"%lld,%.2f,%.2f,%.2f,%.2f,%.0f,%.0f,%.1f,%u,%.1f,%.0f,%.3f,%.1f,%u,%u",
-				(long long)sensor_data.timestamp_ns,
-				sensor_data.raw_temperature,
-				sensor_data.temperature,
-				sensor_data.raw_humidity,
-				sensor_data.humidity,
-				sensor_data.raw_pressure,
-				sensor_data.raw_gas_resistance,
-				sensor_data.iaq,
-				sensor_data.iaq_accuracy,
-				sensor_data.static_iaq,
-				sensor_data.co2_equivalent,
-				sensor_data.breath_voc_equivalent,
-				sensor_data.gas_percentage,
-				sensor_data.stabilization_status > 0.5f ? 1U : 0U,
-				sensor_data.run_in_status > 0.5f ? 1U : 0U
+				"%lld,%d,%d,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u,%u",
+				(long long)sensor_data.timestamp_ms * 1000000LL,
+				sensor_data.raw_temp_c_x100,
+				sensor_data.temp_c_x100,
+				sensor_data.raw_hum_rh_x100,
+				sensor_data.hum_rh_x100,
+				sensor_data.press_pa,
+				sensor_data.gas_ohm,
+				sensor_data.iaq_x10,
+				sensor_data.iaq_acc,
+				sensor_data.static_iaq_x10,
+				sensor_data.co2_eq_ppm,
+				sensor_data.breath_voc_eq_ppb,
+				sensor_data.gas_pct_x100,
+				(sensor_data.status & AIR_CTRL_SENSOR_STABILIZED) ? 1U : 0U,
+				(sensor_data.status & AIR_CTRL_SENSOR_RUN_IN) ? 1U : 0U
 			);
+			#if IS_ENABLED(CONFIG_AIR_CTRL_BSEC_GAS_ESTIMATES)
+			LOG_INF("gas_estimates_x10000,%u,%u,%u,%u",
+				sensor_data.gas_estimate_x10000[0], sensor_data.gas_estimate_x10000[1],
+				sensor_data.gas_estimate_x10000[2], sensor_data.gas_estimate_x10000[3]);
+			#endif
 			#else
 			LOG_INF("=== BME688 Raw Data ===");
-			LOG_INF("  Temperature: %.2f \u00b0C", sensor_data.raw_temperature);
-			LOG_INF("  Humidity: %.2f %%RH", sensor_data.raw_humidity);
-			LOG_INF("  Pressure: %.2f hPa", sensor_data.raw_pressure / 100.0);
-			LOG_INF("  Gas Resistance: %.0f Ohm", sensor_data.raw_gas_resistance);
+			LOG_INF("  Temperature: %s%u.%02u \u00b0C",
+				sensor_data.raw_temp_c_x100 < 0 ? "-" : "",
+				abs(sensor_data.raw_temp_c_x100) / 100U,
+				abs(sensor_data.raw_temp_c_x100) % 100U);
+			LOG_INF("  Humidity: %u.%02u %%RH", sensor_data.raw_hum_rh_x100 / 100U,
+				sensor_data.raw_hum_rh_x100 % 100U);
+			LOG_INF("  Pressure: %u.%02u hPa", sensor_data.press_pa / 100U,
+				sensor_data.press_pa % 100U);
+			LOG_INF("  Gas Resistance: %u Ohm", sensor_data.gas_ohm);
 			#endif
+			#endif /* CONFIG_AIR_CTRL_LOG_SAMPLES */
 
 			(void)air_ctrl_bt_notify_sensor_data(&sensor_data);
-		}
 
-		k_sleep(K_MSEC(100));
+			closed_count = air_ctrl_agg_add(&sensor_data, closed);
+			if (closed_count > 0) {
+				(void)air_ctrl_bt_notify_aggregates(closed, closed_count);
+			}
+
+			air_ctrl_rate_update(&sensor_data);
+
+			air_ctrl_display_update(&sensor_data);
+		}
 	}
 }
@@ -0,0 +1,33 @@
+/*
+ * Shared by the benchmark files: the timing loop and the comparison with the baseline.
+ */
+
+#ifndef BENCH_H_
+#define BENCH_H_
+
+#include <zephyr/kernel.h>
+
+#include <stdint.h>
+
+#define ITERATIONS 1000U
+
+/* Cycles of ITERATIONS runs of body, i counting up. Results must go to a static so the
+ * barrier keeps them.
+ */
+#define BENCH(cycles, body)                                                                        \
+	do {                                                                                       \
+		uint32_t start_ = k_cycle_get_32();                                                \
+                                                                                                   \
+		for (uint32_t i = 0; i < ITERATIONS; i++) {                                        \
+			body;                                                                      \
+			compiler_barrier();                                                        \
+		}                                                                                  \
+		(cycles) = k_cycle_get_32() - start_;                                              \
+	} while (0)
+
+/* Prints the count as a BASELINE() line and fails the test when the board has no baseline
+ * for name or the count is above it by more than the tolerance
+ */
+void bench_check(const char *name, uint32_t cycles);
+
+#endif /* BENCH_H_ */
@@ -0,0 +1,211 @@
+/*
+ * Cycle counts of the per-sample path against a stored baseline (baseline/<board>.inc):
+ * the fixed-point and encoding helpers here, the sensor backend in sensor_raw.c or
+ * sensor_bsec.c. Every benchmark prints its count as a BASELINE() line, the format of the
+ * baseline file, and fails without a recorded count or when it is more than
+ * CONFIG_AIR_CTRL_BENCH_TOLERANCE_PCT slower than that count.
+ */
+
+#include <zephyr/kernel.h>
+#include <zephyr/sys/crc.h>
+#include <zephyr/ztest.h>
+
+#include <stddef.h>
+#include <string.h>
+
+#include "air_ctrl_ble_proto.h"
+#include "air_ctrl_bt_filter.h"
+#include "air_ctrl_rtt_codec.h"
+#include "air_ctrl_sensor.h"
+#include "bench.h"
+
+static const struct {
+	const char *name;
+	uint32_t cycles;
+} baselines[] = {
+#if defined(BENCH_BASELINE)
+#define BASELINE(name, cycles) {#name, cycles},
+#include BENCH_BASELINE
+#undef BASELINE
+#endif
+	{NULL, 0},
+};
+
+/* Same frame as air_ctrl_rtt_stream.c writes */
+struct __packed rtt_frame {
+	uint8_t sync[2];
+	uint8_t version;
+	uint8_t len;
+	struct air_ctrl_rtt_record_v2 record;
+	uint16_t crc;
+};
+
+static uint32_t loop_cycles;
+
+static air_ctrl_sensor_data_t data;
+static air_ctrl_sensor_raw_t raw;
+static struct air_ctrl_ble_values values;
+static struct air_ctrl_ble_sample_v2 sample;
+static struct air_ctrl_ble_batch_entry_v3 entry;
+static struct air_ctrl_ble_alert_v5 alerts[AIR_CTRL_BLE_ALERT_COUNT];
+static struct rtt_frame frame;
+static uint8_t packed[sizeof(struct air_ctrl_ble_sample_v2)];
+static volatile uint32_t sink;
+
+void bench_check(const char *name, uint32_t cycles)
+{
+	uint32_t baseline = 0;
+	uint32_t limit;
+
+	/* No cycle counter worth the name, e.g. time standing still on native_sim */
+	if (cycles == 0) {
+		ztest_test_skip();
+	}
+
+	/* At least 1, a 0 entry in the baseline reads as not recorded */
+	cycles = (cycles > loop_cycles) ? cycles - loop_cycles : 1;
+	TC_PRINT("BASELINE(%s, %u)\n", name, cycles);
+
+	for (size_t i = 0; baselines[i].name != NULL; i++) {
+		if (strcmp(baselines[i].name, name) == 0) {
+			baseline = baselines[i].cycles;
+			break;
+		}
+	}
+
+	zassert_true(baseline > 0, "%s: no baseline for %s, add BASELINE(%s, %u) to baseline/%s.inc",
+		     name, CONFIG_BOARD, name, cycles, CONFIG_BOARD);
+
+	limit = baseline + baseline * CONFIG_AIR_CTRL_BENCH_TOLERANCE_PCT / 100U;
+	zassert_true(cycles <= limit, "%s: %u cycles, baseline %u + %u%%", name, cycles, baseline,
+		     CONFIG_AIR_CTRL_BENCH_TOLERANCE_PCT);
+
+	if (cycles < baseline - baseline * CONFIG_AIR_CTRL_BENCH_TOLERANCE_PCT / 100U) {
+		TC_PRINT("%s: %u cycles, well under the baseline of %u, consider updating it\n",
+			 name, cycles, baseline);
+	}
+}
+
+ZTEST(air_ctrl_bench, test_fixed_i16)
+{
+	uint32_t cycles;
+
+	BENCH(cycles, data.temp_c_x100 = air_ctrl_sensor_fixed_i16((float)i * 0.37f - 40.0f,
+								    100.0f));
+	bench_check("fixed_i16", cycles);
+}
+
+ZTEST(air_ctrl_bench, test_fixed_u16)
+{
+	uint32_t cycles;
+
+	BENCH(cycles, data.co2_eq_ppm = air_ctrl_sensor_fixed_u16((float)i * 1.7f, 1.0f, 0.5f));
+	bench_check("fixed_u16", cycles);
+}
+
+ZTEST(air_ctrl_bench, test_fill_raw)
+{
+	uint32_t cycles;
+
+	BENCH(cycles, {
+		raw.timestamp_ns = (int64_t)i * 3000000000LL;
+		raw.hum_rh_x1000 = i * 100U;
+		air_ctrl_sensor_fill_raw(&raw, &data);
+	});
+	bench_check("fill_raw", cycles);
+}
+
+ZTEST(air_ctrl_bench, test_ble_scale)
+{
+	uint32_t cycles;
+
+	BENCH(cycles, {
+		data.iaq_x10 = (uint16_t)i;
+		air_ctrl_ble_scale(&data, &values);
+	});
+	bench_check("ble_scale", cycles);
+}
+
+ZTEST(air_ctrl_bench, test_encode_sample_v2)
+{
+	uint32_t cycles;
+
+	BENCH(cycles, air_ctrl_ble_encode_sample_v2((uint16_t)i, i * 3000U, &values, &sample));
+	bench_check("encode_sample_v2", cycles);
+}
+
+ZTEST(air_ctrl_bench, test_encode_batch_entry_v3)
+{
+	uint32_t cycles;
+
+	BENCH(cycles, air_ctrl_ble_encode_batch_entry_v3((uint16_t)i, &values, &entry));
+	bench_check("encode_batch_entry_v3", cycles);
+}
+
+/* The compact form is the one with work to do, the full sample is a copy */
+ZTEST(air_ctrl_bench, test_pack_sample_compact)
+{
+	uint32_t cycles;
+
+	air_ctrl_ble_encode_sample_v2(0, 0, &values, &sample);
+	BENCH(cycles, sink = air_ctrl_ble_pack_sample(&sample,
+						      AIR_CTRL_SENSOR_OUT_TEMP |
+						      AIR_CTRL_SENSOR_OUT_HUM |
+						      AIR_CTRL_SENSOR_OUT_IAQ | (i & 1U),
+						      packed));
+	bench_check("pack_sample_compact", cycles);
+}
+
+/* Alternates in and out of the band, so both outcomes are timed */
+ZTEST(air_ctrl_bench, test_deadband_pass)
+{
+	struct air_ctrl_bt_deadband deadband = {0};
+	uint32_t cycles;
+
+	BENCH(cycles, {
+		values.temp_c_x100 =
+			(int16_t)(2000 + (i & 2U) * CONFIG_AIR_CTRL_BT_DEADBAND_TEMP_X100);
+		sample.flags = 0;
+		sink = air_ctrl_bt_deadband_pass(&deadband, &values, i * 3000U, &sample.flags);
+		if (sink) {
+			air_ctrl_bt_deadband_sent(&deadband, &values, i * 3000U, sample.flags);
+		}
+	});
+	bench_check("deadband_pass", cycles);
+}
+
+/* Below the thresholds: the case of almost every sample */
+ZTEST(air_ctrl_bench, test_alerts_update)
+{
+	uint32_t cycles;
+
+	values.iaq_x10 = 250;
+	values.co2_eq_ppm = 600;
+	BENCH(cycles, sink = air_ctrl_bt_alerts_update((uint16_t)i, i * 3000U, &values, alerts));
+	bench_check("alerts_update", cycles);
+}
+
+ZTEST(air_ctrl_bench, test_rtt_frame_crc)
+{
+	uint32_t cycles;
+
+	frame.version = AIR_CTRL_RTT_VERSION;
+	frame.len = sizeof(frame.record);
+	BENCH(cycles, {
+		frame.record.seq = (uint16_t)i;
+		frame.crc = crc16_itu_t(0xffff, &frame.version,
+					offsetof(struct rtt_frame, crc) -
+						offsetof(struct rtt_frame, version));
+	});
+	bench_check("rtt_frame_crc", cycles);
+}
+
+static void *setup(void)
+{
+	BENCH(loop_cycles, sink = i);
+	TC_PRINT("Loop overhead: %u cycles per %u iterations\n", loop_cycles, ITERATIONS);
+
+	return NULL;
+}
+
+ZTEST_SUITE(air_ctrl_bench, NULL, setup, NULL, NULL, NULL);
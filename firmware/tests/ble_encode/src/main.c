@@ -0,0 +1,445 @@
+/*
+ * The encoding half of air_ctrl_bt_notify_sensor_data(): a sample through
+ * air_ctrl_ble_scale(), the v2/v3/v6 encoders, the deadband and the alerts, checked with the
+ * decoders gateways use (air_ctrl_ble_codec.h).
+ */
+
+#include <zephyr/ztest.h>
+
+#include <string.h>
+
+#include "air_ctrl_ble_proto.h"
+#include "air_ctrl_bt_filter.h"
+#include "air_ctrl_sensor.h"
+
+/* What one notify call produces, before anything goes to GATT */
+struct notified {
+	struct air_ctrl_ble_values values;
+	struct air_ctrl_ble_sample_v2 sample;
+	struct air_ctrl_ble_batch_entry_v3 entry;
+	uint8_t packed[sizeof(struct air_ctrl_ble_sample_v2)];
+	size_t packed_len;
+	bool live;
+	struct air_ctrl_ble_adv_v1 adv;
+	struct air_ctrl_ble_alert_v5 alerts[AIR_CTRL_BLE_ALERT_COUNT];
+	size_t alert_count;
+};
+
+/* Deadband of the one subscribed central, and whether its notifications fail (-EBUSY) */
+static struct air_ctrl_bt_deadband deadband;
+static bool notify_fails;
+
+/* Same steps and order as air_ctrl_bt_notify_sensor_data() */
+static void notify(uint16_t seq, const air_ctrl_sensor_data_t *data, uint32_t outputs,
+		   struct notified *out)
+{
+	air_ctrl_ble_scale(data, &out->values);
+	air_ctrl_ble_encode_sample_v2(seq, data->timestamp_ms, &out->values, &out->sample);
+	air_ctrl_ble_encode_batch_entry_v3(0U, &out->values, &out->entry);
+	out->live = air_ctrl_bt_deadband_pass(&deadband, &out->values, data->timestamp_ms,
+					      &out->sample.flags);
+	out->packed_len = air_ctrl_ble_pack_sample(&out->sample, outputs, out->packed);
+	if (out->live && !notify_fails) {
+		air_ctrl_bt_deadband_sent(&deadband, &out->values, data->timestamp_ms,
+					  out->sample.flags);
+	}
+	air_ctrl_ble_encode_adv_v1(seq, &out->values, &out->adv);
+	out->alert_count =
+		air_ctrl_bt_alerts_update(seq, data->timestamp_ms, &out->values, out->alerts);
+}
+
+static air_ctrl_sensor_data_t sample_data(void)
+{
+	return (air_ctrl_sensor_data_t){
+		.timestamp_ms = 123456,
+		.raw_temp_c_x100 = -1234,
+		.temp_c_x100 = -1300,
+		.raw_hum_rh_x100 = 4567,
+		.hum_rh_x100 = 4400,
+		.press_pa = 101325,
+		.gas_ohm = 152340,
+		.iaq_x10 = 253,
+		.static_iaq_x10 = 260,
+		.co2_eq_ppm = 612,
+		.breath_voc_eq_ppb = 1250,
+		.gas_pct_x100 = 4213,
+		.iaq_acc = 3,
+		.status = AIR_CTRL_SENSOR_STABILIZED,
+	};
+}
+
+/* The transmitted fields are the measured ones, not the heat compensated ones */
+ZTEST(air_ctrl_ble_encode, test_scale)
+{
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_values values;
+
+	memset(&values, 0xa5, sizeof(values));
+	air_ctrl_ble_scale(&data, &values);
+
+	zassert_equal(values.temp_c_x100, -1234);
+	zassert_equal(values.hum_rh_x100, 4567U);
+	zassert_equal(values.gas_ohm, 152340U);
+	zassert_equal(values.iaq_x10, 253U);
+	zassert_equal(values.iaq_acc, 3U);
+	zassert_equal(values.co2_eq_ppm, 612U);
+	zassert_equal(values.breath_voc_eq_ppb, 1250U);
+}
+
+ZTEST(air_ctrl_ble_encode, test_sample_v2)
+{
+	static const uint8_t expected[] = {
+		0x02, 0x00, 0x34, 0x12,		/* version, flags, seq */
+		0x40, 0xe2, 0x01, 0x00,		/* 123456 ms */
+		0x2e, 0xfb, 0xd7, 0x11,		/* -12.34 degC, 45.67 %RH */
+		0x14, 0x53, 0x02, 0x00,		/* 152340 ohm */
+		0xfd, 0x00, 0x03,		/* IAQ 25.3, accuracy 3 */
+		0x64, 0x02, 0xe2, 0x04,		/* 612 ppm, 1250 ppb */
+	};
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_values values;
+	struct air_ctrl_ble_sample_v2 sample;
+	struct air_ctrl_ble_sample decoded;
+
+	air_ctrl_ble_scale(&data, &values);
+	air_ctrl_ble_encode_sample_v2(0x1234, data.timestamp_ms, &values, &sample);
+	zassert_equal(sizeof(sample), sizeof(expected));
+	zassert_mem_equal(&sample, expected, sizeof(expected));
+
+	zassert_ok(air_ctrl_ble_decode_sample((const uint8_t *)&sample, sizeof(sample), &decoded));
+	zassert_equal(decoded.version, AIR_CTRL_BLE_VERSION_SAMPLE);
+	zassert_equal(decoded.seq, 0x1234);
+	zassert_equal(decoded.timestamp_ms, 123456U);
+	zassert_equal(decoded.fields, AIR_CTRL_BLE_SAMPLE_FIELDS);
+
+	/* Field by field, struct air_ctrl_ble_values has padding */
+	zassert_equal(decoded.values.temp_c_x100, values.temp_c_x100);
+	zassert_equal(decoded.values.hum_rh_x100, values.hum_rh_x100);
+	zassert_equal(decoded.values.gas_ohm, values.gas_ohm);
+	zassert_equal(decoded.values.iaq_x10, values.iaq_x10);
+	zassert_equal(decoded.values.iaq_acc, values.iaq_acc);
+	zassert_equal(decoded.values.co2_eq_ppm, values.co2_eq_ppm);
+	zassert_equal(decoded.values.breath_voc_eq_ppb, values.breath_voc_eq_ppb);
+}
+
+/* A reading at the ends of every range, from the driver to the decoded notification */
+ZTEST(air_ctrl_ble_encode, test_clamp)
+{
+	const air_ctrl_sensor_raw_t raw = {
+		.timestamp_ns = -5,
+		.temp_c_x100 = INT16_MIN,
+		.hum_rh_x1000 = UINT32_MAX,
+		.press_pa = UINT32_MAX,
+		.gas_ohm = UINT32_MAX,
+	};
+	air_ctrl_sensor_data_t data = {0};
+	struct air_ctrl_ble_values values;
+	struct air_ctrl_ble_sample_v2 sample;
+	struct air_ctrl_ble_sample decoded;
+
+	air_ctrl_sensor_fill_raw(&raw, &data);
+	data.iaq_x10 = UINT16_MAX;
+	data.co2_eq_ppm = UINT16_MAX;
+	data.breath_voc_eq_ppb = UINT16_MAX;
+	zassert_equal(data.timestamp_ms, 0U);
+	zassert_equal(data.raw_hum_rh_x100, UINT16_MAX);
+
+	air_ctrl_ble_scale(&data, &values);
+	air_ctrl_ble_encode_sample_v2(UINT16_MAX, data.timestamp_ms, &values, &sample);
+	zassert_ok(air_ctrl_ble_decode_sample((const uint8_t *)&sample, sizeof(sample), &decoded));
+
+	zassert_equal(decoded.seq, UINT16_MAX);
+	zassert_equal(decoded.timestamp_ms, 0U);
+	zassert_equal(decoded.values.temp_c_x100, INT16_MIN);
+	zassert_equal(decoded.values.hum_rh_x100, UINT16_MAX);
+	zassert_equal(decoded.values.gas_ohm, UINT32_MAX);
+	zassert_equal(decoded.values.iaq_x10, UINT16_MAX);
+	zassert_equal(decoded.values.co2_eq_ppm, UINT16_MAX);
+	zassert_equal(decoded.values.breath_voc_eq_ppb, UINT16_MAX);
+
+	/* An uptime past 2^32 ms is kept in the sample and wraps on the wire */
+	air_ctrl_sensor_fill_raw(&(air_ctrl_sensor_raw_t){.timestamp_ns = (1LL << 32) * 1000000LL +
+								       1000000LL},
+				 &data);
+	zassert_equal(data.timestamp_ms, (1ULL << 32) + 1U);
+	air_ctrl_ble_encode_sample_v2(0, data.timestamp_ms, &values, &sample);
+	zassert_ok(air_ctrl_ble_decode_sample((const uint8_t *)&sample, sizeof(sample), &decoded));
+	zassert_equal(decoded.timestamp_ms, 1U);
+}
+
+ZTEST(air_ctrl_ble_encode, test_batch)
+{
+	static const uint16_t dt_ms[] = {0, 3000, 2999, 65535};
+	struct {
+		struct air_ctrl_ble_batch_hdr_v3 hdr;
+		struct air_ctrl_ble_batch_entry_v3 entries[ARRAY_SIZE(dt_ms)];
+	} __packed batch;
+	struct air_ctrl_ble_sample decoded[ARRAY_SIZE(dt_ms)];
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_values values;
+	uint32_t timestamp_ms = 4294960000U;
+
+	batch.hdr.version = AIR_CTRL_BLE_VERSION_BATCH;
+	batch.hdr.count = ARRAY_SIZE(dt_ms);
+	batch.hdr.base_seq = air_ctrl_ble_le16(UINT16_MAX - 1);
+	batch.hdr.base_timestamp_ms = air_ctrl_ble_le32(timestamp_ms);
+
+	for (size_t i = 0; i < ARRAY_SIZE(dt_ms); i++) {
+		data.raw_temp_c_x100 = (int16_t)(-100 * (int)i);
+		data.co2_eq_ppm = (uint16_t)(400 + i);
+		air_ctrl_ble_scale(&data, &values);
+		air_ctrl_ble_encode_batch_entry_v3(dt_ms[i], &values, &batch.entries[i]);
+	}
+
+	zassert_equal(air_ctrl_ble_decode_batch((const uint8_t *)&batch, sizeof(batch), decoded,
+						ARRAY_SIZE(decoded)),
+		      (int)ARRAY_SIZE(dt_ms));
+
+	for (size_t i = 0; i < ARRAY_SIZE(dt_ms); i++) {
+		timestamp_ms += dt_ms[i];
+		zassert_equal(decoded[i].seq, (uint16_t)(UINT16_MAX - 1 + i), "seq wraps");
+		zassert_equal(decoded[i].timestamp_ms, timestamp_ms, "timestamp wraps");
+		zassert_equal(decoded[i].values.temp_c_x100, -100 * (int)i);
+		zassert_equal(decoded[i].values.co2_eq_ppm, 400 + i);
+		zassert_equal(decoded[i].values.gas_ohm, 152340U);
+	}
+}
+
+/* The full sample while every field is subscribed, the compact one otherwise */
+ZTEST(air_ctrl_ble_encode, test_pack)
+{
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_sample decoded;
+	struct notified n;
+
+	notify(7, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_equal(n.packed_len, sizeof(struct air_ctrl_ble_sample_v2));
+	zassert_mem_equal(n.packed, &n.sample, sizeof(n.sample));
+
+	notify(8, &data, AIR_CTRL_SENSOR_OUT_IAQ | AIR_CTRL_SENSOR_OUT_TEMP, &n);
+	zassert_equal(n.packed_len, sizeof(struct air_ctrl_ble_sample_hdr_v6) + 2 + 3);
+	zassert_ok(air_ctrl_ble_decode_sample(n.packed, n.packed_len, &decoded));
+	zassert_equal(decoded.version, AIR_CTRL_BLE_VERSION_SAMPLE_COMPACT);
+	zassert_equal(decoded.seq, 8U);
+	zassert_equal(decoded.timestamp_ms, 123456U);
+	zassert_equal(decoded.fields, AIR_CTRL_BLE_FIELD_TEMP | AIR_CTRL_BLE_FIELD_IAQ);
+	zassert_equal(decoded.values.temp_c_x100, -1234);
+	zassert_equal(decoded.values.iaq_x10, 253U);
+	zassert_equal(decoded.values.iaq_acc, 3U);
+	zassert_equal(decoded.values.gas_ohm, 0U, "not sent");
+
+	/* Outputs without a sample field leave only the header */
+	notify(9, &data, AIR_CTRL_SENSOR_OUT_STATIC_IAQ | AIR_CTRL_SENSOR_OUT_STATUS, &n);
+	zassert_equal(n.packed_len, sizeof(struct air_ctrl_ble_sample_hdr_v6));
+	zassert_ok(air_ctrl_ble_decode_sample(n.packed, n.packed_len, &decoded));
+	zassert_equal(decoded.fields, 0U);
+
+	/* Pressure is not a sample field, leaving it out still sends the full sample */
+	notify(10, &data, AIR_CTRL_SENSOR_OUT_ALL & ~AIR_CTRL_SENSOR_OUT_PRESS, &n);
+	zassert_equal(n.packed_len, sizeof(struct air_ctrl_ble_sample_v2));
+}
+
+ZTEST(air_ctrl_ble_encode, test_adv)
+{
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_sample decoded;
+	struct notified n;
+
+	notify(0xbeef, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_ok(air_ctrl_ble_decode_adv((const uint8_t *)&n.adv, sizeof(n.adv), &decoded));
+	zassert_equal(decoded.seq, 0xbeef);
+	zassert_equal(decoded.fields, AIR_CTRL_BLE_SAMPLE_FIELDS & ~AIR_CTRL_BLE_FIELD_GAS);
+	zassert_equal(decoded.values.temp_c_x100, -1234);
+	zassert_equal(decoded.values.hum_rh_x100, 4567U);
+	zassert_equal(decoded.values.iaq_x10, 253U);
+	zassert_equal(decoded.values.iaq_acc, 3U);
+	zassert_equal(decoded.values.co2_eq_ppm, 612U);
+	zassert_equal(decoded.values.breath_voc_eq_ppb, 1250U);
+	zassert_equal(decoded.values.gas_ohm, 0U, "not advertised");
+}
+
+ZTEST(air_ctrl_ble_encode, test_deadband)
+{
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_sample decoded;
+	struct notified n;
+
+	notify(0, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(n.live, "first sample after a reset");
+
+	/* Inside the band: held back and counted */
+	data.timestamp_ms += 3000;
+	data.raw_temp_c_x100 += CONFIG_AIR_CTRL_BT_DEADBAND_TEMP_X100;
+	notify(1, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_false(n.live);
+	data.timestamp_ms += 3000;
+	data.co2_eq_ppm += CONFIG_AIR_CTRL_BT_DEADBAND_CO2_PPM;
+	notify(2, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_false(n.live);
+
+	/* Out of the band: sent, with the two held samples in the flags */
+	data.timestamp_ms += 3000;
+	data.raw_temp_c_x100 += 1;
+	notify(3, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(n.live);
+	zassert_ok(air_ctrl_ble_decode_sample(n.packed, n.packed_len, &decoded));
+	zassert_equal(decoded.flags, 2U << AIR_CTRL_BLE_SAMPLE_HELD_SHIFT);
+	zassert_equal(air_ctrl_ble_sample_lost(0, &decoded), 0U);
+
+	/* An accuracy change is a change */
+	data.timestamp_ms += 3000;
+	data.iaq_acc = 2;
+	notify(4, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(n.live);
+	zassert_equal(n.sample.flags, 0U);
+
+	/* Unchanged, but due for a keep-alive */
+	data.timestamp_ms += CONFIG_AIR_CTRL_BT_DEADBAND_KEEPALIVE_S * 1000U;
+	notify(5, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(n.live);
+	zassert_ok(air_ctrl_ble_decode_sample(n.packed, n.packed_len, &decoded));
+	zassert_equal(decoded.flags, AIR_CTRL_BLE_SAMPLE_FLAG_KEEPALIVE);
+
+	/* The batch entry is the same whatever the deadband decided */
+	zassert_equal(n.entry.temp_c_x100, n.sample.temp_c_x100);
+	zassert_equal(n.entry.co2_eq_ppm, n.sample.co2_eq_ppm);
+}
+
+/* A change the central never received is still a change for the next sample */
+ZTEST(air_ctrl_ble_encode, test_deadband_failed_notify)
+{
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_sample decoded;
+	struct notified n;
+
+	notify(0, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(n.live);
+
+	data.timestamp_ms += 3000;
+	data.raw_temp_c_x100 += CONFIG_AIR_CTRL_BT_DEADBAND_TEMP_X100 + 1;
+	notify_fails = true;
+	notify(1, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(n.live);
+
+	/* Same values again: still out of the band of sample 0 */
+	data.timestamp_ms += 3000;
+	notify_fails = false;
+	notify(2, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(n.live, "reference moved on a failed notify");
+	zassert_ok(air_ctrl_ble_decode_sample(n.packed, n.packed_len, &decoded));
+	zassert_equal(decoded.flags, 0U, "nothing was held back");
+
+	/* Now it is the reference */
+	data.timestamp_ms += 3000;
+	notify(3, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_false(n.live);
+}
+
+/* Each central has its own reference, a new subscriber does not reset the others */
+ZTEST(air_ctrl_ble_encode, test_deadband_per_central)
+{
+	struct air_ctrl_bt_deadband other = {0};
+	air_ctrl_sensor_data_t data = sample_data();
+	struct notified n;
+	uint8_t flags = 0U;
+
+	notify(0, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_true(air_ctrl_bt_deadband_pass(&other, &n.values, data.timestamp_ms, &flags));
+	air_ctrl_bt_deadband_sent(&other, &n.values, data.timestamp_ms, flags);
+
+	air_ctrl_bt_deadband_reset(&other);
+	data.timestamp_ms += 3000;
+	notify(1, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_false(n.live, "reset of another central");
+	flags = 0U;
+	zassert_true(air_ctrl_bt_deadband_pass(&other, &n.values, data.timestamp_ms, &flags));
+}
+
+ZTEST(air_ctrl_ble_encode, test_alerts)
+{
+	air_ctrl_sensor_data_t data = sample_data();
+	struct air_ctrl_ble_alert alert;
+	struct notified n;
+
+	notify(0, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_equal(n.alert_count, 0U);
+
+	data.iaq_x10 = CONFIG_AIR_CTRL_BT_ALERT_IAQ_X10;
+	notify(1, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_equal(n.alert_count, 1U);
+	zassert_ok(air_ctrl_ble_decode_alert((const uint8_t *)&n.alerts[0], sizeof(n.alerts[0]),
+					     &alert));
+	zassert_equal(alert.metric, AIR_CTRL_BLE_ALERT_IAQ);
+	zassert_true(alert.raised);
+	zassert_equal(alert.seq, 1U);
+	zassert_equal(alert.timestamp_ms, 123456U);
+	zassert_equal(alert.value, CONFIG_AIR_CTRL_BT_ALERT_IAQ_X10);
+	zassert_equal(alert.threshold, CONFIG_AIR_CTRL_BT_ALERT_IAQ_X10);
+
+	/* Held within the hysteresis, both metrics cross on the same sample */
+	data.iaq_x10 = CONFIG_AIR_CTRL_BT_ALERT_IAQ_X10 - CONFIG_AIR_CTRL_BT_ALERT_IAQ_HYST_X10;
+	notify(2, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_equal(n.alert_count, 0U);
+
+	data.iaq_x10 -= 1;
+	data.co2_eq_ppm = UINT16_MAX;
+	notify(3, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_equal(n.alert_count, 2U);
+	zassert_ok(air_ctrl_ble_decode_alert((const uint8_t *)&n.alerts[0], sizeof(n.alerts[0]),
+					     &alert));
+	zassert_equal(alert.metric, AIR_CTRL_BLE_ALERT_IAQ);
+	zassert_false(alert.raised);
+	zassert_ok(air_ctrl_ble_decode_alert((const uint8_t *)&n.alerts[1], sizeof(n.alerts[1]),
+					     &alert));
+	zassert_equal(alert.metric, AIR_CTRL_BLE_ALERT_CO2);
+	zassert_true(alert.raised);
+	zassert_equal(alert.value, UINT16_MAX);
+
+	data.co2_eq_ppm = 0;
+	notify(4, &data, AIR_CTRL_SENSOR_OUT_ALL, &n);
+	zassert_equal(n.alert_count, 1U);
+	zassert_false(n.alerts[0].raised);
+}
+
+ZTEST(air_ctrl_ble_encode, test_agg)
+{
+	air_ctrl_agg_summary_t summary = {
+		.level = AIR_CTRL_AGG_1H,
+		.start_ms = 7200000,
+		.count = 1200,
+		.stat = {
+			[AIR_CTRL_AGG_TEMP] = {.mean = -525, .min = INT16_MIN, .max = 2150,
+					       .ewma = -400},
+			[AIR_CTRL_AGG_HUM] = {.mean = 4567, .min = 0, .max = UINT16_MAX,
+					      .ewma = 4500},
+			[AIR_CTRL_AGG_IAQ] = {.mean = 253, .min = 250, .max = 260, .ewma = 252},
+			[AIR_CTRL_AGG_CO2] = {.mean = 612, .min = 500, .max = 700, .ewma = 600},
+		},
+	};
+	struct air_ctrl_ble_agg_v4 agg;
+	struct air_ctrl_ble_agg decoded;
+
+	air_ctrl_ble_encode_agg_v4(&summary, &agg);
+	zassert_equal(air_ctrl_ble_decode_agg((const uint8_t *)&agg, sizeof(agg), &decoded, 1), 1);
+
+	zassert_equal(decoded.level, AIR_CTRL_AGG_1H);
+	zassert_equal(decoded.start_ms, 7200000U);
+	zassert_equal(decoded.count, 1200U);
+	zassert_equal((int16_t)decoded.temp_c_x100.mean, -525);
+	zassert_equal((int16_t)decoded.temp_c_x100.min, INT16_MIN);
+	zassert_equal((int16_t)decoded.temp_c_x100.max, 2150);
+	zassert_equal((int16_t)decoded.temp_c_x100.ewma, -400);
+	zassert_equal(decoded.hum_rh_x100.max, UINT16_MAX);
+	zassert_equal(decoded.iaq_x10.mean, 253U);
+	zassert_equal(decoded.co2_eq_ppm.ewma, 600U);
+}
+
+static void before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	air_ctrl_bt_deadband_reset(&deadband);
+	notify_fails = false;
+}
+
+ZTEST_SUITE(air_ctrl_ble_encode, NULL, NULL, before, NULL, NULL);
@@ -0,0 +1,105 @@
+/*
+ * The part of the BSEC 2.x bsec_datatypes.h that air_ctrl_sensor_bsec.c uses, with the
+ * library's ids and sizes, for bsec_stub.c.
+ */
+
+#ifndef BSEC_DATATYPES_H
+#define BSEC_DATATYPES_H
+
+#include <stdint.h>
+
+#define BSEC_MAX_WORKBUFFER_SIZE 4096
+#define BSEC_MAX_PHYSICAL_SENSOR 8
+#define BSEC_MAX_PROPERTY_BLOB_SIZE 2317
+#define BSEC_MAX_STATE_BLOB_SIZE 221
+#define BSEC_NUMBER_OUTPUTS 19
+
+#define BSEC_SAMPLE_RATE_DISABLED 65535.0f
+#define BSEC_SAMPLE_RATE_ULP 0.0033333f
+#define BSEC_SAMPLE_RATE_CONT 1.0f
+#define BSEC_SAMPLE_RATE_LP 0.33333f
+#define BSEC_SAMPLE_RATE_SCAN 0.055556f
+
+typedef enum {
+	BSEC_INPUT_PRESSURE = 1,
+	BSEC_INPUT_HUMIDITY = 2,
+	BSEC_INPUT_TEMPERATURE = 3,
+	BSEC_INPUT_GASRESISTOR = 4,
+	BSEC_INPUT_HEATSOURCE = 14,
+	BSEC_INPUT_DISABLE_BASELINE_TRACKER = 23,
+	BSEC_INPUT_PROFILE_PART = 24,
+} bsec_physical_sensor_t;
+
+typedef enum {
+	BSEC_OUTPUT_IAQ = 1,
+	BSEC_OUTPUT_STATIC_IAQ = 2,
+	BSEC_OUTPUT_CO2_EQUIVALENT = 3,
+	BSEC_OUTPUT_BREATH_VOC_EQUIVALENT = 4,
+	BSEC_OUTPUT_RAW_TEMPERATURE = 6,
+	BSEC_OUTPUT_RAW_PRESSURE = 7,
+	BSEC_OUTPUT_RAW_HUMIDITY = 8,
+	BSEC_OUTPUT_RAW_GAS = 9,
+	BSEC_OUTPUT_STABILIZATION_STATUS = 12,
+	BSEC_OUTPUT_RUN_IN_STATUS = 13,
+	BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE = 14,
+	BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY = 15,
+	BSEC_OUTPUT_GAS_PERCENTAGE = 21,
+	BSEC_OUTPUT_GAS_ESTIMATE_1 = 22,
+	BSEC_OUTPUT_GAS_ESTIMATE_2 = 23,
+	BSEC_OUTPUT_GAS_ESTIMATE_3 = 24,
+	BSEC_OUTPUT_GAS_ESTIMATE_4 = 25,
+} bsec_virtual_sensor_t;
+
+/* Errors are negative, warnings positive */
+typedef enum {
+	BSEC_OK = 0,
+	BSEC_E_DOSTEPS_INVALIDINPUT = -1,
+	BSEC_E_SU_WRONGDATARATE = -10,
+	BSEC_I_SU_SUBSCRIBEDOUTPUTGATES = 10,
+	BSEC_W_SC_CALL_TIMING_VIOLATION = 100,
+} bsec_library_return_t;
+
+typedef struct {
+	uint8_t major;
+	uint8_t minor;
+	uint8_t major_bugfix;
+	uint8_t minor_bugfix;
+} bsec_version_t;
+
+typedef struct {
+	int64_t time_stamp;
+	float signal;
+	uint8_t signal_dimensions;
+	uint8_t sensor_id;
+} bsec_input_t;
+
+typedef struct {
+	int64_t time_stamp;
+	float signal;
+	uint8_t signal_dimensions;
+	uint8_t sensor_id;
+	uint8_t accuracy;
+} bsec_output_t;
+
+typedef struct {
+	float sample_rate;
+	uint8_t sensor_id;
+} bsec_sensor_configuration_t;
+
+typedef struct {
+	int64_t next_call;
+	uint32_t process_data;
+	uint16_t heater_temperature;
+	uint16_t heater_duration;
+	uint16_t heater_temperature_profile[10];
+	uint16_t heater_duration_profile[10];
+	uint8_t heater_profile_len;
+	uint8_t run_gas;
+	uint8_t pressure_oversampling;
+	uint8_t temperature_oversampling;
+	uint8_t humidity_oversampling;
+	uint8_t trigger_measurement;
+	uint8_t op_mode;
+} bsec_bme_settings_t;
+
+#endif /* BSEC_DATATYPES_H */
@@ -0,0 +1,37 @@
+/*
+ * The BSEC 2.x calls air_ctrl_sensor_bsec.c makes, implemented by bsec_stub.c.
+ */
+
+#ifndef BSEC_INTERFACE_H
+#define BSEC_INTERFACE_H
+
+#include "bsec_datatypes.h"
+
+bsec_library_return_t bsec_get_version(void *inst, bsec_version_t *bsec_version_p);
+
+bsec_library_return_t bsec_init(void *inst);
+
+bsec_library_return_t bsec_do_steps(void *inst, const bsec_input_t *inputs, uint8_t n_inputs,
+				    bsec_output_t *outputs, uint8_t *n_outputs);
+
+bsec_library_return_t bsec_update_subscription(
+	void *inst, const bsec_sensor_configuration_t *requested_virtual_sensors,
+	uint8_t n_requested_virtual_sensors, bsec_sensor_configuration_t *required_sensor_settings,
+	uint8_t *n_required_sensor_settings);
+
+bsec_library_return_t bsec_set_configuration(void *inst, const uint8_t *serialized_settings,
+					     uint32_t n_serialized_settings, uint8_t *work_buffer,
+					     uint32_t n_work_buffer_size);
+
+bsec_library_return_t bsec_set_state(void *inst, const uint8_t *serialized_state,
+				     uint32_t n_serialized_state, uint8_t *work_buffer,
+				     uint32_t n_work_buffer_size);
+
+bsec_library_return_t bsec_get_state(void *inst, uint8_t state_set_id, uint8_t *serialized_state,
+				     uint32_t n_serialized_state_max, uint8_t *work_buffer,
+				     uint32_t n_work_buffer, uint32_t *n_serialized_state);
+
+bsec_library_return_t bsec_sensor_control(void *inst, int64_t time_stamp,
+					  bsec_bme_settings_t *sensor_settings);
+
+#endif /* BSEC_INTERFACE_H */
@@ -0,0 +1,10 @@
+#ifndef BSEC_SELECTIVITY_H
+#define BSEC_SELECTIVITY_H
+
+#include <stdint.h>
+
+#include "bsec_datatypes.h"
+
+extern const uint8_t bsec_config_selectivity[BSEC_MAX_PROPERTY_BLOB_SIZE];
+
+#endif /* BSEC_SELECTIVITY_H */
@@ -0,0 +1,174 @@
+/*
+ * Scripted stand-in for libalgobsec.a. It does no signal processing: bsec_do_steps() returns
+ * whatever the test queued with bsec_stub_output().
+ */
+
+#include <string.h>
+
+#include <zephyr/sys/util.h>
+
+#include "bsec_interface.h"
+#include "bsec_selectivity.h"
+#include "bsec_stub.h"
+
+/* Bit of an input in bsec_bme_settings_t.process_data */
+#define PROCESS_BIT(id) BIT((id) - 1)
+
+struct bsec_stub bsec_stub;
+
+const uint8_t bsec_config_selectivity[BSEC_MAX_PROPERTY_BLOB_SIZE] = {0};
+
+void bsec_stub_reset(void)
+{
+	memset(&bsec_stub, 0, sizeof(bsec_stub));
+
+	bsec_stub.control.op_mode = 1;
+	bsec_stub.control.trigger_measurement = 1;
+	bsec_stub.control.run_gas = 1;
+	bsec_stub.control.heater_temperature = 320;
+	bsec_stub.control.heater_duration = 150;
+	bsec_stub.control.process_data =
+		PROCESS_BIT(BSEC_INPUT_PRESSURE) | PROCESS_BIT(BSEC_INPUT_HUMIDITY) |
+		PROCESS_BIT(BSEC_INPUT_TEMPERATURE) | PROCESS_BIT(BSEC_INPUT_GASRESISTOR);
+}
+
+void bsec_stub_output(uint8_t sensor_id, float signal, uint8_t accuracy)
+{
+	bsec_output_t *output;
+
+	if (bsec_stub.n_outputs >= ARRAY_SIZE(bsec_stub.outputs)) {
+		return;
+	}
+
+	output = &bsec_stub.outputs[bsec_stub.n_outputs++];
+	output->sensor_id = sensor_id;
+	output->signal = signal;
+	output->signal_dimensions = 1;
+	output->accuracy = accuracy;
+}
+
+bsec_library_return_t bsec_get_version(void *inst, bsec_version_t *bsec_version_p)
+{
+	ARG_UNUSED(inst);
+
+	bsec_version_p->major = 2;
+	bsec_version_p->minor = 0;
+	bsec_version_p->major_bugfix = 0;
+	bsec_version_p->minor_bugfix = 0;
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_init(void *inst)
+{
+	ARG_UNUSED(inst);
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_do_steps(void *inst, const bsec_input_t *inputs, uint8_t n_inputs,
+				    bsec_output_t *outputs, uint8_t *n_outputs)
+{
+	uint8_t n;
+
+	ARG_UNUSED(inst);
+
+	bsec_stub.do_steps_calls++;
+	bsec_stub.n_inputs = MIN(n_inputs, ARRAY_SIZE(bsec_stub.inputs));
+	memcpy(bsec_stub.inputs, inputs, bsec_stub.n_inputs * sizeof(inputs[0]));
+
+	if (bsec_stub.do_steps_status != BSEC_OK) {
+		*n_outputs = 0;
+		return bsec_stub.do_steps_status;
+	}
+
+	n = MIN(bsec_stub.n_outputs, *n_outputs);
+	if (bsec_stub.outputs_call != 0 && bsec_stub.do_steps_calls != bsec_stub.outputs_call) {
+		n = 0;
+	}
+	for (uint8_t i = 0; i < n; i++) {
+		outputs[i] = bsec_stub.outputs[i];
+		outputs[i].time_stamp = (n_inputs > 0) ? inputs[0].time_stamp : 0;
+	}
+	*n_outputs = n;
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_update_subscription(
+	void *inst, const bsec_sensor_configuration_t *requested_virtual_sensors,
+	uint8_t n_requested_virtual_sensors, bsec_sensor_configuration_t *required_sensor_settings,
+	uint8_t *n_required_sensor_settings)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(required_sensor_settings);
+
+	bsec_stub.subscription_calls++;
+	if (bsec_stub.subscription_status != BSEC_OK) {
+		return bsec_stub.subscription_status;
+	}
+
+	bsec_stub.n_subscribed = MIN(n_requested_virtual_sensors, ARRAY_SIZE(bsec_stub.subscribed));
+	memcpy(bsec_stub.subscribed, requested_virtual_sensors,
+	       bsec_stub.n_subscribed * sizeof(requested_virtual_sensors[0]));
+	*n_required_sensor_settings = 0;
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_configuration(void *inst, const uint8_t *serialized_settings,
+					     uint32_t n_serialized_settings, uint8_t *work_buffer,
+					     uint32_t n_work_buffer_size)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(serialized_settings);
+	ARG_UNUSED(n_serialized_settings);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer_size);
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_set_state(void *inst, const uint8_t *serialized_state,
+				     uint32_t n_serialized_state, uint8_t *work_buffer,
+				     uint32_t n_work_buffer_size)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(serialized_state);
+	ARG_UNUSED(n_serialized_state);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer_size);
+
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_get_state(void *inst, uint8_t state_set_id, uint8_t *serialized_state,
+				     uint32_t n_serialized_state_max, uint8_t *work_buffer,
+				     uint32_t n_work_buffer, uint32_t *n_serialized_state)
+{
+	ARG_UNUSED(inst);
+	ARG_UNUSED(state_set_id);
+	ARG_UNUSED(serialized_state);
+	ARG_UNUSED(n_serialized_state_max);
+	ARG_UNUSED(work_buffer);
+	ARG_UNUSED(n_work_buffer);
+
+	*n_serialized_state = 0;
+	return BSEC_OK;
+}
+
+bsec_library_return_t bsec_sensor_control(void *inst, int64_t time_stamp,
+					  bsec_bme_settings_t *sensor_settings)
+{
+	ARG_UNUSED(inst);
+
+	bsec_stub.control_calls++;
+	if (bsec_stub.control_status < BSEC_OK) {
+		return bsec_stub.control_status;
+	}
+
+	*sensor_settings = bsec_stub.control;
+	sensor_settings->next_call = time_stamp + bsec_stub.period_ns;
+
+	return bsec_stub.control_status;
+}
@@ -0,0 +1,48 @@
+/*
+ * Test control of the BSEC stub: what bsec_sensor_control() and bsec_do_steps() return, and
+ * what the integration passed in.
+ */
+
+#ifndef BSEC_STUB_H
+#define BSEC_STUB_H
+
+#include "bsec_datatypes.h"
+
+struct bsec_stub {
+	/* Copied into the caller's settings by bsec_sensor_control(), next_call is set to the
+	 * call's timestamp plus period_ns
+	 */
+	bsec_bme_settings_t control;
+	int64_t period_ns;
+	bsec_library_return_t control_status;
+
+	/* Returned by bsec_do_steps(), with the timestamp of the first input. Only by call
+	 * number outputs_call (counting from 1) if it is set, the others return none.
+	 */
+	bsec_output_t outputs[BSEC_NUMBER_OUTPUTS];
+	uint8_t n_outputs;
+	unsigned int outputs_call;
+	bsec_library_return_t do_steps_status;
+
+	bsec_library_return_t subscription_status;
+
+	/* Arguments of the last calls */
+	bsec_input_t inputs[BSEC_MAX_PHYSICAL_SENSOR];
+	uint8_t n_inputs;
+	bsec_sensor_configuration_t subscribed[BSEC_NUMBER_OUTPUTS];
+	uint8_t n_subscribed;
+
+	unsigned int control_calls;
+	unsigned int do_steps_calls;
+	unsigned int subscription_calls;
+};
+
+extern struct bsec_stub bsec_stub;
+
+/* Forced mode at 320 degC for 150 ms, every input requested, no outputs */
+void bsec_stub_reset(void);
+
+/* Append one output for the next bsec_do_steps() */
+void bsec_stub_output(uint8_t sensor_id, float signal, uint8_t accuracy);
+
+#endif /* BSEC_STUB_H */
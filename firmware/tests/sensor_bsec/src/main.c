@@ -0,0 +1,585 @@
+/*
+ * air_ctrl_sensor_bsec.c with a scripted BSEC (bsec_stub/) and a fake BME688: the readings
+ * acquire() hands to BSEC, and the mapping of the BSEC outputs to fixed-point sample fields
+ * in process_data().
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor/bme680.h>
+#include <zephyr/ztest.h>
+
+#include <errno.h>
+#include <math.h>
+#include <string.h>
+
+#include "air_ctrl_sched.h"
+#include "air_ctrl_sensor.h"
+#include "bsec_stub.h"
+
+#define FORCED_MODE 1
+#define PARALLEL_MODE 2
+
+/* What the next bme680_read_fields() returns, and the heater profile it was given */
+static struct {
+	struct bme680_field fields[AIR_CTRL_SENSOR_MAX_RAW];
+	int n_fields;
+	int profile_err;
+	struct bme680_heatr_profile profile;
+	unsigned int profile_sets;
+	unsigned int reads;
+} fake;
+
+static unsigned int sched_kicks;
+
+void air_ctrl_sched_kick(void)
+{
+	sched_kicks++;
+}
+
+int bme680_set_heatr_profile(const struct device *dev, const struct bme680_heatr_profile *profile)
+{
+	ARG_UNUSED(dev);
+
+	if (fake.profile_err) {
+		return fake.profile_err;
+	}
+
+	fake.profile = *profile;
+	fake.profile_sets++;
+	return 0;
+}
+
+int bme680_read_fields(const struct device *dev, struct bme680_field *fields, size_t max_fields)
+{
+	ARG_UNUSED(dev);
+
+	fake.reads++;
+	if (fake.n_fields < 0) {
+		return fake.n_fields;
+	}
+
+	max_fields = MIN(max_fields, (size_t)fake.n_fields);
+	memcpy(fields, fake.fields, max_fields * sizeof(fields[0]));
+	return (int)max_fields;
+}
+
+DEVICE_DT_DEFINE(DT_NODELABEL(bme688), NULL, NULL, NULL, NULL, POST_KERNEL,
+		 CONFIG_SENSOR_INIT_PRIORITY, NULL);
+
+static void fake_set(int32_t temp_x100, uint32_t hum_x1000, uint32_t press_pa, uint32_t gas_ohm)
+{
+	fake.fields[0] = (struct bme680_field){
+		.temp_x100 = temp_x100,
+		.press_pa = press_pa,
+		.hum_x1000 = hum_x1000,
+		.gas_ohm = gas_ohm,
+		.gas_valid = true,
+		.heatr_stab = true,
+	};
+	fake.n_fields = 1;
+}
+
+static air_ctrl_sensor_raw_t acquire_one(void)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 1);
+	return raw;
+}
+
+/* One reading through BSEC, returning whatever outputs were queued */
+static air_ctrl_sensor_data_t process_one(void)
+{
+	air_ctrl_sensor_raw_t raw = acquire_one();
+	air_ctrl_sensor_data_t data;
+
+	zassert_true(air_ctrl_sensor_process(&raw, 1, &data));
+	return data;
+}
+
+static const bsec_input_t *find_input(uint8_t sensor_id)
+{
+	for (uint8_t i = 0; i < bsec_stub.n_inputs; i++) {
+		if (bsec_stub.inputs[i].sensor_id == sensor_id) {
+			return &bsec_stub.inputs[i];
+		}
+	}
+
+	return NULL;
+}
+
+static float subscribed_rate(uint8_t sensor_id)
+{
+	for (uint8_t i = 0; i < bsec_stub.n_subscribed; i++) {
+		if (bsec_stub.subscribed[i].sensor_id == sensor_id) {
+			return bsec_stub.subscribed[i].sample_rate;
+		}
+	}
+
+	return -1.0f;
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_inputs)
+{
+	const bsec_input_t *input;
+	air_ctrl_sensor_raw_t raw;
+	air_ctrl_sensor_data_t data;
+
+	fake_set(2137, 45678, 101325, 152340);
+	raw = acquire_one();
+	zassert_equal(raw.temp_c_x100, 2137);
+	zassert_equal(raw.hum_rh_x1000, 45678U);
+	zassert_equal(raw.press_pa, 101325U);
+	zassert_equal(raw.gas_ohm, 152340U);
+	zassert_equal(raw.gas_index, 0U);
+
+	bsec_stub_output(BSEC_OUTPUT_IAQ, 25.0f, 1);
+	zassert_true(air_ctrl_sensor_process(&raw, 1, &data));
+	zassert_equal(bsec_stub.n_inputs, 5);
+
+	/* The heat source (temperature offset) comes with the temperature */
+	input = find_input(BSEC_INPUT_HEATSOURCE);
+	zassert_not_null(input);
+	zassert_equal(input->signal, 0.0f);
+
+	input = find_input(BSEC_INPUT_TEMPERATURE);
+	zassert_not_null(input);
+	zassert_within(input->signal, 21.37f, 1e-4f);
+	zassert_equal(input->time_stamp, raw.timestamp_ns);
+
+	input = find_input(BSEC_INPUT_HUMIDITY);
+	zassert_not_null(input);
+	zassert_within(input->signal, 45.678f, 1e-4f);
+
+	input = find_input(BSEC_INPUT_PRESSURE);
+	zassert_not_null(input);
+	zassert_equal(input->signal, 101325.0f, "in Pa");
+
+	input = find_input(BSEC_INPUT_GASRESISTOR);
+	zassert_not_null(input);
+	zassert_equal(input->signal, 152340.0f);
+
+	zassert_is_null(find_input(BSEC_INPUT_PROFILE_PART));
+}
+
+/* Only the inputs BSEC asks for in process_data are passed */
+ZTEST(air_ctrl_sensor_bsec, test_inputs_requested)
+{
+	air_ctrl_sensor_raw_t raw;
+	air_ctrl_sensor_data_t data;
+
+	bsec_stub.control.process_data = BIT(BSEC_INPUT_PRESSURE - 1);
+	fake_set(2137, 45678, 101325, 152340);
+	raw = acquire_one();
+	zassert_equal(raw.gas_ohm, 0U, "gas not requested");
+
+	bsec_stub_output(BSEC_OUTPUT_IAQ, 25.0f, 1);
+	zassert_true(air_ctrl_sensor_process(&raw, 1, &data));
+	zassert_equal(bsec_stub.n_inputs, 1);
+	zassert_equal(bsec_stub.inputs[0].sensor_id, BSEC_INPUT_PRESSURE);
+
+	/* Nothing requested, nothing to do */
+	bsec_stub.control.process_data = 0;
+	raw = acquire_one();
+	zassert_false(air_ctrl_sensor_process(&raw, 1, &data));
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_outputs)
+{
+	air_ctrl_sensor_data_t data;
+
+	fake_set(2137, 45678, 101325, 152340);
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, 21.5f, 0);
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY, 45.25f, 0);
+	bsec_stub_output(BSEC_OUTPUT_IAQ, 25.5f, 3);
+	bsec_stub_output(BSEC_OUTPUT_STATIC_IAQ, 50.25f, 3);
+	bsec_stub_output(BSEC_OUTPUT_CO2_EQUIVALENT, 600.5f, 3);
+	bsec_stub_output(BSEC_OUTPUT_BREATH_VOC_EQUIVALENT, 1.25f, 3);
+	bsec_stub_output(BSEC_OUTPUT_GAS_PERCENTAGE, 42.125f, 3);
+	bsec_stub_output(BSEC_OUTPUT_STABILIZATION_STATUS, 1.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_RUN_IN_STATUS, 1.0f, 0);
+	data = process_one();
+
+	zassert_equal(data.temp_c_x100, 2150);
+	zassert_equal(data.hum_rh_x100, 4525U);
+	zassert_equal(data.iaq_x10, 255U);
+	zassert_equal(data.iaq_acc, 3U);
+	zassert_equal(data.static_iaq_x10, 502U, "truncated");
+	zassert_equal(data.co2_eq_ppm, 601U, "rounded");
+	zassert_equal(data.breath_voc_eq_ppb, 1250U, "ppm to ppb");
+	zassert_equal(data.gas_pct_x100, 4213U, "rounded");
+	zassert_equal(data.status, AIR_CTRL_SENSOR_STABILIZED | AIR_CTRL_SENSOR_RUN_IN);
+
+	/* The measured values come from the reading, not from BSEC */
+	zassert_equal(data.raw_temp_c_x100, 2137);
+	zassert_equal(data.raw_hum_rh_x100, 4567U);
+	zassert_equal(data.press_pa, 101325U);
+	zassert_equal(data.gas_ohm, 152340U);
+}
+
+/* BSEC echoes the inputs as raw outputs, which must not replace the exact readings */
+ZTEST(air_ctrl_sensor_bsec, test_raw_outputs)
+{
+	air_ctrl_sensor_data_t data;
+
+	fake_set(-525, 45678, 101325, 152340);
+	bsec_stub_output(BSEC_OUTPUT_RAW_TEMPERATURE, 99.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_RAW_HUMIDITY, 99.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_RAW_PRESSURE, 99.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_RAW_GAS, 99.0f, 0);
+	data = process_one();
+
+	zassert_equal(data.raw_temp_c_x100, -525);
+	zassert_equal(data.raw_hum_rh_x100, 4567U);
+	zassert_equal(data.press_pa, 101325U);
+	zassert_equal(data.gas_ohm, 152340U);
+
+	/* Not subscribed outputs stay 0 */
+	zassert_equal(data.temp_c_x100, 0);
+	zassert_equal(data.hum_rh_x100, 0U);
+	zassert_equal(data.iaq_x10, 0U);
+	zassert_equal(data.status, 0U);
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_rounding)
+{
+	air_ctrl_sensor_data_t data;
+
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, -5.25f, 0);
+	bsec_stub_output(BSEC_OUTPUT_IAQ, 25.59f, 0);
+	bsec_stub_output(BSEC_OUTPUT_CO2_EQUIVALENT, 600.4f, 0);
+	bsec_stub_output(BSEC_OUTPUT_BREATH_VOC_EQUIVALENT, 0.25f, 0);
+	bsec_stub_output(BSEC_OUTPUT_STABILIZATION_STATUS, 0.5f, 0);
+	bsec_stub_output(BSEC_OUTPUT_RUN_IN_STATUS, 0.0f, 0);
+	data = process_one();
+
+	zassert_equal(data.temp_c_x100, -525);
+	zassert_equal(data.iaq_x10, 255U, "truncated");
+	zassert_equal(data.co2_eq_ppm, 600U);
+	zassert_equal(data.breath_voc_eq_ppb, 250U);
+	zassert_equal(data.status, 0U, "only above 0.5");
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_saturation)
+{
+	air_ctrl_sensor_data_t data;
+
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, 400.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY, 1000.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_IAQ, 7000.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_CO2_EQUIVALENT, 1e9f, 0);
+	bsec_stub_output(BSEC_OUTPUT_BREATH_VOC_EQUIVALENT, 100.0f, 0);
+	data = process_one();
+
+	zassert_equal(data.temp_c_x100, INT16_MAX);
+	zassert_equal(data.hum_rh_x100, UINT16_MAX);
+	zassert_equal(data.iaq_x10, UINT16_MAX);
+	zassert_equal(data.co2_eq_ppm, UINT16_MAX);
+	zassert_equal(data.breath_voc_eq_ppb, UINT16_MAX);
+
+	bsec_stub_reset();
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, -400.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY, -1.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_IAQ, NAN, 0);
+	bsec_stub_output(BSEC_OUTPUT_STATIC_IAQ, INFINITY, 0);
+	bsec_stub_output(BSEC_OUTPUT_CO2_EQUIVALENT, -INFINITY, 0);
+	bsec_stub_output(BSEC_OUTPUT_GAS_PERCENTAGE, NAN, 0);
+	data = process_one();
+
+	zassert_equal(data.temp_c_x100, INT16_MIN);
+	zassert_equal(data.hum_rh_x100, 0U);
+	zassert_equal(data.iaq_x10, 0U);
+	zassert_equal(data.static_iaq_x10, UINT16_MAX);
+	zassert_equal(data.co2_eq_ppm, 0U);
+	zassert_equal(data.gas_pct_x100, 0U);
+
+	bsec_stub_reset();
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, NAN, 0);
+	data = process_one();
+	zassert_equal(data.temp_c_x100, 0);
+}
+
+#if defined(CONFIG_AIR_CTRL_BSEC_GAS_ESTIMATES)
+ZTEST(air_ctrl_sensor_bsec, test_gas_estimates)
+{
+	air_ctrl_sensor_data_t data;
+
+	bsec_stub_output(BSEC_OUTPUT_GAS_ESTIMATE_1, 0.125f, 0);
+	bsec_stub_output(BSEC_OUTPUT_GAS_ESTIMATE_2, 0.5f, 0);
+	bsec_stub_output(BSEC_OUTPUT_GAS_ESTIMATE_3, 1.0f, 0);
+	bsec_stub_output(BSEC_OUTPUT_GAS_ESTIMATE_4, NAN, 0);
+	data = process_one();
+
+	zassert_equal(data.gas_estimate_x10000[0], 1250U);
+	zassert_equal(data.gas_estimate_x10000[1], 5000U);
+	zassert_equal(data.gas_estimate_x10000[2], 10000U);
+	zassert_equal(data.gas_estimate_x10000[3], 0U);
+
+	/* Not selectable, they stay at the scan rate */
+	zassert_ok(air_ctrl_sensor_set_outputs(AIR_CTRL_SENSOR_OUT_IAQ));
+	(void)acquire_one();
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_GAS_ESTIMATE_1), BSEC_SAMPLE_RATE_SCAN);
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_GAS_ESTIMATE_4), BSEC_SAMPLE_RATE_SCAN);
+}
+#endif
+
+ZTEST(air_ctrl_sensor_bsec, test_process_errors)
+{
+	air_ctrl_sensor_raw_t raw;
+	air_ctrl_sensor_data_t data;
+
+	/* No measurement triggered since init */
+	raw = (air_ctrl_sensor_raw_t){.timestamp_ns = 1};
+	zassert_false(air_ctrl_sensor_process(&raw, 1, &data));
+	zassert_equal(bsec_stub.do_steps_calls, 0U);
+
+	raw = acquire_one();
+	zassert_false(air_ctrl_sensor_process(NULL, 1, &data));
+	zassert_false(air_ctrl_sensor_process(&raw, 1, NULL));
+	zassert_false(air_ctrl_sensor_process(&raw, 0, &data));
+
+	/* No outputs due at this timestamp */
+	zassert_false(air_ctrl_sensor_process(&raw, 1, &data));
+	zassert_equal(bsec_stub.do_steps_calls, 1U);
+
+	bsec_stub_output(BSEC_OUTPUT_IAQ, 25.0f, 1);
+	bsec_stub.do_steps_status = BSEC_E_DOSTEPS_INVALIDINPUT;
+	zassert_false(air_ctrl_sensor_process(&raw, 1, &data));
+
+	bsec_stub.do_steps_status = BSEC_OK;
+	zassert_true(air_ctrl_sensor_process(&raw, 1, &data));
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_acquire_clamp)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	fake_set(40000, 0, 0, 0);
+	raw = acquire_one();
+	zassert_equal(raw.temp_c_x100, INT16_MAX);
+
+	fake_set(-40000, UINT32_MAX, UINT32_MAX, UINT32_MAX);
+	raw = acquire_one();
+	zassert_equal(raw.temp_c_x100, INT16_MIN);
+	zassert_equal(raw.hum_rh_x1000, UINT32_MAX);
+	zassert_equal(raw.press_pa, UINT32_MAX);
+	zassert_equal(raw.gas_ohm, UINT32_MAX);
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_acquire_errors)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	zassert_equal(air_ctrl_sensor_acquire(NULL, 1), 0);
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 0), 0);
+	zassert_equal(bsec_stub.control_calls, 0U);
+
+	bsec_stub.control_status = BSEC_E_DOSTEPS_INVALIDINPUT;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0);
+	zassert_equal(fake.reads, 0U);
+
+	/* Warnings still measure */
+	bsec_stub.control_status = BSEC_W_SC_CALL_TIMING_VIOLATION;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 1);
+
+	bsec_stub.control_status = BSEC_OK;
+	bsec_stub.control.op_mode = 0;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0, "sleep mode");
+	bsec_stub.control.op_mode = FORCED_MODE;
+	bsec_stub.control.trigger_measurement = 0;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0, "no measurement due");
+	zassert_equal(fake.reads, 1U);
+
+	bsec_stub.control.trigger_measurement = 1;
+	fake.n_fields = -EIO;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0);
+	zassert_equal(fake.reads, 2U);
+
+	/* A new heater profile that does not take skips the read */
+	fake.n_fields = 1;
+	fake.profile_err = -EIO;
+	bsec_stub.control.heater_temperature = 321;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0);
+	zassert_equal(fake.reads, 2U);
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_heater_profile)
+{
+	unsigned int sets;
+
+	/* A step of its own, whatever ran before */
+	bsec_stub.control.heater_temperature = 310;
+	bsec_stub.control.heater_duration = 140;
+	(void)acquire_one();
+	zassert_false(fake.profile.parallel);
+	zassert_equal(fake.profile.len, 1U);
+	zassert_equal(fake.profile.temp_c[0], 310U);
+	zassert_equal(fake.profile.dur[0], 140U);
+
+	/* Only written when it changes */
+	sets = fake.profile_sets;
+	(void)acquire_one();
+	zassert_equal(fake.profile_sets, sets);
+
+	bsec_stub.control.heater_temperature = 320;
+	(void)acquire_one();
+	zassert_equal(fake.profile_sets, sets + 1);
+	zassert_equal(fake.profile.temp_c[0], 320U);
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_parallel)
+{
+	static const uint16_t temps[] = {320, 100, 100, 100, 200, 200, 200, 320, 320, 320};
+	static const uint16_t durs[] = {5, 2, 10, 30, 5, 5, 5, 5, 5, 5};
+	air_ctrl_sensor_raw_t raw[AIR_CTRL_SENSOR_MAX_RAW];
+	air_ctrl_sensor_data_t data;
+	const bsec_input_t *input;
+
+	bsec_stub.control.op_mode = PARALLEL_MODE;
+	bsec_stub.control.heater_profile_len = ARRAY_SIZE(temps);
+	memcpy(bsec_stub.control.heater_temperature_profile, temps, sizeof(temps));
+	memcpy(bsec_stub.control.heater_duration_profile, durs, sizeof(durs));
+	bsec_stub.control.process_data |= BIT(BSEC_INPUT_PROFILE_PART - 1);
+
+	for (int i = 0; i < 3; i++) {
+		fake.fields[i] = (struct bme680_field){
+			.temp_x100 = 2100 + i,
+			.hum_x1000 = 40000,
+			.press_pa = 100000,
+			.gas_ohm = 1000U * (i + 1),
+			.gas_index = 4 + i,
+			.meas_index = i,
+			.gas_valid = (i != 1),
+		};
+	}
+	fake.n_fields = 3;
+
+	zassert_equal(air_ctrl_sensor_acquire(raw, ARRAY_SIZE(raw)), 2, "invalid gas skipped");
+	zassert_true(fake.profile.parallel);
+	zassert_equal(fake.profile.len, ARRAY_SIZE(temps));
+	zassert_mem_equal(fake.profile.temp_c, temps, sizeof(temps));
+	zassert_mem_equal(fake.profile.dur, durs, sizeof(durs));
+
+	zassert_equal(raw[0].temp_c_x100, 2100);
+	zassert_equal(raw[0].gas_index, 4U);
+	zassert_equal(raw[1].temp_c_x100, 2102);
+	zassert_equal(raw[1].gas_ohm, 3000U);
+	zassert_equal(raw[1].gas_index, 6U);
+	zassert_equal(raw[0].timestamp_ns, raw[1].timestamp_ns);
+
+	/* Both steps go through BSEC, only the last one is due for IAQ: one sample */
+	bsec_stub_output(BSEC_OUTPUT_IAQ, 25.0f, 1);
+	bsec_stub.outputs_call = 2;
+	zassert_true(air_ctrl_sensor_process(raw, 2, &data));
+	zassert_equal(bsec_stub.do_steps_calls, 2U);
+	input = find_input(BSEC_INPUT_PROFILE_PART);
+	zassert_not_null(input);
+	zassert_equal(input->signal, 6.0f);
+	zassert_equal(data.iaq_x10, 250U);
+	zassert_equal(data.iaq_acc, 1U);
+	zassert_equal(data.gas_ohm, 3000U, "measured values of the last step");
+	zassert_equal(data.raw_temp_c_x100, 2102);
+
+	/* Outputs not due at any step of the next cycle keep their value */
+	bsec_stub.do_steps_calls = 0;
+	bsec_stub.n_outputs = 0;
+	bsec_stub_output(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_TEMPERATURE, 21.5f, 0);
+	bsec_stub.outputs_call = 1;
+	zassert_true(air_ctrl_sensor_process(raw, 2, &data));
+	zassert_equal(data.temp_c_x100, 2150);
+	zassert_equal(data.iaq_x10, 250U);
+	zassert_equal(data.iaq_acc, 1U);
+
+	/* No output at any step, no sample */
+	bsec_stub.n_outputs = 0;
+	zassert_false(air_ctrl_sensor_process(raw, 2, &data));
+
+	/* Never more than asked for */
+	zassert_equal(air_ctrl_sensor_acquire(raw, 1), 1);
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_period)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	bsec_stub.period_ns = 3000000000LL;
+	raw = acquire_one();
+	zassert_equal(air_ctrl_sensor_get_next_call_ns(), raw.timestamp_ns + 3000000000LL);
+
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0, "sampled before the next deadline");
+	zassert_equal(bsec_stub.control_calls, 1U);
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_rate)
+{
+	unsigned int kicks = sched_kicks;
+
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_IAQ), BSEC_SAMPLE_RATE_LP);
+
+	bsec_stub.period_ns = 3000000000LL;
+	(void)acquire_one();
+
+	zassert_equal(air_ctrl_sensor_set_rate((enum air_ctrl_sensor_rate)2), -EINVAL);
+	zassert_ok(air_ctrl_sensor_set_rate(AIR_CTRL_SENSOR_RATE_ULP));
+	zassert_equal(sched_kicks, kicks + 1);
+	zassert_equal(air_ctrl_sensor_get_next_call_ns(), 0, "a rate change is due now");
+	zassert_equal(air_ctrl_sensor_get_rate(), AIR_CTRL_SENSOR_RATE_LP);
+
+	/* Applied on the sensor thread, with a new schedule */
+	(void)acquire_one();
+	zassert_equal(air_ctrl_sensor_get_rate(), AIR_CTRL_SENSOR_RATE_ULP);
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_IAQ), BSEC_SAMPLE_RATE_ULP);
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_RAW_GAS), BSEC_SAMPLE_RATE_ULP);
+	zassert_equal(bsec_stub.control_calls, 2U);
+
+	zassert_ok(air_ctrl_sensor_set_rate(AIR_CTRL_SENSOR_RATE_ULP));
+	zassert_equal(sched_kicks, kicks + 1, "not a change");
+}
+
+ZTEST(air_ctrl_sensor_bsec, test_output_selection)
+{
+	const uint32_t outputs = AIR_CTRL_SENSOR_OUT_IAQ | AIR_CTRL_SENSOR_OUT_TEMP;
+	unsigned int kicks = sched_kicks;
+	air_ctrl_sensor_raw_t raw;
+
+	zassert_equal(air_ctrl_sensor_set_outputs(0), -EINVAL);
+	zassert_equal(air_ctrl_sensor_set_outputs(AIR_CTRL_SENSOR_OUT_ALL + 1), -EINVAL);
+	zassert_equal(air_ctrl_sensor_get_outputs(), AIR_CTRL_SENSOR_OUT_ALL);
+
+	bsec_stub.period_ns = 3000000000LL;
+	zassert_ok(air_ctrl_sensor_set_outputs(outputs));
+	zassert_equal(sched_kicks, kicks + 1);
+	raw = acquire_one();
+	zassert_equal(air_ctrl_sensor_get_outputs(), outputs);
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_IAQ), BSEC_SAMPLE_RATE_LP);
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_RAW_TEMPERATURE), BSEC_SAMPLE_RATE_LP);
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_CO2_EQUIVALENT), BSEC_SAMPLE_RATE_DISABLED);
+	zassert_equal(subscribed_rate(BSEC_OUTPUT_SENSOR_HEAT_COMPENSATED_HUMIDITY),
+		      BSEC_SAMPLE_RATE_DISABLED);
+
+	/* A set BSEC rejects is dropped, the previous one stays */
+	bsec_stub.subscription_status = BSEC_E_SU_WRONGDATARATE;
+	zassert_ok(air_ctrl_sensor_set_outputs(AIR_CTRL_SENSOR_OUT_CO2_EQ));
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0, "the schedule is kept");
+	zassert_equal(air_ctrl_sensor_get_outputs(), outputs);
+	zassert_equal(air_ctrl_sensor_get_rate(), AIR_CTRL_SENSOR_RATE_LP);
+	zassert_equal(air_ctrl_sensor_get_next_call_ns(), raw.timestamp_ns + 3000000000LL,
+		      "nothing pending");
+}
+
+static void before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	memset(&fake, 0, sizeof(fake));
+	fake_set(2000, 50000, 101325, 100000);
+	bsec_stub_reset();
+
+	/* Back to LP and all outputs, with no measurement pending */
+	(void)air_ctrl_sensor_set_rate(AIR_CTRL_SENSOR_RATE_LP);
+	(void)air_ctrl_sensor_set_outputs(AIR_CTRL_SENSOR_OUT_ALL);
+	zassert_ok(air_ctrl_sensor_init());
+	bsec_stub.subscription_calls = 0;
+}
+
+ZTEST_SUITE(air_ctrl_sensor_bsec, NULL, NULL, before, NULL, NULL);
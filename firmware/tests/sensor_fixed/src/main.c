@@ -0,0 +1,147 @@
+/*
+ * air_ctrl_sensor_fixed_i16() / _u16() against the float encoding the BLE encoder used
+ * before samples went fixed point (air_ctrl_ble_scale() up to the v2 sample format).
+ * Wherever the old expression was defined, both must give the same integer.
+ */
+
+#include <zephyr/ztest.h>
+
+#include <math.h>
+
+#include "air_ctrl_sensor.h"
+
+/* The old encoder, as it was. Undefined for NaN and for scaled values outside int32. */
+static int16_t old_temp_c_x100(float raw_temperature)
+{
+	return (int16_t)CLAMP((int32_t)(raw_temperature * 100.0f), INT16_MIN, INT16_MAX);
+}
+
+static uint16_t old_hum_rh_x100(float raw_humidity)
+{
+	return (uint16_t)CLAMP((int32_t)(raw_humidity * 100.0f), 0, UINT16_MAX);
+}
+
+static uint16_t old_iaq_x10(float iaq)
+{
+	return (iaq <= 0.0f) ? 0U : (uint16_t)CLAMP((int32_t)(iaq * 10.0f), 0, UINT16_MAX);
+}
+
+static uint16_t old_co2_eq_ppm(float co2_equivalent)
+{
+	return (co2_equivalent <= 0.0f) ? 0U :
+		(uint16_t)CLAMP((int32_t)(co2_equivalent + 0.5f), 0, UINT16_MAX);
+}
+
+static uint16_t old_breath_voc_eq_ppb(float breath_voc_equivalent)
+{
+	return (breath_voc_equivalent <= 0.0f) ? 0U :
+		(uint16_t)CLAMP((int32_t)(breath_voc_equivalent * 1000.0f + 0.5f), 0,
+				UINT16_MAX);
+}
+
+/* The conversions process_data() applies to the same outputs */
+static void check_all(float value)
+{
+	zassert_equal(air_ctrl_sensor_fixed_i16(value, 100.0f), old_temp_c_x100(value),
+		      "temp: %d != %d", air_ctrl_sensor_fixed_i16(value, 100.0f),
+		      old_temp_c_x100(value));
+	zassert_equal(air_ctrl_sensor_fixed_u16(value, 100.0f, 0.0f), old_hum_rh_x100(value),
+		      "hum: %u != %u", air_ctrl_sensor_fixed_u16(value, 100.0f, 0.0f),
+		      old_hum_rh_x100(value));
+	zassert_equal(air_ctrl_sensor_fixed_u16(value, 10.0f, 0.0f), old_iaq_x10(value),
+		      "iaq: %u != %u", air_ctrl_sensor_fixed_u16(value, 10.0f, 0.0f),
+		      old_iaq_x10(value));
+	zassert_equal(air_ctrl_sensor_fixed_u16(value, 1.0f, 0.5f), old_co2_eq_ppm(value),
+		      "co2: %u != %u", air_ctrl_sensor_fixed_u16(value, 1.0f, 0.5f),
+		      old_co2_eq_ppm(value));
+	zassert_equal(air_ctrl_sensor_fixed_u16(value, 1000.0f, 0.5f),
+		      old_breath_voc_eq_ppb(value), "voc: %u != %u",
+		      air_ctrl_sensor_fixed_u16(value, 1000.0f, 0.5f),
+		      old_breath_voc_eq_ppb(value));
+}
+
+ZTEST(air_ctrl_sensor_fixed, test_negative_temperatures)
+{
+	static const float temps[] = {
+		-0.001f, -0.005f, -0.009f, -0.01f, -0.015f, -0.5f, -1.0f, -10.25f,
+		-40.0f, -40.005f, -273.15f, -327.67f, -327.68f, -327.685f, -327.69f,
+		-400.0f, -1.0e6f,
+	};
+
+	ARRAY_FOR_EACH(temps, i) {
+		check_all(temps[i]);
+	}
+
+	/* Truncated toward zero, not floored */
+	zassert_equal(air_ctrl_sensor_fixed_i16(-0.009f, 100.0f), 0);
+	zassert_equal(air_ctrl_sensor_fixed_i16(-10.259f, 100.0f), -1025);
+}
+
+ZTEST(air_ctrl_sensor_fixed, test_half_ties)
+{
+	static const float ties[] = {
+		0.5f, 1.5f, 2.5f, 414.5f, 415.5f, 1000.5f, 65533.5f, 65534.5f,
+		0.0005f, 0.0015f, 0.0025f, 0.4995f, 1.2345f, 0.05f, 0.15f, 2.25f,
+		12.345f, 21.505f, 50.005f, 99.995f,
+	};
+
+	ARRAY_FOR_EACH(ties, i) {
+		check_all(ties[i]);
+		check_all(-ties[i]);
+	}
+
+	/* Exact ties of the rounded fields go up */
+	zassert_equal(air_ctrl_sensor_fixed_u16(414.5f, 1.0f, 0.5f), 415U);
+	zassert_equal(air_ctrl_sensor_fixed_u16(2.5f, 1.0f, 0.5f), 3U);
+	zassert_equal(air_ctrl_sensor_fixed_u16(0.0025f, 1000.0f, 0.5f), 3U);
+}
+
+ZTEST(air_ctrl_sensor_fixed, test_saturation)
+{
+	static const float edges[] = {
+		327.66f, 327.67f, 327.675f, 327.68f, 655.34f, 655.35f, 655.355f, 655.36f,
+		6553.4f, 6553.5f, 6553.6f, 65534.0f, 65534.49f, 65535.0f, 65535.5f, 65536.0f,
+		65.5345f, 65.535f, 65.5355f, 1.0e6f, 2.0e6f,
+	};
+
+	ARRAY_FOR_EACH(edges, i) {
+		check_all(edges[i]);
+	}
+
+	zassert_equal(air_ctrl_sensor_fixed_i16(1.0e6f, 100.0f), INT16_MAX);
+	zassert_equal(air_ctrl_sensor_fixed_i16(-1.0e6f, 100.0f), INT16_MIN);
+	zassert_equal(air_ctrl_sensor_fixed_u16(1.0e6f, 1.0f, 0.5f), UINT16_MAX);
+}
+
+/* Where the old encoder was undefined the helpers saturate instead */
+ZTEST(air_ctrl_sensor_fixed, test_out_of_int32_range)
+{
+	zassert_equal(air_ctrl_sensor_fixed_i16(1.0e30f, 100.0f), INT16_MAX);
+	zassert_equal(air_ctrl_sensor_fixed_i16(-1.0e30f, 100.0f), INT16_MIN);
+	zassert_equal(air_ctrl_sensor_fixed_i16(INFINITY, 100.0f), INT16_MAX);
+	zassert_equal(air_ctrl_sensor_fixed_i16(-INFINITY, 100.0f), INT16_MIN);
+
+	zassert_equal(air_ctrl_sensor_fixed_u16(1.0e30f, 1000.0f, 0.5f), UINT16_MAX);
+	zassert_equal(air_ctrl_sensor_fixed_u16(INFINITY, 10.0f, 0.0f), UINT16_MAX);
+	zassert_equal(air_ctrl_sensor_fixed_u16(-1.0e30f, 10.0f, 0.0f), 0U);
+	zassert_equal(air_ctrl_sensor_fixed_u16(-INFINITY, 1.0f, 0.5f), 0U);
+}
+
+ZTEST(air_ctrl_sensor_fixed, test_nan)
+{
+	zassert_equal(air_ctrl_sensor_fixed_i16(NAN, 100.0f), 0);
+	zassert_equal(air_ctrl_sensor_fixed_i16(-NAN, 100.0f), 0);
+	zassert_equal(air_ctrl_sensor_fixed_u16(NAN, 100.0f, 0.0f), 0U);
+	zassert_equal(air_ctrl_sensor_fixed_u16(NAN, 1.0f, 0.5f), 0U);
+	zassert_equal(air_ctrl_sensor_fixed_u16(-NAN, 1000.0f, 0.5f), 0U);
+}
+
+/* Every 0.0037 step from -400 to 70000 covers all fields' ranges and both saturations */
+ZTEST(air_ctrl_sensor_fixed, test_sweep)
+{
+	for (int32_t i = -108108; i <= 18918918; i += 97) {
+		check_all((float)i * 0.0037f);
+	}
+}
+
+ZTEST_SUITE(air_ctrl_sensor_fixed, NULL, NULL, NULL, NULL, NULL);
@@ -0,0 +1,266 @@
+/*
+ * air_ctrl_sensor_raw.c against a fake BME680 driver: the conversions from the sensor API
+ * (degC, %RH and kPa in struct sensor_value) to air_ctrl_sensor_raw_t, the passthrough into
+ * a sample, and the sample period.
+ */
+
+#include <zephyr/device.h>
+#include <zephyr/drivers/sensor.h>
+#include <zephyr/ztest.h>
+
+#include <errno.h>
+#include <string.h>
+
+#include "air_ctrl_sched.h"
+#include "air_ctrl_sensor.h"
+
+/* What the next sample fetch returns */
+static struct {
+	struct sensor_value temp;
+	struct sensor_value press;
+	struct sensor_value hum;
+	struct sensor_value gas;
+	int fetch_err;
+	int channel_err;
+	unsigned int fetches;
+} fake;
+
+static unsigned int sched_kicks;
+
+void air_ctrl_sched_kick(void)
+{
+	sched_kicks++;
+}
+
+static int fake_sample_fetch(const struct device *dev, enum sensor_channel chan)
+{
+	ARG_UNUSED(dev);
+	ARG_UNUSED(chan);
+
+	fake.fetches++;
+	return fake.fetch_err;
+}
+
+static int fake_channel_get(const struct device *dev, enum sensor_channel chan,
+			    struct sensor_value *val)
+{
+	ARG_UNUSED(dev);
+
+	switch (chan) {
+	case SENSOR_CHAN_AMBIENT_TEMP:
+		*val = fake.temp;
+		break;
+	case SENSOR_CHAN_PRESS:
+		*val = fake.press;
+		break;
+	case SENSOR_CHAN_HUMIDITY:
+		*val = fake.hum;
+		break;
+	case SENSOR_CHAN_GAS_RES:
+		*val = fake.gas;
+		break;
+	default:
+		return -ENOTSUP;
+	}
+
+	return fake.channel_err;
+}
+
+static DEVICE_API(sensor, fake_bme680_api) = {
+	.sample_fetch = fake_sample_fetch,
+	.channel_get = fake_channel_get,
+};
+
+DEVICE_DT_DEFINE(DT_NODELABEL(bme688), NULL, NULL, NULL, NULL, POST_KERNEL,
+		 CONFIG_SENSOR_INIT_PRIORITY, &fake_bme680_api);
+
+/* In thousandths of the sensor API units (degC, kPa, %RH), gas in ohms */
+static void fake_set(int64_t temp_mc, int64_t press_mkpa, int64_t hum_mrh, int32_t gas_ohm)
+{
+	(void)sensor_value_from_milli(&fake.temp, temp_mc);
+	(void)sensor_value_from_milli(&fake.press, press_mkpa);
+	(void)sensor_value_from_milli(&fake.hum, hum_mrh);
+	fake.gas.val1 = gas_ohm;
+	fake.gas.val2 = 0;
+}
+
+static air_ctrl_sensor_raw_t acquire_one(void)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 1);
+	return raw;
+}
+
+ZTEST(air_ctrl_sensor_raw, test_units)
+{
+	air_ctrl_sensor_raw_t raw;
+	int64_t before_ns = air_ctrl_sensor_get_timestamp_ns();
+
+	fake_set(21370, 101325, 45678, 152340);
+	raw = acquire_one();
+
+	zassert_equal(raw.temp_c_x100, 2137);
+	zassert_equal(raw.press_pa, 101325U, "kPa to Pa: %u", raw.press_pa);
+	zassert_equal(raw.hum_rh_x1000, 45678U);
+	zassert_equal(raw.gas_ohm, 152340U);
+	zassert_equal(raw.gas_index, 0U);
+	zassert_true(raw.timestamp_ns >= before_ns &&
+		     raw.timestamp_ns <= air_ctrl_sensor_get_timestamp_ns());
+}
+
+/* Below the resolution of the sample the values are truncated toward zero */
+ZTEST(air_ctrl_sensor_raw, test_fractions)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	/* 98.765432 kPa, -12.345678 degC, 0.000999 %RH, 152340.5 ohm */
+	fake.press = (struct sensor_value){.val1 = 98, .val2 = 765432};
+	fake.temp = (struct sensor_value){.val1 = -12, .val2 = -345678};
+	fake.hum = (struct sensor_value){.val1 = 0, .val2 = 999};
+	fake.gas = (struct sensor_value){.val1 = 152340, .val2 = 500000};
+	raw = acquire_one();
+
+	zassert_equal(raw.press_pa, 98765U);
+	zassert_equal(raw.temp_c_x100, -1234);
+	zassert_equal(raw.hum_rh_x1000, 0U);
+	zassert_equal(raw.gas_ohm, 152340U, "gas is val1 only");
+}
+
+ZTEST(air_ctrl_sensor_raw, test_clamp)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	fake_set(400000, -5, -1000, -3);
+	raw = acquire_one();
+	zassert_equal(raw.temp_c_x100, INT16_MAX);
+	zassert_equal(raw.press_pa, 0U);
+	zassert_equal(raw.hum_rh_x1000, 0U);
+	zassert_equal(raw.gas_ohm, 0U);
+
+	zassert_ok(air_ctrl_sensor_init());
+	fake_set(-400000, 0, 0, 0);
+	raw = acquire_one();
+	zassert_equal(raw.temp_c_x100, INT16_MIN);
+}
+
+ZTEST(air_ctrl_sensor_raw, test_process)
+{
+	air_ctrl_sensor_data_t data;
+	air_ctrl_sensor_raw_t raw;
+
+	fake_set(-5250, 100000, 45678, 152340);
+	raw = acquire_one();
+
+	memset(&data, 0xa5, sizeof(data));
+	zassert_true(air_ctrl_sensor_process(&raw, 1, &data));
+	zassert_equal(data.timestamp_ms, (uint32_t)(raw.timestamp_ns / 1000000));
+	zassert_equal(data.raw_temp_c_x100, -525);
+	zassert_equal(data.temp_c_x100, -525);
+	zassert_equal(data.raw_hum_rh_x100, 4567U);
+	zassert_equal(data.hum_rh_x100, 4567U);
+	zassert_equal(data.press_pa, 100000U);
+	zassert_equal(data.gas_ohm, 152340U);
+
+	/* No BSEC outputs in raw mode */
+	zassert_equal(data.iaq_x10, 0U);
+	zassert_equal(data.static_iaq_x10, 0U);
+	zassert_equal(data.co2_eq_ppm, 0U);
+	zassert_equal(data.breath_voc_eq_ppb, 0U);
+	zassert_equal(data.gas_pct_x100, 0U);
+	zassert_equal(data.iaq_acc, 0U);
+	zassert_equal(data.status, 0U);
+
+	zassert_false(air_ctrl_sensor_process(NULL, 1, &data));
+	zassert_false(air_ctrl_sensor_process(&raw, 1, NULL));
+	zassert_false(air_ctrl_sensor_process(&raw, 0, &data));
+}
+
+ZTEST(air_ctrl_sensor_raw, test_process_saturation)
+{
+	air_ctrl_sensor_raw_t raw = {
+		.timestamp_ns = -1,
+		.hum_rh_x1000 = 7000000U,
+	};
+	air_ctrl_sensor_data_t data;
+
+	zassert_true(air_ctrl_sensor_process(&raw, 1, &data));
+	zassert_equal(data.timestamp_ms, 0U);
+	zassert_equal(data.raw_hum_rh_x100, UINT16_MAX);
+
+	/* The ms timestamp does not wrap after 49.7 days, only the wire formats do */
+	raw.timestamp_ns = (int64_t)(UINT32_MAX + 2LL) * 1000000LL;
+	zassert_true(air_ctrl_sensor_process(&raw, 1, &data));
+	zassert_equal(data.timestamp_ms, UINT32_MAX + 2ULL);
+}
+
+ZTEST(air_ctrl_sensor_raw, test_errors)
+{
+	air_ctrl_sensor_raw_t raw;
+
+	zassert_equal(air_ctrl_sensor_acquire(NULL, 1), 0);
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 0), 0);
+	zassert_equal(fake.fetches, 0U);
+
+	fake.fetch_err = -EIO;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0);
+	zassert_equal(fake.fetches, 1U);
+
+	zassert_ok(air_ctrl_sensor_init());
+	fake.fetch_err = 0;
+	fake.channel_err = -EIO;
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0);
+}
+
+ZTEST(air_ctrl_sensor_raw, test_period)
+{
+	air_ctrl_sensor_raw_t raw;
+	unsigned int kicks = sched_kicks;
+
+	raw = acquire_one();
+	zassert_equal(air_ctrl_sensor_get_next_call_ns(), raw.timestamp_ns + 3000000000LL);
+	zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 0, "sampled before the next deadline");
+	zassert_equal(fake.fetches, 1U);
+
+	/* A rate change wakes the sensor thread and applies on the next acquisition */
+	zassert_equal(air_ctrl_sensor_set_rate((enum air_ctrl_sensor_rate)2), -EINVAL);
+	zassert_ok(air_ctrl_sensor_set_rate(AIR_CTRL_SENSOR_RATE_ULP));
+	zassert_equal(sched_kicks, kicks + 1);
+	zassert_equal(air_ctrl_sensor_get_next_call_ns(), 0);
+	zassert_equal(air_ctrl_sensor_get_rate(), AIR_CTRL_SENSOR_RATE_LP);
+
+	raw = acquire_one();
+	zassert_equal(air_ctrl_sensor_get_rate(), AIR_CTRL_SENSOR_RATE_ULP);
+	zassert_equal(air_ctrl_sensor_get_next_call_ns(), raw.timestamp_ns + 300000000000LL);
+
+	/* Asking for the active rate again is not a change */
+	zassert_ok(air_ctrl_sensor_set_rate(AIR_CTRL_SENSOR_RATE_ULP));
+	zassert_equal(sched_kicks, kicks + 1);
+}
+
+ZTEST(air_ctrl_sensor_raw, test_outputs)
+{
+	zassert_equal(air_ctrl_sensor_set_outputs(AIR_CTRL_SENSOR_OUT_IAQ), -ENOTSUP);
+	zassert_equal(air_ctrl_sensor_get_outputs(), AIR_CTRL_SENSOR_OUT_ALL);
+}
+
+static void before(void *fixture)
+{
+	ARG_UNUSED(fixture);
+
+	memset(&fake, 0, sizeof(fake));
+	fake_set(20000, 101325, 50000, 100000);
+
+	/* Back to LP with no deadline pending */
+	(void)air_ctrl_sensor_set_rate(AIR_CTRL_SENSOR_RATE_LP);
+	zassert_ok(air_ctrl_sensor_init());
+	if (air_ctrl_sensor_get_rate() != AIR_CTRL_SENSOR_RATE_LP) {
+		air_ctrl_sensor_raw_t raw;
+
+		zassert_equal(air_ctrl_sensor_acquire(&raw, 1), 1);
+		zassert_ok(air_ctrl_sensor_init());
+		fake.fetches = 0;
+	}
+}
+
+ZTEST_SUITE(air_ctrl_sensor_raw, NULL, NULL, before, NULL, NULL);